@@ -0,0 +1,24 @@
+#!/bin/sh
+# Run the same load against the epoll and io_uring backends.
+# Usage: bench/compare_backends.sh [medis_bench options]
+# Build first with `make && make bench`. Defaults to -c 50 -n 1000000 -P 16.
+
+PORT=${PORT:-6390}
+SERVER=${SERVER:-./medis}
+BENCH=${BENCH:-./medis_bench}
+
+if [ $# -eq 0 ]; then
+    set -- -c 50 -n 1000000 -P 16
+fi
+
+for backend in epoll io_uring; do
+    $SERVER --port "$PORT" --backend "$backend" > /dev/null &
+    pid=$!
+    sleep 0.5
+
+    echo "== $backend"
+    $BENCH -p "$PORT" "$@"
+
+    kill -INT "$pid"
+    wait "$pid" 2> /dev/null
+done
@@ -0,0 +1,361 @@
+//
+// Pipelined SET/GET load generator for medis.
+//
+// Every worker thread drives its share of the connections: it writes a
+// batch of pipelined commands to each of them, then reads all replies
+// back. Compare server configurations (e.g. --io-threads 1 vs 4, or TCP
+// vs a Unix socket with -s) by running the same command line against each.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define BENCH_READ_SIZE (64 * 1024)
+
+typedef struct {
+    const char* host;
+    const char* port;
+    const char* socket_path;    // Connect over this Unix socket instead of TCP
+    int clients;
+    long requests;
+    int pipeline;
+    int threads;
+    int data_size;
+    long keyspace;
+} BenchConfig;
+
+typedef struct {
+    int fd;
+    char* rbuf;
+    size_t rlen;
+    size_t rpos;
+    long replies;           // Replies still expected for the current batch
+} BenchConn;
+
+typedef struct {
+    const BenchConfig* config;
+    pthread_t thread;
+    BenchConn* conns;
+    int conn_count;
+    long requests;          // Requests this thread sends in total
+    long errors;
+    unsigned int seed;
+    char* wbuf;
+    size_t wcap;
+} BenchThread;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int bench_connect_unix(const char* path) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) return -1;
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static int bench_connect(const BenchConfig* config) {
+    if (config->socket_path) return bench_connect_unix(config->socket_path);
+
+    struct addrinfo hints, *res, *ai;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if (getaddrinfo(config->host, config->port, &hints, &res) != 0) return -1;
+
+    int fd = -1;
+    for (ai = res; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) continue;
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+
+    if (fd >= 0) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+static bool write_all(int fd, const char* buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+// Append a multibulk command to the thread's write buffer
+static void append_command(BenchThread* t, size_t* len, int argc, const char** argv, const size_t* argv_len) {
+    size_t need = 32;
+    for (int i = 0; i < argc; i++) need += argv_len[i] + 32;
+    if (*len + need > t->wcap) {
+        while (*len + need > t->wcap) t->wcap *= 2;
+        t->wbuf = realloc(t->wbuf, t->wcap);
+        if (!t->wbuf) {
+            perror("realloc");
+            exit(1);
+        }
+    }
+
+    *len += sprintf(t->wbuf + *len, "*%d\r\n", argc);
+    for (int i = 0; i < argc; i++) {
+        *len += sprintf(t->wbuf + *len, "$%zu\r\n", argv_len[i]);
+        memcpy(t->wbuf + *len, argv[i], argv_len[i]);
+        *len += argv_len[i];
+        t->wbuf[(*len)++] = '\r';
+        t->wbuf[(*len)++] = '\n';
+    }
+}
+
+// Consume complete replies from the connection's read buffer. Returns
+// false if the buffer holds only part of the next reply.
+static bool consume_reply(BenchThread* t, BenchConn* c) {
+    char* start = c->rbuf + c->rpos;
+    char* end = c->rbuf + c->rlen;
+    char* crlf = memchr(start, '\n', end - start);
+    if (!crlf) return false;
+
+    size_t line = crlf + 1 - start;
+    if (*start == '$') {
+        long len = strtol(start + 1, NULL, 10);
+        if (len >= 0) {
+            if ((size_t)(end - start) < line + len + 2) return false;
+            line += len + 2;
+        }
+    } else if (*start == '-') {
+        t->errors++;
+    }
+
+    c->rpos += line;
+    c->replies--;
+    return true;
+}
+
+static bool read_replies(BenchThread* t, BenchConn* c) {
+    while (c->replies > 0) {
+        while (c->replies > 0 && c->rpos < c->rlen && consume_reply(t, c));
+        if (c->replies == 0) break;
+
+        // Keep the unconsumed tail and make room for more
+        if (c->rpos > 0) {
+            memmove(c->rbuf, c->rbuf + c->rpos, c->rlen - c->rpos);
+            c->rlen -= c->rpos;
+            c->rpos = 0;
+        }
+        if (c->rlen == BENCH_READ_SIZE) {
+            fprintf(stderr, "Reply larger than read buffer\n");
+            return false;
+        }
+
+        ssize_t n = read(c->fd, c->rbuf + c->rlen, BENCH_READ_SIZE - c->rlen);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            return false;
+        }
+        c->rlen += n;
+    }
+
+    c->rpos = c->rlen = 0;
+    return true;
+}
+
+static void* bench_thread_main(void* arg) {
+    BenchThread* t = arg;
+    const BenchConfig* config = t->config;
+    char* value = malloc(config->data_size);
+    memset(value, 'x', config->data_size);
+
+    long sent = 0;
+    while (sent < t->requests) {
+        // Write one batch to every connection before reading any replies,
+        // so the server sees many clients ready at once
+        int active = 0;
+        for (int i = 0; i < t->conn_count && sent < t->requests; i++) {
+            BenchConn* c = &t->conns[i];
+            size_t len = 0;
+            long batch = config->pipeline;
+            if (batch > t->requests - sent) batch = t->requests - sent;
+
+            for (long j = 0; j < batch; j++) {
+                char key[32];
+                long id = rand_r(&t->seed) % config->keyspace;
+                int key_len = snprintf(key, sizeof(key), "key:%ld", id);
+
+                if ((sent + j) % 2 == 0) {
+                    const char* argv[] = {"SET", key, value};
+                    size_t argv_len[] = {3, (size_t)key_len, (size_t)config->data_size};
+                    append_command(t, &len, 3, argv, argv_len);
+                } else {
+                    const char* argv[] = {"GET", key};
+                    size_t argv_len[] = {3, (size_t)key_len};
+                    append_command(t, &len, 2, argv, argv_len);
+                }
+            }
+
+            if (!write_all(c->fd, t->wbuf, len)) {
+                perror("write");
+                exit(1);
+            }
+            c->replies = batch;
+            sent += batch;
+            active++;
+        }
+
+        for (int i = 0; i < active; i++) {
+            if (!read_replies(t, &t->conns[i])) {
+                fprintf(stderr, "Connection lost\n");
+                exit(1);
+            }
+        }
+    }
+
+    free(value);
+    return NULL;
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr,
+            "Usage: %s [-h host] [-p port] [-s socket] [-c clients] [-n requests]\n"
+            "          [-P pipeline] [-t threads] [-d datasize] [-r keyspace]\n", prog);
+}
+
+int main(int argc, char** argv) {
+    BenchConfig config = {
+        .host = "127.0.0.1",
+        .port = "6379",
+        .socket_path = NULL,
+        .clients = 50,
+        .requests = 1000000,
+        .pipeline = 16,
+        .threads = 1,
+        .data_size = 16,
+        .keyspace = 100000
+    };
+
+    int opt;
+    while ((opt = getopt(argc, argv, "h:p:s:c:n:P:t:d:r:")) != -1) {
+        switch (opt) {
+            case 'h': config.host = optarg; break;
+            case 'p': config.port = optarg; break;
+            case 's': config.socket_path = optarg; break;
+            case 'c': config.clients = atoi(optarg); break;
+            case 'n': config.requests = atol(optarg); break;
+            case 'P': config.pipeline = atoi(optarg); break;
+            case 't': config.threads = atoi(optarg); break;
+            case 'd': config.data_size = atoi(optarg); break;
+            case 'r': config.keyspace = atol(optarg); break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (config.clients < 1 || config.requests < 1 || config.pipeline < 1 ||
+        config.threads < 1 || config.data_size < 1 || config.keyspace < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (config.threads > config.clients) config.threads = config.clients;
+
+    BenchThread* threads = calloc(config.threads, sizeof(BenchThread));
+    if (!threads) {
+        perror("calloc");
+        return 1;
+    }
+
+    // Split connections and requests evenly over the threads
+    for (int i = 0; i < config.threads; i++) {
+        BenchThread* t = &threads[i];
+        t->config = &config;
+        t->conn_count = config.clients / config.threads + (i < config.clients % config.threads);
+        t->requests = config.requests / config.threads + (i < config.requests % config.threads);
+        t->seed = (unsigned int)(i + 1) * 2654435761u;
+        t->wcap = 64 * 1024;
+        t->wbuf = malloc(t->wcap);
+        t->conns = calloc(t->conn_count, sizeof(BenchConn));
+        if (!t->wbuf || !t->conns) {
+            perror("malloc");
+            return 1;
+        }
+
+        for (int j = 0; j < t->conn_count; j++) {
+            t->conns[j].fd = bench_connect(&config);
+            t->conns[j].rbuf = malloc(BENCH_READ_SIZE);
+            if (t->conns[j].fd < 0 || !t->conns[j].rbuf) {
+                if (config.socket_path) {
+                    fprintf(stderr, "Could not connect to %s\n", config.socket_path);
+                } else {
+                    fprintf(stderr, "Could not connect to %s:%s\n", config.host, config.port);
+                }
+                return 1;
+            }
+        }
+    }
+
+    double start = now_seconds();
+    for (int i = 0; i < config.threads; i++) {
+        pthread_create(&threads[i].thread, NULL, bench_thread_main, &threads[i]);
+    }
+
+    long errors = 0;
+    for (int i = 0; i < config.threads; i++) {
+        pthread_join(threads[i].thread, NULL);
+        errors += threads[i].errors;
+    }
+    double elapsed = now_seconds() - start;
+
+    printf("SET/GET: %ld requests, %d clients, %d threads, pipeline %d, %d byte values\n",
+           config.requests, config.clients, config.threads, config.pipeline, config.data_size);
+    if (config.socket_path) {
+        printf("  unix socket %s\n", config.socket_path);
+    } else {
+        printf("  tcp %s:%s\n", config.host, config.port);
+    }
+    printf("  %.2f seconds, %.0f requests per second", elapsed, config.requests / elapsed);
+    if (errors > 0) printf(", %ld errors", errors);
+    printf("\n");
+
+    for (int i = 0; i < config.threads; i++) {
+        for (int j = 0; j < threads[i].conn_count; j++) {
+            close(threads[i].conns[j].fd);
+            free(threads[i].conns[j].rbuf);
+        }
+        free(threads[i].conns);
+        free(threads[i].wbuf);
+    }
+    free(threads);
+    return 0;
+}
@@ -0,0 +1,242 @@
+//
+// Microbenchmark of the protocol scanning and number parsing in
+// src/server/parse.c, and the double formatting in src/server/dtoa.c,
+// against the libc calls they replace.
+//
+// - crlf: find the "\r\n" ending each header line of a pipeline of SET
+//   commands, with the server's scanner and with the memchr() loop it
+//   used before
+// - int: command arguments as int64, stringToInt64() against strtoll()
+// - double: scores and coordinates, parse_double() against strtod()
+// - format: the same numbers written back for a reply, dtoa_format()
+//   against snprintf("%.17g")
+//
+// Each case runs for a fixed number of rounds over the same input and
+// prints nanoseconds per item; -n sets the rounds.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include "server/dtoa.h"
+#include "server/parse.h"
+#include "types/redis_types.h"
+
+#define BENCH_NUMBERS 4096
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Keeps results alive so the loops aren't optimized away
+static volatile uint64_t sink;
+
+static void report(const char* name, const char* impl, double elapsed, long items) {
+    printf("%-8s %-16s %8.2f ns/item\n", name, impl, elapsed * 1e9 / items);
+}
+
+// The scan the RESP parser did before parse_find_crlf()
+static const char* memchr_find_crlf(const char* buf, size_t len) {
+    const char* p = buf;
+    const char* end = buf + len;
+    while (p < end) {
+        const char* cr = memchr(p, '\r', end - p);
+        if (!cr || cr + 1 >= end) return NULL;
+        if (cr[1] == '\n') return cr;
+        p = cr + 1;
+    }
+    return NULL;
+}
+
+// A pipeline of SETs with values of 1 to value_max bytes. The offsets
+// where the parser looks for a CRLF, the start of each header line, are
+// stored in lines; payloads are skipped by their length, not scanned.
+static char* build_pipeline(int commands, int value_max, size_t* len, size_t* lines, int* line_count) {
+    char* buf = malloc((size_t)commands * (value_max + 64));
+    if (!buf) {
+        perror("malloc");
+        exit(1);
+    }
+
+    char value[4096];
+    memset(value, 'v', sizeof(value));
+    *len = 0;
+    *line_count = 0;
+    for (int i = 0; i < commands; i++) {
+        int value_len = 1 + rand() % value_max;
+        char key[32];
+        int key_len = snprintf(key, sizeof(key), "key:%d", rand() % 100000);
+
+        lines[(*line_count)++] = *len;
+        *len += sprintf(buf + *len, "*3\r\n");
+        lines[(*line_count)++] = *len;
+        *len += sprintf(buf + *len, "$3\r\nSET\r\n");
+        lines[(*line_count)++] = *len;
+        *len += sprintf(buf + *len, "$%d\r\n%s\r\n", key_len, key);
+        lines[(*line_count)++] = *len;
+        *len += sprintf(buf + *len, "$%d\r\n", value_len);
+        memcpy(buf + *len, value, value_len);
+        *len += value_len;
+        buf[(*len)++] = '\r';
+        buf[(*len)++] = '\n';
+    }
+    return buf;
+}
+
+static void bench_crlf(long rounds, int value_max) {
+    enum { COMMANDS = 1000 };
+    static size_t lines[COMMANDS * 4];
+    int line_count;
+    size_t len;
+    char* buf = build_pipeline(COMMANDS, value_max, &len, lines, &line_count);
+    char name[32];
+    snprintf(name, sizeof(name), "crlf/%d", value_max);
+
+    struct {
+        const char* impl;
+        const char* (*find)(const char*, size_t);
+    } impls[] = {{"memchr", memchr_find_crlf}, {"parse_find_crlf", parse_find_crlf}};
+
+    for (size_t k = 0; k < sizeof(impls) / sizeof(impls[0]); k++) {
+        uint64_t total = 0;
+        double start = now_seconds();
+        for (long r = 0; r < rounds; r++) {
+            for (int i = 0; i < line_count; i++) {
+                total += impls[k].find(buf + lines[i], len - lines[i]) - buf;
+            }
+        }
+        report(name, impls[k].impl, now_seconds() - start, rounds * line_count);
+        sink += total;
+    }
+    free(buf);
+}
+
+static void bench_int(long rounds) {
+    char* numbers[BENCH_NUMBERS];
+    size_t lens[BENCH_NUMBERS];
+    for (int i = 0; i < BENCH_NUMBERS; i++) {
+        char buf[32];
+        long long value = (long long)rand() * rand() % 100000000 - 1000;
+        lens[i] = snprintf(buf, sizeof(buf), "%lld", value);
+        numbers[i] = strdup(buf);
+    }
+
+    long items = rounds * BENCH_NUMBERS;
+    double start = now_seconds();
+    for (long r = 0; r < rounds; r++) {
+        for (int i = 0; i < BENCH_NUMBERS; i++) {
+            char* end;
+            sink += strtoll(numbers[i], &end, 10) + (*end != '\0');
+        }
+    }
+    report("int", "strtoll", now_seconds() - start, items);
+
+    start = now_seconds();
+    for (long r = 0; r < rounds; r++) {
+        for (int i = 0; i < BENCH_NUMBERS; i++) {
+            int64_t value;
+            sink += stringToInt64(numbers[i], lens[i], &value) ? value : 0;
+        }
+    }
+    report("int", "stringToInt64", now_seconds() - start, items);
+
+    for (int i = 0; i < BENCH_NUMBERS; i++) free(numbers[i]);
+}
+
+// Scores and coordinates as clients send them
+static size_t format_sample(char* buf, size_t size, int i) {
+    switch (i % 3) {
+        case 0: return snprintf(buf, size, "%d", rand() % 10000);
+        case 1: return snprintf(buf, size, "%.2f", rand() / 1000.0);
+        default: return snprintf(buf, size, "%.6f", rand() / (double)RAND_MAX * 360 - 180);
+    }
+}
+
+static void bench_double(long rounds) {
+    char* numbers[BENCH_NUMBERS];
+    size_t lens[BENCH_NUMBERS];
+    for (int i = 0; i < BENCH_NUMBERS; i++) {
+        char buf[32];
+        lens[i] = format_sample(buf, sizeof(buf), i);
+        numbers[i] = strdup(buf);
+    }
+
+    long items = rounds * BENCH_NUMBERS;
+    double total = 0;
+    double start = now_seconds();
+    for (long r = 0; r < rounds; r++) {
+        for (int i = 0; i < BENCH_NUMBERS; i++) {
+            char* end;
+            total += strtod(numbers[i], &end) + (*end != '\0');
+        }
+    }
+    report("double", "strtod", now_seconds() - start, items);
+
+    start = now_seconds();
+    for (long r = 0; r < rounds; r++) {
+        for (int i = 0; i < BENCH_NUMBERS; i++) {
+            double value;
+            total += parse_double(numbers[i], lens[i], &value) ? value : 0;
+        }
+    }
+    report("double", "parse_double", now_seconds() - start, items);
+    sink += (uint64_t)total;
+
+    for (int i = 0; i < BENCH_NUMBERS; i++) free(numbers[i]);
+}
+
+static void bench_format(long rounds) {
+    double numbers[BENCH_NUMBERS];
+    for (int i = 0; i < BENCH_NUMBERS; i++) {
+        char buf[32];
+        format_sample(buf, sizeof(buf), i);
+        numbers[i] = strtod(buf, NULL);
+    }
+
+    long items = rounds * BENCH_NUMBERS;
+    uint64_t total = 0;
+    double start = now_seconds();
+    for (long r = 0; r < rounds; r++) {
+        for (int i = 0; i < BENCH_NUMBERS; i++) {
+            char buf[32];
+            total += snprintf(buf, sizeof(buf), "%.17g", numbers[i]) + buf[0];
+        }
+    }
+    report("format", "snprintf", now_seconds() - start, items);
+
+    start = now_seconds();
+    for (long r = 0; r < rounds; r++) {
+        for (int i = 0; i < BENCH_NUMBERS; i++) {
+            char buf[DTOA_BUF_SIZE];
+            total += dtoa_format(buf, numbers[i]) + buf[0];
+        }
+    }
+    report("format", "dtoa_format", now_seconds() - start, items);
+    sink += total;
+}
+
+int main(int argc, char** argv) {
+    long rounds = 2000;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:")) != -1) {
+        if (opt != 'n') {
+            fprintf(stderr, "Usage: %s [-n rounds]\n", argv[0]);
+            return 1;
+        }
+        rounds = atol(optarg);
+    }
+    if (rounds <= 0) rounds = 1;
+
+    srand(1);
+    bench_crlf(rounds, 16);
+    bench_crlf(rounds, 1024);
+    bench_int(rounds);
+    bench_double(rounds);
+    bench_format(rounds);
+    return 0;
+}
@@ -6,7 +6,7 @@
 #include <stdlib.h>
 #include <string.h>
 
-#define INITIAL_CAPACITY 16
+#define INITIAL_CAPACITY 16  // Always a power of two
 #define MAX_LOAD_FACTOR 0.75f
 
 // MurmurHash2 implementation
@@ -18,7 +18,8 @@ static uint32_t murmurhash2(const char* key, size_t len) {
     const unsigned char* data = (const unsigned char*)key;
     
     while (len >= 4) {
-        uint32_t k = *(uint32_t*)data;
+        uint32_t k;
+        memcpy(&k, data, sizeof(k));
         k *= m;
         k ^= k >> r;
         k *= m;
@@ -29,8 +30,8 @@ static uint32_t murmurhash2(const char* key, size_t len) {
     }
     
     switch (len) {
-        case 3: h ^= data[2] << 16;
-        case 2: h ^= data[1] << 8;
+        case 3: h ^= data[2] << 16;  // fall through
+        case 2: h ^= data[1] << 8;   // fall through
         case 1: h ^= data[0];
                 h *= m;
     }
@@ -42,43 +43,60 @@ static uint32_t murmurhash2(const char* key, size_t len) {
     return h;
 }
 
-// Hash function
-static size_t hash(const char* key, size_t capacity) {
-    return murmurhash2(key, strlen(key)) % capacity;
+static void notify_modified(Hashmap* map, const char* key, size_t key_len) {
+    if (map->on_modified) map->on_modified(key, key_len, map->modified_data);
+}
+
+static size_t bucket_index(const Hashmap* map, uint32_t hash) {
+    return hash & (map->capacity - 1);
+}
+
+static bool entry_matches(const HashmapEntry* entry, uint32_t hash, const char* key, size_t key_len) {
+    return entry->hash == hash && entry->key_len == key_len && memcmp(entry->key, key, key_len) == 0;
 }
 
 // Resize the hashmap
 static void resize(Hashmap* map) {
     size_t old_capacity = map->capacity;
-    RedisObject** old_buckets = map->buckets;
+    HashmapEntry** old_buckets = map->buckets;
     
     map->capacity *= 2;
-    map->buckets = calloc(map->capacity, sizeof(RedisObject*));
+    map->buckets = calloc(map->capacity, sizeof(HashmapEntry*));
     if (!map->buckets) {
         map->capacity = old_capacity;
         map->buckets = old_buckets;
         return;
     }
     
+    // Entries keep their hash, so nothing is hashed again
     for (size_t i = 0; i < old_capacity; i++) {
-        if (old_buckets[i]) {
-            RedisObject* obj = old_buckets[i];
-            size_t index = hash(obj->key, map->capacity);
-            map->buckets[index] = obj;
+        HashmapEntry* entry = old_buckets[i];
+        while (entry) {
+            HashmapEntry* next = entry->next;
+            size_t index = bucket_index(map, entry->hash);
+            entry->next = map->buckets[index];
+            map->buckets[index] = entry;
+            entry = next;
         }
     }
     
     free(old_buckets);
+    map->load_factor = (float)map->size / map->capacity;
 }
 
 Hashmap* hashmap_create(size_t initial_capacity) {
     Hashmap* map = malloc(sizeof(Hashmap));
     if (!map) return NULL;
     
-    map->capacity = initial_capacity ? initial_capacity : INITIAL_CAPACITY;
+    map->capacity = INITIAL_CAPACITY;
+    while (map->capacity < initial_capacity) map->capacity *= 2;
     map->size = 0;
     map->load_factor = 0.0f;
-    map->buckets = calloc(map->capacity, sizeof(RedisObject*));
+    map->on_modified = NULL;
+    map->modified_data = NULL;
+    map->version = 0;
+    map->removed_version = 0;
+    map->buckets = calloc(map->capacity, sizeof(HashmapEntry*));
     
     if (!map->buckets) {
         free(map);
@@ -88,110 +106,138 @@ Hashmap* hashmap_create(size_t initial_capacity) {
     return map;
 }
 
-void hashmap_destroy(Hashmap* map) {
-    if (!map) return;
-    
+static void free_entries(Hashmap* map) {
     for (size_t i = 0; i < map->capacity; i++) {
-        if (map->buckets[i]) {
-            freeRedisObject(map->buckets[i]);
+        HashmapEntry* entry = map->buckets[i];
+        while (entry) {
+            HashmapEntry* next = entry->next;
+            decrRefCount(entry->value);
+            free(entry);
+            entry = next;
         }
+        map->buckets[i] = NULL;
     }
+}
+
+void hashmap_destroy(Hashmap* map) {
+    if (!map) return;
     
+    free_entries(map);
     free(map->buckets);
     free(map);
 }
 
-bool hashmap_put(Hashmap* map, const char* key, RedisObject* value) {
+static HashmapEntry* chain_find(HashmapEntry* entry, uint32_t hash, const char* key, size_t key_len) {
+    while (entry && !entry_matches(entry, hash, key, key_len)) {
+        entry = entry->next;
+    }
+    return entry;
+}
+
+// Store value under key, taking over the caller's reference. A value it
+// replaces is released; a reply may still hold it. Putting the value a
+// key already has just reports it as modified.
+bool hashmap_put(Hashmap* map, const char* key, size_t key_len, RedisObject* value) {
     if (!map || !key || !value) return false;
     
+    uint32_t hash = murmurhash2(key, key_len);
+    HashmapEntry* entry = chain_find(map->buckets[bucket_index(map, hash)], hash, key, key_len);
+    if (entry) {
+        RedisObject* old = entry->value;
+        entry->value = value;
+        value->version = ++map->version;
+        if (old != value) decrRefCount(old);
+        notify_modified(map, key, key_len);
+        return true;
+    }
+    
     // Check load factor and resize if needed
     if (map->load_factor >= MAX_LOAD_FACTOR) {
         resize(map);
     }
     
-    size_t index = hash(key, map->capacity);
-    
-    // Handle collision by chaining
-    if (map->buckets[index]) {
-        RedisObject* current = map->buckets[index];
-        while (current->next) {
-            if (strcmp(current->key, key) == 0) {
-                // Update existing key
-                freeRedisObject(current);
-                map->buckets[index] = value;
-                value->next = current->next;
-                return true;
-            }
-            current = current->next;
-        }
-        
-        if (strcmp(current->key, key) == 0) {
-            // Update existing key
-            freeRedisObject(current);
-            map->buckets[index] = value;
-            value->next = current->next;
-            return true;
-        }
-        
-        // Add to chain
-        value->next = map->buckets[index];
-        map->buckets[index] = value;
-    } else {
-        map->buckets[index] = value;
-        value->next = NULL;
-    }
+    entry = malloc(sizeof(HashmapEntry) + key_len + 1);
+    if (!entry) return false;
+    entry->value = value;
+    entry->hash = hash;
+    entry->key_len = key_len;
+    memcpy(entry->key, key, key_len);
+    entry->key[key_len] = '\0';
+    
+    size_t index = bucket_index(map, hash);
+    entry->next = map->buckets[index];
+    map->buckets[index] = entry;
     
     map->size++;
     map->load_factor = (float)map->size / map->capacity;
+    value->version = ++map->version;
+    notify_modified(map, key, key_len);
     return true;
 }
 
-RedisObject* hashmap_get(Hashmap* map, const char* key) {
+RedisObject* hashmap_get(Hashmap* map, const char* key, size_t key_len) {
     if (!map || !key) return NULL;
     
-    size_t index = hash(key, map->capacity);
-    RedisObject* current = map->buckets[index];
+    uint32_t hash = murmurhash2(key, key_len);
+    HashmapEntry* entry = chain_find(map->buckets[bucket_index(map, hash)], hash, key, key_len);
+    return entry ? entry->value : NULL;
+}
+
+// Look up keys[0], keys[step], ... storing each value, or NULL, in values.
+// Each batch is hashed and its buckets prefetched first, then the first
+// entry of each chain, so the cache misses of a batch overlap instead of
+// being taken one lookup after another. Also warms the cache for writes
+// to the same keys right after.
+void hashmap_get_many(Hashmap* map, char** keys, const size_t* key_lens, size_t count, size_t step,
+                      RedisObject** values) {
+    uint32_t hashes[HASHMAP_BATCH];
     
-    while (current) {
-        if (strcmp(current->key, key) == 0) {
-            return current;
+    for (size_t start = 0; start < count; start += HASHMAP_BATCH) {
+        size_t n = count - start < HASHMAP_BATCH ? count - start : HASHMAP_BATCH;
+        char** batch = keys + start * step;
+        const size_t* batch_lens = key_lens + start * step;
+        
+        for (size_t i = 0; i < n; i++) {
+            hashes[i] = murmurhash2(batch[i * step], batch_lens[i * step]);
+            __builtin_prefetch(&map->buckets[bucket_index(map, hashes[i])]);
+        }
+        for (size_t i = 0; i < n; i++) {
+            HashmapEntry* head = map->buckets[bucket_index(map, hashes[i])];
+            if (head) __builtin_prefetch(head);
+        }
+        for (size_t i = 0; i < n; i++) {
+            HashmapEntry* entry = chain_find(map->buckets[bucket_index(map, hashes[i])], hashes[i],
+                                             batch[i * step], batch_lens[i * step]);
+            values[start + i] = entry ? entry->value : NULL;
         }
-        current = current->next;
     }
-    
-    return NULL;
 }
 
-bool hashmap_remove(Hashmap* map, const char* key) {
+bool hashmap_remove(Hashmap* map, const char* key, size_t key_len) {
     if (!map || !key) return false;
     
-    size_t index = hash(key, map->capacity);
-    RedisObject* current = map->buckets[index];
-    RedisObject* prev = NULL;
-    
-    while (current) {
-        if (strcmp(current->key, key) == 0) {
-            if (prev) {
-                prev->next = current->next;
-            } else {
-                map->buckets[index] = current->next;
-            }
-            
-            freeRedisObject(current);
-            map->size--;
-            map->load_factor = (float)map->size / map->capacity;
-            return true;
-        }
-        
-        prev = current;
-        current = current->next;
+    uint32_t hash = murmurhash2(key, key_len);
+    HashmapEntry** link = &map->buckets[bucket_index(map, hash)];
+    while (*link && !entry_matches(*link, hash, key, key_len)) {
+        link = &(*link)->next;
     }
+    if (!*link) return false;
     
-    return false;
+    HashmapEntry* entry = *link;
+    *link = entry->next;
+    
+    // The key may point into the value or the entry, so report it first
+    map->removed_version = ++map->version;
+    notify_modified(map, key, key_len);
+    decrRefCount(entry->value);
+    free(entry);
+    map->size--;
+    map->load_factor = (float)map->size / map->capacity;
+    return true;
 }
 
-bool hashmap_contains(Hashmap* map, const char* key) {
-    return hashmap_get(map, key) != NULL;
+bool hashmap_contains(Hashmap* map, const char* key, size_t key_len) {
+    return hashmap_get(map, key, key_len) != NULL;
 }
 
 size_t hashmap_size(Hashmap* map) {
@@ -201,13 +247,30 @@ size_t hashmap_size(Hashmap* map) {
 void hashmap_clear(Hashmap* map) {
     if (!map) return;
     
-    for (size_t i = 0; i < map->capacity; i++) {
-        if (map->buckets[i]) {
-            freeRedisObject(map->buckets[i]);
-            map->buckets[i] = NULL;
-        }
-    }
-    
+    free_entries(map);
     map->size = 0;
     map->load_factor = 0.0f;
+    map->removed_version = ++map->version;
+    notify_modified(map, NULL, 0);
+}
+
+// Report a change made to a value in place, without hashmap_put()
+void hashmap_touch(Hashmap* map, const char* key, size_t key_len) {
+    RedisObject* obj = hashmap_get(map, key, key_len);
+    if (!obj) return;
+    obj->version = ++map->version;
+    notify_modified(map, key, key_len);
+}
+
+// A number that changes whenever the key does, for WATCH. A missing key
+// reports the last removal of any key, so deleting it, or creating and
+// deleting it again, is seen as a change too; other removals may also be.
+uint64_t hashmap_version(Hashmap* map, const char* key, size_t key_len) {
+    RedisObject* obj = hashmap_get(map, key, key_len);
+    return obj ? obj->version : map->removed_version;
+}
+
+void hashmap_set_modified_hook(Hashmap* map, HashmapModifiedProc proc, void* data) {
+    map->on_modified = proc;
+    map->modified_data = data;
 }
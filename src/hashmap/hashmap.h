@@ -6,22 +6,48 @@
 #include <stddef.h>  // for size_t
 #include "../types/redis_types.h"
 
+#define HASHMAP_BATCH 16  // Lookups hashmap_get_many() overlaps
+
+// Called once a key has been set, changed in place or removed; key is
+// NULL when the whole map is cleared
+typedef void (*HashmapModifiedProc)(const char* key, size_t key_len, void* data);
+
+// A key and its value. The key is stored length-prefixed right after the
+// entry, so keys are binary-safe, and a lookup compares hash and length
+// before it looks at any bytes.
+typedef struct HashmapEntry {
+    struct HashmapEntry* next;
+    RedisObject* value;
+    uint32_t hash;
+    size_t key_len;
+    char key[];             // NUL-terminated too
+} HashmapEntry;
+
 // Hash map structure
 typedef struct {
-    RedisObject** buckets;
+    HashmapEntry** buckets;
     size_t size;
-    size_t capacity;
+    size_t capacity;        // A power of two
     float load_factor;
+    HashmapModifiedProc on_modified;  // Optional, e.g. to invalidate client caches
+    void* modified_data;
+    uint64_t version;           // Bumped by every change, see hashmap_version()
+    uint64_t removed_version;   // Version of the last removal
 } Hashmap;
 
 // Function declarations
 Hashmap* hashmap_create(size_t initial_capacity);
 void hashmap_destroy(Hashmap* map);
-bool hashmap_put(Hashmap* map, const char* key, RedisObject* value);
-RedisObject* hashmap_get(Hashmap* map, const char* key);
-bool hashmap_remove(Hashmap* map, const char* key);
-bool hashmap_contains(Hashmap* map, const char* key);
+bool hashmap_put(Hashmap* map, const char* key, size_t key_len, RedisObject* value);
+RedisObject* hashmap_get(Hashmap* map, const char* key, size_t key_len);
+void hashmap_get_many(Hashmap* map, char** keys, const size_t* key_lens, size_t count, size_t step,
+                      RedisObject** values);
+bool hashmap_remove(Hashmap* map, const char* key, size_t key_len);
+bool hashmap_contains(Hashmap* map, const char* key, size_t key_len);
 size_t hashmap_size(Hashmap* map);
 void hashmap_clear(Hashmap* map);
+void hashmap_touch(Hashmap* map, const char* key, size_t key_len);
+uint64_t hashmap_version(Hashmap* map, const char* key, size_t key_len);
+void hashmap_set_modified_hook(Hashmap* map, HashmapModifiedProc proc, void* data);
 
 #endif // HASHMAP_H
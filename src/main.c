@@ -3,33 +3,286 @@
 //
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <signal.h>
-#include "server/redis_server.h"
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "server/server.h"
+#include "server/io_threads.h"
+#include "server/shard.h"
 
-RedisServer* server = NULL;
+Server* server = NULL;
+Server** shard_servers = NULL;
+int shard_count = 0;
+
+static void stop_shards(void) {
+    for (int i = 0; i < shard_count; i++) {
+        if (shard_servers[i]) server_stop(shard_servers[i]);
+    }
+}
 
 void signal_handler(int signum) {
-    if (server) {
+    (void)signum;
+    if (server || shard_servers) {
         printf("\nShutting down Redis server...\n");
-        stopRedisServer(server);
     }
+    if (server) server_stop(server);
+    stop_shards();
+}
+
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [--host addr] [--port port] [--maxclients n] [--io-threads n] [--shards n]\n", prog);
+    fprintf(stderr, "       [--backend epoll|io_uring] [--unixsocket path]\n");
+    fprintf(stderr, "       [--client-output-buffer-limit normal|pubsub hard soft seconds]\n");
+    fprintf(stderr, "       [--tracking-table-max-keys n] [--reply-cache max-bytes min-reads]\n");
+    fprintf(stderr, "       [--client-budget commands usec]\n");
+    fprintf(stderr, "  --shards 0 starts one shard per CPU\n");
+    fprintf(stderr, "  With --shards, multi-key commands need their keys on one shard: give\n");
+    fprintf(stderr, "  them a common {tag}, e.g. {user1}:a {user1}:b, or they fail with CROSSSLOT\n");
+    fprintf(stderr, "  --port 0 listens on the Unix socket only\n");
+    fprintf(stderr, "  Limits are bytes with an optional k, m or g suffix; 0 disables one\n");
+    fprintf(stderr, "  --client-budget caps what one client runs per loop iteration; 0 disables a cap\n");
+}
+
+// Parse a byte count such as 512, 64k, 32m or 1g
+static bool parse_bytes(const char* str, size_t* out) {
+    char* end;
+    unsigned long long value = strtoull(str, &end, 10);
+    if (end == str || *str == '-') return false;
+
+    switch (*end) {
+        case 'k': case 'K': value <<= 10; end++; break;
+        case 'm': case 'M': value <<= 20; end++; break;
+        case 'g': case 'G': value <<= 30; end++; break;
+    }
+    if (*end != '\0') return false;
+
+    *out = (size_t)value;
+    return true;
+}
+
+// --client-output-buffer-limit <class> <hard> <soft> <seconds>
+static bool parse_reply_limit(char** args, ReplyLimit* limits) {
+    ClientClass class;
+    if (strcmp(args[0], "normal") == 0) {
+        class = CLIENT_CLASS_NORMAL;
+    } else if (strcmp(args[0], "pubsub") == 0) {
+        class = CLIENT_CLASS_PUBSUB;
+    } else {
+        return false;
+    }
+
+    ReplyLimit limit;
+    char* end;
+    if (!parse_bytes(args[1], &limit.hard_bytes) || !parse_bytes(args[2], &limit.soft_bytes)) return false;
+    long seconds = strtol(args[3], &end, 10);
+    if (*end != '\0' || end == args[3] || seconds < 0 || seconds > INT_MAX) return false;
+    limit.soft_seconds = (int)seconds;
+
+    limits[class] = limit;
+    return true;
+}
+
+static void* shard_thread_main(void* arg) {
+    // Without this shard the others would forward to a dead queue
+    if (!server_start(arg)) stop_shards();
+    return NULL;
+}
+
+// Shared-nothing mode: one event loop thread and keyspace shard per core,
+// all accepting on the same port
+static int run_shards(const char* host, int port, int max_clients, int count, const ReplyLimit* limits,
+                      size_t reply_cache_bytes, uint32_t reply_cache_reads,
+                      size_t budget_commands, uint32_t budget_usec) {
+    int per_shard = (max_clients + count - 1) / count;
+    shard_servers = calloc(count, sizeof(Server*));
+    pthread_t* threads = calloc(count, sizeof(pthread_t));
+    if (!shard_servers || !threads) {
+        fprintf(stderr, "Failed to allocate shards\n");
+        return 1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        shard_servers[i] = server_create(host, (uint16_t)port, per_shard);
+        if (!shard_servers[i]) {
+            fprintf(stderr, "Failed to create Redis server\n");
+            return 1;
+        }
+        memcpy(shard_servers[i]->config.reply_limits, limits, sizeof(shard_servers[i]->config.reply_limits));
+        shard_servers[i]->config.reply_cache_max_bytes = reply_cache_bytes;
+        shard_servers[i]->config.reply_cache_min_reads = reply_cache_reads;
+        shard_servers[i]->config.client_budget_commands = budget_commands;
+        shard_servers[i]->config.client_budget_usec = budget_usec;
+    }
+
+    ShardGroup* group = shard_group_create(shard_servers, count);
+    if (!group) {
+        fprintf(stderr, "Failed to create shards\n");
+        return 1;
+    }
+    shard_count = count;
+
+    // Shard 0 runs on the main thread
+    int started = 1;
+    for (int i = 1; i < count; i++) {
+        if (pthread_create(&threads[i], NULL, shard_thread_main, shard_servers[i]) != 0) {
+            perror("Failed to start shard thread");
+            break;
+        }
+        started++;
+    }
+
+    int status = 0;
+    if (started < count || !server_start(shard_servers[0])) {
+        fprintf(stderr, "Failed to start Redis server\n");
+        status = 1;
+    }
+
+    // Cleanup
+    stop_shards();
+    for (int i = 1; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    shard_count = 0;
+    shard_group_destroy(group);
+    for (int i = 0; i < count; i++) {
+        server_destroy(shard_servers[i]);
+    }
+    free(shard_servers);
+    shard_servers = NULL;
+    free(threads);
+    return status;
 }
 
-int main() {
+int main(int argc, char** argv) {
+    const char* host = DEFAULT_HOST;
+    int port = DEFAULT_PORT;
+    int max_clients = MAX_CLIENTS;
+    int io_threads = 1;
+    int shards = 1;
+    const char* unix_socket = NULL;
+    long long tracking_max_keys = TRACKING_TABLE_MAX_KEYS;
+    size_t reply_cache_bytes = REPLY_CACHE_MAX_BYTES;
+    long long reply_cache_reads = REPLY_CACHE_MIN_READS;
+    long long budget_commands = CLIENT_BUDGET_COMMANDS;
+    long long budget_usec = CLIENT_BUDGET_USEC;
+    ReplyLimit limits[CLIENT_CLASS_COUNT];
+    server_default_reply_limits(limits);
+    ServerBackend backend = SERVER_BACKEND_EPOLL;
+
+    // Parse command line options
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return 1;
+        }
+
+        if (strcmp(argv[i], "--host") == 0) {
+            host = argv[++i];
+        } else if (strcmp(argv[i], "--port") == 0) {
+            port = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--maxclients") == 0) {
+            max_clients = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--io-threads") == 0) {
+            io_threads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--shards") == 0) {
+            shards = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--client-output-buffer-limit") == 0) {
+            if (i + 4 >= argc || !parse_reply_limit(argv + i + 1, limits)) {
+                usage(argv[0]);
+                return 1;
+            }
+            i += 4;
+        } else if (strcmp(argv[i], "--tracking-table-max-keys") == 0) {
+            tracking_max_keys = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--reply-cache") == 0) {
+            if (i + 2 >= argc || !parse_bytes(argv[i + 1], &reply_cache_bytes)) {
+                usage(argv[0]);
+                return 1;
+            }
+            reply_cache_reads = atoll(argv[i + 2]);
+            i += 2;
+        } else if (strcmp(argv[i], "--client-budget") == 0) {
+            if (i + 2 >= argc) {
+                usage(argv[0]);
+                return 1;
+            }
+            budget_commands = atoll(argv[i + 1]);
+            budget_usec = atoll(argv[i + 2]);
+            i += 2;
+        } else if (strcmp(argv[i], "--unixsocket") == 0) {
+            unix_socket = argv[++i];
+        } else if (strcmp(argv[i], "--backend") == 0) {
+            const char* name = argv[++i];
+            if (strcmp(name, "epoll") == 0) {
+                backend = SERVER_BACKEND_EPOLL;
+            } else if (strcmp(name, "io_uring") == 0) {
+                backend = SERVER_BACKEND_IO_URING;
+            } else {
+                usage(argv[0]);
+                return 1;
+            }
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (shards == 0) shards = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (port < 0 || port > 65535 || (port == 0 && !unix_socket) || max_clients <= 0 ||
+        io_threads < 1 || io_threads > IO_THREADS_MAX || tracking_max_keys < 0 ||
+        reply_cache_reads < 0 || reply_cache_reads > UINT32_MAX ||
+        budget_commands < 0 || budget_usec < 0 || budget_usec > UINT32_MAX ||
+        shards < 1 || shards > SHARDS_MAX) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (shards > 1 && io_threads > 1) {
+        fprintf(stderr, "--shards and --io-threads can't be combined\n");
+        return 1;
+    }
+    if (shards > 1 && unix_socket) {
+        fprintf(stderr, "--unixsocket can't be combined with --shards\n");
+        return 1;
+    }
+    if (backend == SERVER_BACKEND_IO_URING && (shards > 1 || io_threads > 1)) {
+        fprintf(stderr, "--backend io_uring can't be combined with --shards or --io-threads\n");
+        return 1;
+    }
+
     // Set up signal handling
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
 
+    if (shards > 1) {
+        return run_shards(host, port, max_clients, shards, limits, reply_cache_bytes, (uint32_t)reply_cache_reads,
+                          (size_t)budget_commands, (uint32_t)budget_usec);
+    }
+
     // Create and start server
-    server = createRedisServer(DEFAULT_PORT);
+    server = server_create(host, (uint16_t)port, max_clients);
     if (!server) {
         fprintf(stderr, "Failed to create Redis server\n");
         return 1;
     }
+    server->config.io_threads = io_threads;
+    server->config.backend = backend;
+    server->config.unix_socket = unix_socket;
+    memcpy(server->config.reply_limits, limits, sizeof(server->config.reply_limits));
+    server->config.tracking_table_max_keys = (size_t)tracking_max_keys;
+    server->config.reply_cache_max_bytes = reply_cache_bytes;
+    server->config.reply_cache_min_reads = (uint32_t)reply_cache_reads;
+    server->config.client_budget_commands = (size_t)budget_commands;
+    server->config.client_budget_usec = (uint32_t)budget_usec;
 
-    startRedisServer(server);
+    if (!server_start(server)) {
+        fprintf(stderr, "Failed to start Redis server\n");
+        server_destroy(server);
+        return 1;
+    }
 
     // Cleanup
-    freeRedisServer(server);
+    server_destroy(server);
     return 0;
-}
\ No newline at end of file
+}
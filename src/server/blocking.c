@@ -0,0 +1,353 @@
+#include "blocking.h"
+#include "parse.h"
+#include "shard.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define BLOCKING_INITIAL_BUCKETS 16
+
+// A blocked client's place in the queue of one key
+typedef struct BlockWaiter {
+    Client* client;
+    struct BlockedKey* key;
+    struct BlockWaiter* prev;
+    struct BlockWaiter* next;
+} BlockWaiter;
+
+// Clients blocked on one key, served first come first served
+typedef struct BlockedKey {
+    char* name;
+    size_t name_len;
+    BlockWaiter* head;
+    BlockWaiter* tail;
+    bool ready;                 // Listed in BlockingState.ready
+    struct BlockedKey* next;    // Bucket chain
+} BlockedKey;
+
+// A key pushed to, kept by name as its waiters may be gone by the time
+// it is handled
+typedef struct {
+    char* name;
+    size_t name_len;
+} ReadyKey;
+
+// Keys with blocked clients. A key is dropped with its last waiter, so
+// pushes to keys nobody waits on cost a single failed lookup.
+typedef struct BlockingState {
+    BlockedKey** buckets;
+    size_t bucket_count;        // Power of two
+    size_t key_count;
+    ReadyKey* ready;            // Keys pushed to since the last handle_ready_keys()
+    size_t ready_count;
+    size_t ready_capacity;
+} BlockingState;
+
+static void block_timeout(TimerQueue* timers, void* data);
+
+// FNV-1a
+static size_t blocking_hash(const char* key, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)key[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Keys are binary-safe; the copy is NUL-terminated as well
+static char* copy_key(const char* key, size_t len) {
+    char* copy = malloc(len + 1);
+    if (!copy) return NULL;
+    memcpy(copy, key, len);
+    copy[len] = '\0';
+    return copy;
+}
+
+BlockingState* blocking_create(void) {
+    BlockingState* state = calloc(1, sizeof(BlockingState));
+    if (!state) return NULL;
+    
+    state->bucket_count = BLOCKING_INITIAL_BUCKETS;
+    state->buckets = calloc(state->bucket_count, sizeof(BlockedKey*));
+    if (!state->buckets) {
+        free(state);
+        return NULL;
+    }
+    return state;
+}
+
+// Release every blocked client without a reply. Proxies parked for
+// other shards are freed along with their commands.
+void blocking_destroy(Server* server) {
+    BlockingState* state = server->blocking;
+    if (!state) return;
+    
+    for (size_t i = 0; i < state->bucket_count; i++) {
+        while (state->buckets[i]) {
+            Client* client = state->buckets[i]->head->client;
+            unblock_client(server, client);
+            if (client->shard_msg) {
+                shard_message_free(client->shard_msg);
+                client_free(client);
+            }
+        }
+    }
+    
+    for (size_t i = 0; i < state->ready_count; i++) {
+        free(state->ready[i].name);
+    }
+    free(state->ready);
+    free(state->buckets);
+    free(state);
+    server->blocking = NULL;
+}
+
+static BlockedKey* blocked_key_find(BlockingState* state, const char* name, size_t len) {
+    BlockedKey* bk = state->buckets[blocking_hash(name, len) & (state->bucket_count - 1)];
+    while (bk && (bk->name_len != len || memcmp(bk->name, name, len) != 0)) bk = bk->next;
+    return bk;
+}
+
+// Double the buckets once there are more keys than buckets
+static void blocking_grow(BlockingState* state) {
+    size_t count = state->bucket_count * 2;
+    BlockedKey** buckets = calloc(count, sizeof(BlockedKey*));
+    if (!buckets) return;
+    
+    for (size_t i = 0; i < state->bucket_count; i++) {
+        BlockedKey* bk = state->buckets[i];
+        while (bk) {
+            BlockedKey* next = bk->next;
+            size_t index = blocking_hash(bk->name, bk->name_len) & (count - 1);
+            bk->next = buckets[index];
+            buckets[index] = bk;
+            bk = next;
+        }
+    }
+    
+    free(state->buckets);
+    state->buckets = buckets;
+    state->bucket_count = count;
+}
+
+static BlockedKey* blocked_key_get(BlockingState* state, const char* name, size_t len) {
+    BlockedKey* bk = blocked_key_find(state, name, len);
+    if (bk) return bk;
+    
+    bk = calloc(1, sizeof(BlockedKey));
+    if (!bk) return NULL;
+    bk->name = copy_key(name, len);
+    if (!bk->name) {
+        free(bk);
+        return NULL;
+    }
+    bk->name_len = len;
+    
+    if (state->key_count >= state->bucket_count) blocking_grow(state);
+    size_t index = blocking_hash(name, len) & (state->bucket_count - 1);
+    bk->next = state->buckets[index];
+    state->buckets[index] = bk;
+    state->key_count++;
+    return bk;
+}
+
+static void blocked_key_drop(BlockingState* state, BlockedKey* bk) {
+    BlockedKey** link = &state->buckets[blocking_hash(bk->name, bk->name_len) & (state->bucket_count - 1)];
+    while (*link != bk) link = &(*link)->next;
+    *link = bk->next;
+    state->key_count--;
+    free(bk->name);
+    free(bk);
+}
+
+// Park the client until a push to one of the keys serves it, or until
+// timeout_ms passes; 0 waits forever. ids, if given, holds the last
+// stream ID seen per key. Fields specific to the command (pop_front,
+// target, ...) are set by the caller beforehand. Returns false if out
+// of memory, with the client left unblocked.
+bool block_client(Server* server, Client* client, BlockType type, char** keys, const size_t* key_lens,
+                  char** ids, int key_count, int64_t timeout_ms) {
+    BlockingState* state = server->blocking;
+    BlockState* block = &client->block;
+    
+    block->type = type;
+    block->keys = calloc(key_count, sizeof(char*));
+    block->key_lens = calloc(key_count, sizeof(size_t));
+    block->waiters = calloc(key_count, sizeof(BlockWaiter*));
+    if (ids) block->ids = calloc(key_count, sizeof(char*));
+    if (!block->keys || !block->key_lens || !block->waiters || (ids && !block->ids)) goto fail;
+    
+    for (int i = 0; i < key_count; i++) {
+        // A key named twice is waited on once
+        bool seen = false;
+        for (int j = 0; j < block->key_count && !seen; j++) {
+            seen = block->key_lens[j] == key_lens[i] && memcmp(block->keys[j], keys[i], key_lens[i]) == 0;
+        }
+        if (seen) continue;
+        
+        char* name = copy_key(keys[i], key_lens[i]);
+        char* id = ids ? strdup(ids[i]) : NULL;
+        BlockWaiter* waiter = malloc(sizeof(BlockWaiter));
+        BlockedKey* bk = name && (!ids || id) && waiter ? blocked_key_get(state, keys[i], key_lens[i]) : NULL;
+        if (!bk) {
+            free(name);
+            free(id);
+            free(waiter);
+            goto fail;
+        }
+        
+        waiter->client = client;
+        waiter->key = bk;
+        waiter->next = NULL;
+        waiter->prev = bk->tail;
+        if (bk->tail) {
+            bk->tail->next = waiter;
+        } else {
+            bk->head = waiter;
+        }
+        bk->tail = waiter;
+        
+        block->keys[block->key_count] = name;
+        block->key_lens[block->key_count] = key_lens[i];
+        block->waiters[block->key_count] = waiter;
+        if (ids) block->ids[block->key_count] = id;
+        block->key_count++;
+    }
+    
+    if (timeout_ms > 0) {
+        block->timer = timer_add(&server->timers, monotonic_ms() + timeout_ms, block_timeout, client);
+        if (!block->timer) goto fail;
+    }
+    return true;
+
+fail:
+    unblock_client(server, client);
+    return false;
+}
+
+// Take the client out of every queue it waits in, without replying
+void unblock_client(Server* server, Client* client) {
+    BlockState* block = &client->block;
+    if (block->type == BLOCK_NONE) return;
+    
+    for (int i = 0; i < block->key_count; i++) {
+        BlockWaiter* waiter = block->waiters[i];
+        BlockedKey* bk = waiter->key;
+        if (waiter->prev) {
+            waiter->prev->next = waiter->next;
+        } else {
+            bk->head = waiter->next;
+        }
+        if (waiter->next) {
+            waiter->next->prev = waiter->prev;
+        } else {
+            bk->tail = waiter->prev;
+        }
+        if (!bk->head) blocked_key_drop(server->blocking, bk);
+        
+        free(waiter);
+        free(block->keys[i]);
+        if (block->ids) free(block->ids[i]);
+    }
+    
+    timer_cancel(&server->timers, block->timer);
+    free(block->keys);
+    free(block->key_lens);
+    free(block->waiters);
+    free(block->ids);
+    free(block->target);
+    memset(block, 0, sizeof(BlockState));
+}
+
+// Answer a client whose timeout has passed as if nothing had arrived
+static void block_timeout(TimerQueue* timers, void* data) {
+    Server* server = timers->data;
+    Client* client = data;
+    
+    // The timer is already gone
+    client->block.timer = NULL;
+    if (client->block.target) {
+        send_null(client);
+    } else {
+        send_null_array(client);
+    }
+    
+    unblock_client(server, client);
+    server_unblocked_client(server, client);
+}
+
+// Note that key was pushed to. Its waiters are served after the command,
+// so they see the command's whole effect and its reply comes first.
+void signal_key_ready(Server* server, const char* key, size_t key_len) {
+    BlockingState* state = server->blocking;
+    if (state->key_count == 0) return;
+    
+    BlockedKey* bk = blocked_key_find(state, key, key_len);
+    if (!bk || bk->ready) return;
+    
+    if (state->ready_count == state->ready_capacity) {
+        size_t capacity = state->ready_capacity ? state->ready_capacity * 2 : 16;
+        ReadyKey* ready = realloc(state->ready, capacity * sizeof(ReadyKey));
+        if (!ready) return;
+        state->ready = ready;
+        state->ready_capacity = capacity;
+    }
+    
+    char* name = copy_key(key, key_len);
+    if (!name) return;
+    state->ready[state->ready_count++] = (ReadyKey){name, key_len};
+    bk->ready = true;
+}
+
+// Offer the key to its waiters in the order they blocked
+static void serve_key(Server* server, BlockedKey* bk) {
+    BlockWaiter* waiter = bk->head;
+    while (waiter) {
+        // Unblocking a client only removes its own waiter, and the key
+        // outlives it as long as another one follows
+        BlockWaiter* next = waiter->next;
+        Client* client = waiter->client;
+        
+        bool served = client->block.type == BLOCK_LIST ? serve_blocked_list(server, client, bk->name, bk->name_len)
+                                                       : serve_blocked_stream(server, client);
+        if (served) {
+            unblock_client(server, client);
+            server_unblocked_client(server, client);
+        }
+        waiter = next;
+    }
+}
+
+// Serve clients blocked on the keys signalled since the last call
+void handle_ready_keys(Server* server) {
+    BlockingState* state = server->blocking;
+    
+    // A BLMOVE served here pushes to its destination, which may add
+    // keys to the end of the list while it is walked and move the list,
+    // so the entry is copied out first
+    for (size_t i = 0; i < state->ready_count; i++) {
+        ReadyKey ready = state->ready[i];
+        BlockedKey* bk = blocked_key_find(state, ready.name, ready.name_len);
+        if (bk) {
+            bk->ready = false;
+            serve_key(server, bk);
+        }
+        free(ready.name);
+    }
+    state->ready_count = 0;
+}
+
+// Parse a timeout in seconds (BLPOP) or milliseconds (XREAD BLOCK).
+// Fractions are rounded up so a short timeout doesn't become 0, which
+// means waiting forever.
+bool parse_block_timeout(const char* arg, bool seconds, int64_t* timeout_ms) {
+    double value;
+    if (!parse_double(arg, strlen(arg), &value) || !isfinite(value) || value < 0) return false;
+    
+    if (seconds) value *= 1000;
+    if (value > (double)(INT64_MAX / 2)) return false;
+    *timeout_ms = (int64_t)ceil(value);
+    return true;
+}
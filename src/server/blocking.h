@@ -0,0 +1,23 @@
+#ifndef BLOCKING_H
+#define BLOCKING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "server.h"
+
+// Function declarations
+struct BlockingState* blocking_create(void);
+void blocking_destroy(Server* server);
+bool block_client(Server* server, Client* client, BlockType type, char** keys, const size_t* key_lens,
+                  char** ids, int key_count, int64_t timeout_ms);
+void unblock_client(Server* server, Client* client);
+void signal_key_ready(Server* server, const char* key, size_t key_len);
+void handle_ready_keys(Server* server);
+bool parse_block_timeout(const char* arg, bool seconds, int64_t* timeout_ms);
+
+// Serve a client blocked on key now that it may have data, implemented
+// next to the commands. Return false if there was nothing for it.
+bool serve_blocked_list(Server* server, Client* client, const char* key, size_t key_len);
+bool serve_blocked_stream(Server* server, Client* client);
+
+#endif // BLOCKING_H
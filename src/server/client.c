@@ -0,0 +1,326 @@
+#include "server.h"
+#include "multi.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define COMMAND_QUEUE_INITIAL 16
+
+static bool command_queue_init(CommandQueue* queue) {
+    queue->argv_capacity = COMMAND_QUEUE_INITIAL;
+    queue->capacity = COMMAND_QUEUE_INITIAL;
+    queue->argv = malloc(queue->argv_capacity * sizeof(char*));
+    queue->argv_len = malloc(queue->argv_capacity * sizeof(size_t));
+    queue->argv_owned = malloc(queue->argv_capacity * sizeof(char*));
+    queue->argc = malloc(queue->capacity * sizeof(int));
+    queue->argv_start = malloc(queue->capacity * sizeof(size_t));
+    queue->frame_len = malloc(queue->capacity * sizeof(size_t));
+    queue->argv_count = 0;
+    queue->count = 0;
+    queue->next = 0;
+    
+    return queue->argv && queue->argv_len && queue->argv_owned && queue->argc &&
+           queue->argv_start && queue->frame_len;
+}
+
+static void command_queue_free(CommandQueue* queue) {
+    // Big bulks of commands that never ran
+    if (queue->argv_owned) {
+        for (size_t i = 0; i < queue->argv_count; i++) {
+            free(queue->argv_owned[i]);
+        }
+    }
+    free(queue->argv);
+    free(queue->argv_len);
+    free(queue->argv_owned);
+    free(queue->argc);
+    free(queue->argv_start);
+    free(queue->frame_len);
+    memset(queue, 0, sizeof(CommandQueue));
+}
+
+// Append the command the parser just completed, taking over its big bulks
+static bool command_queue_push(CommandQueue* queue, RespParser* parser, size_t frame_len) {
+    size_t argc = parser->argc;
+    
+    if (queue->argv_count + argc > queue->argv_capacity) {
+        size_t capacity = queue->argv_capacity * 2;
+        while (capacity < queue->argv_count + argc) capacity *= 2;
+        
+        char** argv = realloc(queue->argv, capacity * sizeof(char*));
+        if (!argv) return false;
+        queue->argv = argv;
+        
+        size_t* argv_len = realloc(queue->argv_len, capacity * sizeof(size_t));
+        if (!argv_len) return false;
+        queue->argv_len = argv_len;
+        
+        char** argv_owned = realloc(queue->argv_owned, capacity * sizeof(char*));
+        if (!argv_owned) return false;
+        queue->argv_owned = argv_owned;
+        
+        queue->argv_capacity = capacity;
+    }
+    
+    if (queue->count == queue->capacity) {
+        size_t capacity = queue->capacity * 2;
+        
+        int* argcs = realloc(queue->argc, capacity * sizeof(int));
+        if (!argcs) return false;
+        queue->argc = argcs;
+        
+        size_t* starts = realloc(queue->argv_start, capacity * sizeof(size_t));
+        if (!starts) return false;
+        queue->argv_start = starts;
+        
+        size_t* frames = realloc(queue->frame_len, capacity * sizeof(size_t));
+        if (!frames) return false;
+        queue->frame_len = frames;
+        
+        queue->capacity = capacity;
+    }
+    
+    memcpy(queue->argv + queue->argv_count, parser->argv, argc * sizeof(char*));
+    memcpy(queue->argv_len + queue->argv_count, parser->argv_len, argc * sizeof(size_t));
+    memcpy(queue->argv_owned + queue->argv_count, parser->arg_owned, argc * sizeof(char*));
+    memset(parser->arg_owned, 0, argc * sizeof(char*));
+    queue->argc[queue->count] = (int)argc;
+    queue->argv_start[queue->count] = queue->argv_count;
+    queue->frame_len[queue->count] = frame_len;
+    queue->argv_count += argc;
+    queue->count++;
+    return true;
+}
+
+Client* client_create(int fd) {
+    Client* client = malloc(sizeof(Client));
+    if (!client) return NULL;
+    
+    memset(client, 0, sizeof(Client));
+    client->fd = fd;
+    client->buffer = malloc(BUFFER_SIZE);
+    if (!client->buffer) {
+        free(client);
+        return NULL;
+    }
+    client->buffer_size = BUFFER_SIZE;
+    client->io_status = CLIENT_IO_OK;
+    
+    if (!resp_parser_init(&client->parser)) {
+        free(client->buffer);
+        free(client);
+        return NULL;
+    }
+    
+    if (!command_queue_init(&client->commands)) {
+        command_queue_free(&client->commands);
+        resp_parser_free(&client->parser);
+        free(client->buffer);
+        free(client);
+        return NULL;
+    }
+    
+    if (!client_init_reply(client)) {
+        command_queue_free(&client->commands);
+        resp_parser_free(&client->parser);
+        free(client->buffer);
+        free(client);
+        return NULL;
+    }
+    
+    return client;
+}
+
+// Close the socket and release everything the client owns
+void client_free(Client* client) {
+    if (!client) return;
+    
+    close(client->fd);
+    client_free_reply(client);
+    free(client->send_iov);
+    free(client->channels.links);
+    free(client->patterns.links);
+    for (size_t i = 0; i < client->tracking.prefix_count; i++) {
+        free(client->tracking.prefixes[i]);
+    }
+    free(client->tracking.prefixes);
+    multi_discard(client);
+    multi_unwatch(client);
+    command_queue_free(&client->commands);
+    resp_parser_free(&client->parser);
+    free(client->buffer);
+    free(client);
+}
+
+// Forget executed commands and rewind the query buffer if it is drained
+void client_reset_commands(Client* client) {
+    CommandQueue* queue = &client->commands;
+    queue->argv_count = 0;
+    queue->count = 0;
+    queue->next = 0;
+    
+    if (client->query_offset == client->buffer_pos) {
+        client->query_offset = 0;
+        client->parse_offset = 0;
+        client->buffer_pos = 0;
+    }
+}
+
+// Parsed commands are slices of the query buffer; follow it when it moves
+static void command_queue_rebase(CommandQueue* queue, const char* old_base, char* new_base) {
+    for (size_t i = 0; i < queue->argv_count; i++) {
+        if (queue->argv_owned[i]) continue;
+        queue->argv[i] = new_base + (queue->argv[i] - old_base);
+    }
+}
+
+// Make room for at least len more bytes in the query buffer, or for the
+// rest of the bulk the parser is waiting on if that is larger
+static ClientIOStatus client_reserve_query(Client* client, size_t len) {
+    bool commands_pending = client->commands.next < client->commands.count;
+    size_t wanted = client->buffer_pos + len;
+    if (client->parser.need > 0 && client->parse_offset + client->parser.need > wanted) {
+        wanted = client->parse_offset + client->parser.need;
+    }
+    
+    // Slide an unfinished command to the front only when the free tail
+    // is too small for the next read, instead of after every command
+    if (wanted > client->buffer_size && client->query_offset > 0 && !commands_pending) {
+        size_t pending = client->buffer_pos - client->query_offset;
+        memmove(client->buffer, client->buffer + client->query_offset, pending);
+        client->buffer_pos = pending;
+        client->parse_offset -= client->query_offset;
+        wanted -= client->query_offset;
+        client->query_offset = 0;
+    }
+    
+    // Grow the query buffer when it is still full or when the pending
+    // bulk is known to need more room than is left
+    if (wanted > client->buffer_size) {
+        if (wanted > QUERY_BUFFER_MAX) return CLIENT_IO_LIMIT;
+        size_t new_size = client->buffer_size * 2;
+        while (new_size < wanted) new_size *= 2;
+        if (new_size > QUERY_BUFFER_MAX) new_size = QUERY_BUFFER_MAX;
+        
+        char* new_buffer;
+        if (commands_pending) {
+            // Copy instead of realloc so the commands can be moved over
+            new_buffer = malloc(new_size);
+            if (!new_buffer) return CLIENT_IO_LIMIT;
+            memcpy(new_buffer, client->buffer, client->buffer_pos);
+            command_queue_rebase(&client->commands, client->buffer, new_buffer);
+            free(client->buffer);
+        } else {
+            new_buffer = realloc(client->buffer, new_size);
+            if (!new_buffer) return CLIENT_IO_LIMIT;
+        }
+        client->buffer = new_buffer;
+        client->buffer_size = new_size;
+    }
+    
+    return CLIENT_IO_OK;
+}
+
+// Take over a big bulk argument of the command being executed instead of
+// copying it. The buffer holds argv_len[index] bytes plus a NUL and is the
+// caller's to free. Returns NULL for arguments living in the query buffer.
+char* client_take_arg(Client* client, int index) {
+    if (!client || !client->argv_owned || index < 0 || index >= client->argc) return NULL;
+    
+    char* buf = client->argv_owned[index];
+    client->argv_owned[index] = NULL;
+    return buf;
+}
+
+// Free the big bulks of the command just executed that nobody took
+void client_release_args(Client* client) {
+    if (!client->argv_owned) return;
+    
+    for (int i = 0; i < client->argc; i++) {
+        free(client->argv_owned[i]);
+        client->argv_owned[i] = NULL;
+    }
+    client->argv_owned = NULL;
+}
+
+// Read whatever the socket has into the query buffer. Safe to run on an
+// I/O thread: it touches nothing but the client itself.
+ClientIOStatus client_read_query(Client* client) {
+    // Leave the rest in the socket until the parsed commands have run
+    if (client->commands.next < client->commands.count) return CLIENT_IO_OK;
+    
+    // A big bulk is read straight into its final buffer, and no further:
+    // what follows it stays in the socket until the next read
+    RespParser* parser = &client->parser;
+    char* dst;
+    size_t room;
+    if (parser->bulk_buf) {
+        dst = parser->bulk_buf + parser->bulk_filled;
+        room = parser->bulk_len + 2 - parser->bulk_filled;
+    } else {
+        ClientIOStatus status = client_reserve_query(client, 1);
+        if (status != CLIENT_IO_OK) return status;
+        dst = client->buffer + client->buffer_pos;
+        room = client->buffer_size - client->buffer_pos;
+    }
+    
+    ssize_t n = read(client->fd, dst, room);
+    if (n == 0) return CLIENT_IO_CLOSED;
+    if (n < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) return CLIENT_IO_OK;
+        perror("Error reading from client");
+        return CLIENT_IO_CLOSED;
+    }
+    
+    if (parser->bulk_buf) {
+        parser->bulk_filled += n;
+    } else {
+        client->buffer_pos += n;
+    }
+    return CLIENT_IO_OK;
+}
+
+// Add data that was already received, e.g. by io_uring into one of its
+// own buffers, to the query buffer
+ClientIOStatus client_append_query(Client* client, const char* data, size_t len) {
+    size_t taken = resp_parser_feed_bulk(&client->parser, data, len);
+    data += taken;
+    len -= taken;
+    if (len == 0) return CLIENT_IO_OK;
+    
+    ClientIOStatus status = client_reserve_query(client, len);
+    if (status != CLIENT_IO_OK) return status;
+    
+    memcpy(client->buffer + client->buffer_pos, data, len);
+    client->buffer_pos += len;
+    return CLIENT_IO_OK;
+}
+
+// Split the unparsed part of the query buffer into commands, leaving a
+// trailing partial frame for the next read
+ClientIOStatus client_parse_query(Client* client) {
+    RespParser* parser = &client->parser;
+    
+    while (client->parse_offset < client->buffer_pos || parser->bulk_buf) {
+        size_t consumed;
+        RespStatus status = resp_parse(parser, client->buffer + client->parse_offset,
+                                       client->buffer_pos - client->parse_offset, &consumed);
+        if (status == RESP_INCOMPLETE) {
+            // Whatever followed a big bulk header now lives in bulk_buf
+            if (parser->bulk_buf) client->buffer_pos = client->parse_offset + parser->pos;
+            break;
+        }
+        if (status == RESP_ERROR) return CLIENT_IO_PROTOCOL;
+        
+        if (!command_queue_push(&client->commands, parser, consumed)) {
+            parser->error = "out of memory";
+            return CLIENT_IO_PROTOCOL;
+        }
+        resp_parser_reset(parser);
+        client->parse_offset += consumed;
+    }
+    
+    return CLIENT_IO_OK;
+}
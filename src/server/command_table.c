@@ -0,0 +1,142 @@
+#include "command_table.h"
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+
+// Every command: name, handler, arity, flags, first/last key and key step,
+// then the first, second and last letter of the name for command_lookup()
+#define COMMAND_LIST(X) \
+    X(SET,       set_command,       -3, CMD_WRITE,    1,  1, 1, 'S', 'E', 'T') \
+    X(GET,       get_command,        2, CMD_READONLY, 1,  1, 1, 'G', 'E', 'T') \
+    X(MGET,      mget_command,      -2, CMD_READONLY, 1, -1, 1, 'M', 'G', 'T') \
+    X(MSET,      mset_command,      -3, CMD_WRITE,    1, -1, 2, 'M', 'S', 'T') \
+    X(MSETNX,    msetnx_command,    -3, CMD_WRITE,    1, -1, 2, 'M', 'S', 'X') \
+    X(DEL,       del_command,       -2, CMD_WRITE,    1, -1, 1, 'D', 'E', 'L') \
+    X(UNLINK,    unlink_command,    -2, CMD_WRITE,    1, -1, 1, 'U', 'N', 'K') \
+    X(EXISTS,    exists_command,    -2, CMD_READONLY, 1, -1, 1, 'E', 'X', 'S') \
+    X(INCR,      incr_command,       2, CMD_WRITE,    1,  1, 1, 'I', 'N', 'R') \
+    X(DECR,      decr_command,       2, CMD_WRITE,    1,  1, 1, 'D', 'E', 'R') \
+    X(INCRBY,    incrby_command,     3, CMD_WRITE,    1,  1, 1, 'I', 'N', 'Y') \
+    X(DECRBY,    decrby_command,     3, CMD_WRITE,    1,  1, 1, 'D', 'E', 'Y') \
+    X(INCRBYFLOAT, incrbyfloat_command, 3, CMD_WRITE, 1,  1, 1, 'I', 'N', 'T') \
+    X(LPUSH,     lpush_command,     -3, CMD_WRITE,    1,  1, 1, 'L', 'P', 'H') \
+    X(RPUSH,     rpush_command,     -3, CMD_WRITE,    1,  1, 1, 'R', 'P', 'H') \
+    X(LRANGE,    lrange_command,     4, CMD_READONLY, 1,  1, 1, 'L', 'R', 'E') \
+    X(BLPOP,     blpop_command,     -3, CMD_WRITE | CMD_BLOCKING, 1, -2, 1, 'B', 'L', 'P') \
+    X(BRPOP,     brpop_command,     -3, CMD_WRITE | CMD_BLOCKING, 1, -2, 1, 'B', 'R', 'P') \
+    X(BLMOVE,    blmove_command,     6, CMD_WRITE | CMD_BLOCKING, 1,  2, 1, 'B', 'L', 'E') \
+    X(SADD,      sadd_command,      -3, CMD_WRITE,    1,  1, 1, 'S', 'A', 'D') \
+    X(SMEMBERS,  smembers_command,   2, CMD_READONLY, 1,  1, 1, 'S', 'M', 'S') \
+    X(SISMEMBER, sismember_command,  3, CMD_READONLY, 1,  1, 1, 'S', 'I', 'R') \
+    X(ZADD,      zadd_command,      -4, CMD_WRITE,    1,  1, 1, 'Z', 'A', 'D') \
+    X(ZRANGE,    zrange_command,    -4, CMD_READONLY, 1,  1, 1, 'Z', 'R', 'E') \
+    X(ZSCORE,    zscore_command,     3, CMD_READONLY, 1,  1, 1, 'Z', 'S', 'E') \
+    X(HSET,      hset_command,      -4, CMD_WRITE,    1,  1, 1, 'H', 'S', 'T') \
+    X(HGET,      hget_command,       3, CMD_READONLY, 1,  1, 1, 'H', 'G', 'T') \
+    X(HGETALL,   hgetall_command,    2, CMD_READONLY, 1,  1, 1, 'H', 'G', 'L') \
+    X(SETBIT,    setbit_command,     4, CMD_WRITE,    1,  1, 1, 'S', 'E', 'T') \
+    X(GETBIT,    getbit_command,     3, CMD_READONLY, 1,  1, 1, 'G', 'E', 'T') \
+    X(BITCOUNT,  bitcount_command,  -2, CMD_READONLY, 1,  1, 1, 'B', 'I', 'T') \
+    X(PFADD,     pfadd_command,     -3, CMD_WRITE,    1,  1, 1, 'P', 'F', 'D') \
+    X(PFCOUNT,   pfcount_command,   -2, CMD_READONLY, 1, -1, 1, 'P', 'F', 'T') \
+    X(PFMERGE,   pfmerge_command,   -3, CMD_WRITE,    1, -1, 1, 'P', 'F', 'E') \
+    X(GEOADD,    geoadd_command,    -5, CMD_WRITE,    1,  1, 1, 'G', 'E', 'D') \
+    X(GEOPOS,    geopos_command,    -3, CMD_READONLY, 1,  1, 1, 'G', 'E', 'S') \
+    X(GEODIST,   geodist_command,    4, CMD_READONLY, 1,  1, 1, 'G', 'E', 'T') \
+    X(XADD,      xadd_command,      -4, CMD_WRITE,    1,  1, 1, 'X', 'A', 'D') \
+    X(XRANGE,    xrange_command,     4, CMD_READONLY, 1,  1, 1, 'X', 'R', 'E') \
+    X(XREAD,     xread_command,     -3, CMD_READONLY | CMD_MOVABLE_KEYS | CMD_BLOCKING, 0, 0, 0, 'X', 'R', 'D') \
+    X(SUBSCRIBE,    subscribe_command,    -2, CMD_PUBSUB, 0, 0, 0, 'S', 'U', 'E') \
+    X(UNSUBSCRIBE,  unsubscribe_command,  -1, CMD_PUBSUB, 0, 0, 0, 'U', 'N', 'E') \
+    X(PSUBSCRIBE,   psubscribe_command,   -2, CMD_PUBSUB, 0, 0, 0, 'P', 'S', 'E') \
+    X(PUNSUBSCRIBE, punsubscribe_command, -1, CMD_PUBSUB, 0, 0, 0, 'P', 'U', 'E') \
+    X(PUBLISH,      publish_command,       3, 0,          0, 0, 0, 'P', 'U', 'H') \
+    X(CLIENT,       client_command,       -2, 0,          0, 0, 0, 'C', 'L', 'T') \
+    X(MULTI,        multi_command,         1, CMD_TXN,    0, 0, 0, 'M', 'U', 'I') \
+    X(EXEC,         exec_command,          1, CMD_TXN,    0, 0, 0, 'E', 'X', 'C') \
+    X(DISCARD,      discard_command,       1, CMD_TXN,    0, 0, 0, 'D', 'I', 'D') \
+    X(WATCH,        watch_command,        -2, CMD_TXN,    1, -1, 1, 'W', 'A', 'H') \
+    X(UNWATCH,      unwatch_command,       1, 0,          0, 0, 0, 'U', 'N', 'H')
+
+enum {
+#define X(name, proc, arity, flags, first, last, step, a, b, z) CMD_ID_##name,
+    COMMAND_LIST(X)
+#undef X
+    COMMAND_COUNT
+};
+
+static const Command command_table[COMMAND_COUNT] = {
+#define X(name, proc, arity, flags, first, last, step, a, b, z) \
+    [CMD_ID_##name] = {#name, proc, arity, flags, first, last, step},
+    COMMAND_LIST(X)
+#undef X
+};
+
+// Switch key of a command name: its length and three of its letters,
+// uppercased. Two commands with the same key would be duplicate case
+// labels, so the switch below is a perfect hash checked by the compiler.
+#define COMMAND_KEY(len, a, b, z) \
+    ((uint32_t)(len) << 24 | (uint32_t)(a) << 16 | (uint32_t)(b) << 8 | (uint32_t)(z))
+
+static inline unsigned char ascii_upper(char c) {
+    return c >= 'a' && c <= 'z' ? c - ('a' - 'A') : (unsigned char)c;
+}
+
+// Find a command by name, in any case. One switch picks the only
+// candidate and one compare confirms it.
+const Command* command_lookup(const char* name, size_t len) {
+    if (!name || len < 2 || len > 255) return NULL;
+    
+    const Command* cmd;
+    switch (COMMAND_KEY(len, ascii_upper(name[0]), ascii_upper(name[1]), ascii_upper(name[len - 1]))) {
+#define X(name, proc, arity, flags, first, last, step, a, b, z) \
+        case COMMAND_KEY(sizeof(#name) - 1, a, b, z): cmd = &command_table[CMD_ID_##name]; break;
+        COMMAND_LIST(X)
+#undef X
+        default:
+            return NULL;
+    }
+    
+    return strncasecmp(cmd->name, name, len) == 0 ? cmd : NULL;
+}
+
+const Command* command_table_entries(size_t* count) {
+    *count = COMMAND_COUNT;
+    return command_table;
+}
+
+bool command_arity_ok(const Command* cmd, int argc) {
+    return cmd->arity >= 0 ? argc == cmd->arity : argc >= -cmd->arity;
+}
+
+// XREAD [COUNT n] [BLOCK ms] STREAMS key [key ...] id [id ...]
+static bool xread_key_range(int argc, char** argv, int* first, int* last) {
+    int streams = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcasecmp(argv[i], "STREAMS") == 0) {
+            streams = i;
+            break;
+        }
+    }
+    
+    int remaining = argc - streams - 1;
+    if (streams == 0 || remaining < 2 || remaining % 2 != 0) return false;
+    *first = streams + 1;
+    *last = streams + remaining / 2;
+    return true;
+}
+
+// Positions of the command's keys in argv as first..last by step.
+// Returns false if this invocation has no keys.
+bool command_key_range(const Command* cmd, int argc, char** argv, int* first, int* last, int* step) {
+    *step = 1;
+    if (cmd->flags & CMD_MOVABLE_KEYS) {
+        return xread_key_range(argc, argv, first, last);
+    }
+    if (cmd->first_key == 0 || argc <= cmd->first_key) return false;
+    
+    *first = cmd->first_key;
+    *last = cmd->last_key < 0 ? argc + cmd->last_key : cmd->last_key;
+    *step = cmd->key_step;
+    return *last >= *first;
+}
@@ -0,0 +1,36 @@
+#ifndef COMMAND_TABLE_H
+#define COMMAND_TABLE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "server.h"
+
+// Command flags
+#define CMD_WRITE        (1 << 0)  // May modify the keyspace
+#define CMD_READONLY     (1 << 1)  // Only reads keys
+#define CMD_MOVABLE_KEYS (1 << 2)  // Key positions depend on the arguments
+#define CMD_BLOCKING     (1 << 3)  // May wait for another client's write
+#define CMD_PUBSUB       (1 << 4)  // Allowed while the client is subscribed
+#define CMD_TXN          (1 << 5)  // Runs at once inside MULTI instead of being queued
+
+typedef bool (*CommandProc)(Server* server, Client* client, char** args, int argc);
+
+// A command's handler and metadata. Key positions follow Redis: keys are
+// argv[first_key], argv[first_key + key_step], ... up to argv[last_key].
+typedef struct Command {
+    const char* name;
+    CommandProc proc;
+    int arity;              // Exact argc counting the name, or -N for at least N
+    int flags;
+    int first_key;          // 0 if the command takes no keys
+    int last_key;           // Negative counts from the end, -1 being the last argument
+    int key_step;
+} Command;
+
+// Function declarations
+const Command* command_lookup(const char* name, size_t len);
+const Command* command_table_entries(size_t* count);
+bool command_arity_ok(const Command* cmd, int argc);
+bool command_key_range(const Command* cmd, int argc, char** argv, int* first, int* last, int* step);
+
+#endif // COMMAND_TABLE_H
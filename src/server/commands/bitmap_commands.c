@@ -1,105 +1,116 @@
 #include "../../server/server.h"
 #include <string.h>
 
-bool handle_bitmap_command(Server* server, Client* client, const char* command, char** args, int argc) {
-    if (!server || !client || !command || !args || argc < 2) {
-        send_error(client, "ERR wrong number of arguments");
+// Bit offsets are limited to 4G bits, a 512MB bitmap
+static bool parse_bit_offset(Client* client, char** args, int index, int64_t* offset) {
+    if (!stringToInt64(args[index], client->argv_len[index], offset) || *offset < 0 ||
+        *offset >= (int64_t)4 * 1024 * 1024 * 1024) {
+        send_error(client, "ERR bit offset is not an integer or out of range");
         return false;
     }
-    
+    return true;
+}
+
+bool setbit_command(Server* server, Client* client, char** args, int argc) {
+    (void)argc;
     const char* key = args[1];
+    int64_t offset, value;
+    if (!parse_bit_offset(client, args, 2, &offset)) return false;
+    if (!stringToInt64(args[3], client->argv_len[3], &value) || (value != 0 && value != 1)) {
+        send_error(client, "ERR bit is not an integer or out of range");
+        return false;
+    }
+    
+    RedisObject* obj = hashmap_get(server->db, key, client->argv_len[1]);
+    bool created = obj == NULL;
+    RedisBitmap* bitmap;
     
-    if (strcasecmp(command, "SETBIT") == 0) {
-        if (argc != 4) {
-            send_error(client, "ERR wrong number of arguments for SETBIT");
+    if (!obj) {
+        bitmap = createRedisBitmap();
+        if (!bitmap) {
+            send_error(client, "ERR out of memory");
             return false;
         }
-        
-        RedisObject* obj = hashmap_get(server->db, key);
-        RedisBitmap* bitmap;
-        
+        obj = createRedisObject(REDIS_BITMAP, bitmap);
         if (!obj) {
-            bitmap = createRedisBitmap();
-            if (!bitmap) {
-                send_error(client, "ERR out of memory");
-                return false;
-            }
-            obj = createRedisObject(REDIS_BITMAP, bitmap);
-            if (!obj) {
-                freeRedisBitmap(bitmap);
-                send_error(client, "ERR out of memory");
-                return false;
-            }
-        } else if (obj->type != REDIS_BITMAP) {
-            send_error(client, "WRONGTYPE Operation against a key holding the wrong kind of value");
+            freeRedisBitmap(bitmap);
+            send_error(client, "ERR out of memory");
             return false;
-        } else {
-            bitmap = obj->data;
         }
-        
-        size_t offset = strtoul(args[2], NULL, 10);
-        int value = strtol(args[3], NULL, 10);
-        
-        if (value != 0 && value != 1) {
-            send_error(client, "ERR bit is not an integer or out of range");
-            return false;
-        }
-        
-        bool old_value = bitmap_set(bitmap, offset, value == 1);
-        
-        if (!hashmap_put(server->db, key, obj)) {
-            send_error(client, "ERR failed to update key");
-            return false;
-        }
-        
-        send_integer(client, old_value ? 1 : 0);
+    } else if (obj->type != REDIS_BITMAP) {
+        send_error(client, "WRONGTYPE Operation against a key holding the wrong kind of value");
+        return false;
+    } else {
+        bitmap = obj->data;
+    }
+    
+    bool old_value = bitmapGet(bitmap, (size_t)offset);
+    if (!bitmapSet(bitmap, (size_t)offset, value == 1)) {
+        if (created) freeRedisObject(obj);
+        send_error(client, "ERR out of memory");
+        return false;
+    }
+    
+    if (!hashmap_put(server->db, key, client->argv_len[1], obj)) {
+        if (created) freeRedisObject(obj);
+        send_error(client, "ERR failed to update key");
+        return false;
+    }
+    
+    send_integer(client, old_value ? 1 : 0);
+    return true;
+}
+
+bool getbit_command(Server* server, Client* client, char** args, int argc) {
+    (void)argc;
+    const char* key = args[1];
+    int64_t offset;
+    if (!parse_bit_offset(client, args, 2, &offset)) return false;
+    
+    RedisObject* obj = hashmap_get(server->db, key, client->argv_len[1]);
+    if (!obj || obj->type != REDIS_BITMAP) {
+        send_integer(client, 0);
         return true;
     }
-    else if (strcasecmp(command, "GETBIT") == 0) {
-        if (argc != 3) {
-            send_error(client, "ERR wrong number of arguments for GETBIT");
-            return false;
-        }
-        
-        RedisObject* obj = hashmap_get(server->db, key);
-        if (!obj || obj->type != REDIS_BITMAP) {
-            send_integer(client, 0);
-            return true;
-        }
-        
-        RedisBitmap* bitmap = obj->data;
-        size_t offset = strtoul(args[2], NULL, 10);
-        
-        bool value = bitmap_get(bitmap, offset);
-        send_integer(client, value ? 1 : 0);
+    
+    RedisBitmap* bitmap = obj->data;
+    
+    bool value = bitmapGet(bitmap, (size_t)offset);
+    send_integer(client, value ? 1 : 0);
+    return true;
+}
+
+bool bitcount_command(Server* server, Client* client, char** args, int argc) {
+    const char* key = args[1];
+    
+    if (argc != 2 && argc != 4) {
+        send_error(client, "ERR wrong number of arguments for BITCOUNT");
+        return false;
+    }
+    
+    int64_t start = 0;
+    int64_t end = -1;
+    if (argc == 4 && (!parse_int64_arg(client, args, 2, &start) || !parse_int64_arg(client, args, 3, &end))) {
+        return false;
+    }
+    
+    RedisObject* obj = hashmap_get(server->db, key, client->argv_len[1]);
+    if (!obj || obj->type != REDIS_BITMAP) {
+        send_integer(client, 0);
         return true;
     }
-    else if (strcasecmp(command, "BITCOUNT") == 0) {
-        if (argc != 2 && argc != 4) {
-            send_error(client, "ERR wrong number of arguments for BITCOUNT");
-            return false;
-        }
-        
-        RedisObject* obj = hashmap_get(server->db, key);
-        if (!obj || obj->type != REDIS_BITMAP) {
-            send_integer(client, 0);
-            return true;
-        }
-        
-        RedisBitmap* bitmap = obj->data;
-        size_t start = 0;
-        size_t end = bitmap->size * 8 - 1;
-        
-        if (argc == 4) {
-            start = strtoul(args[2], NULL, 10);
-            end = strtoul(args[3], NULL, 10);
-        }
-        
-        size_t count = bitmap_count(bitmap, start, end);
-        send_integer(client, count);
+    
+    RedisBitmap* bitmap = obj->data;
+    if (argc == 2) {
+        send_integer(client, (int64_t)bitmapCount(bitmap));
         return true;
     }
     
-    send_error(client, "ERR unknown command");
-    return false;
-} 
\ No newline at end of file
+    // start and end are byte indices, as in Redis
+    size_t first, last, count = 0;
+    if (clamp_range(start, end, (bitmap->size + 7) / 8, &first, &last)) {
+        for (size_t i = first; i <= last; i++) count += __builtin_popcount(bitmap->bits[i]);
+    }
+    send_integer(client, (int64_t)count);
+    return true;
+}
@@ -0,0 +1,123 @@
+#include "../../server/server.h"
+#include "../../server/tracking.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+// CLIENT TRACKING ON|OFF [REDIRECT id] [BCAST] [PREFIX prefix ...] [NOLOOP]
+//
+// Only RESP2 is spoken, so invalidations always go to another connection
+// subscribed to __redis__:invalidate, and REDIRECT is required.
+static bool client_tracking(Server* server, Client* client, char** args, int argc) {
+    bool on;
+    if (strcasecmp(args[2], "ON") == 0) {
+        on = true;
+    } else if (strcasecmp(args[2], "OFF") == 0) {
+        on = false;
+    } else {
+        send_error(client, "ERR syntax error");
+        return false;
+    }
+    
+    uint64_t redirect = 0;
+    bool has_redirect = false;
+    bool bcast = false;
+    bool noloop = false;
+    char** prefixes = malloc((size_t)argc * sizeof(char*));
+    int prefix_count = 0;
+    if (!prefixes) {
+        send_error(client, "ERR out of memory");
+        return false;
+    }
+    
+    for (int i = 3; i < argc; i++) {
+        bool more = i + 1 < argc;
+        if (strcasecmp(args[i], "REDIRECT") == 0 && more) {
+            char* end;
+            unsigned long long id = strtoull(args[++i], &end, 10);
+            if (*end != '\0' || end == args[i] || *args[i] == '-') {
+                free(prefixes);
+                send_error(client, "ERR value is not an integer or out of range");
+                return false;
+            }
+            redirect = (uint64_t)id;
+            has_redirect = true;
+        } else if (strcasecmp(args[i], "BCAST") == 0) {
+            bcast = true;
+        } else if (strcasecmp(args[i], "PREFIX") == 0 && more) {
+            prefixes[prefix_count++] = args[++i];
+        } else if (strcasecmp(args[i], "NOLOOP") == 0) {
+            noloop = true;
+        } else {
+            free(prefixes);
+            send_error(client, "ERR syntax error");
+            return false;
+        }
+    }
+    
+    if (!on) {
+        free(prefixes);
+        tracking_disable(server, client);
+        send_ok(client);
+        return true;
+    }
+    
+    const char* error = NULL;
+    char message[256];
+    const char* other;
+    const char* overlap;
+    if (server->shards) {
+        error = "ERR CLIENT TRACKING is not supported with more than one shard";
+    } else if (prefix_count > 0 && !bcast) {
+        error = "ERR PREFIX option requires BCAST mode to be enabled";
+    } else if (client->tracking.enabled && client->tracking.bcast != bcast) {
+        error = "ERR You can't switch BCAST mode on/off before disabling tracking for this client, "
+                "and then re-enabling it with a different mode.";
+    } else if (!has_redirect) {
+        error = "ERR CLIENT TRACKING needs REDIRECT to a client subscribed to __redis__:invalidate";
+    } else if (!server_find_client(server, redirect)) {
+        error = "ERR The client ID you want redirect to does not exist";
+    } else if ((overlap = tracking_prefix_overlap(client, prefixes, prefix_count, &other))) {
+        snprintf(message, sizeof(message),
+                 "ERR Prefix '%.64s' overlaps with an existing prefix '%.64s'. "
+                 "Prefixes for a single client must not overlap.", overlap, other);
+        error = message;
+    }
+    if (error) {
+        free(prefixes);
+        send_error(client, error);
+        return false;
+    }
+    
+    bool ok = tracking_enable(server, client, redirect, bcast, noloop, prefixes, prefix_count);
+    free(prefixes);
+    if (!ok) {
+        send_error(client, "ERR out of memory");
+        return false;
+    }
+    send_ok(client);
+    return true;
+}
+
+// CLIENT ID | GETREDIR | TRACKING ...
+bool client_command(Server* server, Client* client, char** args, int argc) {
+    const char* sub = args[1];
+    
+    if (strcasecmp(sub, "ID") == 0 && argc == 2) {
+        send_integer(client, (int64_t)client->id);
+        return true;
+    }
+    if (strcasecmp(sub, "GETREDIR") == 0 && argc == 2) {
+        send_integer(client, client->tracking.enabled ? (int64_t)client->tracking.redirect : -1);
+        return true;
+    }
+    if (strcasecmp(sub, "TRACKING") == 0 && argc >= 3) {
+        return client_tracking(server, client, args, argc);
+    }
+    
+    char error[128];
+    snprintf(error, sizeof(error), "ERR unknown subcommand or wrong number of arguments for '%.32s'", sub);
+    send_error(client, error);
+    return false;
+}
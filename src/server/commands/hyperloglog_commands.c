@@ -1,171 +1,121 @@
 #include "../../server/server.h"
 #include <string.h>
 
-bool handle_hyperloglog_command(Server* server, Client* client, const char* command, char** args, int argc) {
-    if (!server || !client || !command || !args || argc < 2) {
-        send_error(client, "ERR wrong number of arguments");
-        return false;
+// Check that every key from first on is a HyperLogLog or missing
+static bool check_hll_keys(Server* server, Client* client, char** args, int first, int argc) {
+    for (int i = first; i < argc; i++) {
+        RedisObject* obj = hashmap_get(server->db, args[i], client->argv_len[i]);
+        if (obj && obj->type != REDIS_HYPERLOGLOG) {
+            send_error(client, "WRONGTYPE Operation against a key holding the wrong kind of value");
+            return false;
+        }
     }
-    
+    return true;
+}
+
+// Merge the HyperLogLogs at keys first..argc-1 into dst; missing keys
+// count as empty
+static void merge_hll_keys(Server* server, Client* client, RedisHyperLogLog* dst, char** args, int first,
+                           int argc) {
+    for (int i = first; i < argc; i++) {
+        RedisObject* obj = hashmap_get(server->db, args[i], client->argv_len[i]);
+        if (obj) hllMerge(dst, obj->data);
+    }
+}
+
+bool pfadd_command(Server* server, Client* client, char** args, int argc) {
     const char* key = args[1];
     
-    if (strcasecmp(command, "PFADD") == 0) {
-        if (argc < 3) {
-            send_error(client, "ERR wrong number of arguments for PFADD");
+    RedisObject* obj = hashmap_get(server->db, key, client->argv_len[1]);
+    bool created = obj == NULL;
+    RedisHyperLogLog* hll;
+    
+    if (!obj) {
+        hll = createRedisHyperLogLog();
+        if (!hll) {
+            send_error(client, "ERR out of memory");
             return false;
         }
-        
-        RedisObject* obj = hashmap_get(server->db, key);
-        RedisHyperLogLog* hll;
-        
+        obj = createRedisObject(REDIS_HYPERLOGLOG, hll);
         if (!obj) {
-            hll = createRedisHyperLogLog();
-            if (!hll) {
-                send_error(client, "ERR out of memory");
-                return false;
-            }
-            obj = createRedisObject(REDIS_HYPERLOGLOG, hll);
-            if (!obj) {
-                freeRedisHyperLogLog(hll);
-                send_error(client, "ERR out of memory");
-                return false;
-            }
-        } else if (obj->type != REDIS_HYPERLOGLOG) {
-            send_error(client, "WRONGTYPE Operation against a key holding the wrong kind of value");
+            freeRedisHyperLogLog(hll);
+            send_error(client, "ERR out of memory");
             return false;
-        } else {
-            hll = obj->data;
-        }
-        
-        // Add all elements
-        bool changed = false;
-        for (int i = 2; i < argc; i++) {
-            RedisString* element = createRedisString(args[i]);
-            if (!element) {
-                send_error(client, "ERR out of memory");
-                return false;
-            }
-            
-            if (hyperloglog_add(hll, element)) {
-                changed = true;
-            }
-            freeRedisString(element);
         }
-        
-        if (!hashmap_put(server->db, key, obj)) {
-            send_error(client, "ERR failed to update key");
-            return false;
-        }
-        
-        send_integer(client, changed ? 1 : 0);
+    } else if (obj->type != REDIS_HYPERLOGLOG) {
+        send_error(client, "WRONGTYPE Operation against a key holding the wrong kind of value");
+        return false;
+    } else {
+        hll = obj->data;
+    }
+    
+    // Add all elements
+    bool changed = created;
+    for (int i = 2; i < argc; i++) {
+        if (hllAdd(hll, args[i], client->argv_len[i])) changed = true;
+    }
+    
+    if (!hashmap_put(server->db, key, client->argv_len[1], obj)) {
+        if (created) freeRedisObject(obj);
+        send_error(client, "ERR failed to update key");
+        return false;
+    }
+    
+    send_integer(client, changed ? 1 : 0);
+    return true;
+}
+
+bool pfcount_command(Server* server, Client* client, char** args, int argc) {
+    if (!check_hll_keys(server, client, args, 1, argc)) return false;
+    
+    if (argc == 2) {
+        RedisObject* obj = hashmap_get(server->db, args[1], client->argv_len[1]);
+        send_integer(client, obj ? (int64_t)hllCount(obj->data) : 0);
         return true;
     }
-    else if (strcasecmp(command, "PFCOUNT") == 0) {
-        if (argc < 2) {
-            send_error(client, "ERR wrong number of arguments for PFCOUNT");
-            return false;
-        }
-        
-        if (argc == 2) {
-            RedisObject* obj = hashmap_get(server->db, key);
-            if (!obj || obj->type != REDIS_HYPERLOGLOG) {
-                send_integer(client, 0);
-                return true;
-            }
-            
-            RedisHyperLogLog* hll = obj->data;
-            size_t count = hyperloglog_count(hll);
-            send_integer(client, count);
-            return true;
-        }
-        else {
-            // Merge multiple HLLs
-            RedisHyperLogLog* merged = createRedisHyperLogLog();
-            if (!merged) {
-                send_error(client, "ERR out of memory");
-                return false;
-            }
-            
-            bool error = false;
-            for (int i = 1; i < argc; i++) {
-                RedisObject* obj = hashmap_get(server->db, args[i]);
-                if (!obj || obj->type != REDIS_HYPERLOGLOG) {
-                    error = true;
-                    break;
-                }
-                
-                RedisHyperLogLog* hll = obj->data;
-                if (!hyperloglog_merge(merged, hll)) {
-                    error = true;
-                    break;
-                }
-            }
-            
-            if (error) {
-                freeRedisHyperLogLog(merged);
-                send_error(client, "ERR invalid HyperLogLog key");
-                return false;
-            }
-            
-            size_t count = hyperloglog_count(merged);
-            freeRedisHyperLogLog(merged);
-            
-            send_integer(client, count);
-            return true;
-        }
+    
+    // Count the union of several HyperLogLogs
+    RedisHyperLogLog* merged = createRedisHyperLogLog();
+    if (!merged) {
+        send_error(client, "ERR out of memory");
+        return false;
     }
-    else if (strcasecmp(command, "PFMERGE") == 0) {
-        if (argc < 3) {
-            send_error(client, "ERR wrong number of arguments for PFMERGE");
+    merge_hll_keys(server, client, merged, args, 1, argc);
+    send_integer(client, (int64_t)hllCount(merged));
+    freeRedisHyperLogLog(merged);
+    return true;
+}
+
+bool pfmerge_command(Server* server, Client* client, char** args, int argc) {
+    const char* key = args[1];
+    if (!check_hll_keys(server, client, args, 1, argc)) return false;
+    
+    RedisObject* dest_obj = hashmap_get(server->db, key, client->argv_len[1]);
+    bool created = dest_obj == NULL;
+    
+    if (!dest_obj) {
+        RedisHyperLogLog* dest = createRedisHyperLogLog();
+        if (!dest) {
+            send_error(client, "ERR out of memory");
             return false;
         }
-        
-        RedisObject* dest_obj = hashmap_get(server->db, key);
-        RedisHyperLogLog* dest;
-        
+        dest_obj = createRedisObject(REDIS_HYPERLOGLOG, dest);
         if (!dest_obj) {
-            dest = createRedisHyperLogLog();
-            if (!dest) {
-                send_error(client, "ERR out of memory");
-                return false;
-            }
-            dest_obj = createRedisObject(REDIS_HYPERLOGLOG, dest);
-            if (!dest_obj) {
-                freeRedisHyperLogLog(dest);
-                send_error(client, "ERR out of memory");
-                return false;
-            }
-        } else if (dest_obj->type != REDIS_HYPERLOGLOG) {
-            send_error(client, "WRONGTYPE Operation against a key holding the wrong kind of value");
-            return false;
-        } else {
-            dest = dest_obj->data;
-        }
-        
-        // Merge all source HLLs
-        for (int i = 2; i < argc; i++) {
-            RedisObject* src_obj = hashmap_get(server->db, args[i]);
-            if (!src_obj || src_obj->type != REDIS_HYPERLOGLOG) {
-                send_error(client, "ERR invalid HyperLogLog key");
-                return false;
-            }
-            
-            RedisHyperLogLog* src = src_obj->data;
-            if (!hyperloglog_merge(dest, src)) {
-                send_error(client, "ERR failed to merge HyperLogLogs");
-                return false;
-            }
-        }
-        
-        if (!hashmap_put(server->db, key, dest_obj)) {
-            send_error(client, "ERR failed to update key");
+            freeRedisHyperLogLog(dest);
+            send_error(client, "ERR out of memory");
             return false;
         }
-        
-        send_ok(client);
-        return true;
     }
     
-    send_error(client, "ERR unknown command");
-    return false;
-} 
\ No newline at end of file
+    // Merge all source HLLs
+    merge_hll_keys(server, client, dest_obj->data, args, 2, argc);
+    
+    if (!hashmap_put(server->db, key, client->argv_len[1], dest_obj)) {
+        if (created) freeRedisObject(dest_obj);
+        send_error(client, "ERR failed to update key");
+        return false;
+    }
+    
+    send_ok(client);
+    return true;
+}
@@ -1,155 +1,304 @@
 #include "../../server/server.h"
+#include "../../server/blocking.h"
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
-bool handle_list_command(Server* server, Client* client, const char* command, char** args, int argc) {
-    if (!server || !client || !command || !args || argc < 2) {
-        send_error(client, "ERR wrong number of arguments");
-        return false;
-    }
-    
+// LPUSH/RPUSH: push every value in turn, creating the list if needed
+static bool push_generic(Server* server, Client* client, char** args, int argc, bool head) {
     const char* key = args[1];
+    size_t key_len = client->argv_len[1];
     
-    if (strcasecmp(command, "LPUSH") == 0) {
-        if (argc < 3) {
-            send_error(client, "ERR wrong number of arguments for LPUSH");
+    RedisObject* obj = hashmap_get(server->db, key, key_len);
+    bool created = obj == NULL;
+    RedisList* list;
+    
+    if (!obj) {
+        list = createRedisList();
+        if (!list) {
+            send_error(client, "ERR out of memory");
             return false;
         }
-        
-        RedisObject* obj = hashmap_get(server->db, key);
-        RedisList* list;
-        
+        obj = createRedisObject(REDIS_LIST, list);
         if (!obj) {
-            list = createRedisList();
-            if (!list) {
-                send_error(client, "ERR out of memory");
-                return false;
-            }
-            obj = createRedisObject(REDIS_LIST, list);
-            if (!obj) {
-                freeRedisList(list);
-                send_error(client, "ERR out of memory");
-                return false;
-            }
-        } else if (obj->type != REDIS_LIST) {
-            send_error(client, "WRONGTYPE Operation against a key holding the wrong kind of value");
+            freeRedisList(list);
+            send_error(client, "ERR out of memory");
             return false;
-        } else {
-            list = obj->data;
-        }
-        
-        // Push all arguments to the list
-        for (int i = 2; i < argc; i++) {
-            RedisString* str = createRedisString(args[i]);
-            if (!str) {
-                send_error(client, "ERR out of memory");
-                return false;
-            }
-            list_push_front(list, str);
         }
-        
-        if (!hashmap_put(server->db, key, obj)) {
-            send_error(client, "ERR failed to update key");
+    } else if (obj->type != REDIS_LIST) {
+        send_error(client, "WRONGTYPE Operation against a key holding the wrong kind of value");
+        return false;
+    } else {
+        list = obj->data;
+    }
+    
+    // Push all arguments to the list
+    for (int i = 2; i < argc; i++) {
+        if (!listPush(list, args[i], client->argv_len[i], head)) {
+            if (created) freeRedisObject(obj);
+            send_error(client, "ERR out of memory");
             return false;
         }
-        
-        send_integer(client, list->size);
+    }
+    
+    if (!hashmap_put(server->db, key, key_len, obj)) {
+        if (created) freeRedisObject(obj);
+        send_error(client, "ERR failed to update key");
+        return false;
+    }
+    
+    signal_key_ready(server, key, key_len);
+    send_integer(client, (int64_t)list->len);
+    return true;
+}
+
+bool lpush_command(Server* server, Client* client, char** args, int argc) {
+    return push_generic(server, client, args, argc, true);
+}
+
+bool rpush_command(Server* server, Client* client, char** args, int argc) {
+    return push_generic(server, client, args, argc, false);
+}
+
+bool lrange_command(Server* server, Client* client, char** args, int argc) {
+    (void)argc;
+    const char* key = args[1];
+    int64_t start, end;
+    if (!parse_int64_arg(client, args, 2, &start) || !parse_int64_arg(client, args, 3, &end)) return false;
+    
+    RedisObject* obj = hashmap_get(server->db, key, client->argv_len[1]);
+    if (!obj || obj->type != REDIS_LIST) {
+        send_array(client, 0);
         return true;
     }
-    else if (strcasecmp(command, "RPUSH") == 0) {
-        if (argc < 3) {
-            send_error(client, "ERR wrong number of arguments for RPUSH");
-            return false;
-        }
-        
-        RedisObject* obj = hashmap_get(server->db, key);
-        RedisList* list;
-        
-        if (!obj) {
-            list = createRedisList();
-            if (!list) {
-                send_error(client, "ERR out of memory");
-                return false;
-            }
-            obj = createRedisObject(REDIS_LIST, list);
-            if (!obj) {
-                freeRedisList(list);
-                send_error(client, "ERR out of memory");
-                return false;
-            }
-        } else if (obj->type != REDIS_LIST) {
-            send_error(client, "WRONGTYPE Operation against a key holding the wrong kind of value");
+    
+    RedisList* list = obj->data;
+    size_t first, last;
+    if (!clamp_range(start, end, list->len, &first, &last)) {
+        send_array(client, 0);
+        return true;
+    }
+    
+    // Create response array
+    send_array(client, last - first + 1);
+    
+    ListNode* current = list->head;
+    size_t current_pos = 0;
+    
+    while (current && current_pos < first) {
+        current = current->next;
+        current_pos++;
+    }
+    
+    while (current && current_pos <= last) {
+        send_bulk(client, current->value->data, current->value->len);
+        current = current->next;
+        current_pos++;
+    }
+    
+    return true;
+}
+
+// Pop from one end of a non-empty list, deleting the key once it is
+// empty. The caller frees the returned element.
+static RedisBytes* list_pop_key(Server* server, const char* key, size_t key_len, RedisList* list, bool front) {
+    RedisBytes* value = listPop(list, front);
+    if (list->len == 0) {
+        hashmap_remove(server->db, key, key_len);
+    } else {
+        hashmap_touch(server->db, key, key_len);
+    }
+    return value;
+}
+
+// The list at key, if it has something to pop
+static RedisList* poppable_list(Server* server, const char* key, size_t key_len) {
+    RedisObject* obj = hashmap_get(server->db, key, key_len);
+    if (!obj || obj->type != REDIS_LIST) return NULL;
+    RedisList* list = obj->data;
+    return list->len > 0 ? list : NULL;
+}
+
+// Reply to BLPOP/BRPOP with the key and the element popped from it
+static void pop_reply(Server* server, Client* client, const char* key, size_t key_len, RedisList* list,
+                      bool front) {
+    RedisBytes* value = list_pop_key(server, key, key_len, list, front);
+    send_array(client, 2);
+    send_bulk(client, key, key_len);
+    send_bulk(client, value->data, value->len);
+    free(value);
+}
+
+// Move an element from the non-empty list at src_key to dst_key and reply
+// with it. The destination has been checked to be a list or missing.
+static bool list_move(Server* server, Client* client, const char* src_key, size_t src_len,
+                      const char* dst_key, size_t dst_len, bool from_front, bool to_front) {
+    RedisObject* dst = hashmap_get(server->db, dst_key, dst_len);
+    bool dst_existed = dst != NULL;
+    if (!dst) {
+        RedisList* list = createRedisList();
+        dst = list ? createRedisObject(REDIS_LIST, list) : NULL;
+        if (!dst) {
+            if (list) freeRedisList(list);
+            send_error(client, "ERR out of memory");
             return false;
-        } else {
-            list = obj->data;
         }
-        
-        // Push all arguments to the list
-        for (int i = 2; i < argc; i++) {
-            RedisString* str = createRedisString(args[i]);
-            if (!str) {
-                send_error(client, "ERR out of memory");
-                return false;
-            }
-            list_push_back(list, str);
-        }
-        
-        if (!hashmap_put(server->db, key, obj)) {
+        if (!hashmap_put(server->db, dst_key, dst_len, dst)) {
+            freeRedisObject(dst);
             send_error(client, "ERR failed to update key");
             return false;
         }
-        
-        send_integer(client, list->size);
-        return true;
     }
-    else if (strcasecmp(command, "LRANGE") == 0) {
-        if (argc != 4) {
-            send_error(client, "ERR wrong number of arguments for LRANGE");
+    
+    // Popped before the source key may go away, which with src == dst
+    // can't happen as the element goes right back
+    RedisList* src = poppable_list(server, src_key, src_len);
+    RedisBytes* value = listPop(src, from_front);
+    if (!listPush(dst->data, value->data, value->len, to_front)) {
+        // Put it back where it came from; the node just freed makes room
+        listPush(src, value->data, value->len, from_front);
+        free(value);
+        send_error(client, "ERR out of memory");
+        return false;
+    }
+    send_bulk(client, value->data, value->len);
+    free(value);
+    if (src->len == 0) {
+        hashmap_remove(server->db, src_key, src_len);
+    } else {
+        hashmap_touch(server->db, src_key, src_len);
+    }
+    if (dst_existed && (src_len != dst_len || memcmp(src_key, dst_key, src_len) != 0)) {
+        hashmap_touch(server->db, dst_key, dst_len);
+    }
+    
+    signal_key_ready(server, dst_key, dst_len);
+    return true;
+}
+
+static bool bpop_generic(Server* server, Client* client, char** args, int argc, bool front) {
+    int64_t timeout_ms;
+    if (!parse_block_timeout(args[argc - 1], true, &timeout_ms)) {
+        send_error(client, "ERR timeout is not a float or out of range");
+        return false;
+    }
+    
+    // Pop from the first key holding a non-empty list
+    for (int i = 1; i < argc - 1; i++) {
+        RedisObject* obj = hashmap_get(server->db, args[i], client->argv_len[i]);
+        if (obj && obj->type != REDIS_LIST) {
+            send_error(client, "WRONGTYPE Operation against a key holding the wrong kind of value");
             return false;
         }
-        
-        RedisObject* obj = hashmap_get(server->db, key);
-        if (!obj || obj->type != REDIS_LIST) {
-            send_array(client, 0);
+        RedisList* list = poppable_list(server, args[i], client->argv_len[i]);
+        if (list) {
+            pop_reply(server, client, args[i], client->argv_len[i], list, front);
             return true;
         }
-        
-        RedisList* list = obj->data;
-        long start = strtol(args[2], NULL, 10);
-        long end = strtol(args[3], NULL, 10);
-        
-        // Handle negative indices
-        if (start < 0) start = list->size + start;
-        if (end < 0) end = list->size + end;
-        
-        // Bounds checking
-        if (start < 0) start = 0;
-        if (end >= list->size) end = list->size - 1;
-        if (start > end) {
-            send_array(client, 0);
-            return true;
-        }
-        
-        // Create response array
-        size_t count = end - start + 1;
-        send_array(client, count);
-        
-        ListNode* current = list->head;
-        size_t current_pos = 0;
-        
-        while (current && current_pos < start) {
-            current = current->next;
-            current_pos++;
-        }
-        
-        while (current && current_pos <= end) {
-            send_string(client, current->value->value);
-            current = current->next;
-            current_pos++;
-        }
-        
+    }
+    
+    // All empty: wait for a push to any of them, except inside EXEC,
+    // which must not stall, where it times out at once
+    if (client->multi.executing) {
+        send_null_array(client);
+        return true;
+    }
+    client->block.pop_front = front;
+    if (!block_client(server, client, BLOCK_LIST, args + 1, client->argv_len + 1, NULL, argc - 2, timeout_ms)) {
+        send_error(client, "ERR out of memory");
+        return false;
+    }
+    return true;
+}
+
+// BLPOP key [key ...] timeout
+bool blpop_command(Server* server, Client* client, char** args, int argc) {
+    return bpop_generic(server, client, args, argc, true);
+}
+
+// BRPOP key [key ...] timeout
+bool brpop_command(Server* server, Client* client, char** args, int argc) {
+    return bpop_generic(server, client, args, argc, false);
+}
+
+static bool parse_list_end(const char* arg, bool* front) {
+    if (strcasecmp(arg, "LEFT") == 0) {
+        *front = true;
+    } else if (strcasecmp(arg, "RIGHT") == 0) {
+        *front = false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// BLMOVE source destination LEFT|RIGHT LEFT|RIGHT timeout
+bool blmove_command(Server* server, Client* client, char** args, int argc) {
+    (void)argc;
+    bool from_front, to_front;
+    if (!parse_list_end(args[3], &from_front) || !parse_list_end(args[4], &to_front)) {
+        send_error(client, "ERR syntax error");
+        return false;
+    }
+    
+    int64_t timeout_ms;
+    if (!parse_block_timeout(args[5], true, &timeout_ms)) {
+        send_error(client, "ERR timeout is not a float or out of range");
+        return false;
+    }
+    
+    RedisObject* src = hashmap_get(server->db, args[1], client->argv_len[1]);
+    RedisObject* dst = hashmap_get(server->db, args[2], client->argv_len[2]);
+    if ((src && src->type != REDIS_LIST) || (dst && dst->type != REDIS_LIST)) {
+        send_error(client, "WRONGTYPE Operation against a key holding the wrong kind of value");
+        return false;
+    }
+    
+    if (poppable_list(server, args[1], client->argv_len[1])) {
+        return list_move(server, client, args[1], client->argv_len[1], args[2], client->argv_len[2],
+                         from_front, to_front);
+    }
+    if (client->multi.executing) {
+        send_null(client);
         return true;
     }
     
-    send_error(client, "ERR unknown command");
-    return false;
-} 
\ No newline at end of file
+    client->block.pop_front = from_front;
+    client->block.push_front = to_front;
+    client->block.target = malloc(client->argv_len[2] + 1);
+    if (client->block.target) {
+        memcpy(client->block.target, args[2], client->argv_len[2]);
+        client->block.target[client->argv_len[2]] = '\0';
+        client->block.target_len = client->argv_len[2];
+    }
+    if (!client->block.target ||
+        !block_client(server, client, BLOCK_LIST, args + 1, client->argv_len + 1, NULL, 1, timeout_ms)) {
+        free(client->block.target);
+        client->block.target = NULL;
+        send_error(client, "ERR out of memory");
+        return false;
+    }
+    return true;
+}
+
+// Pop for a client blocked in BLPOP/BRPOP/BLMOVE now that key was pushed
+// to. A BLMOVE whose destination has become another type gets the error.
+bool serve_blocked_list(Server* server, Client* client, const char* key, size_t key_len) {
+    RedisList* list = poppable_list(server, key, key_len);
+    if (!list) return false;
+    
+    BlockState* block = &client->block;
+    if (!block->target) {
+        pop_reply(server, client, key, key_len, list, block->pop_front);
+        return true;
+    }
+    
+    RedisObject* dst = hashmap_get(server->db, block->target, block->target_len);
+    if (dst && dst->type != REDIS_LIST) {
+        send_error(client, "WRONGTYPE Operation against a key holding the wrong kind of value");
+        return true;
+    }
+    list_move(server, client, key, key_len, block->target, block->target_len, block->pop_front,
+              block->push_front);
+    return true;
+}
@@ -0,0 +1,89 @@
+#include "../../server/server.h"
+#include "../../server/pubsub.h"
+#include "../../server/shard.h"
+#include <string.h>
+
+// Confirm a (un)subscription: [kind, name, subscriptions left]
+static void send_subscription(Client* client, const char* kind, const char* name, size_t name_len,
+                              size_t count) {
+    send_array(client, 3);
+    send_bulk(client, kind, strlen(kind));
+    if (name) {
+        send_bulk(client, name, name_len);
+    } else {
+        send_null(client);
+    }
+    send_integer(client, count);
+}
+
+static bool subscribe_generic(Server* server, Client* client, char** args, int argc, bool pattern) {
+    for (int i = 1; i < argc; i++) {
+        bool added;
+        if (!pubsub_subscribe(server, client, args[i], client->argv_len[i], pattern, &added)) {
+            send_error(client, "ERR out of memory");
+            return false;
+        }
+        send_subscription(client, pattern ? "psubscribe" : "subscribe", args[i], client->argv_len[i],
+                          pubsub_subscription_count(client));
+    }
+    return true;
+}
+
+// Without arguments every channel (or pattern) is dropped, each with a
+// reply of its own, or a single one with a null name if there was none
+static bool unsubscribe_generic(Server* server, Client* client, char** args, int argc, bool pattern) {
+    const char* kind = pattern ? "punsubscribe" : "unsubscribe";
+    
+    if (argc == 1) {
+        size_t len = 0;
+        const char* name = pubsub_last_subscription(client, pattern, &len);
+        if (!name) send_subscription(client, kind, NULL, 0, pubsub_subscription_count(client));
+        
+        // The name goes away with the last subscriber, so reply first
+        while (name) {
+            send_subscription(client, kind, name, len, pubsub_subscription_count(client) - 1);
+            pubsub_unsubscribe(server, client, name, len, pattern);
+            name = pubsub_last_subscription(client, pattern, &len);
+        }
+        return true;
+    }
+    
+    for (int i = 1; i < argc; i++) {
+        pubsub_unsubscribe(server, client, args[i], client->argv_len[i], pattern);
+        send_subscription(client, kind, args[i], client->argv_len[i], pubsub_subscription_count(client));
+    }
+    return true;
+}
+
+// SUBSCRIBE channel [channel ...]
+bool subscribe_command(Server* server, Client* client, char** args, int argc) {
+    return subscribe_generic(server, client, args, argc, false);
+}
+
+// UNSUBSCRIBE [channel ...]
+bool unsubscribe_command(Server* server, Client* client, char** args, int argc) {
+    return unsubscribe_generic(server, client, args, argc, false);
+}
+
+// PSUBSCRIBE pattern [pattern ...]
+bool psubscribe_command(Server* server, Client* client, char** args, int argc) {
+    return subscribe_generic(server, client, args, argc, true);
+}
+
+// PUNSUBSCRIBE [pattern ...]
+bool punsubscribe_command(Server* server, Client* client, char** args, int argc) {
+    return unsubscribe_generic(server, client, args, argc, true);
+}
+
+// PUBLISH channel message. Other shards deliver it to their own
+// subscribers; as in Redis Cluster, the reply counts this shard's only.
+bool publish_command(Server* server, Client* client, char** args, int argc) {
+    size_t receivers = pubsub_publish(server, args[1], client->argv_len[1], args[2], client->argv_len[2]);
+    if (server->shards && !shard_publish(server, argc, args, client->argv_len)) {
+        send_error(client, "ERR out of memory");
+        return false;
+    }
+    
+    send_integer(client, receivers);
+    return true;
+}
@@ -1,112 +1,79 @@
 #include "../../server/server.h"
 #include <string.h>
 
-bool handle_set_command(Server* server, Client* client, const char* command, char** args, int argc) {
-    if (!server || !client || !command || !args || argc < 2) {
-        send_error(client, "ERR wrong number of arguments");
-        return false;
-    }
-    
+bool sadd_command(Server* server, Client* client, char** args, int argc) {
     const char* key = args[1];
     
-    if (strcasecmp(command, "SADD") == 0) {
-        if (argc < 3) {
-            send_error(client, "ERR wrong number of arguments for SADD");
+    RedisObject* obj = hashmap_get(server->db, key, client->argv_len[1]);
+    bool created = obj == NULL;
+    RedisSet* set;
+    
+    if (!obj) {
+        set = createRedisSet();
+        if (!set) {
+            send_error(client, "ERR out of memory");
             return false;
         }
-        
-        RedisObject* obj = hashmap_get(server->db, key);
-        RedisSet* set;
-        
+        obj = createRedisObject(REDIS_SET, set);
         if (!obj) {
-            set = createRedisSet();
-            if (!set) {
-                send_error(client, "ERR out of memory");
-                return false;
-            }
-            obj = createRedisObject(REDIS_SET, set);
-            if (!obj) {
-                freeRedisSet(set);
-                send_error(client, "ERR out of memory");
-                return false;
-            }
-        } else if (obj->type != REDIS_SET) {
-            send_error(client, "WRONGTYPE Operation against a key holding the wrong kind of value");
-            return false;
-        } else {
-            set = obj->data;
-        }
-        
-        // Add all arguments to the set
-        size_t added = 0;
-        for (int i = 2; i < argc; i++) {
-            RedisString* str = createRedisString(args[i]);
-            if (!str) {
-                send_error(client, "ERR out of memory");
-                return false;
-            }
-            if (set_add(set, str)) {
-                added++;
-            } else {
-                freeRedisString(str);
-            }
-        }
-        
-        if (!hashmap_put(server->db, key, obj)) {
-            send_error(client, "ERR failed to update key");
+            freeRedisSet(set);
+            send_error(client, "ERR out of memory");
             return false;
         }
-        
-        send_integer(client, added);
-        return true;
+    } else if (obj->type != REDIS_SET) {
+        send_error(client, "WRONGTYPE Operation against a key holding the wrong kind of value");
+        return false;
+    } else {
+        set = obj->data;
     }
-    else if (strcasecmp(command, "SMEMBERS") == 0) {
-        RedisObject* obj = hashmap_get(server->db, key);
-        if (!obj || obj->type != REDIS_SET) {
-            send_array(client, 0);
-            return true;
-        }
-        
-        RedisSet* set = obj->data;
-        send_array(client, set->size);
-        
-        // Iterate through all members
-        for (size_t i = 0; i < set->capacity; i++) {
-            SetNode* node = set->buckets[i];
-            while (node) {
-                send_string(client, node->value->value);
-                node = node->next;
-            }
-        }
-        
+    
+    // Add all arguments to the set; setAdd() is false for a member
+    // already there
+    size_t added = 0;
+    for (int i = 2; i < argc; i++) {
+        if (setAdd(set, args[i], client->argv_len[i])) added++;
+    }
+    
+    if (!hashmap_put(server->db, key, client->argv_len[1], obj)) {
+        if (created) freeRedisObject(obj);
+        send_error(client, "ERR failed to update key");
+        return false;
+    }
+    
+    send_integer(client, added);
+    return true;
+}
+
+bool smembers_command(Server* server, Client* client, char** args, int argc) {
+    (void)argc;
+    const char* key = args[1];
+    
+    RedisObject* obj = hashmap_get(server->db, key, client->argv_len[1]);
+    if (!obj || obj->type != REDIS_SET) {
+        send_array(client, 0);
         return true;
     }
-    else if (strcasecmp(command, "SISMEMBER") == 0) {
-        if (argc != 3) {
-            send_error(client, "ERR wrong number of arguments for SISMEMBER");
-            return false;
-        }
-        
-        RedisObject* obj = hashmap_get(server->db, key);
-        if (!obj || obj->type != REDIS_SET) {
-            send_integer(client, 0);
-            return true;
-        }
-        
-        RedisSet* set = obj->data;
-        RedisString* str = createRedisString(args[2]);
-        if (!str) {
-            send_error(client, "ERR out of memory");
-            return false;
-        }
-        
-        bool is_member = set_contains(set, str);
-        freeRedisString(str);
-        
-        send_integer(client, is_member ? 1 : 0);
+    
+    RedisSet* set = obj->data;
+    send_array(client, set->size);
+    for (size_t i = 0; i < set->size; i++) {
+        send_bulk(client, set->elements[i]->data, set->elements[i]->len);
+    }
+    
+    return true;
+}
+
+bool sismember_command(Server* server, Client* client, char** args, int argc) {
+    (void)argc;
+    const char* key = args[1];
+    
+    RedisObject* obj = hashmap_get(server->db, key, client->argv_len[1]);
+    if (!obj || obj->type != REDIS_SET) {
+        send_integer(client, 0);
         return true;
     }
     
-    send_error(client, "ERR unknown command");
-    return false;
-} 
\ No newline at end of file
+    RedisSet* set = obj->data;
+    send_integer(client, setIsMember(set, args[2], client->argv_len[2]) ? 1 : 0);
+    return true;
+}
@@ -1,194 +1,335 @@
 #include "../../server/server.h"
+#include "../../server/blocking.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <time.h>
 
-bool handle_stream_command(Server* server, Client* client, const char* command, char** args, int argc) {
-    if (!server || !client || !command || !args || argc < 2) {
-        send_error(client, "ERR wrong number of arguments");
-        return false;
+// Longest "ms-seq" ID: two 20-digit numbers and the dash
+#define STREAM_ID_MAX_LEN 42
+
+typedef struct {
+    uint64_t ms;
+    uint64_t seq;
+} StreamID;
+
+// "ms-seq", or "ms" alone with missing_seq as its sequence number
+static bool parse_stream_id(const char* str, size_t len, uint64_t missing_seq, StreamID* id) {
+    const char* dash = memchr(str, '-', len);
+    size_t ms_len = dash ? (size_t)(dash - str) : len;
+    int64_t ms, seq;
+    if (!stringToInt64(str, ms_len, &ms) || ms < 0) return false;
+    if (dash) {
+        if (!stringToInt64(dash + 1, len - ms_len - 1, &seq) || seq < 0) return false;
+    }
+    id->ms = (uint64_t)ms;
+    id->seq = dash ? (uint64_t)seq : missing_seq;
+    return true;
+}
+
+static int stream_id_compare(StreamID a, StreamID b) {
+    if (a.ms != b.ms) return a.ms < b.ms ? -1 : 1;
+    if (a.seq != b.seq) return a.seq < b.seq ? -1 : 1;
+    return 0;
+}
+
+// IDs of stored entries were written by XADD, so they always parse
+static StreamID entry_id(const StreamEntry* entry) {
+    StreamID id = {0, 0};
+    parse_stream_id(entry->id, strlen(entry->id), 0, &id);
+    return id;
+}
+
+// First entry with an ID above id, or equal to it as well if inclusive.
+// Entries are kept in ID order.
+static StreamEntry* stream_seek(RedisStream* stream, StreamID id, bool inclusive) {
+    StreamEntry* entry = stream->first;
+    while (entry) {
+        int cmp = stream_id_compare(entry_id(entry), id);
+        if (cmp > 0 || (inclusive && cmp == 0)) break;
+        entry = entry->next;
+    }
+    return entry;
+}
+
+// Entries from the first one on up to end included, at most limit if
+// limit > 0
+static size_t stream_count_until(StreamEntry* first, StreamID end, size_t limit) {
+    size_t count = 0;
+    for (StreamEntry* entry = first; entry && (limit == 0 || count < limit); entry = entry->next) {
+        if (stream_id_compare(entry_id(entry), end) > 0) break;
+        count++;
+    }
+    return count;
+}
+
+// Reply with count entries from first on as [id, [field, value, ...]] pairs
+static void send_stream_entries(Client* client, StreamEntry* first, size_t count) {
+    send_array(client, count);
+    StreamEntry* entry = first;
+    for (size_t i = 0; i < count; i++, entry = entry->next) {
+        send_array(client, 2);
+        send_string(client, entry->id);
+        
+        // Send fields
+        send_array(client, entry->num_fields * 2);
+        for (size_t j = 0; j < entry->num_fields; j++) {
+            send_bulk(client, entry->fields[j]->data, entry->fields[j]->len);
+            send_bulk(client, entry->values[j]->data, entry->values[j]->len);
+        }
     }
+}
+
+// The ID XADD gives a new entry: "*" picks the current time, bumping the
+// sequence number past the last entry if the clock hasn't moved on, and
+// an explicit ID must be above the last one. Sends the error on failure.
+static bool xadd_id(Client* client, RedisStream* stream, const char* arg, size_t arg_len, StreamID* id) {
+    StreamID last = {0, 0};
+    if (stream && stream->last) last = entry_id(stream->last);
     
+    if (arg_len == 1 && arg[0] == '*') {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        id->ms = (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+        id->seq = 0;
+        if (id->ms <= last.ms) {
+            id->ms = last.ms;
+            id->seq = last.seq + 1;
+        }
+        return true;
+    }
+    
+    if (!parse_stream_id(arg, arg_len, 0, id)) {
+        send_error(client, "ERR Invalid stream ID specified as stream command argument");
+        return false;
+    }
+    if (id->ms == 0 && id->seq == 0) {
+        send_error(client, "ERR The ID specified in XADD must be greater than 0-0");
+        return false;
+    }
+    if (stream_id_compare(*id, last) <= 0) {
+        send_error(client, "ERR The ID specified in XADD is equal or smaller than the target stream top item");
+        return false;
+    }
+    return true;
+}
+
+bool xadd_command(Server* server, Client* client, char** args, int argc) {
     const char* key = args[1];
+    size_t key_len = client->argv_len[1];
     
-    if (strcasecmp(command, "XADD") == 0) {
-        if (argc < 4 || (argc - 2) % 2 != 0) {
-            send_error(client, "ERR wrong number of arguments for XADD");
-            return false;
-        }
-        
-        RedisObject* obj = hashmap_get(server->db, key);
-        RedisStream* stream;
-        
+    if ((argc - 3) % 2 != 0) {
+        send_error(client, "ERR wrong number of arguments for XADD");
+        return false;
+    }
+    
+    RedisObject* obj = hashmap_get(server->db, key, key_len);
+    if (obj && obj->type != REDIS_STREAM) {
+        send_error(client, "WRONGTYPE Operation against a key holding the wrong kind of value");
+        return false;
+    }
+    
+    StreamID id;
+    if (!xadd_id(client, obj ? obj->data : NULL, args[2], client->argv_len[2], &id)) return false;
+    char id_str[STREAM_ID_MAX_LEN + 1];
+    snprintf(id_str, sizeof(id_str), "%" PRIu64 "-%" PRIu64, id.ms, id.seq);
+    
+    bool created = obj == NULL;
+    if (created) {
+        RedisStream* stream = createRedisStream();
+        obj = stream ? createRedisObject(REDIS_STREAM, stream) : NULL;
         if (!obj) {
-            stream = createRedisStream();
-            if (!stream) {
-                send_error(client, "ERR out of memory");
-                return false;
-            }
-            obj = createRedisObject(REDIS_STREAM, stream);
-            if (!obj) {
-                freeRedisStream(stream);
-                send_error(client, "ERR out of memory");
-                return false;
-            }
-        } else if (obj->type != REDIS_STREAM) {
-            send_error(client, "WRONGTYPE Operation against a key holding the wrong kind of value");
+            if (stream) freeRedisStream(stream);
+            send_error(client, "ERR out of memory");
             return false;
-        } else {
-            stream = obj->data;
         }
-        
-        // Generate ID if not provided
-        char* id = args[2];
-        if (strcmp(id, "*") == 0) {
-            id = stream_generate_id(stream);
-            if (!id) {
-                send_error(client, "ERR out of memory");
-                return false;
-            }
-        }
-        
-        // Add all field-value pairs
-        StreamEntry* entry = stream_add(stream, id);
-        if (!entry) {
-            if (strcmp(id, "*") == 0) {
-                free(id);
-            }
-            send_error(client, "ERR failed to add entry");
-            return false;
-        }
-        
-        for (int i = 3; i < argc; i += 2) {
-            RedisString* field = createRedisString(args[i]);
-            RedisString* value = createRedisString(args[i + 1]);
-            
-            if (!field || !value) {
-                if (field) freeRedisString(field);
-                if (value) freeRedisString(value);
-                send_error(client, "ERR out of memory");
-                return false;
-            }
-            
-            if (!stream_entry_add_field(entry, field, value)) {
-                freeRedisString(field);
-                freeRedisString(value);
-                send_error(client, "ERR failed to add field");
-                return false;
-            }
-        }
-        
-        if (!hashmap_put(server->db, key, obj)) {
-            send_error(client, "ERR failed to update key");
-            return false;
-        }
-        
-        send_string(client, id);
-        if (strcmp(id, "*") == 0) {
-            free(id);
+    }
+    
+    // Fields and values alternate in args
+    size_t num_fields = (argc - 3) / 2;
+    char** fields = malloc(num_fields * sizeof(char*));
+    char** values = malloc(num_fields * sizeof(char*));
+    size_t* field_lens = malloc(num_fields * sizeof(size_t));
+    size_t* value_lens = malloc(num_fields * sizeof(size_t));
+    StreamEntry* entry = NULL;
+    if (fields && values && field_lens && value_lens) {
+        for (size_t i = 0; i < num_fields; i++) {
+            fields[i] = args[3 + 2 * i];
+            field_lens[i] = client->argv_len[3 + 2 * i];
+            values[i] = args[4 + 2 * i];
+            value_lens[i] = client->argv_len[4 + 2 * i];
         }
+        entry = streamAdd(obj->data, id_str, fields, field_lens, values, value_lens, num_fields);
+    }
+    free(fields);
+    free(values);
+    free(field_lens);
+    free(value_lens);
+    
+    if (!entry) {
+        if (created) freeRedisObject(obj);
+        send_error(client, "ERR out of memory");
+        return false;
+    }
+    
+    if (!hashmap_put(server->db, key, key_len, obj)) {
+        if (created) freeRedisObject(obj);
+        send_error(client, "ERR failed to update key");
+        return false;
+    }
+    
+    signal_key_ready(server, key, key_len);
+    send_string(client, entry->id);
+    return true;
+}
+
+// XRANGE key start end, both included; "-" and "+" are the lowest and
+// highest IDs, and an ID without a sequence number covers all of them
+bool xrange_command(Server* server, Client* client, char** args, int argc) {
+    (void)argc;
+    StreamID start = {0, 0};
+    StreamID end = {UINT64_MAX, UINT64_MAX};
+    if ((strcmp(args[2], "-") != 0 && !parse_stream_id(args[2], client->argv_len[2], 0, &start)) ||
+        (strcmp(args[3], "+") != 0 && !parse_stream_id(args[3], client->argv_len[3], UINT64_MAX, &end))) {
+        send_error(client, "ERR Invalid stream ID specified as stream command argument");
+        return false;
+    }
+    
+    RedisObject* obj = hashmap_get(server->db, args[1], client->argv_len[1]);
+    if (!obj || obj->type != REDIS_STREAM) {
+        send_array(client, 0);
         return true;
     }
-    else if (strcasecmp(command, "XRANGE") == 0) {
-        if (argc != 4) {
-            send_error(client, "ERR wrong number of arguments for XRANGE");
-            return false;
-        }
-        
-        RedisObject* obj = hashmap_get(server->db, key);
-        if (!obj || obj->type != REDIS_STREAM) {
-            send_array(client, 0);
-            return true;
-        }
-        
-        RedisStream* stream = obj->data;
-        const char* start = args[2];
-        const char* end = args[3];
-        
-        // Get entries in range
-        StreamEntry** entries;
-        size_t count;
-        if (!stream_range(stream, start, end, &entries, &count)) {
-            send_error(client, "ERR failed to get range");
-            return false;
+    
+    StreamEntry* first = stream_seek(obj->data, start, true);
+    send_stream_entries(client, first, stream_count_until(first, end, 0));
+    return true;
+}
+
+// Reply with the entries after ids[i] of each stream keys[i], at most
+// count per stream if count > 0, leaving out streams with none. The IDs
+// have been checked. Returns 1 if it replied, 0 if there was nothing to
+// read and -1 on an error, which has been sent.
+static int xread_reply(Server* server, Client* client, char** keys, const size_t* key_lens, char** ids,
+                       int key_count, long count) {
+    StreamEntry** firsts = calloc(key_count, sizeof(StreamEntry*));
+    size_t* counts = calloc(key_count, sizeof(size_t));
+    if (!firsts || !counts) {
+        free(firsts);
+        free(counts);
+        send_error(client, "ERR out of memory");
+        return -1;
+    }
+    
+    int status = 0;
+    size_t found = 0;
+    StreamID last = {UINT64_MAX, UINT64_MAX};
+    for (int i = 0; i < key_count; i++) {
+        RedisObject* obj = hashmap_get(server->db, keys[i], key_lens[i]);
+        if (!obj) continue;
+        if (obj->type != REDIS_STREAM) {
+            send_error(client, "WRONGTYPE Operation against a key holding the wrong kind of value");
+            status = -1;
+            break;
         }
-        
-        send_array(client, count);
-        
-        for (size_t i = 0; i < count; i++) {
-            StreamEntry* entry = entries[i];
+        StreamID after = {0, 0};
+        parse_stream_id(ids[i], strlen(ids[i]), 0, &after);
+        firsts[i] = stream_seek(obj->data, after, false);
+        counts[i] = stream_count_until(firsts[i], last, count > 0 ? (size_t)count : 0);
+        if (counts[i] > 0) found++;
+    }
+    
+    if (status == 0 && found > 0) {
+        send_array(client, found);
+        for (int i = 0; i < key_count; i++) {
+            if (counts[i] == 0) continue;
             send_array(client, 2);
-            send_string(client, entry->id);
-            
-            // Send fields
-            send_array(client, entry->field_count * 2);
-            for (size_t j = 0; j < entry->field_count; j++) {
-                send_string(client, entry->fields[j]->field->value);
-                send_string(client, entry->fields[j]->value->value);
-            }
+            send_bulk(client, keys[i], key_lens[i]);
+            send_stream_entries(client, firsts[i], counts[i]);
         }
-        
-        free(entries);
-        return true;
+        status = 1;
     }
-    else if (strcasecmp(command, "XREAD") == 0) {
-        if (argc < 3) {
-            send_error(client, "ERR wrong number of arguments for XREAD");
+    
+    free(firsts);
+    free(counts);
+    return status;
+}
+
+// XREAD [COUNT count] [BLOCK milliseconds] STREAMS key [key ...] id [id ...]
+bool xread_command(Server* server, Client* client, char** args, int argc) {
+    long count = 0;
+    int64_t block_ms = -1;
+    int streams = 0;
+    for (int i = 1; i < argc && streams == 0; i++) {
+        if (strcasecmp(args[i], "STREAMS") == 0) {
+            streams = i;
+        } else if (strcasecmp(args[i], "COUNT") == 0 && i + 1 < argc) {
+            int64_t value;
+            if (!parse_int64_arg(client, args, ++i, &value)) return false;
+            count = value;
+        } else if (strcasecmp(args[i], "BLOCK") == 0 && i + 1 < argc) {
+            if (!parse_block_timeout(args[++i], false, &block_ms)) {
+                send_error(client, "ERR timeout is not an integer or out of range");
+                return false;
+            }
+        } else {
+            send_error(client, "ERR syntax error");
             return false;
         }
-        
-        // Parse streams and IDs
-        size_t stream_count = (argc - 2) / 2;
-        if ((argc - 2) % 2 != 0) {
-            send_error(client, "ERR wrong number of arguments for XREAD");
+    }
+    
+    int remaining = argc - streams - 1;
+    if (streams == 0 || remaining < 2 || remaining % 2 != 0) {
+        send_error(client, "ERR Unbalanced XREAD list of streams: for each stream key an ID or '$' must be specified");
+        return false;
+    }
+    
+    // "$" means entries added from now on, so it becomes the last ID
+    int key_count = remaining / 2;
+    char** keys = args + streams + 1;
+    const size_t* key_lens = client->argv_len + streams + 1;
+    char** ids = calloc(key_count, sizeof(char*));
+    if (!ids) {
+        send_error(client, "ERR out of memory");
+        return false;
+    }
+    for (int i = 0; i < key_count; i++) {
+        ids[i] = keys[key_count + i];
+        StreamID id;
+        if (strcmp(ids[i], "$") == 0) {
+            RedisObject* obj = hashmap_get(server->db, keys[i], key_lens[i]);
+            RedisStream* stream = obj && obj->type == REDIS_STREAM ? obj->data : NULL;
+            ids[i] = stream && stream->last ? stream->last->id : "0-0";
+        } else if (!parse_stream_id(ids[i], key_lens[key_count + i], 0, &id)) {
+            free(ids);
+            send_error(client, "ERR Invalid stream ID specified as stream command argument");
             return false;
         }
-        
-        send_array(client, 1);
-        send_array(client, stream_count);
-        
-        for (size_t i = 0; i < stream_count; i++) {
-            const char* stream_key = args[2 + i * 2];
-            const char* id = args[3 + i * 2];
-            
-            RedisObject* obj = hashmap_get(server->db, stream_key);
-            if (!obj || obj->type != REDIS_STREAM) {
-                send_array(client, 2);
-                send_string(client, stream_key);
-                send_array(client, 0);
-                continue;
-            }
-            
-            RedisStream* stream = obj->data;
-            StreamEntry** entries;
-            size_t count;
-            
-            if (!stream_read(stream, id, &entries, &count)) {
-                send_error(client, "ERR failed to read stream");
-                return false;
-            }
-            
-            send_array(client, 2);
-            send_string(client, stream_key);
-            send_array(client, count);
-            
-            for (size_t j = 0; j < count; j++) {
-                StreamEntry* entry = entries[j];
-                send_array(client, 2);
-                send_string(client, entry->id);
-                
-                // Send fields
-                send_array(client, entry->field_count * 2);
-                for (size_t k = 0; k < entry->field_count; k++) {
-                    send_string(client, entry->fields[k]->field->value);
-                    send_string(client, entry->fields[k]->value->value);
-                }
+    }
+    
+    int status = xread_reply(server, client, keys, key_lens, ids, key_count, count);
+    if (status == 0) {
+        if (block_ms < 0 || client->multi.executing) {
+            send_null_array(client);
+        } else {
+            client->block.count = count;
+            if (!block_client(server, client, BLOCK_STREAM, keys, key_lens, ids, key_count, block_ms)) {
+                send_error(client, "ERR out of memory");
+                status = -1;
             }
-            
-            free(entries);
         }
-        
-        return true;
     }
     
-    send_error(client, "ERR unknown command");
-    return false;
-} 
\ No newline at end of file
+    free(ids);
+    return status >= 0;
+}
+
+// Read again for a client blocked in XREAD now that a stream it waits on
+// was added to
+bool serve_blocked_stream(Server* server, Client* client) {
+    BlockState* block = &client->block;
+    return xread_reply(server, client, block->keys, block->key_lens, block->ids, block->key_count,
+                       block->count) != 0;
+}
@@ -1,54 +1,342 @@
 #include "../../server/server.h"
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+#include <math.h>
 
-bool handle_string_command(Server* server, Client* client, const char* command, char** args, int argc) {
-    if (!server || !client || !command || !args || argc < 2) {
-        send_error(client, "ERR wrong number of arguments");
+#define WRONGTYPE_ERROR "WRONGTYPE Operation against a key holding the wrong kind of value"
+
+// A string object for value, holding it as an integer when it reads back
+// the same way, and in the object's own allocation when it is short
+static RedisObject* string_object(const char* value, size_t len) {
+    int64_t integer;
+    if (stringToInt64(value, len, &integer)) return createRedisIntegerObject(integer);
+    if (len < REDIS_EMBSTR_MAX_LEN) return createRedisEmbeddedString(value, len);
+    
+    RedisString* str = createRedisStringLen(value, len);
+    if (!str) return NULL;
+    
+    RedisObject* obj = createRedisObject(REDIS_STRING, str);
+    if (!obj) freeRedisString(str);
+    return obj;
+}
+
+// A string object for args[index], keeping the buffer of a big value
+// that was received into its own allocation
+static RedisObject* string_arg(Client* client, char** args, int index) {
+    char* owned = client_take_arg(client, index);
+    if (!owned) return string_object(args[index], client->argv_len[index]);
+    
+    RedisString* str = createRedisStringOwned(owned, client->argv_len[index]);
+    if (!str) {
+        free(owned);
+        return NULL;
+    }
+    
+    RedisObject* obj = createRedisObject(REDIS_STRING, str);
+    if (!obj) freeRedisString(str);
+    return obj;
+}
+
+bool set_command(Server* server, Client* client, char** args, int argc) {
+    (void)argc;
+    const char* key = args[1];
+    
+    RedisObject* obj = string_arg(client, args, 2);
+    if (!obj) {
+        send_error(client, "ERR out of memory");
+        return false;
+    }
+    
+    if (hashmap_put(server->db, key, client->argv_len[1], obj)) {
+        send_ok(client);
+        return true;
+    } else {
+        freeRedisObject(obj);
+        send_error(client, "ERR failed to set key");
         return false;
     }
+}
+
+// Reply with a string value, caching its framed form once it has been read
+// often enough; a failure to cache only costs the speedup
+static void send_string_value(Server* server, Client* client, RedisObject* obj) {
+    if (obj->encoding == REDIS_ENCODING_INT) {
+        send_bulk_object(client, obj);
+        return;
+    }
     
+    RedisString* str = obj->data;
+    if (!str->reply && str->len <= server->config.reply_cache_max_bytes &&
+        ++str->reads >= server->config.reply_cache_min_reads) {
+        redisStringCacheReply(str);
+    }
+    send_bulk_object(client, obj);
+}
+
+bool get_command(Server* server, Client* client, char** args, int argc) {
+    (void)argc;
     const char* key = args[1];
     
-    if (strcasecmp(command, "SET") == 0) {
-        if (argc < 3) {
-            send_error(client, "ERR wrong number of arguments for SET");
-            return false;
+    RedisObject* obj = hashmap_get(server->db, key, client->argv_len[1]);
+    if (!obj || obj->type != REDIS_STRING) {
+        send_null(client);
+        return true;
+    }
+    
+    send_string_value(server, client, obj);
+    return true;
+}
+
+// The multi-key commands look their keys up HASHMAP_BATCH at a time, so
+// the cache misses of a batch overlap
+
+// MGET key [key ...]
+bool mget_command(Server* server, Client* client, char** args, int argc) {
+    RedisObject* values[HASHMAP_BATCH];
+    
+    send_array(client, argc - 1);
+    for (int start = 1; start < argc; start += HASHMAP_BATCH) {
+        int n = argc - start < HASHMAP_BATCH ? argc - start : HASHMAP_BATCH;
+        hashmap_get_many(server->db, args + start, client->argv_len + start, n, 1, values);
+        for (int i = 0; i < n; i++) {
+            if (values[i] && values[i]->type == REDIS_STRING) {
+                send_string_value(server, client, values[i]);
+            } else {
+                send_null(client);
+            }
         }
-        
-        RedisString* str = createRedisString(args[2]);
-        if (!str) {
-            send_error(client, "ERR out of memory");
-            return false;
+    }
+    return true;
+}
+
+// MSET key value [key value ...], and MSETNX, which sets nothing if any of
+// the keys exists
+static bool mset_generic(Server* server, Client* client, char** args, int argc, bool nx) {
+    if ((argc - 1) % 2 != 0) {
+        send_arity_error(client, nx ? "msetnx" : "mset");
+        return false;
+    }
+    
+    RedisObject* values[HASHMAP_BATCH];
+    int pairs = (argc - 1) / 2;
+    if (nx) {
+        for (int start = 0; start < pairs; start += HASHMAP_BATCH) {
+            int n = pairs - start < HASHMAP_BATCH ? pairs - start : HASHMAP_BATCH;
+            hashmap_get_many(server->db, args + 1 + start * 2, client->argv_len + 1 + start * 2, n, 2, values);
+            for (int i = 0; i < n; i++) {
+                if (values[i]) {
+                    send_integer(client, 0);
+                    return true;
+                }
+            }
         }
-        
-        RedisObject* obj = createRedisObject(REDIS_STRING, str);
+    }
+    
+    for (int index = 1; index < argc; index += 2) {
+        RedisObject* obj = string_arg(client, args, index + 1);
         if (!obj) {
-            freeRedisString(str);
             send_error(client, "ERR out of memory");
             return false;
         }
-        
-        if (hashmap_put(server->db, key, obj)) {
-            send_ok(client);
-            return true;
-        } else {
+        if (!hashmap_put(server->db, args[index], client->argv_len[index], obj)) {
             freeRedisObject(obj);
             send_error(client, "ERR failed to set key");
             return false;
         }
     }
-    else if (strcasecmp(command, "GET") == 0) {
-        RedisObject* obj = hashmap_get(server->db, key);
-        if (!obj || obj->type != REDIS_STRING) {
-            send_null(client);
-            return true;
+    
+    if (nx) {
+        send_integer(client, 1);
+    } else {
+        send_ok(client);
+    }
+    return true;
+}
+
+bool mset_command(Server* server, Client* client, char** args, int argc) {
+    return mset_generic(server, client, args, argc, false);
+}
+
+bool msetnx_command(Server* server, Client* client, char** args, int argc) {
+    return mset_generic(server, client, args, argc, true);
+}
+
+// DEL key [key ...]: the number of keys removed
+bool del_command(Server* server, Client* client, char** args, int argc) {
+    RedisObject* values[HASHMAP_BATCH];
+    int64_t removed = 0;
+    
+    for (int start = 1; start < argc; start += HASHMAP_BATCH) {
+        int n = argc - start < HASHMAP_BATCH ? argc - start : HASHMAP_BATCH;
+        hashmap_get_many(server->db, args + start, client->argv_len + start, n, 1, values);
+        for (int i = 0; i < n; i++) {
+            // A key repeated in the same call is removed once
+            if (values[i] && hashmap_remove(server->db, args[start + i], client->argv_len[start + i])) removed++;
+        }
+    }
+    send_integer(client, removed);
+    return true;
+}
+
+// UNLINK key [key ...]: values are freed right away, as with DEL
+bool unlink_command(Server* server, Client* client, char** args, int argc) {
+    return del_command(server, client, args, argc);
+}
+
+// EXISTS key [key ...]: a key given twice counts twice
+bool exists_command(Server* server, Client* client, char** args, int argc) {
+    RedisObject* values[HASHMAP_BATCH];
+    int64_t found = 0;
+    
+    for (int start = 1; start < argc; start += HASHMAP_BATCH) {
+        int n = argc - start < HASHMAP_BATCH ? argc - start : HASHMAP_BATCH;
+        hashmap_get_many(server->db, args + start, client->argv_len + start, n, 1, values);
+        for (int i = 0; i < n; i++) {
+            if (values[i]) found++;
+        }
+    }
+    send_integer(client, found);
+    return true;
+}
+
+// INCR and friends: the value must be an integer. Integer-encoded values
+// are updated in the object itself.
+static bool incr_generic(Server* server, Client* client, const char* key, size_t key_len, int64_t delta) {
+    RedisObject* obj = hashmap_get(server->db, key, key_len);
+    int64_t value = 0;
+    if (obj) {
+        if (obj->type != REDIS_STRING) {
+            send_error(client, WRONGTYPE_ERROR);
+            return false;
         }
         
-        RedisString* str = obj->data;
-        send_string(client, str->value);
-        return true;
+        bool valid = obj->encoding == REDIS_ENCODING_INT;
+        if (valid) {
+            value = obj->integer;
+        } else {
+            RedisString* str = obj->data;
+            valid = stringToInt64(str->value, str->len, &value);
+        }
+        if (!valid) {
+            send_error(client, "ERR value is not an integer or out of range");
+            return false;
+        }
+    }
+    
+    if ((delta > 0 && value > INT64_MAX - delta) || (delta < 0 && value < INT64_MIN - delta)) {
+        send_error(client, "ERR increment or decrement would overflow");
+        return false;
+    }
+    value += delta;
+    
+    // A shared object must not change under its other holders
+    if (obj && obj->encoding == REDIS_ENCODING_INT &&
+        atomic_load_explicit(&obj->refcount, memory_order_acquire) == 1) {
+        obj->integer = value;
+        hashmap_touch(server->db, key, key_len);
+    } else {
+        RedisObject* updated = createRedisIntegerObject(value);
+        if (!updated) {
+            send_error(client, "ERR out of memory");
+            return false;
+        }
+        if (!hashmap_put(server->db, key, key_len, updated)) {
+            freeRedisObject(updated);
+            send_error(client, "ERR failed to set key");
+            return false;
+        }
+    }
+    
+    send_integer(client, value);
+    return true;
+}
+
+bool incr_command(Server* server, Client* client, char** args, int argc) {
+    (void)argc;
+    return incr_generic(server, client, args[1], client->argv_len[1], 1);
+}
+
+bool decr_command(Server* server, Client* client, char** args, int argc) {
+    (void)argc;
+    return incr_generic(server, client, args[1], client->argv_len[1], -1);
+}
+
+bool incrby_command(Server* server, Client* client, char** args, int argc) {
+    (void)argc;
+    int64_t delta;
+    if (!parse_int64_arg(client, args, 2, &delta)) return false;
+    return incr_generic(server, client, args[1], client->argv_len[1], delta);
+}
+
+bool decrby_command(Server* server, Client* client, char** args, int argc) {
+    (void)argc;
+    int64_t delta;
+    if (!parse_int64_arg(client, args, 2, &delta)) return false;
+    if (delta == INT64_MIN) {
+        send_error(client, "ERR decrement would overflow");
+        return false;
+    }
+    return incr_generic(server, client, args[1], client->argv_len[1], -delta);
+}
+
+// The whole of len bytes as a finite number, no surrounding spaces
+static bool parse_long_double(const char* str, size_t len, long double* value) {
+    if (len == 0 || isspace((unsigned char)str[0])) return false;
+    
+    char* end;
+    *value = strtold(str, &end);
+    return end == str + len && !isnan(*value);
+}
+
+// INCRBYFLOAT key increment: the result is stored as text
+bool incrbyfloat_command(Server* server, Client* client, char** args, int argc) {
+    (void)argc;
+    const char* key = args[1];
+    long double increment;
+    if (!parse_long_double(args[2], client->argv_len[2], &increment)) {
+        send_error(client, "ERR value is not a valid float");
+        return false;
+    }
+    
+    RedisObject* obj = hashmap_get(server->db, key, client->argv_len[1]);
+    long double value = 0;
+    if (obj) {
+        if (obj->type != REDIS_STRING) {
+            send_error(client, WRONGTYPE_ERROR);
+            return false;
+        }
+        if (obj->encoding == REDIS_ENCODING_INT) {
+            value = obj->integer;
+        } else {
+            RedisString* str = obj->data;
+            if (!parse_long_double(str->value, str->len, &value)) {
+                send_error(client, "ERR value is not a valid float");
+                return false;
+            }
+        }
+    }
+    
+    value += increment;
+    if (isnan(value) || isinf(value)) {
+        send_error(client, "ERR increment would produce NaN or Infinity");
+        return false;
+    }
+    
+    char buf[64];
+    int len = snprintf(buf, sizeof(buf), "%.17Lg", value);
+    RedisObject* updated = string_object(buf, len);
+    if (!updated) {
+        send_error(client, "ERR out of memory");
+        return false;
+    }
+    if (!hashmap_put(server->db, key, client->argv_len[1], updated)) {
+        freeRedisObject(updated);
+        send_error(client, "ERR failed to set key");
+        return false;
     }
     
-    send_error(client, "ERR unknown command");
-    return false;
-} 
\ No newline at end of file
+    send_bulk(client, buf, len);
+    return true;
+}
@@ -0,0 +1,91 @@
+#include "../../server/server.h"
+#include "../../server/multi.h"
+
+// MULTI: commands are queued until EXEC
+bool multi_command(Server* server, Client* client, char** args, int argc) {
+    (void)args;
+    (void)argc;
+    if (server->shards) {
+        send_error(client, "ERR MULTI is not supported with more than one shard");
+        return false;
+    }
+    if (client->multi.active) {
+        send_error(client, "ERR MULTI calls can not be nested");
+        return false;
+    }
+    
+    client->multi.active = true;
+    send_ok(client);
+    return true;
+}
+
+// EXEC: run the queue, unless a command failed to queue or a watched key
+// changed, which a null reply reports
+bool exec_command(Server* server, Client* client, char** args, int argc) {
+    (void)args;
+    (void)argc;
+    if (!client->multi.active) {
+        send_error(client, "ERR EXEC without MULTI");
+        return false;
+    }
+    if (client->multi.dirty) {
+        multi_discard(client);
+        multi_unwatch(client);
+        send_error(client, "EXECABORT Transaction discarded because of previous errors.");
+        return false;
+    }
+    if (multi_watched_changed(server, client)) {
+        multi_discard(client);
+        multi_unwatch(client);
+        send_null_array(client);
+        return true;
+    }
+    
+    multi_exec(server, client);
+    return true;
+}
+
+bool discard_command(Server* server, Client* client, char** args, int argc) {
+    (void)server;
+    (void)args;
+    (void)argc;
+    if (!client->multi.active) {
+        send_error(client, "ERR DISCARD without MULTI");
+        return false;
+    }
+    
+    multi_discard(client);
+    multi_unwatch(client);
+    send_ok(client);
+    return true;
+}
+
+// WATCH key [key ...]
+bool watch_command(Server* server, Client* client, char** args, int argc) {
+    if (server->shards) {
+        send_error(client, "ERR WATCH is not supported with more than one shard");
+        return false;
+    }
+    if (client->multi.active) {
+        send_error(client, "ERR WATCH inside MULTI is not allowed");
+        return false;
+    }
+    
+    for (int i = 1; i < argc; i++) {
+        if (!multi_watch(server, client, args[i], client->argv_len[i])) {
+            send_error(client, "ERR out of memory");
+            return false;
+        }
+    }
+    send_ok(client);
+    return true;
+}
+
+bool unwatch_command(Server* server, Client* client, char** args, int argc) {
+    (void)server;
+    (void)args;
+    (void)argc;
+    multi_unwatch(client);
+    send_ok(client);
+    return true;
+}
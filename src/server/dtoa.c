@@ -0,0 +1,266 @@
+#include "dtoa.h"
+#include "../types/redis_types.h"
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+// Shortest digits that read back as the same double, by Grisu2 (Florian
+// Loitsch, "Printing Floating-Point Numbers Quickly and Accurately with
+// Integers", 2010). The output always round-trips; in rare cases it has
+// a digit more than the shortest.
+
+#define DP_SIGNIFICAND_BITS 52
+#define DP_EXPONENT_BIAS (0x3FF + DP_SIGNIFICAND_BITS)
+#define DP_HIDDEN_BIT 0x0010000000000000ULL
+#define DP_SIGNIFICAND_MASK 0x000FFFFFFFFFFFFFULL
+
+// Beyond this %g switches to an exponent, as it does here
+#define DTOA_MAX_FIXED_EXPONENT 17
+
+// A number f * 2^e
+typedef struct {
+    uint64_t f;
+    int e;
+} DiyFp;
+
+// 10^-348, 10^-340, ..., 10^340 as normalized DiyFp
+static const uint64_t cached_powers_f[] = {
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL, 0xcf42894a5dce35eaULL,
+    0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL, 0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL,
+    0xbe5691ef416bd60cULL, 0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL, 0xc21094364dfb5637ULL,
+    0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL, 0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL,
+    0xb23867fb2a35b28eULL, 0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL, 0xb5b5ada8aaff80b8ULL,
+    0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL, 0x964e858c91ba2655ULL, 0xdff9772470297ebdULL,
+    0xa6dfbd9fb8e5b88fULL, 0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL, 0xaa242499697392d3ULL,
+    0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL, 0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL,
+    0x9c40000000000000ULL, 0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL, 0x9f4f2726179a2245ULL,
+    0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL, 0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL,
+    0x924d692ca61be758ULL, 0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL, 0x952ab45cfa97a0b3ULL,
+    0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL, 0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL,
+    0x88fcf317f22241e2ULL, 0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL, 0x8bab8eefb6409c1aULL,
+    0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL, 0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL,
+    0x80444b5e7aa7cf85ULL, 0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL
+};
+
+static const int16_t cached_powers_e[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+    -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+    -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+    -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+    56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+    694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+    1013, 1039, 1066
+};
+
+static const uint32_t pow10_32[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+static const uint64_t pow10_64[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+    1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+    1000000000000000000ULL, 10000000000000000000ULL
+};
+
+static DiyFp diyfp_from_double(double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    int biased_e = (int)((bits >> DP_SIGNIFICAND_BITS) & 0x7FF);
+    uint64_t significand = bits & DP_SIGNIFICAND_MASK;
+    if (biased_e != 0) return (DiyFp){significand + DP_HIDDEN_BIT, biased_e - DP_EXPONENT_BIAS};
+    return (DiyFp){significand, 1 - DP_EXPONENT_BIAS};
+}
+
+// The upper 64 bits of the product, rounded
+static DiyFp diyfp_multiply(DiyFp a, DiyFp b) {
+    unsigned __int128 product = (unsigned __int128)a.f * b.f;
+    uint64_t high = (uint64_t)(product >> 64);
+    if ((uint64_t)product & (1ULL << 63)) high++;
+    return (DiyFp){high, a.e + b.e + 64};
+}
+
+static DiyFp diyfp_normalize(DiyFp x) {
+    int shift = __builtin_clzll(x.f);
+    return (DiyFp){x.f << shift, x.e - shift};
+}
+
+// The midpoints to the neighbouring doubles, on the same exponent
+static void normalized_boundaries(DiyFp v, DiyFp* minus, DiyFp* plus) {
+    DiyFp upper = diyfp_normalize((DiyFp){(v.f << 1) + 1, v.e - 1});
+    DiyFp lower = v.f == DP_HIDDEN_BIT ? (DiyFp){(v.f << 2) - 1, v.e - 2} : (DiyFp){(v.f << 1) - 1, v.e - 1};
+    lower.f <<= lower.e - upper.e;
+    lower.e = upper.e;
+    *minus = lower;
+    *plus = upper;
+}
+
+// A power of ten c with e + c.e in [-60, -32], and its exponent k
+static DiyFp cached_power(int e, int* k) {
+    double dk = (-61 - e) * 0.30102999566398114 + 347;
+    int ik = (int)dk;
+    if (dk - ik > 0.0) ik++;
+    unsigned index = (unsigned)((ik >> 3) + 1);
+    *k = -(-348 + (int)(index << 3));
+    return (DiyFp){cached_powers_f[index], cached_powers_e[index]};
+}
+
+static int count_digits(uint32_t n) {
+    int digits = 1;
+    while (digits < 10 && n >= pow10_32[digits]) digits++;
+    return digits;
+}
+
+// Move the last digit towards w while it stays inside the boundaries
+static void grisu_round(char* digits, int len, uint64_t delta, uint64_t rest, uint64_t ten_kappa, uint64_t wp_w) {
+    while (rest < wp_w && delta - rest >= ten_kappa &&
+           (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w)) {
+        digits[len - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+// Generate digits of mp until they pin down a number within delta of it
+static int digit_gen(DiyFp w, DiyFp mp, uint64_t delta, char* digits, int* k) {
+    int shift = -mp.e;
+    uint64_t one = 1ULL << shift;
+    uint64_t wp_w = mp.f - w.f;
+    uint32_t p1 = (uint32_t)(mp.f >> shift);
+    uint64_t p2 = mp.f & (one - 1);
+    int kappa = count_digits(p1);
+    int len = 0;
+    
+    while (kappa > 0) {
+        uint32_t d = p1 / pow10_32[kappa - 1];
+        p1 %= pow10_32[kappa - 1];
+        if (d || len) digits[len++] = (char)('0' + d);
+        kappa--;
+        uint64_t rest = ((uint64_t)p1 << shift) + p2;
+        if (rest <= delta) {
+            *k += kappa;
+            grisu_round(digits, len, delta, rest, (uint64_t)pow10_32[kappa] << shift, wp_w);
+            return len;
+        }
+    }
+    
+    for (;;) {
+        p2 *= 10;
+        delta *= 10;
+        char d = (char)(p2 >> shift);
+        if (d || len) digits[len++] = (char)('0' + d);
+        p2 &= one - 1;
+        kappa--;
+        if (p2 < delta) {
+            *k += kappa;
+            int index = -kappa;
+            grisu_round(digits, len, delta, p2, one, index < 20 ? wp_w * pow10_64[index] : 0);
+            return len;
+        }
+    }
+}
+
+// Digits of a positive finite value, which is digits * 10^k
+static int grisu2(double value, char* digits, int* k) {
+    DiyFp v = diyfp_from_double(value);
+    DiyFp minus, plus;
+    normalized_boundaries(v, &minus, &plus);
+    
+    DiyFp c = cached_power(plus.e, k);
+    DiyFp w = diyfp_multiply(diyfp_normalize(v), c);
+    DiyFp wp = diyfp_multiply(plus, c);
+    DiyFp wm = diyfp_multiply(minus, c);
+    wm.f++;
+    wp.f--;
+    return digit_gen(w, wp, wp.f - wm.f, digits, k);
+}
+
+// Lay the digits out the way %g does: plain unless the exponent is below
+// -4 or at least 17, then d.ddde+XX
+static size_t format_digits(char* buf, const char* digits, int len, int k) {
+    int exponent = len + k - 1;
+    char* p = buf;
+    
+    if (exponent < -4 || exponent >= DTOA_MAX_FIXED_EXPONENT) {
+        *p++ = digits[0];
+        if (len > 1) {
+            *p++ = '.';
+            memcpy(p, digits + 1, len - 1);
+            p += len - 1;
+        }
+        *p++ = 'e';
+        *p++ = exponent < 0 ? '-' : '+';
+        int magnitude = exponent < 0 ? -exponent : exponent;
+        if (magnitude >= 100) *p++ = (char)('0' + magnitude / 100);
+        *p++ = (char)('0' + magnitude / 10 % 10);
+        *p++ = (char)('0' + magnitude % 10);
+    } else if (exponent >= len - 1) {
+        memcpy(p, digits, len);
+        p += len;
+        memset(p, '0', exponent - len + 1);
+        p += exponent - len + 1;
+    } else if (exponent >= 0) {
+        memcpy(p, digits, exponent + 1);
+        p += exponent + 1;
+        *p++ = '.';
+        memcpy(p, digits + exponent + 1, len - exponent - 1);
+        p += len - exponent - 1;
+    } else {
+        *p++ = '0';
+        *p++ = '.';
+        memset(p, '0', -exponent - 1);
+        p += -exponent - 1;
+        memcpy(p, digits, len);
+        p += len;
+    }
+    
+    *p = '\0';
+    return p - buf;
+}
+
+// Write value with the fewest digits that read back as the same double,
+// laid out like printf's %.17g, with a NUL after it. buf needs
+// DTOA_BUF_SIZE bytes. Integral values, the usual scores, take the
+// integer path.
+size_t dtoa_format(char* buf, double value) {
+    if (isnan(value)) {
+        memcpy(buf, "nan", 4);
+        return 3;
+    }
+    if (isinf(value)) {
+        if (value > 0) {
+            memcpy(buf, "inf", 4);
+            return 3;
+        }
+        memcpy(buf, "-inf", 5);
+        return 4;
+    }
+    if (value == 0) {
+        if (signbit(value)) {
+            memcpy(buf, "-0", 3);
+            return 2;
+        }
+        memcpy(buf, "0", 2);
+        return 1;
+    }
+    if (value > -1e17 && value < 1e17 && value == (double)(int64_t)value) {
+        return int64ToString(buf, (int64_t)value);
+    }
+    
+    char* p = buf;
+    if (value < 0) {
+        *p++ = '-';
+        value = -value;
+    }
+    char digits[20];
+    int k;
+    int len = grisu2(value, digits, &k);
+    return (p - buf) + format_digits(p, digits, len, k);
+}
@@ -0,0 +1,12 @@
+#ifndef DTOA_H
+#define DTOA_H
+
+#include <stddef.h>
+
+// Room for any double dtoa_format() writes, NUL included
+#define DTOA_BUF_SIZE 32
+
+// Function declarations
+size_t dtoa_format(char* buf, double value);
+
+#endif // DTOA_H
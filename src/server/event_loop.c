@@ -0,0 +1,286 @@
+#include "event_loop.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/epoll.h>
+
+EventLoop* event_loop_create(int setsize) {
+    if (setsize <= 0) return NULL;
+    
+    EventLoop* loop = malloc(sizeof(EventLoop));
+    if (!loop) return NULL;
+    
+    loop->setsize = setsize;
+    loop->maxfd = -1;
+    loop->data = NULL;
+    loop->before_sleep = NULL;
+    loop->dont_wait = false;
+    loop->timers = NULL;
+    loop->events = calloc(setsize, sizeof(FileEvent));
+    loop->fired = malloc(setsize * sizeof(struct epoll_event));
+    if (!loop->events || !loop->fired) {
+        free(loop->events);
+        free(loop->fired);
+        free(loop);
+        return NULL;
+    }
+    
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epfd < 0) {
+        free(loop->events);
+        free(loop->fired);
+        free(loop);
+        return NULL;
+    }
+    
+    return loop;
+}
+
+void event_loop_destroy(EventLoop* loop) {
+    if (!loop) return;
+    close(loop->epfd);
+    free(loop->events);
+    free(loop->fired);
+    free(loop);
+}
+
+bool event_loop_add(EventLoop* loop, int fd, int mask, FileEventProc proc, void* data) {
+    if (!loop || fd < 0) return false;
+    if (fd >= loop->setsize) {
+        errno = ERANGE;
+        return false;
+    }
+    
+    FileEvent* fe = &loop->events[fd];
+    int new_mask = fe->mask | mask;
+    
+    // Level-triggered: the kernel only reports fds that are ready
+    struct epoll_event ee;
+    memset(&ee, 0, sizeof(ee));
+    if (new_mask & EVENT_READABLE) ee.events |= EPOLLIN;
+    if (new_mask & EVENT_WRITABLE) ee.events |= EPOLLOUT;
+    ee.data.fd = fd;
+    
+    int op = fe->mask == EVENT_NONE ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+    if (epoll_ctl(loop->epfd, op, fd, &ee) < 0) return false;
+    
+    fe->mask = new_mask;
+    if (mask & EVENT_READABLE) fe->read_proc = proc;
+    if (mask & EVENT_WRITABLE) fe->write_proc = proc;
+    fe->data = data;
+    if (fd > loop->maxfd) loop->maxfd = fd;
+    return true;
+}
+
+void event_loop_remove(EventLoop* loop, int fd, int mask) {
+    if (!loop || fd < 0 || fd >= loop->setsize) return;
+    
+    FileEvent* fe = &loop->events[fd];
+    if (fe->mask == EVENT_NONE) return;
+    
+    int new_mask = fe->mask & ~mask;
+    
+    struct epoll_event ee;
+    memset(&ee, 0, sizeof(ee));
+    if (new_mask & EVENT_READABLE) ee.events |= EPOLLIN;
+    if (new_mask & EVENT_WRITABLE) ee.events |= EPOLLOUT;
+    ee.data.fd = fd;
+    
+    if (new_mask != EVENT_NONE) {
+        epoll_ctl(loop->epfd, EPOLL_CTL_MOD, fd, &ee);
+    } else {
+        // The fd may already be closed, in which case the kernel dropped it
+        epoll_ctl(loop->epfd, EPOLL_CTL_DEL, fd, &ee);
+    }
+    
+    fe->mask = new_mask;
+    if (fd == loop->maxfd && new_mask == EVENT_NONE) {
+        int j;
+        for (j = loop->maxfd - 1; j >= 0; j--) {
+            if (loop->events[j].mask != EVENT_NONE) break;
+        }
+        loop->maxfd = j;
+    }
+}
+
+int event_loop_get_mask(const EventLoop* loop, int fd) {
+    if (!loop || fd < 0 || fd >= loop->setsize) return EVENT_NONE;
+    return loop->events[fd].mask;
+}
+
+void event_loop_set_before_sleep(EventLoop* loop, BeforeSleepProc proc) {
+    if (!loop) return;
+    loop->before_sleep = proc;
+}
+
+// Wait up to timeout_ms (-1 blocks) and dispatch ready fds.
+// Returns the number of fds handled, or -1 on error.
+int event_loop_process(EventLoop* loop, int timeout_ms) {
+    if (!loop) return -1;
+    
+    if (loop->before_sleep) loop->before_sleep(loop);
+    if (loop->dont_wait) {
+        loop->dont_wait = false;
+        timeout_ms = 0;
+    }
+    if (loop->timers) timeout_ms = timers_wait_ms(loop->timers, timeout_ms);
+    
+    struct epoll_event* fired = loop->fired;
+    int n = epoll_wait(loop->epfd, fired, loop->setsize, timeout_ms);
+    if (n < 0) {
+        if (errno != EINTR) return -1;
+        n = 0;
+    }
+    
+    for (int i = 0; i < n; i++) {
+        int fd = fired[i].data.fd;
+        FileEvent* fe = &loop->events[fd];
+        
+        int mask = EVENT_NONE;
+        if (fired[i].events & EPOLLIN) mask |= EVENT_READABLE;
+        if (fired[i].events & EPOLLOUT) mask |= EVENT_WRITABLE;
+        if (fired[i].events & (EPOLLERR | EPOLLHUP)) mask |= EVENT_READABLE | EVENT_WRITABLE;
+        
+        // A handler earlier in this batch may have removed the fd,
+        // so re-check the registered mask before each callback
+        bool read_fired = false;
+        if (fe->mask & mask & EVENT_READABLE) {
+            fe->read_proc(loop, fd, fe->data, mask);
+            read_fired = true;
+        }
+        if (fe->mask & mask & EVENT_WRITABLE) {
+            if (!read_fired || fe->write_proc != fe->read_proc) {
+                fe->write_proc(loop, fd, fe->data, mask);
+            }
+        }
+    }
+    
+    if (loop->timers) timers_run(loop->timers);
+    return n;
+}
+
+int64_t monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void timers_init(TimerQueue* timers, void* data) {
+    timers->heap = NULL;
+    timers->count = 0;
+    timers->capacity = 0;
+    timers->data = data;
+}
+
+// Drop every pending timer without running it
+void timers_free(TimerQueue* timers) {
+    for (size_t i = 0; i < timers->count; i++) {
+        free(timers->heap[i]);
+    }
+    free(timers->heap);
+    timers->heap = NULL;
+    timers->count = 0;
+    timers->capacity = 0;
+}
+
+static void timer_place(TimerQueue* timers, Timer* timer, size_t index) {
+    timers->heap[index] = timer;
+    timer->index = index;
+}
+
+static void timer_sift_up(TimerQueue* timers, size_t index) {
+    Timer* timer = timers->heap[index];
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (timers->heap[parent]->when_ms <= timer->when_ms) break;
+        timer_place(timers, timers->heap[parent], index);
+        index = parent;
+    }
+    timer_place(timers, timer, index);
+}
+
+static void timer_sift_down(TimerQueue* timers, size_t index) {
+    Timer* timer = timers->heap[index];
+    while (true) {
+        size_t child = index * 2 + 1;
+        if (child >= timers->count) break;
+        if (child + 1 < timers->count && timers->heap[child + 1]->when_ms < timers->heap[child]->when_ms) {
+            child++;
+        }
+        if (timer->when_ms <= timers->heap[child]->when_ms) break;
+        timer_place(timers, timers->heap[child], index);
+        index = child;
+    }
+    timer_place(timers, timer, index);
+}
+
+// Call proc(timers, data) once monotonic_ms() reaches when_ms. The handle
+// stays valid until the timer runs or is cancelled. Returns NULL if out
+// of memory.
+Timer* timer_add(TimerQueue* timers, int64_t when_ms, TimerProc proc, void* data) {
+    if (timers->count == timers->capacity) {
+        size_t capacity = timers->capacity ? timers->capacity * 2 : 16;
+        Timer** heap = realloc(timers->heap, capacity * sizeof(Timer*));
+        if (!heap) return NULL;
+        timers->heap = heap;
+        timers->capacity = capacity;
+    }
+    
+    Timer* timer = malloc(sizeof(Timer));
+    if (!timer) return NULL;
+    timer->when_ms = when_ms;
+    timer->proc = proc;
+    timer->data = data;
+    
+    timer_place(timers, timer, timers->count++);
+    timer_sift_up(timers, timer->index);
+    return timer;
+}
+
+// Remove a timer that has not run yet
+void timer_cancel(TimerQueue* timers, Timer* timer) {
+    if (!timer) return;
+    
+    size_t index = timer->index;
+    Timer* last = timers->heap[--timers->count];
+    if (last != timer) {
+        timer_place(timers, last, index);
+        timer_sift_down(timers, index);
+        timer_sift_up(timers, last->index);
+    }
+    free(timer);
+}
+
+// How long a wait of at most max_ms (-1 for no limit) may last so the
+// next timer runs on time
+int timers_wait_ms(const TimerQueue* timers, int max_ms) {
+    if (timers->count == 0 || max_ms == 0) return max_ms;
+    
+    int64_t wait = timers->heap[0]->when_ms - monotonic_ms();
+    if (wait < 0) wait = 0;
+    return max_ms >= 0 && wait > max_ms ? max_ms : (int)wait;
+}
+
+// Run the timers that are due. Timers added meanwhile wait for the next
+// call, even if already due. Returns how many ran.
+int timers_run(TimerQueue* timers) {
+    int64_t now = monotonic_ms();
+    int ran = 0;
+    
+    while (timers->count > 0 && timers->heap[0]->when_ms <= now) {
+        Timer* timer = timers->heap[0];
+        Timer* last = timers->heap[--timers->count];
+        if (last != timer) {
+            timer_place(timers, last, 0);
+            timer_sift_down(timers, 0);
+        }
+        
+        timer->proc(timers, timer->data);
+        free(timer);
+        ran++;
+    }
+    
+    return ran;
+}
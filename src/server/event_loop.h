@@ -0,0 +1,82 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Event masks
+#define EVENT_NONE     0
+#define EVENT_READABLE 1
+#define EVENT_WRITABLE 2
+
+// Extra fd slots on top of max_clients (listener, stdio, logs, ...)
+#define EVENT_LOOP_FDSET_INCR 128
+
+typedef struct EventLoop EventLoop;
+typedef struct TimerQueue TimerQueue;
+
+// Called when a registered fd becomes readable or writable
+typedef void (*FileEventProc)(EventLoop* loop, int fd, void* data, int mask);
+
+// Called once per iteration, right before waiting for events
+typedef void (*BeforeSleepProc)(EventLoop* loop);
+
+// Called once when a timer is due; the timer is gone by then
+typedef void (*TimerProc)(TimerQueue* timers, void* data);
+
+// Per-fd registration, indexed by the fd itself
+typedef struct {
+    int mask;
+    FileEventProc read_proc;
+    FileEventProc write_proc;
+    void* data;
+} FileEvent;
+
+// One-shot timer, see timer_add()
+typedef struct Timer {
+    int64_t when_ms;        // Monotonic deadline
+    size_t index;           // Position in the heap
+    TimerProc proc;
+    void* data;
+} Timer;
+
+// Pending timers as a binary min-heap on the deadline
+struct TimerQueue {
+    Timer** heap;
+    size_t count;
+    size_t capacity;
+    void* data;             // Owner context, e.g. the Server
+};
+
+struct EventLoop {
+    int epfd;
+    int setsize;
+    int maxfd;
+    FileEvent* events;
+    void* fired;  // struct epoll_event[setsize]
+    void* data;   // Owner context, e.g. the Server
+    BeforeSleepProc before_sleep;
+    bool dont_wait;  // Set by before_sleep when work is left: poll, don't block
+    TimerQueue* timers;  // Run after the fd events; the wait ends at the next one
+};
+
+// Function declarations
+EventLoop* event_loop_create(int setsize);
+void event_loop_destroy(EventLoop* loop);
+bool event_loop_add(EventLoop* loop, int fd, int mask, FileEventProc proc, void* data);
+void event_loop_remove(EventLoop* loop, int fd, int mask);
+int event_loop_get_mask(const EventLoop* loop, int fd);
+void event_loop_set_before_sleep(EventLoop* loop, BeforeSleepProc proc);
+int event_loop_process(EventLoop* loop, int timeout_ms);
+
+// Timers
+int64_t monotonic_ms(void);
+void timers_init(TimerQueue* timers, void* data);
+void timers_free(TimerQueue* timers);
+Timer* timer_add(TimerQueue* timers, int64_t when_ms, TimerProc proc, void* data);
+void timer_cancel(TimerQueue* timers, Timer* timer);
+int timers_wait_ms(const TimerQueue* timers, int max_ms);
+int timers_run(TimerQueue* timers);
+
+#endif // EVENT_LOOP_H
@@ -0,0 +1,199 @@
+#include "io_threads.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+
+// How long an idle worker spins before checking whether it is parked
+#define IO_SPIN_ITERATIONS 1000000
+
+// Below this many clients per thread, handing work out costs more than
+// doing it on the main thread
+#define IO_MIN_CLIENTS_PER_THREAD 2
+
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t mutex;   // Held by the main thread while the worker is parked
+    IOThreadPool* pool;
+    Client** clients;
+    size_t count;
+    size_t capacity;
+    atomic_size_t pending;   // Non-zero while the worker owns `clients`
+} IOThread;
+
+struct IOThreadPool {
+    int count;               // Thread 0 is the main thread itself
+    IOThread* threads;
+    atomic_int op;
+    atomic_bool shutdown;
+    bool active;
+};
+
+static void io_process_client(Client* client, IOOp op) {
+    if (op == IO_OP_READ) {
+        ClientIOStatus status = client_read_query(client);
+        if (status == CLIENT_IO_OK) status = client_parse_query(client);
+        client->io_status = status;
+    } else {
+        client->io_status = client_flush(client) ? CLIENT_IO_OK : CLIENT_IO_CLOSED;
+    }
+}
+
+static void* io_thread_main(void* arg) {
+    IOThread* thread = arg;
+    IOThreadPool* pool = thread->pool;
+    
+    while (true) {
+        for (int i = 0; i < IO_SPIN_ITERATIONS; i++) {
+            if (atomic_load(&thread->pending) != 0) break;
+        }
+        
+        if (atomic_load(&thread->pending) == 0) {
+            // Blocks here while the main thread keeps us parked; otherwise
+            // give the core back in case threads outnumber cores
+            pthread_mutex_lock(&thread->mutex);
+            pthread_mutex_unlock(&thread->mutex);
+            sched_yield();
+            continue;
+        }
+        
+        if (atomic_load(&pool->shutdown)) break;
+        
+        IOOp op = atomic_load(&pool->op);
+        for (size_t i = 0; i < thread->count; i++) {
+            io_process_client(thread->clients[i], op);
+        }
+        thread->count = 0;
+        atomic_store(&thread->pending, 0);
+    }
+    
+    return NULL;
+}
+
+// Hold every worker on its mutex, so none spins while there is no work.
+// The next io_threads_run() with enough clients releases them.
+void io_threads_park(IOThreadPool* pool) {
+    if (!pool || !pool->active) return;
+    for (int i = 1; i < pool->count; i++) {
+        pthread_mutex_lock(&pool->threads[i].mutex);
+    }
+    pool->active = false;
+}
+
+bool io_threads_parked(const IOThreadPool* pool) {
+    return !pool || !pool->active;
+}
+
+static void io_threads_unpark(IOThreadPool* pool) {
+    if (pool->active) return;
+    for (int i = 1; i < pool->count; i++) {
+        pthread_mutex_unlock(&pool->threads[i].mutex);
+    }
+    pool->active = true;
+}
+
+IOThreadPool* io_threads_create(int count) {
+    if (count <= 1) return NULL;
+    if (count > IO_THREADS_MAX) count = IO_THREADS_MAX;
+    
+    IOThreadPool* pool = malloc(sizeof(IOThreadPool));
+    if (!pool) return NULL;
+    
+    pool->count = count;
+    pool->threads = calloc(count, sizeof(IOThread));
+    if (!pool->threads) {
+        free(pool);
+        return NULL;
+    }
+    atomic_init(&pool->op, IO_OP_READ);
+    atomic_init(&pool->shutdown, false);
+    pool->active = true;
+    
+    for (int i = 0; i < count; i++) {
+        IOThread* thread = &pool->threads[i];
+        thread->pool = pool;
+        atomic_init(&thread->pending, 0);
+        pthread_mutex_init(&thread->mutex, NULL);
+    }
+    
+    // Workers start parked and are released once there is enough load
+    io_threads_park(pool);
+    
+    for (int i = 1; i < count; i++) {
+        if (pthread_create(&pool->threads[i].thread, NULL, io_thread_main, &pool->threads[i]) != 0) {
+            perror("Failed to create I/O thread");
+            pool->count = i;
+            io_threads_destroy(pool);
+            return NULL;
+        }
+    }
+    
+    return pool;
+}
+
+void io_threads_destroy(IOThreadPool* pool) {
+    if (!pool) return;
+    
+    atomic_store(&pool->shutdown, true);
+    io_threads_unpark(pool);
+    for (int i = 1; i < pool->count; i++) {
+        atomic_store(&pool->threads[i].pending, 1);
+        pthread_join(pool->threads[i].thread, NULL);
+    }
+    
+    for (int i = 0; i < pool->count; i++) {
+        pthread_mutex_destroy(&pool->threads[i].mutex);
+        free(pool->threads[i].clients);
+    }
+    free(pool->threads);
+    free(pool);
+}
+
+// Run `op` on every client, spread across the pool, and return once all
+// of them are done. The caller's thread takes a share of the work too.
+void io_threads_run(IOThreadPool* pool, Client** clients, size_t count, IOOp op) {
+    if (!pool || count < (size_t)pool->count * IO_MIN_CLIENTS_PER_THREAD) {
+        if (pool) io_threads_park(pool);
+        for (size_t i = 0; i < count; i++) {
+            io_process_client(clients[i], op);
+        }
+        return;
+    }
+    
+    io_threads_unpark(pool);
+    atomic_store(&pool->op, op);
+    
+    // Round-robin assignment
+    for (size_t i = 0; i < count; i++) {
+        IOThread* thread = &pool->threads[i % pool->count];
+        if (thread->count == thread->capacity) {
+            size_t capacity = thread->capacity ? thread->capacity * 2 : 64;
+            Client** grown = realloc(thread->clients, capacity * sizeof(Client*));
+            if (!grown) {
+                io_process_client(clients[i], op);
+                continue;
+            }
+            thread->clients = grown;
+            thread->capacity = capacity;
+        }
+        thread->clients[thread->count++] = clients[i];
+    }
+    
+    for (int i = 1; i < pool->count; i++) {
+        if (pool->threads[i].count > 0) {
+            atomic_store(&pool->threads[i].pending, pool->threads[i].count);
+        }
+    }
+    
+    IOThread* self = &pool->threads[0];
+    for (size_t i = 0; i < self->count; i++) {
+        io_process_client(self->clients[i], op);
+    }
+    self->count = 0;
+    
+    for (int i = 1; i < pool->count; i++) {
+        while (atomic_load(&pool->threads[i].pending) != 0) sched_yield();
+    }
+}
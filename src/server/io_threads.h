@@ -0,0 +1,24 @@
+#ifndef IO_THREADS_H
+#define IO_THREADS_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "server.h"
+
+#define IO_THREADS_MAX 64
+
+typedef enum {
+    IO_OP_READ,   // Read the socket and parse the query buffer
+    IO_OP_WRITE   // Flush pending replies
+} IOOp;
+
+typedef struct IOThreadPool IOThreadPool;
+
+// Function declarations
+IOThreadPool* io_threads_create(int count);
+void io_threads_destroy(IOThreadPool* pool);
+void io_threads_run(IOThreadPool* pool, Client** clients, size_t count, IOOp op);
+void io_threads_park(IOThreadPool* pool);
+bool io_threads_parked(const IOThreadPool* pool);
+
+#endif // IO_THREADS_H
@@ -0,0 +1,148 @@
+#include "multi.h"
+#include <stdlib.h>
+#include <string.h>
+
+static void free_queued(QueuedCommand* queued) {
+    for (int i = 0; i < queued->argc; i++) {
+        free(queued->argv_owned[i]);
+    }
+    free(queued->argv);
+    free(queued->argv_len);
+    free(queued->argv_owned);
+}
+
+// Queue a command for EXEC. Its arguments are slices of the query buffer,
+// so they are copied, except big bulks already in their own allocation,
+// which are taken over. The arity has already been checked.
+bool multi_queue(Client* client, const Command* cmd, char** args, int argc) {
+    MultiState* multi = &client->multi;
+    if (multi->count == multi->capacity) {
+        int capacity = multi->capacity ? multi->capacity * 2 : 8;
+        QueuedCommand* commands = realloc(multi->commands, capacity * sizeof(QueuedCommand));
+        if (!commands) return false;
+        multi->commands = commands;
+        multi->capacity = capacity;
+    }
+    
+    QueuedCommand* queued = &multi->commands[multi->count];
+    queued->cmd = cmd;
+    queued->argc = argc;
+    queued->argv = calloc(argc, sizeof(char*));
+    queued->argv_len = calloc(argc, sizeof(size_t));
+    queued->argv_owned = calloc(argc, sizeof(char*));
+    if (!queued->argv || !queued->argv_len || !queued->argv_owned) {
+        queued->argc = 0;
+        free_queued(queued);
+        return false;
+    }
+    
+    bool from_client = args == client->argv;
+    for (int i = 0; i < argc; i++) {
+        size_t len = from_client ? client->argv_len[i] : strlen(args[i]);
+        char* arg = from_client ? client_take_arg(client, i) : NULL;
+        if (!arg) {
+            arg = malloc(len + 1);
+            if (!arg) {
+                free_queued(queued);
+                return false;
+            }
+            memcpy(arg, args[i], len);
+            arg[len] = '\0';
+        }
+        queued->argv[i] = arg;
+        queued->argv_len[i] = len;
+        queued->argv_owned[i] = arg;
+    }
+    
+    multi->count++;
+    return true;
+}
+
+// Drop the queued commands and leave MULTI. Watched keys stay.
+void multi_discard(Client* client) {
+    MultiState* multi = &client->multi;
+    for (int i = 0; i < multi->count; i++) {
+        free_queued(&multi->commands[i]);
+    }
+    free(multi->commands);
+    multi->commands = NULL;
+    multi->count = 0;
+    multi->capacity = 0;
+    multi->active = false;
+    multi->dirty = false;
+}
+
+// Run the queued commands back to back, replying with one array of their
+// replies, then leave MULTI. The caller has checked the watched keys.
+void multi_exec(Server* server, Client* client) {
+    MultiState* multi = &client->multi;
+    int saved_argc = client->argc;
+    char** saved_argv = client->argv;
+    size_t* saved_argv_len = client->argv_len;
+    char** saved_argv_owned = client->argv_owned;
+    
+    send_array(client, multi->count);
+    multi->executing = true;
+    for (int i = 0; i < multi->count; i++) {
+        QueuedCommand* queued = &multi->commands[i];
+        client->argc = queued->argc;
+        client->argv = queued->argv;
+        client->argv_len = queued->argv_len;
+        client->argv_owned = queued->argv_owned;
+        call_command(server, client, queued->cmd, queued->argv, queued->argc);
+    }
+    multi->executing = false;
+    
+    client->argc = saved_argc;
+    client->argv = saved_argv;
+    client->argv_len = saved_argv_len;
+    client->argv_owned = saved_argv_owned;
+    multi_discard(client);
+    multi_unwatch(client);
+}
+
+// Remember the key's version for EXEC to compare
+bool multi_watch(Server* server, Client* client, const char* key, size_t key_len) {
+    MultiState* multi = &client->multi;
+    for (int i = 0; i < multi->watched_count; i++) {
+        const WatchedKey* watched = &multi->watched[i];
+        if (watched->key_len == key_len && memcmp(watched->key, key, key_len) == 0) return true;
+    }
+    
+    if (multi->watched_count == multi->watched_capacity) {
+        int capacity = multi->watched_capacity ? multi->watched_capacity * 2 : 4;
+        WatchedKey* watched = realloc(multi->watched, capacity * sizeof(WatchedKey));
+        if (!watched) return false;
+        multi->watched = watched;
+        multi->watched_capacity = capacity;
+    }
+    
+    char* copy = malloc(key_len + 1);
+    if (!copy) return false;
+    memcpy(copy, key, key_len);
+    copy[key_len] = '\0';
+    multi->watched[multi->watched_count++] = (WatchedKey){copy, key_len, hashmap_version(server->db, key, key_len)};
+    return true;
+}
+
+void multi_unwatch(Client* client) {
+    MultiState* multi = &client->multi;
+    for (int i = 0; i < multi->watched_count; i++) {
+        free(multi->watched[i].key);
+    }
+    free(multi->watched);
+    multi->watched = NULL;
+    multi->watched_count = 0;
+    multi->watched_capacity = 0;
+}
+
+// Optimistic locking: nothing is held while watching, EXEC just checks
+// whether any watched key changed since
+bool multi_watched_changed(Server* server, const Client* client) {
+    const MultiState* multi = &client->multi;
+    for (int i = 0; i < multi->watched_count; i++) {
+        const WatchedKey* watched = &multi->watched[i];
+        if (hashmap_version(server->db, watched->key, watched->key_len) != watched->version) return true;
+    }
+    return false;
+}
@@ -0,0 +1,16 @@
+#ifndef MULTI_H
+#define MULTI_H
+
+#include <stdbool.h>
+#include "server.h"
+#include "command_table.h"
+
+// Function declarations
+bool multi_queue(Client* client, const Command* cmd, char** args, int argc);
+void multi_discard(Client* client);
+void multi_exec(Server* server, Client* client);
+bool multi_watch(Server* server, Client* client, const char* key, size_t key_len);
+void multi_unwatch(Client* client);
+bool multi_watched_changed(Server* server, const Client* client);
+
+#endif // MULTI_H
@@ -0,0 +1,159 @@
+#include "parse.h"
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PARSE_X86 1
+#endif
+
+// Used for what the vector loops leave over: a CR in the last byte can't
+// be followed by its LF, so it isn't searched
+static const char* find_crlf_scalar(const char* p, const char* end) {
+    while (end - p >= 2) {
+        const char* cr = memchr(p, '\r', end - p - 1);
+        if (!cr) return NULL;
+        if (cr[1] == '\n') return cr;
+        p = cr + 1;
+    }
+    return NULL;
+}
+
+#ifdef PARSE_X86
+// Bit i is set if p[i] is a CR followed by LF, for 16 positions: the
+// second load, one byte further on, lines each LF up with the CR before
+// it, so a lone CR in the data costs nothing extra
+static inline int crlf_mask_sse2(const char* p) {
+    __m128i here = _mm_loadu_si128((const __m128i*)p);
+    __m128i next = _mm_loadu_si128((const __m128i*)(p + 1));
+    return _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(here, _mm_set1_epi8('\r')),
+                                           _mm_cmpeq_epi8(next, _mm_set1_epi8('\n'))));
+}
+
+static const char* find_crlf_sse2(const char* p, const char* end) {
+    while (end - p >= 17) {
+        int mask = crlf_mask_sse2(p);
+        if (mask) return p + __builtin_ctz(mask);
+        p += 16;
+    }
+    return find_crlf_scalar(p, end);
+}
+
+// The same 32 positions at a time, for long inline commands
+__attribute__((target("avx2")))
+static const char* find_crlf_avx2(const char* p, const char* end) {
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+    while (end - p >= 33) {
+        __m256i here = _mm256_loadu_si256((const __m256i*)p);
+        __m256i next = _mm256_loadu_si256((const __m256i*)(p + 1));
+        unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(here, cr),
+                                                              _mm256_cmpeq_epi8(next, lf)));
+        if (mask) return p + __builtin_ctz(mask);
+        p += 32;
+    }
+    return find_crlf_sse2(p, end);
+}
+#endif
+
+// Find the first "\r\n" in buf[0..len); returns its '\r' or NULL.
+// Header lines are a few bytes long, so the first SSE2 step nearly always
+// finds it; longer lines go on with AVX2 when the CPU has it.
+const char* parse_find_crlf(const char* buf, size_t len) {
+    const char* end = buf + len;
+#ifdef PARSE_X86
+    if (len < 17) return find_crlf_scalar(buf, end);
+    int mask = crlf_mask_sse2(buf);
+    if (mask) return buf + __builtin_ctz(mask);
+    if (__builtin_cpu_supports("avx2")) return find_crlf_avx2(buf + 16, end);
+    return find_crlf_sse2(buf + 16, end);
+#else
+    return find_crlf_scalar(buf, end);
+#endif
+}
+
+// strtod() wants a C string, so the bytes are copied and terminated
+static bool parse_double_libc(const char* str, size_t len, double* value) {
+    char stack[PARSE_DOUBLE_STACK_LEN];
+    char* copy = len < sizeof(stack) ? stack : malloc(len + 1);
+    if (!copy) return false;
+    memcpy(copy, str, len);
+    copy[len] = '\0';
+    
+    char* end;
+    errno = 0;
+    double result = strtod(copy, &end);
+    bool ok = end == copy + len && !isnan(result) &&
+              !(errno == ERANGE && (isinf(result) || result == 0));
+    if (copy != stack) free(copy);
+    if (ok) *value = result;
+    return ok;
+}
+
+// Powers of ten a double holds exactly
+static const double exact_powers_of_ten[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Parse the whole of len bytes as a double, as strtod() reads it, but
+// without leading spaces or anything after the number, and neither NaN
+// nor a result that overflows or underflows to zero. "inf" is allowed.
+//
+// Plain decimals like scores and coordinates are converted here: when the
+// digits fit in 53 bits and the power of ten is exact, one multiply or
+// divide rounds correctly. Everything else goes to strtod().
+bool parse_double(const char* str, size_t len, double* value) {
+    if (len == 0 || isspace((unsigned char)str[0])) return false;
+    
+    const char* p = str;
+    const char* end = str + len;
+    bool negative = *p == '-';
+    if (*p == '-' || *p == '+') p++;
+    
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    bool digits = false;
+    for (; p < end && *p >= '0' && *p <= '9'; p++) {
+        if (mantissa > (UINT64_MAX - 9) / 10) return parse_double_libc(str, len, value);
+        mantissa = mantissa * 10 + (*p - '0');
+        digits = true;
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+            if (mantissa > (UINT64_MAX - 9) / 10) return parse_double_libc(str, len, value);
+            mantissa = mantissa * 10 + (*p - '0');
+            exponent--;
+            digits = true;
+        }
+    }
+    
+    // "inf", hex and the like
+    if (!digits) return parse_double_libc(str, len, value);
+    
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool exponent_negative = p < end && *p == '-';
+        if (p < end && (*p == '-' || *p == '+')) p++;
+        if (p == end || *p < '0' || *p > '9') return false;
+        
+        int e = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; p++) {
+            if (e < 100000) e = e * 10 + (*p - '0');
+        }
+        exponent += exponent_negative ? -e : e;
+    }
+    if (p != end) return parse_double_libc(str, len, value);
+    
+    if (mantissa > (1ULL << 53) || exponent < -22 || exponent > 22) {
+        return parse_double_libc(str, len, value);
+    }
+    double result = (double)mantissa;
+    result = exponent < 0 ? result / exact_powers_of_ten[-exponent] : result * exact_powers_of_ten[exponent];
+    *value = negative ? -result : result;
+    return true;
+}
@@ -0,0 +1,14 @@
+#ifndef PARSE_H
+#define PARSE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Longest number parse_double() converts without a heap copy
+#define PARSE_DOUBLE_STACK_LEN 128
+
+// Function declarations
+const char* parse_find_crlf(const char* buf, size_t len);
+bool parse_double(const char* str, size_t len, double* value);
+
+#endif // PARSE_H
@@ -0,0 +1,530 @@
+#include "pubsub.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PUBSUB_INITIAL_BUCKETS 16
+
+// One subscriber of a channel or pattern
+typedef struct {
+    Client* client;
+    size_t link;            // Index of the subscription in the client's list
+} Subscriber;
+
+// A channel or pattern with at least one subscriber
+typedef struct PubSubTarget {
+    char* name;
+    size_t name_len;
+    Subscriber* subscribers;
+    size_t count;
+    size_t capacity;
+    struct PubSubTarget* next;          // Bucket chain
+    struct PatternNode* node;           // Pattern: trie node of its literal prefix
+    struct PubSubTarget* node_prev;     // Pattern: others at the same node
+    struct PubSubTarget* node_next;
+} PubSubTarget;
+
+// A client's subscription; subscribers[index] of target points back here
+typedef struct PubSubLink {
+    PubSubTarget* target;
+    size_t index;
+} PubSubLink;
+
+// Trie on the literal prefix of patterns, the part before the first
+// wildcard. A channel can only match the patterns found on the path its
+// own bytes take from the root, so a publish never looks at the others.
+typedef struct PatternNode {
+    unsigned char byte;
+    struct PatternNode* parent;
+    struct PatternNode** children;
+    size_t child_count;
+    size_t child_capacity;
+    PubSubTarget* patterns;
+} PatternNode;
+
+typedef struct {
+    PubSubTarget** buckets;
+    size_t bucket_count;    // Power of two
+    size_t count;
+} TargetTable;
+
+// Channels and patterns with subscribers. A target is dropped with its
+// last subscriber.
+typedef struct PubSub {
+    TargetTable channels;
+    TargetTable patterns;
+    PatternNode root;
+} PubSub;
+
+// FNV-1a
+static size_t pubsub_hash(const char* name, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static bool table_init(TargetTable* table) {
+    table->bucket_count = PUBSUB_INITIAL_BUCKETS;
+    table->count = 0;
+    table->buckets = calloc(table->bucket_count, sizeof(PubSubTarget*));
+    return table->buckets != NULL;
+}
+
+static PubSubTarget* table_find(const TargetTable* table, const char* name, size_t len) {
+    PubSubTarget* target = table->buckets[pubsub_hash(name, len) & (table->bucket_count - 1)];
+    while (target && (target->name_len != len || memcmp(target->name, name, len) != 0)) {
+        target = target->next;
+    }
+    return target;
+}
+
+// Double the buckets once there are more targets than buckets
+static void table_grow(TargetTable* table) {
+    size_t count = table->bucket_count * 2;
+    PubSubTarget** buckets = calloc(count, sizeof(PubSubTarget*));
+    if (!buckets) return;
+    
+    for (size_t i = 0; i < table->bucket_count; i++) {
+        PubSubTarget* target = table->buckets[i];
+        while (target) {
+            PubSubTarget* next = target->next;
+            size_t index = pubsub_hash(target->name, target->name_len) & (count - 1);
+            target->next = buckets[index];
+            buckets[index] = target;
+            target = next;
+        }
+    }
+    
+    free(table->buckets);
+    table->buckets = buckets;
+    table->bucket_count = count;
+}
+
+static void table_insert(TargetTable* table, PubSubTarget* target) {
+    if (table->count >= table->bucket_count) table_grow(table);
+    size_t index = pubsub_hash(target->name, target->name_len) & (table->bucket_count - 1);
+    target->next = table->buckets[index];
+    table->buckets[index] = target;
+    table->count++;
+}
+
+static void table_remove(TargetTable* table, PubSubTarget* target) {
+    PubSubTarget** link = &table->buckets[pubsub_hash(target->name, target->name_len) & (table->bucket_count - 1)];
+    while (*link != target) link = &(*link)->next;
+    *link = target->next;
+    table->count--;
+}
+
+PubSub* pubsub_create(void) {
+    PubSub* ps = calloc(1, sizeof(PubSub));
+    if (!ps) return NULL;
+    
+    if (!table_init(&ps->channels) || !table_init(&ps->patterns)) {
+        free(ps->channels.buckets);
+        free(ps->patterns.buckets);
+        free(ps);
+        return NULL;
+    }
+    return ps;
+}
+
+// Drop every subscription. Clients stay connected.
+void pubsub_destroy(Server* server) {
+    PubSub* ps = server->pubsub;
+    if (!ps) return;
+    
+    TargetTable* tables[] = {&ps->channels, &ps->patterns};
+    for (int t = 0; t < 2; t++) {
+        for (size_t i = 0; i < tables[t]->bucket_count; i++) {
+            while (tables[t]->buckets[i]) {
+                pubsub_unsubscribe_all(server, tables[t]->buckets[i]->subscribers[0].client);
+            }
+        }
+    }
+    
+    free(ps->channels.buckets);
+    free(ps->patterns.buckets);
+    free(ps->root.children);
+    free(ps);
+    server->pubsub = NULL;
+}
+
+// Make room for one more element in a growable array
+static bool reserve(void** array, size_t* capacity, size_t count, size_t size) {
+    if (count < *capacity) return true;
+    
+    size_t grown = *capacity ? *capacity * 2 : 4;
+    void* resized = realloc(*array, grown * size);
+    if (!resized) return false;
+    *array = resized;
+    *capacity = grown;
+    return true;
+}
+
+static PatternNode* node_child(const PatternNode* node, unsigned char byte) {
+    for (size_t i = 0; i < node->child_count; i++) {
+        if (node->children[i]->byte == byte) return node->children[i];
+    }
+    return NULL;
+}
+
+// Free nodes left without patterns or children, walking up to the root
+static void node_prune(PatternNode* node) {
+    while (node->parent && !node->patterns && node->child_count == 0) {
+        PatternNode* parent = node->parent;
+        for (size_t i = 0; i < parent->child_count; i++) {
+            if (parent->children[i] == node) {
+                parent->children[i] = parent->children[--parent->child_count];
+                break;
+            }
+        }
+        free(node->children);
+        free(node);
+        node = parent;
+    }
+}
+
+// Node of the pattern's literal prefix, created along with its parents
+static PatternNode* node_for_pattern(PatternNode* root, const char* pattern, size_t len) {
+    PatternNode* node = root;
+    for (const char* p = pattern; p < pattern + len && !memchr("*?[\\", *p, 4); p++) {
+        PatternNode* child = node_child(node, (unsigned char)*p);
+        if (!child) {
+            child = calloc(1, sizeof(PatternNode));
+            if (!child || !reserve((void**)&node->children, &node->child_capacity, node->child_count,
+                                   sizeof(PatternNode*))) {
+                free(child);
+                node_prune(node);
+                return NULL;
+            }
+            child->byte = (unsigned char)*p;
+            child->parent = node;
+            node->children[node->child_count++] = child;
+        }
+        node = child;
+    }
+    return node;
+}
+
+static PubSubTarget* target_create(PubSub* ps, const char* name, size_t len, bool pattern) {
+    PubSubTarget* target = calloc(1, sizeof(PubSubTarget));
+    if (!target) return NULL;
+    target->name = malloc(len + 1);
+    if (!target->name) {
+        free(target);
+        return NULL;
+    }
+    memcpy(target->name, name, len);
+    target->name[len] = '\0';
+    target->name_len = len;
+    
+    if (pattern) {
+        target->node = node_for_pattern(&ps->root, name, len);
+        if (!target->node) {
+            free(target->name);
+            free(target);
+            return NULL;
+        }
+        target->node_next = target->node->patterns;
+        if (target->node_next) target->node_next->node_prev = target;
+        target->node->patterns = target;
+    }
+    
+    table_insert(pattern ? &ps->patterns : &ps->channels, target);
+    return target;
+}
+
+static void target_drop(PubSub* ps, PubSubTarget* target, bool pattern) {
+    table_remove(pattern ? &ps->patterns : &ps->channels, target);
+    
+    if (pattern) {
+        if (target->node_prev) {
+            target->node_prev->node_next = target->node_next;
+        } else {
+            target->node->patterns = target->node_next;
+        }
+        if (target->node_next) target->node_next->node_prev = target->node_prev;
+        node_prune(target->node);
+    }
+    
+    free(target->subscribers);
+    free(target->name);
+    free(target);
+}
+
+static SubscriptionList* subscription_list(Client* client, bool pattern) {
+    return pattern ? &client->patterns : &client->channels;
+}
+
+// Subscribed clients get their own output buffer limits
+static void set_client_class(Server* server, Client* client, ClientClass client_class) {
+    client->client_class = client_class;
+    client->reply_limit = server->config.reply_limits[client_class].hard_bytes;
+    client->soft_limit_since = 0;
+}
+
+// Remove the client's i-th subscription. Both sides fill the hole with
+// their last entry, whose back index is updated to match.
+static void unlink_subscription(Server* server, Client* client, bool pattern, size_t i) {
+    SubscriptionList* list = subscription_list(client, pattern);
+    PubSubTarget* target = list->links[i].target;
+    size_t index = list->links[i].index;
+    
+    target->count--;
+    if (index != target->count) {
+        Subscriber* moved = &target->subscribers[index];
+        *moved = target->subscribers[target->count];
+        subscription_list(moved->client, pattern)->links[moved->link].index = index;
+    }
+    
+    list->count--;
+    if (i != list->count) {
+        PubSubLink* moved = &list->links[i];
+        *moved = list->links[list->count];
+        moved->target->subscribers[moved->index].link = i;
+    }
+    
+    if (target->count == 0) target_drop(server->pubsub, target, pattern);
+    if (client->channels.count == 0 && client->patterns.count == 0) {
+        set_client_class(server, client, CLIENT_CLASS_NORMAL);
+    }
+}
+
+static bool find_subscription(Client* client, const PubSubTarget* target, bool pattern, size_t* i) {
+    SubscriptionList* list = subscription_list(client, pattern);
+    for (size_t j = 0; j < list->count; j++) {
+        if (list->links[j].target == target) {
+            *i = j;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Subscribe the client to a channel, or to a glob-style pattern. added
+// is false if it already was. Returns false if out of memory.
+bool pubsub_subscribe(Server* server, Client* client, const char* name, size_t len, bool pattern,
+                      bool* added) {
+    PubSub* ps = server->pubsub;
+    SubscriptionList* list = subscription_list(client, pattern);
+    size_t i;
+    
+    *added = false;
+    PubSubTarget* target = table_find(pattern ? &ps->patterns : &ps->channels, name, len);
+    if (target && find_subscription(client, target, pattern, &i)) return true;
+    
+    if (!target) {
+        target = target_create(ps, name, len, pattern);
+        if (!target) return false;
+    }
+    if (!reserve((void**)&list->links, &list->capacity, list->count, sizeof(PubSubLink)) ||
+        !reserve((void**)&target->subscribers, &target->capacity, target->count, sizeof(Subscriber))) {
+        if (target->count == 0) target_drop(ps, target, pattern);
+        return false;
+    }
+    
+    if (client->channels.count == 0 && client->patterns.count == 0) {
+        set_client_class(server, client, CLIENT_CLASS_PUBSUB);
+    }
+    list->links[list->count] = (PubSubLink){target, target->count};
+    target->subscribers[target->count] = (Subscriber){client, list->count};
+    list->count++;
+    target->count++;
+    *added = true;
+    return true;
+}
+
+// Returns false if the client wasn't subscribed
+bool pubsub_unsubscribe(Server* server, Client* client, const char* name, size_t len, bool pattern) {
+    PubSub* ps = server->pubsub;
+    PubSubTarget* target = table_find(pattern ? &ps->patterns : &ps->channels, name, len);
+    size_t i;
+    if (!target || !find_subscription(client, target, pattern, &i)) return false;
+    
+    unlink_subscription(server, client, pattern, i);
+    return true;
+}
+
+// Drop all of a client's subscriptions, e.g. when it disconnects
+void pubsub_unsubscribe_all(Server* server, Client* client) {
+    if (!server->pubsub) return;
+    while (client->channels.count > 0) {
+        unlink_subscription(server, client, false, client->channels.count - 1);
+    }
+    while (client->patterns.count > 0) {
+        unlink_subscription(server, client, true, client->patterns.count - 1);
+    }
+}
+
+// Name of the client's most recent remaining subscription, or NULL
+const char* pubsub_last_subscription(const Client* client, bool pattern, size_t* len) {
+    const SubscriptionList* list = pattern ? &client->patterns : &client->channels;
+    if (list->count == 0) return NULL;
+    
+    const PubSubTarget* target = list->links[list->count - 1].target;
+    *len = target->name_len;
+    return target->name;
+}
+
+size_t pubsub_subscription_count(const Client* client) {
+    return client->channels.count + client->patterns.count;
+}
+
+static size_t encode_bulk(char* out, const char* data, size_t len) {
+    size_t n = sprintf(out, "$%zu\r\n", len);
+    memcpy(out + n, data, len);
+    memcpy(out + n + len, "\r\n", 2);
+    return n + len + 2;
+}
+
+// Encode a message once for all its subscribers: [message, channel,
+// payload], or [pmessage, pattern, channel, payload] for a pattern
+static RedisObject* encode_message(const char* pattern, size_t pattern_len, const char* channel,
+                                   size_t channel_len, const char* message, size_t message_len) {
+    char* buf = malloc(128 + pattern_len + channel_len + message_len);
+    if (!buf) return NULL;
+    
+    size_t len;
+    if (pattern) {
+        memcpy(buf, "*4\r\n$8\r\npmessage\r\n", 18);
+        len = 18 + encode_bulk(buf + 18, pattern, pattern_len);
+    } else {
+        memcpy(buf, "*3\r\n$7\r\nmessage\r\n", 17);
+        len = 17;
+    }
+    len += encode_bulk(buf + len, channel, channel_len);
+    len += encode_bulk(buf + len, message, message_len);
+    
+    RedisString* str = createRedisStringOwned(buf, len);
+    RedisObject* obj = str ? createRedisObject(REDIS_STRING, str) : NULL;
+    if (!obj) {
+        if (str) {
+            freeRedisString(str);
+        } else {
+            free(buf);
+        }
+        return NULL;
+    }
+    return obj;
+}
+
+// Queue one shared frame to every subscriber of the target. Output
+// limits are checked when the replies are written, so nobody is
+// disconnected, and no subscriber list changes, while this runs.
+static size_t deliver(Server* server, const PubSubTarget* target, const char* channel, size_t channel_len,
+                      const char* message, size_t message_len, bool pattern) {
+    RedisObject* frame = encode_message(pattern ? target->name : NULL, pattern ? target->name_len : 0,
+                                        channel, channel_len, message, message_len);
+    if (!frame) return 0;
+    
+    for (size_t i = 0; i < target->count; i++) {
+        Client* client = target->subscribers[i].client;
+        send_shared(client, frame);
+        server_queue_reply(server, client);
+    }
+    
+    decrRefCount(frame);
+    return target->count;
+}
+
+// Send a message to the channel's subscribers and to those of matching
+// patterns. Returns how many clients it was queued for.
+size_t pubsub_publish(Server* server, const char* channel, size_t channel_len, const char* message,
+                      size_t message_len) {
+    PubSub* ps = server->pubsub;
+    size_t receivers = 0;
+    
+    PubSubTarget* target = table_find(&ps->channels, channel, channel_len);
+    if (target) receivers += deliver(server, target, channel, channel_len, message, message_len, false);
+    if (ps->patterns.count == 0) return receivers;
+    
+    // Only patterns whose literal prefix is a prefix of the channel
+    const char* p = channel;
+    const char* end = channel + channel_len;
+    for (PatternNode* node = &ps->root; node; node = p < end ? node_child(node, (unsigned char)*p++) : NULL) {
+        for (PubSubTarget* pattern = node->patterns; pattern; pattern = pattern->node_next) {
+            if (pubsub_glob_match(pattern->name, pattern->name_len, channel, channel_len)) {
+                receivers += deliver(server, pattern, channel, channel_len, message, message_len, true);
+            }
+        }
+    }
+    return receivers;
+}
+
+// Match one element of a glob pattern (a byte, ?, [class] or \escape)
+// against c. Returns the rest of the pattern, or NULL on a mismatch.
+static const char* glob_step(const char* p, const char* end, unsigned char c) {
+    if (p == end) return NULL;
+    switch (*p) {
+        case '?':
+            return p + 1;
+        case '\\':
+            if (p + 1 < end) return (unsigned char)p[1] == c ? p + 2 : NULL;
+            return c == '\\' ? p + 1 : NULL;
+        case '[': {
+            p++;
+            bool negate = p < end && *p == '^';
+            if (negate) p++;
+            
+            bool match = false;
+            while (p < end && *p != ']') {
+                if (*p == '\\' && p + 1 < end) {
+                    match |= (unsigned char)p[1] == c;
+                    p += 2;
+                } else if (p + 2 < end && p[1] == '-' && p[2] != ']') {
+                    unsigned char lo = p[0], hi = p[2];
+                    if (lo > hi) {
+                        unsigned char tmp = lo;
+                        lo = hi;
+                        hi = tmp;
+                    }
+                    match |= c >= lo && c <= hi;
+                    p += 3;
+                } else {
+                    match |= (unsigned char)*p == c;
+                    p++;
+                }
+            }
+            if (p < end) p++;
+            return match != negate ? p : NULL;
+        }
+        default:
+            return (unsigned char)*p == c ? p + 1 : NULL;
+    }
+}
+
+// Glob-style match as in Redis: *, ?, [abc], [^abc], [a-z] and \x.
+// On a mismatch only the last * is retried, one byte further along.
+bool pubsub_glob_match(const char* pattern, size_t pattern_len, const char* str, size_t str_len) {
+    const char* pattern_end = pattern + pattern_len;
+    const char* str_end = str + str_len;
+    const char* star = NULL;    // Pattern right after the last *
+    const char* resume = NULL;  // Where the string picks up if it is retried
+    
+    while (str < str_end) {
+        if (pattern < pattern_end && *pattern == '*') {
+            while (pattern < pattern_end && *pattern == '*') pattern++;
+            if (pattern == pattern_end) return true;
+            star = pattern;
+            resume = str;
+            continue;
+        }
+        
+        const char* next = glob_step(pattern, pattern_end, (unsigned char)*str);
+        if (next) {
+            pattern = next;
+            str++;
+        } else if (star) {
+            pattern = star;
+            str = ++resume;
+        } else {
+            return false;
+        }
+    }
+    
+    while (pattern < pattern_end && *pattern == '*') pattern++;
+    return pattern == pattern_end;
+}
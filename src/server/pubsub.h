@@ -0,0 +1,21 @@
+#ifndef PUBSUB_H
+#define PUBSUB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "server.h"
+
+// Function declarations
+struct PubSub* pubsub_create(void);
+void pubsub_destroy(Server* server);
+bool pubsub_subscribe(Server* server, Client* client, const char* name, size_t len, bool pattern,
+                      bool* added);
+bool pubsub_unsubscribe(Server* server, Client* client, const char* name, size_t len, bool pattern);
+void pubsub_unsubscribe_all(Server* server, Client* client);
+const char* pubsub_last_subscription(const Client* client, bool pattern, size_t* len);
+size_t pubsub_subscription_count(const Client* client);
+size_t pubsub_publish(Server* server, const char* channel, size_t channel_len, const char* message,
+                      size_t message_len);
+bool pubsub_glob_match(const char* pattern, size_t pattern_len, const char* str, size_t str_len);
+
+#endif // PUBSUB_H
@@ -0,0 +1,405 @@
+#include "server.h"
+#include "dtoa.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <sys/uio.h>
+
+bool client_init_reply(Client* client) {
+    if (!client) return false;
+    
+    client->reply = malloc(REPLY_CHUNK_SIZE);
+    if (!client->reply) return false;
+    
+    client->reply_pos = 0;
+    client->reply_head = NULL;
+    client->reply_tail = NULL;
+    client->reply_bytes = 0;
+    client->sent_len = 0;
+    client->reply_overflow = false;
+    return true;
+}
+
+static void reply_chunk_free(ReplyChunk* chunk) {
+    if (chunk->obj) decrRefCount(chunk->obj);
+    free(chunk);
+}
+
+void client_free_reply(Client* client) {
+    if (!client) return;
+    
+    ReplyChunk* chunk = client->reply_head;
+    while (chunk) {
+        ReplyChunk* next = chunk->next;
+        reply_chunk_free(chunk);
+        chunk = next;
+    }
+    
+    free(client->reply);
+    client->reply = NULL;
+    client->reply_pos = 0;
+    client->reply_head = NULL;
+    client->reply_tail = NULL;
+    client->reply_bytes = 0;
+    client->sent_len = 0;
+}
+
+bool client_has_pending_reply(const Client* client) {
+    return client && (client->reply_pos > 0 || client->reply_head != NULL);
+}
+
+// Bytes of reply memory the client holds, sent or not
+size_t client_reply_size(const Client* client) {
+    return client->reply_pos + client->reply_bytes;
+}
+
+static void reply_link_chunk(Client* client, ReplyChunk* chunk) {
+    if (client->reply_tail) {
+        client->reply_tail->next = chunk;
+    } else {
+        client->reply_head = chunk;
+    }
+    client->reply_tail = chunk;
+    client->reply_bytes += chunk->used;
+}
+
+// Past the hard limit the reply can't be completed any more, so stop
+// buffering it; the server disconnects the client
+static bool reply_over_limit(Client* client, size_t len) {
+    if (client->reply_limit > 0 && client_reply_size(client) + len > client->reply_limit) {
+        client->reply_overflow = true;
+        return true;
+    }
+    return false;
+}
+
+// Append raw bytes to the client's pending reply. Data goes to the fixed
+// buffer while no overflow chunk exists, so ordering is preserved.
+static void reply_append(Client* client, const char* data, size_t len) {
+    if (!client->reply || client->reply_overflow) return;
+    
+    if (!client->reply_head) {
+        size_t avail = REPLY_CHUNK_SIZE - client->reply_pos;
+        size_t n = len < avail ? len : avail;
+        memcpy(client->reply + client->reply_pos, data, n);
+        client->reply_pos += n;
+        data += n;
+        len -= n;
+        if (len == 0) return;
+    }
+    
+    // Fill the tail chunk before allocating a new one
+    ReplyChunk* tail = client->reply_tail;
+    if (tail && tail->used < tail->size) {
+        size_t avail = tail->size - tail->used;
+        size_t n = len < avail ? len : avail;
+        memcpy(tail->buf + tail->used, data, n);
+        tail->used += n;
+        client->reply_bytes += n;
+        data += n;
+        len -= n;
+        if (len == 0) return;
+    }
+    
+    if (reply_over_limit(client, len)) return;
+    
+    size_t size = len > REPLY_CHUNK_SIZE ? len : REPLY_CHUNK_SIZE;
+    ReplyChunk* chunk = malloc(sizeof(ReplyChunk) + size);
+    if (!chunk) return;
+    
+    chunk->next = NULL;
+    chunk->size = size;
+    chunk->used = len;
+    chunk->data = chunk->buf;
+    chunk->obj = NULL;
+    memcpy(chunk->buf, data, len);
+    reply_link_chunk(client, chunk);
+}
+
+// Queue len bytes owned by obj without copying them. The chunk holds a
+// reference, so the bytes outlive an overwrite or delete of the key
+// until they have been written. Full from the start, so later replies
+// go to chunks of their own.
+static void reply_append_ref(Client* client, RedisObject* obj, const char* data, size_t len) {
+    if (!client->reply || client->reply_overflow) return;
+    if (reply_over_limit(client, len)) return;
+    
+    ReplyChunk* chunk = malloc(sizeof(ReplyChunk));
+    if (!chunk) return;
+    
+    chunk->next = NULL;
+    chunk->size = len;
+    chunk->used = len;
+    chunk->data = data;
+    chunk->obj = obj;
+    incrRefCount(obj);
+    reply_link_chunk(client, chunk);
+}
+
+// Room left in the block replies are currently appended to
+static size_t reply_space(const Client* client) {
+    if (!client->reply_head) return REPLY_CHUNK_SIZE - client->reply_pos;
+    return client->reply_tail->size - client->reply_tail->used;
+}
+
+// Drop the first `written` pending bytes after a successful write
+void client_reply_consume(Client* client, size_t written) {
+    if (client->reply_pos > 0) {
+        size_t remaining = client->reply_pos - client->sent_len;
+        if (written < remaining) {
+            client->sent_len += written;
+            return;
+        }
+        written -= remaining;
+        client->reply_pos = 0;
+        client->sent_len = 0;
+    }
+    
+    while (client->reply_head && written > 0) {
+        ReplyChunk* chunk = client->reply_head;
+        size_t remaining = chunk->used - client->sent_len;
+        if (written < remaining) {
+            client->sent_len += written;
+            return;
+        }
+        
+        written -= remaining;
+        client->reply_head = chunk->next;
+        if (!client->reply_head) client->reply_tail = NULL;
+        client->reply_bytes -= chunk->used;
+        client->sent_len = 0;
+        reply_chunk_free(chunk);
+    }
+}
+
+// Point iov at the pending reply data, oldest first: the rest of the
+// fixed buffer, then the overflow chunks. Returns the iovec count.
+int client_reply_iov(const Client* client, struct iovec* iov, int max_iov, size_t* total) {
+    int iovcnt = 0;
+    size_t offset = client->sent_len;
+    *total = 0;
+    
+    if (client->reply_pos > 0 && iovcnt < max_iov) {
+        iov[iovcnt].iov_base = client->reply + offset;
+        iov[iovcnt].iov_len = client->reply_pos - offset;
+        *total += iov[iovcnt++].iov_len;
+        offset = 0;
+    }
+    
+    for (ReplyChunk* chunk = client->reply_head; chunk && iovcnt < max_iov; chunk = chunk->next) {
+        iov[iovcnt].iov_base = (char*)chunk->data + offset;
+        iov[iovcnt].iov_len = chunk->used - offset;
+        *total += iov[iovcnt++].iov_len;
+        offset = 0;
+    }
+    
+    return iovcnt;
+}
+
+// Write as much pending reply data as the socket accepts, gathering the
+// fixed buffer and overflow chunks into a single writev per round.
+// Returns false on a fatal socket error; leftover data stays queued.
+bool client_flush(Client* client) {
+    if (!client) return false;
+    
+    while (client_has_pending_reply(client)) {
+        struct iovec iov[REPLY_MAX_IOV];
+        size_t total;
+        int iovcnt = client_reply_iov(client, iov, REPLY_MAX_IOV, &total);
+        
+        ssize_t n = writev(client->fd, iov, iovcnt);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+            return false;
+        }
+        
+        client_reply_consume(client, n);
+        
+        // Short write: the socket buffer is full
+        if ((size_t)n < total) return true;
+    }
+    
+    return true;
+}
+
+// Move the whole pending reply into one malloc'd buffer and clear it.
+// Used to hand a reply produced here to the thread owning the client.
+char* client_take_reply(Client* client, size_t* len) {
+    if (!client || !len) return NULL;
+    
+    size_t total = client->reply_pos + client->reply_bytes - client->sent_len;
+    char* out = malloc(total ? total : 1);
+    if (!out) return NULL;
+    
+    size_t pos = 0;
+    size_t offset = client->sent_len;
+    if (client->reply_pos > 0) {
+        memcpy(out, client->reply + offset, client->reply_pos - offset);
+        pos += client->reply_pos - offset;
+        offset = 0;
+    }
+    for (ReplyChunk* chunk = client->reply_head; chunk; chunk = chunk->next) {
+        memcpy(out + pos, chunk->data + offset, chunk->used - offset);
+        pos += chunk->used - offset;
+        offset = 0;
+    }
+    
+    client_reply_consume(client, total);
+    *len = total;
+    return out;
+}
+
+// Response helper functions
+void send_raw(Client* client, const char* data, size_t len) {
+    if (!client || !data) return;
+    reply_append(client, data, len);
+}
+
+void send_ok(Client* client) {
+    if (!client) return;
+    reply_append(client, "+OK\r\n", 5);
+}
+
+void send_queued(Client* client) {
+    if (!client) return;
+    reply_append(client, "+QUEUED\r\n", 9);
+}
+
+void send_error(Client* client, const char* error) {
+    if (!client || !error) return;
+    reply_append(client, "-", 1);
+    reply_append(client, error, strlen(error));
+    reply_append(client, "\r\n", 2);
+}
+
+// The error for a command given the wrong number of arguments. The name
+// is written in lower case, as Redis does.
+void send_arity_error(Client* client, const char* name) {
+    char lower[32];
+    size_t len = 0;
+    for (; name[len] && len < sizeof(lower) - 1; len++) lower[len] = tolower((unsigned char)name[len]);
+    lower[len] = '\0';
+    
+    char error[96];
+    snprintf(error, sizeof(error), "ERR wrong number of arguments for '%s' command", lower);
+    send_error(client, error);
+}
+
+// "<prefix><value>\r\n", the framing of integers, bulks and arrays
+static size_t format_header(char* buf, char prefix, int64_t value) {
+    buf[0] = prefix;
+    size_t len = 1 + int64ToString(buf + 1, value);
+    buf[len++] = '\r';
+    buf[len++] = '\n';
+    return len;
+}
+
+void send_integer(Client* client, int64_t value) {
+    if (!client) return;
+    char buf[32];
+    reply_append(client, buf, format_header(buf, ':', value));
+}
+
+void send_string(Client* client, const char* str) {
+    if (!client) return;
+    if (!str) {
+        send_null(client);
+        return;
+    }
+    
+    send_bulk(client, str, strlen(str));
+}
+
+void send_bulk(Client* client, const char* data, size_t len) {
+    if (!client) return;
+    if (!data) {
+        send_null(client);
+        return;
+    }
+    
+    char header[32];
+    reply_append(client, header, format_header(header, '$', (int64_t)len));
+    reply_append(client, data, len);
+    reply_append(client, "\r\n", 2);
+}
+
+// Bulk reply of a double in its shortest exact form, framed in one append
+void send_double(Client* client, double value) {
+    if (!client) return;
+    char digits[DTOA_BUF_SIZE];
+    size_t len = dtoa_format(digits, value);
+    
+    char buf[DTOA_BUF_SIZE + 16];
+    size_t framed = format_header(buf, '$', (int64_t)len);
+    memcpy(buf + framed, digits, len);
+    framed += len;
+    buf[framed++] = '\r';
+    buf[framed++] = '\n';
+    reply_append(client, buf, framed);
+}
+
+// Bulk reply of a string object. Large values are written straight from
+// the object's buffer instead of being copied into the reply.
+void send_bulk_object(Client* client, RedisObject* obj) {
+    if (!client) return;
+    if (!obj || obj->type != REDIS_STRING) {
+        send_null(client);
+        return;
+    }
+    if (obj->encoding == REDIS_ENCODING_INT) {
+        char buf[24];
+        send_bulk(client, buf, int64ToString(buf, obj->integer));
+        return;
+    }
+    
+    RedisString* str = obj->data;
+    if (str->reply) {
+        if (str->reply_len < REPLY_REF_MIN_BYTES) {
+            reply_append(client, str->reply, str->reply_len);
+        } else {
+            reply_append_ref(client, obj, str->reply, str->reply_len);
+        }
+        return;
+    }
+    if (str->len < REPLY_REF_MIN_BYTES) {
+        send_bulk(client, str->value, str->len);
+        return;
+    }
+    
+    char header[32];
+    reply_append(client, header, format_header(header, '$', (int64_t)str->len));
+    reply_append_ref(client, obj, str->value, str->len);
+    reply_append(client, "\r\n", 2);
+}
+
+// Reply encoded once and sent to many clients, such as a published
+// message. Queued by reference unless it fits in the current block.
+void send_shared(Client* client, RedisObject* obj) {
+    if (!client || !obj) return;
+    
+    RedisString* str = obj->data;
+    if (str->len <= reply_space(client)) {
+        reply_append(client, str->value, str->len);
+    } else {
+        reply_append_ref(client, obj, str->value, str->len);
+    }
+}
+
+void send_array(Client* client, size_t size) {
+    if (!client) return;
+    char buf[32];
+    reply_append(client, buf, format_header(buf, '*', (int64_t)size));
+}
+
+void send_null(Client* client) {
+    if (!client) return;
+    reply_append(client, "$-1\r\n", 5);
+}
+
+void send_null_array(Client* client) {
+    if (!client) return;
+    reply_append(client, "*-1\r\n", 5);
+}
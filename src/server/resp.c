@@ -0,0 +1,313 @@
+#include "resp.h"
+#include "parse.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define RESP_INITIAL_ARGV 16
+
+bool resp_parser_init(RespParser* parser) {
+    if (!parser) return false;
+    
+    parser->argv_capacity = RESP_INITIAL_ARGV;
+    parser->arg_offsets = malloc(parser->argv_capacity * sizeof(size_t));
+    parser->argv_len = malloc(parser->argv_capacity * sizeof(size_t));
+    parser->argv = malloc(parser->argv_capacity * sizeof(char*));
+    parser->arg_owned = malloc(parser->argv_capacity * sizeof(char*));
+    if (!parser->arg_offsets || !parser->argv_len || !parser->argv || !parser->arg_owned) {
+        free(parser->arg_offsets);
+        free(parser->argv_len);
+        free(parser->argv);
+        free(parser->arg_owned);
+        return false;
+    }
+    
+    parser->argc = 0;
+    parser->bulk_buf = NULL;
+    resp_parser_reset(parser);
+    return true;
+}
+
+void resp_parser_free(RespParser* parser) {
+    if (!parser) return;
+    if (parser->arg_owned) resp_parser_reset(parser);
+    free(parser->arg_offsets);
+    free(parser->argv_len);
+    free(parser->argv);
+    free(parser->arg_owned);
+    parser->arg_offsets = NULL;
+    parser->argv_len = NULL;
+    parser->argv = NULL;
+    parser->arg_owned = NULL;
+    parser->argv_capacity = 0;
+}
+
+// Get ready for the next command, freeing big bulks nobody took over
+void resp_parser_reset(RespParser* parser) {
+    if (!parser) return;
+    for (int i = 0; i < parser->argc; i++) {
+        free(parser->arg_owned[i]);
+    }
+    free(parser->bulk_buf);
+    parser->bulk_buf = NULL;
+    parser->bulk_filled = 0;
+    parser->multibulk_len = 0;
+    parser->bulk_len = -1;
+    parser->pos = 0;
+    parser->need = 0;
+    parser->argc = 0;
+    parser->error = NULL;
+}
+
+static bool ensure_argv(RespParser* parser, long count) {
+    if (count <= parser->argv_capacity) return true;
+    
+    int capacity = parser->argv_capacity;
+    while (capacity < count) capacity *= 2;
+    
+    size_t* offsets = realloc(parser->arg_offsets, capacity * sizeof(size_t));
+    if (!offsets) return false;
+    parser->arg_offsets = offsets;
+    
+    size_t* lens = realloc(parser->argv_len, capacity * sizeof(size_t));
+    if (!lens) return false;
+    parser->argv_len = lens;
+    
+    char** argv = realloc(parser->argv, capacity * sizeof(char*));
+    if (!argv) return false;
+    parser->argv = argv;
+    
+    char** owned = realloc(parser->arg_owned, capacity * sizeof(char*));
+    if (!owned) return false;
+    parser->arg_owned = owned;
+    
+    parser->argv_capacity = capacity;
+    return true;
+}
+
+// Strict decimal parse of a protocol length; rejects signs other than a
+// leading '-', empty input and trailing garbage
+static bool parse_length(const char* s, size_t len, long long* out) {
+    if (len == 0 || len > 20) return false;
+    
+    bool negative = false;
+    if (*s == '-') {
+        negative = true;
+        s++;
+        len--;
+        if (len == 0) return false;
+    }
+    
+    long long value = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (s[i] < '0' || s[i] > '9') return false;
+        if (value > (RESP_MAX_BULK_LEN * 4)) return false;
+        value = value * 10 + (s[i] - '0');
+    }
+    
+    *out = negative ? -value : value;
+    return true;
+}
+
+// Find "\r\n" at or after pos; returns the offset of '\r' or -1
+static long find_crlf(const char* buf, size_t pos, size_t len) {
+    if (pos >= len) return -1;
+    const char* cr = parse_find_crlf(buf + pos, len - pos);
+    return cr ? (long)(cr - buf) : -1;
+}
+
+// Inline commands: "SET key value\r\n", split on whitespace in place
+static RespStatus parse_inline(RespParser* parser, char* buf, size_t len, size_t* consumed) {
+    char* newline = memchr(buf, '\n', len);
+    if (!newline) {
+        if (len > RESP_MAX_INLINE_LEN) {
+            parser->error = "too big inline request";
+            return RESP_ERROR;
+        }
+        return RESP_INCOMPLETE;
+    }
+    
+    size_t line_len = newline - buf;
+    if (line_len > 0 && buf[line_len - 1] == '\r') line_len--;
+    
+    parser->argc = 0;
+    size_t i = 0;
+    while (i < line_len) {
+        while (i < line_len && (buf[i] == ' ' || buf[i] == '\t')) i++;
+        if (i >= line_len) break;
+        
+        size_t start = i;
+        while (i < line_len && buf[i] != ' ' && buf[i] != '\t') i++;
+        
+        if (!ensure_argv(parser, parser->argc + 1)) {
+            parser->error = "out of memory";
+            return RESP_ERROR;
+        }
+        parser->arg_offsets[parser->argc] = start;
+        parser->argv_len[parser->argc] = i - start;
+        parser->arg_owned[parser->argc] = NULL;
+        parser->argc++;
+        
+        // Terminate the token in place; the separator is never an argument
+        buf[i] = '\0';
+        i++;
+    }
+    
+    for (int j = 0; j < parser->argc; j++) {
+        parser->argv[j] = buf + parser->arg_offsets[j];
+    }
+    
+    *consumed = (newline - buf) + 1;
+    return RESP_OK;
+}
+
+// Parse one command from buf[0..len). State is kept across calls so a
+// frame split over several reads is only scanned once. On RESP_OK the
+// arguments point into buf, are NUL-terminated in place, and *consumed
+// holds the frame length; call resp_parser_reset() before the next one.
+RespStatus resp_parse(RespParser* parser, char* buf, size_t len, size_t* consumed) {
+    if (!parser || !buf || !consumed) return RESP_ERROR;
+    *consumed = 0;
+    
+    if (parser->multibulk_len == 0) {
+        if (len == 0) return RESP_INCOMPLETE;
+        if (buf[0] != '*') return parse_inline(parser, buf, len, consumed);
+        
+        long crlf = find_crlf(buf, 0, len);
+        if (crlf < 0) {
+            if (len > RESP_MAX_INLINE_LEN) {
+                parser->error = "too big mbulk count string";
+                return RESP_ERROR;
+            }
+            return RESP_INCOMPLETE;
+        }
+        
+        long long count;
+        if (!parse_length(buf + 1, crlf - 1, &count) || count > RESP_MAX_MULTIBULK_LEN) {
+            parser->error = "invalid multibulk length";
+            return RESP_ERROR;
+        }
+        
+        parser->pos = crlf + 2;
+        if (count <= 0) {
+            // Empty command, skip it
+            parser->argc = 0;
+            *consumed = parser->pos;
+            return RESP_OK;
+        }
+        
+        if (!ensure_argv(parser, count)) {
+            parser->error = "out of memory";
+            return RESP_ERROR;
+        }
+        parser->multibulk_len = count;
+        parser->argc = 0;
+    }
+    
+    while (parser->multibulk_len > 0) {
+        if (parser->bulk_len < 0) {
+            long crlf = find_crlf(buf, parser->pos, len);
+            if (crlf < 0) {
+                if (len - parser->pos > RESP_MAX_INLINE_LEN) {
+                    parser->error = "too big bulk count string";
+                    return RESP_ERROR;
+                }
+                return RESP_INCOMPLETE;
+            }
+            
+            if (buf[parser->pos] != '$') {
+                parser->error = "expected '$'";
+                return RESP_ERROR;
+            }
+            
+            long long bulk_len;
+            if (!parse_length(buf + parser->pos + 1, crlf - parser->pos - 1, &bulk_len) ||
+                bulk_len < 0 || bulk_len > RESP_MAX_BULK_LEN) {
+                parser->error = "invalid bulk length";
+                return RESP_ERROR;
+            }
+            
+            parser->bulk_len = bulk_len;
+            parser->pos = crlf + 2;
+        }
+        
+        // A big payload arrives in its own buffer and takes no room here
+        if (parser->bulk_buf) {
+            size_t total = parser->bulk_len + 2;
+            if (parser->bulk_filled < total) return RESP_INCOMPLETE;
+            
+            if (parser->bulk_buf[total - 2] != '\r' || parser->bulk_buf[total - 1] != '\n') {
+                parser->error = "bulk payload not terminated by CRLF";
+                return RESP_ERROR;
+            }
+            
+            parser->bulk_buf[total - 2] = '\0';
+            parser->arg_offsets[parser->argc] = parser->pos;
+            parser->argv_len[parser->argc] = parser->bulk_len;
+            parser->arg_owned[parser->argc] = parser->bulk_buf;
+            parser->argc++;
+            
+            parser->bulk_buf = NULL;
+            parser->bulk_filled = 0;
+            parser->bulk_len = -1;
+            parser->multibulk_len--;
+            continue;
+        }
+        
+        // Wait for the whole payload plus its trailing CRLF
+        size_t end = parser->pos + parser->bulk_len;
+        if (end + 2 > len) {
+            if (parser->bulk_len >= RESP_BIG_BULK_LEN) {
+                // Allocate the final storage once and move the part that
+                // already arrived; the caller drops it from buf
+                parser->bulk_buf = malloc(parser->bulk_len + 2);
+                if (!parser->bulk_buf) {
+                    parser->error = "out of memory";
+                    return RESP_ERROR;
+                }
+                parser->bulk_filled = len - parser->pos;
+                memcpy(parser->bulk_buf, buf + parser->pos, parser->bulk_filled);
+                parser->need = 0;
+                return RESP_INCOMPLETE;
+            }
+            
+            parser->need = end + 2;
+            return RESP_INCOMPLETE;
+        }
+        
+        if (buf[end] != '\r' || buf[end + 1] != '\n') {
+            parser->error = "bulk payload not terminated by CRLF";
+            return RESP_ERROR;
+        }
+        
+        // The CR is ours to overwrite, which gives handlers a C string
+        buf[end] = '\0';
+        parser->arg_offsets[parser->argc] = parser->pos;
+        parser->argv_len[parser->argc] = parser->bulk_len;
+        parser->arg_owned[parser->argc] = NULL;
+        parser->argc++;
+        
+        parser->pos = end + 2;
+        parser->bulk_len = -1;
+        parser->multibulk_len--;
+    }
+    
+    for (int i = 0; i < parser->argc; i++) {
+        parser->argv[i] = parser->arg_owned[i] ? parser->arg_owned[i] : buf + parser->arg_offsets[i];
+    }
+    
+    parser->need = 0;
+    *consumed = parser->pos;
+    return RESP_OK;
+}
+
+// Copy received bytes into the big bulk being collected. Returns how many
+// were taken; the rest belongs after the bulk, in the query buffer.
+size_t resp_parser_feed_bulk(RespParser* parser, const char* data, size_t len) {
+    if (!parser || !parser->bulk_buf) return 0;
+    
+    size_t room = parser->bulk_len + 2 - parser->bulk_filled;
+    size_t n = len < room ? len : room;
+    memcpy(parser->bulk_buf + parser->bulk_filled, data, n);
+    parser->bulk_filled += n;
+    return n;
+}
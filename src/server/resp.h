@@ -0,0 +1,53 @@
+#ifndef RESP_H
+#define RESP_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Protocol limits
+#define RESP_MAX_MULTIBULK_LEN (1024 * 1024)
+#define RESP_MAX_BULK_LEN (512LL * 1024 * 1024)
+#define RESP_MAX_INLINE_LEN (64 * 1024)
+
+// Bulks at least this long that haven't fully arrived yet are received
+// into an allocation of their own instead of the query buffer
+#define RESP_BIG_BULK_LEN (32 * 1024)
+
+typedef enum {
+    RESP_OK,          // A full command was parsed
+    RESP_INCOMPLETE,  // More bytes are needed
+    RESP_ERROR        // Protocol error, see parser->error
+} RespStatus;
+
+// Incremental parser state for one client. Positions are offsets from
+// the start of the command so the buffer may be reallocated between
+// calls; argv/argv_len are only valid after RESP_OK.
+//
+// While bulk_buf is set, the payload of a big bulk goes there rather
+// than into the query buffer: the caller reads into it directly or uses
+// resp_parser_feed_bulk(). Completed big bulks are listed in arg_owned
+// and freed by resp_parser_reset() unless the caller takes them first.
+typedef struct {
+    long multibulk_len;   // Bulks still expected, 0 before the header
+    long long bulk_len;   // Length of the pending bulk, -1 before its header
+    size_t pos;           // Parse position within the current command
+    size_t need;          // Bytes the current command needs, when known
+    int argc;
+    int argv_capacity;
+    size_t* arg_offsets;
+    size_t* argv_len;
+    char** argv;
+    char** arg_owned;     // Per argument: its own allocation, or NULL
+    char* bulk_buf;       // Big bulk being received, payload plus CRLF
+    size_t bulk_filled;   // Bytes of bulk_buf received so far
+    const char* error;
+} RespParser;
+
+// Function declarations
+bool resp_parser_init(RespParser* parser);
+void resp_parser_free(RespParser* parser);
+void resp_parser_reset(RespParser* parser);
+RespStatus resp_parse(RespParser* parser, char* buf, size_t len, size_t* consumed);
+size_t resp_parser_feed_bulk(RespParser* parser, const char* data, size_t len);
+
+#endif // RESP_H
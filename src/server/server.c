@@ -1,36 +1,80 @@
 #include "server.h"
+#include "blocking.h"
+#include "command_table.h"
+#include "io_threads.h"
+#include "multi.h"
+#include "parse.h"
+#include "pubsub.h"
+#include "shard.h"
+#include "tracking.h"
+#include "uring.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/un.h>
 #include <errno.h>
 #include <signal.h>
 #include <fcntl.h>
 #include <arpa/inet.h>
+#include <time.h>
 
-#define BUFFER_SIZE 4096
-#define MAX_ARGS 64
+// Upper bound on how long the loop sleeps, so server_stop() from
+// another thread is noticed even when no client is active
+#define EVENT_LOOP_MAX_WAIT_MS 1000
+
+// How long the loop sleeps while I/O threads are spinning, so they are
+// parked soon after the load stops
+#define IO_THREADS_IDLE_WAIT_MS 10
+
+// io_uring user_data: the client pointer with the request kind in the
+// low bits. Accepts carry the listening fd instead, cancels nothing.
+#define URING_OP_ACCEPT 0
+#define URING_OP_RECV   1
+#define URING_OP_SEND   2
+#define URING_OP_CANCEL 3
+#define URING_OP_MASK   3
+#define URING_ACCEPT_DATA(fd) ((uint64_t)(fd) << 2 | URING_OP_ACCEPT)
 
 // Forward declarations
-static void handle_client(Server* server, Client* client);
-static char** parse_command(const char* command, int* argc);
+static int listen_tcp(Server* server);
+static int listen_unix(Server* server);
+static int finish_listener(Server* server, int fd);
+static void close_listeners(Server* server);
+static void accept_handler(EventLoop* loop, int fd, void* data, int mask);
+static void add_client(Server* server, int client_fd);
+static void read_handler(EventLoop* loop, int fd, void* data, int mask);
+static void write_handler(EventLoop* loop, int fd, void* data, int mask);
+static void flush_client(Server* server, Client* client);
+static void update_write_interest(Server* server, Client* client);
+static void before_sleep(EventLoop* loop);
+static void drop_handled_reads(Server* server, size_t handled);
+static void handle_pending_reads(Server* server);
+static void handle_pending_writes(Server* server);
+static void process_client(Server* server, Client* client);
+static void execute_commands(Server* server, Client* client);
+static void execute_command(Server* server, Client* client);
+static void handle_shard_messages(Server* server);
+static void queue_pending_read(Server* server, Client* client);
+static void queue_pending_write(Server* server, Client* client);
+static bool check_reply_limits(Server* server, Client* client);
+static void check_soft_limits(Server* server);
+static void resume_client(Server* server, Client* client);
 static void cleanup_client(Server* server, Client* client);
-
-// Command handlers
-bool handle_string_command(Server* server, Client* client, const char* command, char** args, int argc);
-bool handle_list_command(Server* server, Client* client, const char* command, char** args, int argc);
-bool handle_set_command(Server* server, Client* client, const char* command, char** args, int argc);
-bool handle_sorted_set_command(Server* server, Client* client, const char* command, char** args, int argc);
-bool handle_hash_command(Server* server, Client* client, const char* command, char** args, int argc);
-bool handle_bitmap_command(Server* server, Client* client, const char* command, char** args, int argc);
-bool handle_hyperloglog_command(Server* server, Client* client, const char* command, char** args, int argc);
-bool handle_geo_command(Server* server, Client* client, const char* command, char** args, int argc);
-bool handle_stream_command(Server* server, Client* client, const char* command, char** args, int argc);
+static void free_closed_clients(Server* server);
+static void release_client(Server* server, Client* client);
+static void index_client(Server* server, Client* client);
+static void unindex_client(Server* server, Client* client);
+static int uring_process(Server* server);
+static void uring_handle_event(Server* server, const UringEvent* event);
+static void uring_handle_pending_reads(Server* server);
+static void uring_handle_pending_writes(Server* server);
 
 Server* server_create(const char* host, uint16_t port, int max_clients) {
-    if (!host || port == 0 || max_clients <= 0) return NULL;
+    if (!host || max_clients <= 0) return NULL;
     
     Server* server = malloc(sizeof(Server));
     if (!server) return NULL;
@@ -43,11 +87,22 @@ Server* server_create(const char* host, uint16_t port, int max_clients) {
     }
     server->config.port = port;
     server->config.max_clients = max_clients;
+    server->config.io_threads = 1;
+    server->config.backend = SERVER_BACKEND_EPOLL;
+    server->config.unix_socket = NULL;
+    server_default_reply_limits(server->config.reply_limits);
+    server->config.tracking_table_max_keys = TRACKING_TABLE_MAX_KEYS;
+    server->config.reply_cache_max_bytes = REPLY_CACHE_MAX_BYTES;
+    server->config.reply_cache_min_reads = REPLY_CACHE_MIN_READS;
+    server->config.client_budget_commands = CLIENT_BUDGET_COMMANDS;
+    server->config.client_budget_usec = CLIENT_BUDGET_USEC;
     server->config.daemonize = false;
     
     // Initialize server state
     server->server_fd = -1;
-    server->db = hashmap_create();
+    server->unix_fd = -1;
+    server->loop = NULL;
+    server->db = hashmap_create(0);
     if (!server->db) {
         free(server->config.host);
         free(server);
@@ -55,7 +110,29 @@ Server* server_create(const char* host, uint16_t port, int max_clients) {
     }
     
     server->clients = calloc(max_clients, sizeof(Client*));
-    if (!server->clients) {
+    // At most half full, so probes stay short
+    size_t id_slots = 1;
+    while (id_slots < (size_t)max_clients * 2) id_slots *= 2;
+    server->clients_by_id = calloc(id_slots, sizeof(Client*));
+    server->id_index_mask = id_slots - 1;
+    server->clients_to_close = calloc(max_clients, sizeof(Client*));
+    // A client unblocked while the pending reads are handled is queued
+    // for the next round and may be in the current one too
+    server->pending_reads = calloc(max_clients * 2, sizeof(Client*));
+    server->pending_writes = calloc(max_clients, sizeof(Client*));
+    server->blocking = blocking_create();
+    server->pubsub = pubsub_create();
+    server->tracking = tracking_create();
+    if (!server->clients || !server->clients_by_id || !server->clients_to_close || !server->pending_reads ||
+        !server->pending_writes || !server->blocking || !server->pubsub || !server->tracking) {
+        free(server->clients);
+        free(server->clients_by_id);
+        free(server->clients_to_close);
+        free(server->pending_reads);
+        free(server->pending_writes);
+        blocking_destroy(server);
+        pubsub_destroy(server);
+        tracking_destroy(server);
         hashmap_destroy(server->db);
         free(server->config.host);
         free(server);
@@ -63,7 +140,19 @@ Server* server_create(const char* host, uint16_t port, int max_clients) {
     }
     
     server->client_count = 0;
+    server->next_client_id = 1;
+    server->close_count = 0;
+    server->last_soft_check = 0;
+    server->pending_read_count = 0;
+    server->pending_write_count = 0;
+    server->io_pool = NULL;
+    server->uring = NULL;
+    server->shards = NULL;
+    server->shard_id = 0;
+    server->current_client = NULL;
     server->running = false;
+    timers_init(&server->timers, server);
+    hashmap_set_modified_hook(server->db, tracking_key_modified, server);
     
     return server;
 }
@@ -76,13 +165,34 @@ void server_destroy(Server* server) {
         server_stop(server);
     }
     
-    // Clean up all clients
-    for (size_t i = 0; i < server->client_count; i++) {
-        cleanup_client(server, server->clients[i]);
+    // In-flight io_uring requests point into client memory, so the ring
+    // goes first; clients are then freed without waiting on it
+    uring_destroy(server->uring);
+    server->uring = NULL;
+    
+    // Blocked clients are dropped without a reply
+    blocking_destroy(server);
+    pubsub_destroy(server);
+    tracking_destroy(server);
+    
+    // Clean up all clients; those already closed are still registered
+    server->close_count = 0;
+    while (server->client_count > 0) {
+        release_client(server, server->clients[server->client_count - 1]);
     }
     
-    // Free client array
+    // Close listeners and event loop
+    close_listeners(server);
+    event_loop_destroy(server->loop);
+    io_threads_destroy(server->io_pool);
+    timers_free(&server->timers);
+    
+    // Free client arrays
     free(server->clients);
+    free(server->clients_by_id);
+    free(server->clients_to_close);
+    free(server->pending_reads);
+    free(server->pending_writes);
     
     // Clean up database
     hashmap_destroy(server->db);
@@ -94,30 +204,156 @@ void server_destroy(Server* server) {
     free(server);
 }
 
+// Output buffer limits as in Redis: none for normal clients, whose
+// pipelines are paused at REPLY_PAUSE_BYTES instead
+void server_default_reply_limits(ReplyLimit limits[CLIENT_CLASS_COUNT]) {
+    memset(limits, 0, CLIENT_CLASS_COUNT * sizeof(ReplyLimit));
+    limits[CLIENT_CLASS_PUBSUB] = (ReplyLimit){
+        .hard_bytes = 32 * 1024 * 1024,
+        .soft_bytes = 8 * 1024 * 1024,
+        .soft_seconds = 60
+    };
+}
+
 bool server_start(Server* server) {
     if (!server) return false;
     
-    // Create server socket
-    server->server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (server->server_fd < 0) {
-        perror("Failed to create server socket");
+    // The ring must be created on the thread that runs the loop
+    if (server->config.backend == SERVER_BACKEND_IO_URING && !server->uring) {
+        server->uring = uring_create(URING_ENTRIES);
+        if (!server->uring) {
+            fprintf(stderr, "io_uring is not available, falling back to epoll\n");
+            server->config.backend = SERVER_BACKEND_EPOLL;
+        }
+    }
+    
+    // Listen on TCP unless the port is 0, and on the Unix socket if set
+    if (server->config.port == 0 && !server->config.unix_socket) {
+        fprintf(stderr, "No port or Unix socket to listen on\n");
         return false;
     }
+    if (server->config.port != 0) {
+        server->server_fd = listen_tcp(server);
+        if (server->server_fd < 0) return false;
+    }
+    if (server->config.unix_socket) {
+        server->unix_fd = listen_unix(server);
+        if (server->unix_fd < 0) {
+            close_listeners(server);
+            return false;
+        }
+    }
+    
+    if (server->uring) {
+        // One multishot accept per listener covers every connection from now on
+        if ((server->server_fd >= 0 && !uring_accept_multishot(server->uring, server->server_fd,
+                                                                URING_ACCEPT_DATA(server->server_fd))) ||
+            (server->unix_fd >= 0 && !uring_accept_multishot(server->uring, server->unix_fd,
+                                                              URING_ACCEPT_DATA(server->unix_fd)))) {
+            fprintf(stderr, "Failed to queue accept on io_uring\n");
+            close_listeners(server);
+            return false;
+        }
+        printf("Using the io_uring backend\n");
+    } else {
+        // Create event loop sized for every client fd plus some headroom.
+        // Shards share the process fd table, so each must cover all of them.
+        int setsize = server->config.max_clients + EVENT_LOOP_FDSET_INCR;
+        if (server->shards) {
+            setsize = server->config.max_clients * server->shards->count + EVENT_LOOP_FDSET_INCR;
+        }
+        server->loop = event_loop_create(setsize);
+        if (!server->loop) {
+            perror("Failed to create event loop");
+            close_listeners(server);
+            return false;
+        }
+        server->loop->data = server;
+        server->loop->timers = &server->timers;
+        event_loop_set_before_sleep(server->loop, before_sleep);
+        
+        if ((server->server_fd >= 0 &&
+             !event_loop_add(server->loop, server->server_fd, EVENT_READABLE, accept_handler, server)) ||
+            (server->unix_fd >= 0 &&
+             !event_loop_add(server->loop, server->unix_fd, EVENT_READABLE, accept_handler, server))) {
+            perror("Failed to register server socket");
+            close_listeners(server);
+            return false;
+        }
+        
+        if (server->shards && !shard_attach(server)) {
+            perror("Failed to register shard wakeup fd");
+            close_listeners(server);
+            return false;
+        }
+        
+        // Socket reads, parsing and reply writes may be spread over threads;
+        // commands always run here, so the data types need no locking
+        if (server->config.io_threads > 1 && !server->io_pool) {
+            server->io_pool = io_threads_create(server->config.io_threads);
+            if (!server->io_pool) {
+                fprintf(stderr, "Failed to start I/O threads, using the main thread only\n");
+            } else {
+                printf("Using %d I/O threads\n", server->config.io_threads);
+                // Busy workers spin between batches, so extra threads only
+                // steal time from the main thread
+                long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+                if (cpus > 0 && server->config.io_threads > cpus) {
+                    fprintf(stderr, "Warning: %d I/O threads on %ld CPUs will hurt throughput\n",
+                            server->config.io_threads, cpus);
+                }
+            }
+        }
+    
+    }
+    
+    // Writes to a closed peer must fail with EPIPE, not kill the process
+    signal(SIGPIPE, SIG_IGN);
+    
+    server->running = true;
+    if (server->shards) {
+        printf("Shard %d listening on %s:%d\n", server->shard_id, server->config.host, server->config.port);
+    } else if (server->server_fd >= 0) {
+        printf("Server listening on %s:%d\n", server->config.host, server->config.port);
+    }
+    if (server->unix_fd >= 0) {
+        printf("Server listening on %s\n", server->config.unix_socket);
+    }
+    
+    // Main server loop: only sockets with pending events are touched
+    while (server->running) {
+        int wait_ms = io_threads_parked(server->io_pool) ? EVENT_LOOP_MAX_WAIT_MS : IO_THREADS_IDLE_WAIT_MS;
+        int processed = server->uring ? uring_process(server) : event_loop_process(server->loop, wait_ms);
+        if (processed < 0) {
+            perror("Error waiting for events");
+            break;
+        }
+    }
+    
+    return true;
+}
+
+// Create the non-blocking TCP listener on host:port
+static int listen_tcp(Server* server) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("Failed to create server socket");
+        return -1;
+    }
     
     // Set socket options
     int opt = 1;
-    if (setsockopt(server->server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
         perror("Failed to set socket options");
-        close(server->server_fd);
-        return false;
+        close(fd);
+        return -1;
     }
     
-    // Set non-blocking mode
-    int flags = fcntl(server->server_fd, F_GETFL, 0);
-    if (flags < 0 || fcntl(server->server_fd, F_SETFL, flags | O_NONBLOCK) < 0) {
-        perror("Failed to set non-blocking mode");
-        close(server->server_fd);
-        return false;
+    // Every shard binds the same address; the kernel spreads connections
+    if (server->shards && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        perror("Failed to set SO_REUSEPORT");
+        close(fd);
+        return -1;
     }
     
     // Bind socket
@@ -127,295 +363,877 @@ bool server_start(Server* server) {
     addr.sin_addr.s_addr = inet_addr(server->config.host);
     addr.sin_port = htons(server->config.port);
     
-    if (bind(server->server_fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
         perror("Failed to bind socket");
-        close(server->server_fd);
-        return false;
+        close(fd);
+        return -1;
+    }
+    return finish_listener(server, fd);
+}
+
+// Create the listener on config.unix_socket, replacing a stale socket
+// file left behind by an earlier run
+static int listen_unix(Server* server) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(server->config.unix_socket) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Unix socket path too long: %s\n", server->config.unix_socket);
+        return -1;
+    }
+    strcpy(addr.sun_path, server->config.unix_socket);
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("Failed to create Unix socket");
+        return -1;
+    }
+    
+    unlink(server->config.unix_socket);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("Failed to bind Unix socket");
+        close(fd);
+        return -1;
+    }
+    
+    fd = finish_listener(server, fd);
+    if (fd < 0) unlink(server->config.unix_socket);
+    return fd;
+}
+
+// Make a bound socket non-blocking and start listening on it. io_uring
+// waits for connections by itself, so its listeners stay blocking.
+static int finish_listener(Server* server, int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (!server->uring &&
+        (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)) {
+        perror("Failed to set non-blocking mode");
+        close(fd);
+        return -1;
     }
     
-    // Listen for connections
-    if (listen(server->server_fd, server->config.max_clients) < 0) {
+    if (listen(fd, server->config.max_clients) < 0) {
         perror("Failed to listen on socket");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void close_listeners(Server* server) {
+    if (server->server_fd >= 0) {
         close(server->server_fd);
-        return false;
+        server->server_fd = -1;
     }
+    if (server->unix_fd >= 0) {
+        close(server->unix_fd);
+        server->unix_fd = -1;
+        unlink(server->config.unix_socket);
+    }
+}
+
+void server_stop(Server* server) {
+    if (!server) return;
+    server->running = false;
+}
+
+bool server_is_running(const Server* server) {
+    return server && server->running;
+}
+
+static void accept_handler(EventLoop* loop, int fd, void* data, int mask) {
+    (void)loop;
+    (void)mask;
+    Server* server = data;
     
-    server->running = true;
-    printf("Server listening on %s:%d\n", server->config.host, server->config.port);
-    
-    // Main server loop
-    while (server->running) {
-        // Accept new connections
-        struct sockaddr_in client_addr;
-        socklen_t client_len = sizeof(client_addr);
-        int client_fd = accept(server->server_fd, (struct sockaddr*)&client_addr, &client_len);
+    // Drain the accept queue; the listener is non-blocking
+    while (true) {
+        int client_fd = accept(fd, NULL, NULL);
         
-        if (client_fd >= 0) {
-            // Check if we can accept more clients
-            if (server->client_count >= server->config.max_clients) {
-                close(client_fd);
-                continue;
+        if (client_fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                perror("Error accepting connection");
             }
-            
-            // Set client socket to non-blocking mode
-            int flags = fcntl(client_fd, F_GETFL, 0);
-            if (flags < 0 || fcntl(client_fd, F_SETFL, flags | O_NONBLOCK) < 0) {
-                perror("Failed to set client socket non-blocking");
-                close(client_fd);
-                continue;
-            }
-            
-            // Create new client
-            Client* client = malloc(sizeof(Client));
-            if (!client) {
-                close(client_fd);
-                continue;
-            }
-            
-            client->fd = client_fd;
-            client->buffer = malloc(BUFFER_SIZE);
-            if (!client->buffer) {
-                free(client);
-                close(client_fd);
-                continue;
-            }
-            
-            client->buffer_size = BUFFER_SIZE;
-            client->buffer_pos = 0;
-            client->authenticated = false;
-            
-            // Add client to array
-            server->clients[server->client_count++] = client;
-            printf("New client connected (%d/%d)\n", 
-                   server->client_count, server->config.max_clients);
-        }
-        else if (errno != EAGAIN && errno != EWOULDBLOCK) {
-            perror("Error accepting connection");
+            return;
         }
         
-        // Handle existing clients
-        for (size_t i = 0; i < server->client_count; i++) {
-            handle_client(server, server->clients[i]);
+        add_client(server, client_fd);
+    }
+}
+
+// Set up a freshly accepted socket and start reading from it. The
+// socket is closed if the client can't be taken on.
+static void add_client(Server* server, int client_fd) {
+    // Check if we can accept more clients
+    if (server->client_count >= (size_t)server->config.max_clients) {
+        close(client_fd);
+        return;
+    }
+    
+    // Set client socket to non-blocking mode. io_uring waits for socket
+    // readiness by itself, so its sockets stay blocking.
+    int flags = fcntl(client_fd, F_GETFL, 0);
+    if (!server->uring &&
+        (flags < 0 || fcntl(client_fd, F_SETFL, flags | O_NONBLOCK) < 0)) {
+        perror("Failed to set client socket non-blocking");
+        close(client_fd);
+        return;
+    }
+    
+    // Replies are already batched per loop iteration; don't let Nagle
+    // hold back the tail of one waiting for the peer's delayed ACK.
+    // Fails harmlessly on Unix sockets, which have no Nagle.
+    int nodelay = 1;
+    setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    
+    // Create new client
+    Client* client = client_create(client_fd);
+    if (!client) {
+        close(client_fd);
+        return;
+    }
+    
+    // Watch the new socket for incoming commands
+    if (server->uring) {
+        if (!uring_recv_multishot(server->uring, client_fd, (uint64_t)(uintptr_t)client | URING_OP_RECV)) {
+            fprintf(stderr, "Failed to queue receive on io_uring\n");
+            client_free(client);
+            return;
         }
-        
-        // Small delay to prevent busy waiting
-        usleep(1000);
+        client->recv_armed = true;
+    } else if (!event_loop_add(server->loop, client_fd, EVENT_READABLE, read_handler, client)) {
+        perror("Failed to register client socket");
+        client_free(client);
+        return;
     }
     
-    return true;
+    server_register_client(server, client);
+    printf("New client connected (id=%llu, %zu/%d)\n", (unsigned long long)client->id,
+           server->client_count, server->config.max_clients);
 }
 
-void server_stop(Server* server) {
-    if (!server) return;
-    server->running = false;
+// Readable sockets are only queued here; reading happens in
+// before_sleep so it can be spread over the I/O threads
+static void read_handler(EventLoop* loop, int fd, void* data, int mask) {
+    (void)fd;
+    (void)mask;
+    Server* server = loop->data;
+    Client* client = data;
+    
+    queue_pending_read(server, client);
 }
 
-bool server_is_running(Server* server) {
-    return server && server->running;
+static void write_handler(EventLoop* loop, int fd, void* data, int mask) {
+    (void)fd;
+    (void)mask;
+    flush_client(loop->data, data);
+}
+
+// Send pending replies; if the socket can't take them all, wait for it
+// to become writable instead of blocking the loop
+static void flush_client(Server* server, Client* client) {
+    if (!client_flush(client)) {
+        cleanup_client(server, client);
+        return;
+    }
+    update_write_interest(server, client);
+    resume_client(server, client);
 }
 
-static void handle_client(Server* server, Client* client) {
-    if (!server || !client) return;
+static void update_write_interest(Server* server, Client* client) {
+    if (client_has_pending_reply(client)) {
+        if (!(event_loop_get_mask(server->loop, client->fd) & EVENT_WRITABLE)) {
+            event_loop_add(server->loop, client->fd, EVENT_WRITABLE, write_handler, client);
+        }
+    } else {
+        event_loop_remove(server->loop, client->fd, EVENT_WRITABLE);
+    }
+}
+
+// Read and execute everything that arrived, then flush every client that
+// produced replies, so a pipelined batch costs one write no matter how
+// many commands it had
+static void before_sleep(EventLoop* loop) {
+    Server* server = loop->data;
+    if (server->shards) handle_shard_messages(server);
+    bool had_io = server->pending_read_count > 0 || server->pending_write_count > 0;
+    handle_pending_reads(server);
+    handle_pending_writes(server);
+    
+    // I/O workers spin while they wait for work; once an iteration has
+    // none, park them so an idle server leaves the cores alone
+    if (!had_io) io_threads_park(server->io_pool);
+    
+    // Flushing let paused clients go on: serve them on the next
+    // iteration without waiting for an event
+    if (server->pending_read_count > 0) loop->dont_wait = true;
+    
+    if (server->shards) shard_flush(server);
+    check_soft_limits(server);
+    free_closed_clients(server);
+}
+
+// Forget the first `handled` pending reads. Clients queued while they
+// were handled, such as ones a command unblocked, wait for the next round.
+static void drop_handled_reads(Server* server, size_t handled) {
+    server->pending_read_count -= handled;
+    memmove(server->pending_reads, server->pending_reads + handled, server->pending_read_count * sizeof(Client*));
+}
+
+static void handle_pending_reads(Server* server) {
+    if (server->pending_read_count == 0) return;
+    
+    // Clients closed since their socket fired are dropped before the
+    // I/O stage; the rest stay valid until free_closed_clients()
+    size_t handled = server->pending_read_count;
+    size_t count = 0;
+    for (size_t i = 0; i < handled; i++) {
+        Client* client = server->pending_reads[i];
+        client->pending_read = false;
+        if (!client->close_queued) server->pending_reads[count++] = client;
+    }
+    
+    io_threads_run(server->io_pool, server->pending_reads, count, IO_OP_READ);
     
-    // Read data from client
-    ssize_t n = read(client->fd, client->buffer + client->buffer_pos, 
-                     client->buffer_size - client->buffer_pos);
-    if (n <= 0) {
-        if (n == 0) {
-            // Client closed connection
+    for (size_t i = 0; i < count; i++) {
+        if (!server->pending_reads[i]->close_queued) process_client(server, server->pending_reads[i]);
+    }
+    drop_handled_reads(server, handled);
+}
+
+static void handle_pending_writes(Server* server) {
+    if (server->pending_write_count == 0) return;
+    
+    // Output limits are checked here, not as replies are queued, so a
+    // publish never disconnects a subscriber in the middle of its fan-out
+    size_t count = 0;
+    for (size_t i = 0; i < server->pending_write_count; i++) {
+        Client* client = server->pending_writes[i];
+        client->pending_write = false;
+        if (!client->close_queued && check_reply_limits(server, client)) {
+            server->pending_writes[count++] = client;
+        }
+    }
+    
+    io_threads_run(server->io_pool, server->pending_writes, count, IO_OP_WRITE);
+    
+    for (size_t i = 0; i < count; i++) {
+        Client* client = server->pending_writes[i];
+        if (client->io_status == CLIENT_IO_CLOSED || client->close_after_reply) {
             cleanup_client(server, client);
-        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
-            // Error reading from client
-            perror("Error reading from client");
+        } else {
+            update_write_interest(server, client);
+            resume_client(server, client);
+        }
+    }
+    server->pending_write_count = 0;
+}
+
+// Act on the outcome of the read stage and run the parsed commands
+static void process_client(Server* server, Client* client) {
+    switch (client->io_status) {
+        case CLIENT_IO_CLOSED:
             cleanup_client(server, client);
+            return;
+        case CLIENT_IO_LIMIT:
+            send_error(client, "ERR query buffer limit exceeded");
+            client->close_after_reply = true;
+            queue_pending_write(server, client);
+            return;
+        case CLIENT_IO_PROTOCOL: {
+            // Commands before the bad frame still run
+            execute_commands(server, client);
+            char error[128];
+            snprintf(error, sizeof(error), "ERR Protocol error: %s", client->parser.error);
+            send_error(client, error);
+            client->close_after_reply = true;
+            queue_pending_write(server, client);
+            return;
         }
-        return;
+        case CLIENT_IO_OK:
+            break;
     }
     
-    client->buffer_pos += n;
+    execute_commands(server, client);
+    queue_pending_write(server, client);
+}
+
+// Read from the client and run its commands before the loop sleeps again
+static void queue_pending_read(Server* server, Client* client) {
+    if (!client->pending_read) {
+        client->pending_read = true;
+        server->pending_reads[server->pending_read_count++] = client;
+    }
+}
+
+// Flush the client's replies before the loop sleeps again
+static void queue_pending_write(Server* server, Client* client) {
+    if ((client_has_pending_reply(client) || client->close_after_reply) && !client->pending_write) {
+        client->pending_write = true;
+        server->pending_writes[server->pending_write_count++] = client;
+    }
+}
+
+static int64_t monotonic_usec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Whether the client has used up its share of this loop iteration. The
+// clock is only read every 16 commands, which costs next to nothing.
+static bool client_budget_spent(const Server* server, size_t executed, int64_t started) {
+    size_t max_commands = server->config.client_budget_commands;
+    if (max_commands > 0 && executed >= max_commands) return true;
+    return server->config.client_budget_usec > 0 && executed % 16 == 0 &&
+           monotonic_usec() - started >= server->config.client_budget_usec;
+}
+
+static void execute_commands(Server* server, Client* client) {
+    CommandQueue* queue = &client->commands;
+    size_t executed = 0;
+    int64_t started = server->config.client_budget_usec > 0 ? monotonic_usec() : 0;
     
-    // Process complete commands
-    while (client->buffer_pos > 0) {
-        // Find command end marker
-        char* cmd_end = memchr(client->buffer, '\n', client->buffer_pos);
-        if (!cmd_end) break;
+    // A forwarded or blocking command stalls the rest of the pipeline so
+    // replies keep their order
+    while (queue->next < queue->count && !client->forwarded && !client->reply_paused &&
+           client->block.type == BLOCK_NONE) {
+        // A long pipeline is run a slice per loop iteration, so clients
+        // with a command or two don't wait behind it. A closing client
+        // runs what it sent in one go.
+        if (executed > 0 && client->io_status == CLIENT_IO_OK && client_budget_spent(server, executed, started)) {
+            queue_pending_read(server, client);
+            break;
+        }
+        executed++;
         
-        // Calculate command length
-        size_t cmd_len = cmd_end - client->buffer;
-        if (cmd_len > 0 && cmd_end[-1] == '\r') cmd_len--;
+        size_t i = queue->next++;
+        client->argc = queue->argc[i];
+        client->argv = queue->argv + queue->argv_start[i];
+        client->argv_len = queue->argv_len + queue->argv_start[i];
+        client->argv_owned = queue->argv_owned + queue->argv_start[i];
+        client->query_offset += queue->frame_len[i];
         
-        // Create null-terminated command string
-        char cmd[BUFFER_SIZE];
-        if (cmd_len >= sizeof(cmd)) {
-            send_error(client, "ERR command too long");
-            cleanup_client(server, client);
+        if (client->argc > 0) execute_command(server, client);
+        client_release_args(client);
+        
+        // A client that doesn't read its replies stops being served until
+        // they drain, rather than growing its backlog without bound. After
+        // a protocol error the rest runs anyway, as the client is closing.
+        if (client->reply_overflow) break;
+        if (client_reply_size(client) >= REPLY_PAUSE_BYTES && client->io_status == CLIENT_IO_OK) {
+            client->reply_paused = true;
+            event_loop_remove(server->loop, client->fd, EVENT_READABLE);
+        }
+    }
+    
+    // Nothing more can run until server_unblocked_client(), so stop
+    // reading rather than wake up for every packet meanwhile
+    if (client->block.type != BLOCK_NONE && queue->next < queue->count) {
+        event_loop_remove(server->loop, client->fd, EVENT_READABLE);
+    }
+    
+    if (queue->next == queue->count) client_reset_commands(client);
+}
+
+// Run the client's current command here, or hand it to the shard owning
+// its keys
+static void execute_command(Server* server, Client* client) {
+    // Subscribed clients stay here, where handle_command turns down
+    // anything but subscription commands
+    if (server->shards && pubsub_subscription_count(client) == 0) {
+        int target = shard_route(server->shards->count, client->argc, client->argv, client->argv_len);
+        if (target == SHARD_CROSS) {
+            send_error(client, "CROSSSLOT Keys in request don't hash to the same shard");
             return;
         }
-        memcpy(cmd, client->buffer, cmd_len);
-        cmd[cmd_len] = '\0';
-        
-        // Parse command
-        int argc;
-        char** args = parse_command(cmd, &argc);
-        if (!args) {
-            send_error(client, "ERR out of memory");
-            cleanup_client(server, client);
+        if (target >= 0 && target != server->shard_id) {
+            if (!shard_forward(server, client, target)) {
+                send_error(client, "ERR out of memory");
+                return;
+            }
+            // Nothing more is read until the reply is back
+            client->forwarded = true;
+            event_loop_remove(server->loop, client->fd, EVENT_READABLE);
             return;
         }
+    }
+    
+    handle_command(server, client, client->argv[0], client->argv, client->argc);
+}
+
+// Run commands other shards forwarded here, and resume clients whose
+// forwarded commands have been answered
+static void handle_shard_messages(Server* server) {
+    ShardMessage* msg;
+    while ((msg = shard_receive(server)) != NULL) {
+        if (msg->type == SHARD_REQUEST) {
+            shard_execute(server, msg);
+            continue;
+        }
+        if (msg->type == SHARD_PUBLISH) {
+            pubsub_publish(server, msg->argv[1], msg->argv_len[1], msg->argv[2], msg->argv_len[2]);
+            shard_message_free(msg);
+            continue;
+        }
         
-        // Handle command
-        if (argc > 0) {
-            handle_command(server, client, args[0], args, argc);
+        Client* client = msg->client;
+        client->forwarded = false;
+        if (client->close_deferred) {
+            client_free(client);
+            shard_message_free(msg);
+            continue;
+        }
+        if (client->close_queued) {
+            shard_message_free(msg);
+            continue;
         }
         
-        // Free arguments
-        for (int i = 0; i < argc; i++) {
-            free(args[i]);
+        if (msg->reply) {
+            send_raw(client, msg->reply, msg->reply_len);
+        } else {
+            send_error(client, "ERR out of memory");
         }
-        free(args);
+        shard_message_free(msg);
         
-        // Remove processed command from buffer
-        size_t remaining = client->buffer_pos - (cmd_end - client->buffer + 1);
-        if (remaining > 0) {
-            memmove(client->buffer, cmd_end + 1, remaining);
+        if (!client->reply_paused) {
+            event_loop_add(server->loop, client->fd, EVENT_READABLE, read_handler, client);
         }
-        client->buffer_pos = remaining;
+        execute_commands(server, client);
+        queue_pending_write(server, client);
     }
 }
 
-static char** parse_command(const char* command, int* argc) {
-    char* cmd_copy = strdup(command);
-    if (!cmd_copy) {
-        *argc = 0;
-        return NULL;
-    }
+static int64_t monotonic_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+// Disconnect a client whose pending replies are over its class's hard
+// limit, or have stayed over the soft limit for too long. Returns false
+// if the client was closed.
+static bool check_reply_limits(Server* server, Client* client) {
+    const ReplyLimit* limit = &server->config.reply_limits[client->client_class];
+    size_t size = client_reply_size(client);
     
-    char** args = malloc(MAX_ARGS * sizeof(char*));
-    if (!args) {
-        free(cmd_copy);
-        *argc = 0;
-        return NULL;
+    bool over = client->reply_overflow || (limit->hard_bytes > 0 && size > limit->hard_bytes);
+    if (!over && limit->soft_bytes > 0 && size > limit->soft_bytes) {
+        int64_t now = monotonic_seconds();
+        if (client->soft_limit_since == 0) {
+            client->soft_limit_since = now;
+        } else if (now - client->soft_limit_since >= limit->soft_seconds) {
+            over = true;
+        }
+    } else {
+        client->soft_limit_since = 0;
     }
     
-    *argc = 0;
-    char* token = strtok(cmd_copy, " ");
+    if (over) {
+        fprintf(stderr, "Closing client id=%llu over its output buffer limit (%zu bytes pending)\n",
+                (unsigned long long)client->id, size);
+        cleanup_client(server, client);
+        return false;
+    }
+    return true;
+}
+
+// A stuck reader sends no events, so clients over their soft limit are
+// looked at again once a second
+static void check_soft_limits(Server* server) {
+    int64_t now = monotonic_seconds();
+    if (now == server->last_soft_check) return;
+    server->last_soft_check = now;
     
-    while (token && *argc < MAX_ARGS) {
-        args[(*argc)++] = strdup(token);
-        token = strtok(NULL, " ");
+    for (size_t i = 0; i < server->client_count; i++) {
+        Client* client = server->clients[i];
+        if (client->soft_limit_since && !client->close_queued) check_reply_limits(server, client);
     }
+}
+
+// Once a paused client's backlog has drained, read from it again and
+// queue it to run the commands it has waiting
+static void resume_client(Server* server, Client* client) {
+    if (!client->reply_paused || client_reply_size(client) >= REPLY_PAUSE_BYTES) return;
     
-    free(cmd_copy);
-    return args;
+    client->reply_paused = false;
+    if (!client->forwarded) {
+        event_loop_add(server->loop, client->fd, EVENT_READABLE, read_handler, client);
+    }
+    queue_pending_read(server, client);
 }
 
+// Disconnect a client. Its memory and socket are kept until the end of
+// the loop iteration, so pointers to it in the pending lists or in
+// events not yet handled stay valid and its fd can't be reused meanwhile.
 static void cleanup_client(Server* server, Client* client) {
-    if (!server || !client) return;
+    if (!server || !client || client->close_queued) return;
     
-    // Remove client from array
-    for (size_t i = 0; i < server->client_count; i++) {
-        if (server->clients[i] == client) {
-            // Shift remaining clients
-            for (size_t j = i; j < server->client_count - 1; j++) {
-                server->clients[j] = server->clients[j + 1];
+    client->close_queued = true;
+    server->clients_to_close[server->close_count++] = client;
+    unblock_client(server, client);
+    pubsub_unsubscribe_all(server, client);
+    tracking_disable(server, client);
+    
+    // Stop watching the socket
+    event_loop_remove(server->loop, client->fd, EVENT_READABLE | EVENT_WRITABLE);
+}
+
+// Give a new connection its ID and add it to the registry, which owns it
+// from now on. The caller has checked there is room.
+void server_register_client(Server* server, Client* client) {
+    // Shards hand out interleaved IDs so they stay unique process-wide
+    uint64_t stride = server->shards ? (uint64_t)server->shards->count : 1;
+    client->id = server->next_client_id++ * stride + (uint64_t)server->shard_id;
+    
+    client->client_class = CLIENT_CLASS_NORMAL;
+    client->reply_limit = server->config.reply_limits[CLIENT_CLASS_NORMAL].hard_bytes;
+    
+    client->slot = server->client_count;
+    server->clients[server->client_count++] = client;
+    index_client(server, client);
+}
+
+// Take a client out of the registry, moving the last one into its slot.
+// The client is the caller's again.
+void server_unregister_client(Server* server, Client* client) {
+    Client* last = server->clients[--server->client_count];
+    server->clients[client->slot] = last;
+    last->slot = client->slot;
+    unindex_client(server, client);
+}
+
+static size_t id_slot(const Server* server, uint64_t id) {
+    uint64_t hash = id * 0x9E3779B97F4A7C15ull;
+    return (size_t)(hash ^ (hash >> 32)) & server->id_index_mask;
+}
+
+static void index_client(Server* server, Client* client) {
+    size_t i = id_slot(server, client->id);
+    while (server->clients_by_id[i]) i = (i + 1) & server->id_index_mask;
+    server->clients_by_id[i] = client;
+}
+
+// Linear probing: shift back the entries after the hole that would no
+// longer be found past it
+static void unindex_client(Server* server, Client* client) {
+    size_t mask = server->id_index_mask;
+    size_t hole = id_slot(server, client->id);
+    while (server->clients_by_id[hole] != client) hole = (hole + 1) & mask;
+    
+    for (size_t i = (hole + 1) & mask; server->clients_by_id[i]; i = (i + 1) & mask) {
+        size_t home = id_slot(server, server->clients_by_id[i]->id);
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            server->clients_by_id[hole] = server->clients_by_id[i];
+            hole = i;
+        }
+    }
+    server->clients_by_id[hole] = NULL;
+}
+
+// A connected client by ID, e.g. the target of CLIENT TRACKING REDIRECT
+Client* server_find_client(const Server* server, uint64_t id) {
+    for (size_t i = id_slot(server, id); server->clients_by_id[i]; i = (i + 1) & server->id_index_mask) {
+        if (server->clients_by_id[i]->id == id) return server->clients_by_id[i];
+    }
+    return NULL;
+}
+
+static void free_closed_clients(Server* server) {
+    for (size_t i = 0; i < server->close_count; i++) {
+        release_client(server, server->clients_to_close[i]);
+    }
+    server->close_count = 0;
+}
+
+static void release_client(Server* server, Client* client) {
+    // The kernel still holds io_uring requests for this client: cancel
+    // them and finish the cleanup when the last one completes
+    if (server->uring && (client->recv_armed || client->send_armed)) {
+        if (!client->closing) {
+            client->closing = true;
+            if (!uring_cancel_fd(server->uring, client->fd, URING_OP_CANCEL)) {
+                shutdown(client->fd, SHUT_RDWR);
             }
-            server->client_count--;
-            break;
         }
+        return;
     }
     
-    // Close socket
-    close(client->fd);
+    server_unregister_client(server, client);
     
-    // Free client resources
-    free(client->buffer);
-    free(client);
+    // Another shard still holds a command from this client; hang up now
+    // but keep the memory until its reply arrives
+    if (client->forwarded && server->running) {
+        close(client->fd);
+        client->fd = -1;
+        client->close_deferred = true;
+        return;
+    }
+    
+    // Close socket and free client resources
+    client_free(client);
 }
 
-bool handle_command(Server* server, Client* client, const char* command, char** args, int argc) {
-    if (!server || !client || !command || !args || argc < 1) {
-        send_error(client, "ERR invalid command");
-        return false;
+// One iteration of the io_uring loop: submit everything queued and wait
+// for completions, take all of them, then run commands and queue the
+// replies, mirroring before_sleep on the epoll backend
+static int uring_process(Server* server) {
+    int timeout_ms = server->pending_read_count > 0 ? 0 : timers_wait_ms(&server->timers, EVENT_LOOP_MAX_WAIT_MS);
+    if (uring_wait(server->uring, timeout_ms) < 0) return -1;
+    
+    UringEvent event;
+    int processed = 0;
+    while (uring_next_event(server->uring, &event)) {
+        uring_handle_event(server, &event);
+        processed++;
     }
     
-    // Convert command to uppercase for comparison
-    char cmd[32];
-    strncpy(cmd, command, sizeof(cmd) - 1);
-    cmd[sizeof(cmd) - 1] = '\0';
-    for (char* p = cmd; *p; p++) *p = toupper(*p);
+    timers_run(&server->timers);
+    uring_handle_pending_reads(server);
+    uring_handle_pending_writes(server);
+    check_soft_limits(server);
+    free_closed_clients(server);
+    return processed;
+}
+
+static void uring_handle_event(Server* server, const UringEvent* event) {
+    Client* client = (Client*)(uintptr_t)(event->user_data & ~(uint64_t)URING_OP_MASK);
     
-    // Handle string commands
-    if (strcmp(cmd, "SET") == 0 || strcmp(cmd, "GET") == 0) {
-        return handle_string_command(server, client, command, args, argc);
+    switch (event->user_data & URING_OP_MASK) {
+        case URING_OP_ACCEPT: {
+            int listen_fd = (int)(event->user_data >> 2);
+            if (event->res >= 0) {
+                add_client(server, event->res);
+            } else if (event->res != -EINTR && event->res != -EAGAIN) {
+                fprintf(stderr, "Error accepting connection: %s\n", strerror(-event->res));
+            }
+            if (!event->more && server->running &&
+                !uring_accept_multishot(server->uring, listen_fd, URING_ACCEPT_DATA(listen_fd))) {
+                fprintf(stderr, "Failed to queue accept on io_uring\n");
+                server_stop(server);
+            }
+            return;
+        }
+        
+        case URING_OP_RECV:
+            if (!event->more) client->recv_armed = false;
+            
+            // Already on its way out: drop anything else the peer sends
+            if (client->close_queued || client->close_after_reply || client->io_status != CLIENT_IO_OK) {
+                uring_recycle_buffer(server->uring, event);
+                break;
+            }
+            
+            if (event->res > 0) {
+                // Copy out and hand the buffer straight back to the kernel
+                client->io_status = client_append_query(client, uring_event_buffer(server->uring, event),
+                                                        event->res);
+                uring_recycle_buffer(server->uring, event);
+            } else if (event->res == 0) {
+                // Peer closed its side: answer what it sent, then hang up
+                client->close_after_reply = true;
+            } else if (event->res != -ENOBUFS) {
+                client->io_status = CLIENT_IO_CLOSED;
+            }
+            
+            // Running out of provided buffers ends a multishot receive
+            // without losing data; they are free again after this batch
+            if (!client->recv_armed && client->io_status == CLIENT_IO_OK && !client->close_after_reply) {
+                if (uring_recv_multishot(server->uring, client->fd, (uint64_t)(uintptr_t)client | URING_OP_RECV)) {
+                    client->recv_armed = true;
+                } else {
+                    client->io_status = CLIENT_IO_CLOSED;
+                }
+            }
+            
+            if (event->res != -ENOBUFS) queue_pending_read(server, client);
+            break;
+        
+        case URING_OP_SEND:
+            client->send_armed = false;
+            if (client->close_queued) break;
+            
+            if (event->res < 0 && event->res != -EINTR && event->res != -EAGAIN) {
+                cleanup_client(server, client);
+                return;
+            }
+            
+            // Partly sent replies go out with the next batch
+            if (event->res > 0) client_reply_consume(client, event->res);
+            resume_client(server, client);
+            queue_pending_write(server, client);
+            break;
+        
+        case URING_OP_CANCEL:
+            return;
     }
-    // Handle list commands
-    else if (strcmp(cmd, "LPUSH") == 0 || strcmp(cmd, "RPUSH") == 0 || strcmp(cmd, "LRANGE") == 0) {
-        return handle_list_command(server, client, command, args, argc);
+    
+    // A closing client is freed once its last request has completed
+    if (client->closing && !client->recv_armed && !client->send_armed) {
+        release_client(server, client);
     }
-    // Handle set commands
-    else if (strcmp(cmd, "SADD") == 0 || strcmp(cmd, "SMEMBERS") == 0 || strcmp(cmd, "SISMEMBER") == 0) {
-        return handle_set_command(server, client, command, args, argc);
+}
+
+// Data is already in the query buffers; parse it and run the commands
+static void uring_handle_pending_reads(Server* server) {
+    size_t handled = server->pending_read_count;
+    for (size_t i = 0; i < handled; i++) {
+        server->pending_reads[i]->pending_read = false;
     }
-    // Handle sorted set commands
-    else if (strcmp(cmd, "ZADD") == 0 || strcmp(cmd, "ZRANGE") == 0 || strcmp(cmd, "ZSCORE") == 0) {
-        return handle_sorted_set_command(server, client, command, args, argc);
+    
+    for (size_t i = 0; i < handled; i++) {
+        Client* client = server->pending_reads[i];
+        if (client->close_queued) continue;
+        if (client->io_status == CLIENT_IO_OK) client->io_status = client_parse_query(client);
+        process_client(server, client);
     }
-    // Handle hash commands
-    else if (strcmp(cmd, "HSET") == 0 || strcmp(cmd, "HGET") == 0 || strcmp(cmd, "HGETALL") == 0) {
-        return handle_hash_command(server, client, command, args, argc);
+    drop_handled_reads(server, handled);
+}
+
+// Start one sendmsg per client with replies and none in flight. The
+// iovecs point at reply memory that stays put until the completion.
+static void uring_handle_pending_writes(Server* server) {
+    size_t kept = 0;
+    for (size_t i = 0; i < server->pending_write_count; i++) {
+        server->pending_writes[i]->pending_write = false;
     }
-    // Handle bitmap commands
-    else if (strcmp(cmd, "SETBIT") == 0 || strcmp(cmd, "GETBIT") == 0 || strcmp(cmd, "BITCOUNT") == 0) {
-        return handle_bitmap_command(server, client, command, args, argc);
+    
+    for (size_t i = 0; i < server->pending_write_count; i++) {
+        Client* client = server->pending_writes[i];
+        
+        // The completion queues the client again if anything is left
+        if (client->send_armed || client->close_queued || !check_reply_limits(server, client)) continue;
+        
+        if (client->io_status == CLIENT_IO_CLOSED ||
+            (client->close_after_reply && !client_has_pending_reply(client))) {
+            cleanup_client(server, client);
+            continue;
+        }
+        if (!client_has_pending_reply(client)) continue;
+        
+        if (!client->send_iov) client->send_iov = malloc(REPLY_MAX_IOV * sizeof(struct iovec));
+        if (client->send_iov) {
+            size_t total;
+            memset(&client->send_msg, 0, sizeof(client->send_msg));
+            client->send_msg.msg_iov = client->send_iov;
+            client->send_msg.msg_iovlen = client_reply_iov(client, client->send_iov, REPLY_MAX_IOV, &total);
+            client->send_armed = uring_sendmsg(server->uring, client->fd, &client->send_msg,
+                                               (uint64_t)(uintptr_t)client | URING_OP_SEND);
+        }
+        
+        // Submission queue full or no memory: try again next iteration
+        if (!client->send_armed) {
+            client->pending_write = true;
+            server->pending_writes[kept++] = client;
+        }
     }
-    // Handle HyperLogLog commands
-    else if (strcmp(cmd, "PFADD") == 0 || strcmp(cmd, "PFCOUNT") == 0 || strcmp(cmd, "PFMERGE") == 0) {
-        return handle_hyperloglog_command(server, client, command, args, argc);
+    server->pending_write_count = kept;
+}
+
+bool handle_command(Server* server, Client* client, const char* command, char** args, int argc) {
+    if (!server || !client || !command || !args || argc < 1) {
+        send_error(client, "ERR invalid command");
+        return false;
     }
-    // Handle geo commands
-    else if (strcmp(cmd, "GEOADD") == 0 || strcmp(cmd, "GEOPOS") == 0 || strcmp(cmd, "GEODIST") == 0) {
-        return handle_geo_command(server, client, command, args, argc);
+    
+    // A command that can't be queued dooms the transaction
+    const Command* cmd = command_lookup(command, strlen(command));
+    if (!cmd) {
+        client->multi.dirty = client->multi.active;
+        send_error(client, "ERR unknown command");
+        return false;
     }
-    // Handle stream commands
-    else if (strcmp(cmd, "XADD") == 0 || strcmp(cmd, "XRANGE") == 0 || strcmp(cmd, "XREAD") == 0) {
-        return handle_stream_command(server, client, command, args, argc);
+    if (!command_arity_ok(cmd, argc)) {
+        client->multi.dirty = client->multi.active;
+        send_arity_error(client, cmd->name);
+        return false;
     }
     
-    send_error(client, "ERR unknown command");
-    return false;
+    // RESP2: a subscribed client only manages its subscriptions
+    if (pubsub_subscription_count(client) > 0 && !(cmd->flags & CMD_PUBSUB)) {
+        char error[160];
+        snprintf(error, sizeof(error),
+                 "ERR Can't execute '%s': only (P)SUBSCRIBE / (P)UNSUBSCRIBE are allowed in this context",
+                 cmd->name);
+        send_error(client, error);
+        return false;
+    }
+    
+    // Inside MULTI commands are only queued, to run back to back on EXEC
+    if (client->multi.active && !(cmd->flags & CMD_TXN)) {
+        if (!multi_queue(client, cmd, args, argc)) {
+            client->multi.dirty = true;
+            send_error(client, "ERR out of memory");
+            return false;
+        }
+        send_queued(client);
+        return true;
+    }
+    
+    bool ok = call_command(server, client, cmd, args, argc);
+    
+    // Serve clients blocked on keys the command (or transaction) pushed to
+    handle_ready_keys(server);
+    return ok;
 }
 
-// Response helper functions
-void send_ok(Client* client) {
-    if (!client) return;
-    dprintf(client->fd, "+OK\r\n");
+// Run a command that has been looked up and checked
+bool call_command(Server* server, Client* client, const Command* cmd, char** args, int argc) {
+    server->current_client = client;
+    bool ok = cmd->proc(server, client, args, argc);
+    server->current_client = NULL;
+    if (client->tracking.enabled && !client->tracking.bcast && (cmd->flags & CMD_READONLY)) {
+        tracking_remember_keys(server, client, cmd, args, client->argv_len, argc);
+    }
+    return ok;
 }
 
-void send_error(Client* client, const char* error) {
-    if (!client || !error) return;
-    dprintf(client->fd, "-%s\r\n", error);
+// Whole-argument integer, without the sign, space or leading zero that
+// strtol() would let through and with overflow reported
+bool parse_int64_arg(Client* client, char** args, int index, int64_t* value) {
+    if (stringToInt64(args[index], client->argv_len[index], value)) return true;
+    send_error(client, "ERR value is not an integer or out of range");
+    return false;
 }
 
-void send_integer(Client* client, int64_t value) {
-    if (!client) return;
-    dprintf(client->fd, ":%ld\r\n", value);
+bool parse_double_arg(Client* client, char** args, int index, double* value) {
+    if (parse_double(args[index], client->argv_len[index], value)) return true;
+    send_error(client, "ERR value is not a valid float");
+    return false;
 }
 
-void send_string(Client* client, const char* str) {
-    if (!client) return;
-    if (!str) {
-        send_null(client);
-        return;
-    }
-    dprintf(client->fd, "$%zu\r\n%s\r\n", strlen(str), str);
+// Inclusive start..end range over len elements, negative indices counting
+// from the end, clamped into [first, last]. Returns false if it is empty.
+bool clamp_range(int64_t start, int64_t end, size_t len, size_t* first, size_t* last) {
+    if (len == 0) return false;
+    if (start < 0) start = start < -(int64_t)len ? 0 : (int64_t)len + start;
+    if (end < 0) end += (int64_t)len;
+    if (end < 0 || start > end || (uint64_t)start >= len) return false;
+    
+    *first = (size_t)start;
+    *last = (uint64_t)end >= len ? len - 1 : (size_t)end;
+    return true;
 }
 
-void send_array(Client* client, size_t size) {
-    if (!client) return;
-    dprintf(client->fd, "*%zu\r\n", size);
+// Flush replies queued for a client other than the one running the
+// command, e.g. a subscriber
+void server_queue_reply(Server* server, Client* client) {
+    queue_pending_write(server, client);
 }
 
-void send_null(Client* client) {
-    if (!client) return;
-    dprintf(client->fd, "$-1\r\n");
-} 
\ No newline at end of file
+// Reply to a client that was blocked, now served or timed out, and let it
+// run the rest of its pipeline
+void server_unblocked_client(Server* server, Client* client) {
+    // A proxy running another shard's command sends the reply back there
+    if (client->shard_msg) {
+        shard_reply_blocked(server, client);
+        return;
+    }
+    
+    queue_pending_write(server, client);
+    if (client->close_queued) return;
+    if (!client->reply_paused) {
+        event_loop_add(server->loop, client->fd, EVENT_READABLE, read_handler, client);
+    }
+    queue_pending_read(server, client);
+}
@@ -3,38 +3,255 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdatomic.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 #include "../hashmap/hashmap.h"
 #include "../types/redis_types.h"
+#include "event_loop.h"
+#include "resp.h"
 
 #define MAX_CLIENTS 10000
 #define BUFFER_SIZE 4096
-#define MAX_ARGS 100
+#define QUERY_BUFFER_MAX (1024LL * 1024 * 1024)
+#define REPLY_CHUNK_SIZE (16 * 1024)
+#define REPLY_MAX_IOV 64
+#define REPLY_REF_MIN_BYTES (16 * 1024)  // Bulk values this big are sent by reference
+#define REPLY_PAUSE_BYTES (4 * 1024 * 1024)  // Backlog that stops a client's commands
+#define DEFAULT_HOST "0.0.0.0"
+#define DEFAULT_PORT 6379
+#define TRACKING_TABLE_MAX_KEYS 1000000  // Keys remembered for CLIENT TRACKING
+#define REPLY_CACHE_MAX_BYTES 1024  // String values whose GET reply may be cached
+#define REPLY_CACHE_MIN_READS 2     // GETs of a value before its reply is cached
+#define CLIENT_BUDGET_COMMANDS 1000  // Commands a client runs per loop iteration
+#define CLIENT_BUDGET_USEC 1000      // Time it may spend on them
+
+// How sockets are driven: readiness with epoll, or completions with io_uring
+typedef enum {
+    SERVER_BACKEND_EPOLL,
+    SERVER_BACKEND_IO_URING
+} ServerBackend;
+
+// Clients with their own output buffer limits
+typedef enum {
+    CLIENT_CLASS_NORMAL,
+    CLIENT_CLASS_PUBSUB,
+    CLIENT_CLASS_COUNT
+} ClientClass;
+
+// Output buffer limits for one client class; 0 disables a limit
+typedef struct {
+    size_t hard_bytes;      // Disconnect as soon as pending replies exceed this
+    size_t soft_bytes;      // Disconnect if exceeded for soft_seconds in a row
+    int soft_seconds;
+} ReplyLimit;
 
 // Server configuration
 typedef struct {
     char* host;
-    uint16_t port;
+    uint16_t port;          // 0 disables the TCP listener
+    const char* unix_socket;  // Also listen on this path if set; not copied
     int max_clients;
+    int io_threads;         // Threads doing socket I/O, including the main one
+    ServerBackend backend;
+    ReplyLimit reply_limits[CLIENT_CLASS_COUNT];
+    size_t tracking_table_max_keys;  // 0 for no limit
+    size_t reply_cache_max_bytes;    // 0 disables the GET reply cache
+    uint32_t reply_cache_min_reads;
+    size_t client_budget_commands;   // 0 for no limit
+    uint32_t client_budget_usec;     // 0 for no limit
     bool daemonize;
 } ServerConfig;
 
+// Overflow block of reply data, used once the fixed reply buffer is full.
+// Holds bytes copied into buf, or a reference to a large string value.
+typedef struct ReplyChunk {
+    struct ReplyChunk* next;
+    size_t size;
+    size_t used;
+    const char* data;       // buf, or the bytes of obj
+    RedisObject* obj;       // Referenced value, NULL for copied bytes
+    char buf[];
+} ReplyChunk;
+
+// Commands parsed ahead of execution; argv entries are query buffer slices
+typedef struct {
+    char** argv;
+    size_t* argv_len;
+    char** argv_owned;      // Big bulks held in their own allocation, else NULL
+    size_t argv_count;
+    size_t argv_capacity;
+    int* argc;              // Per command: argument count
+    size_t* argv_start;     // Per command: first entry in argv
+    size_t* frame_len;      // Per command: bytes of query buffer it spans
+    size_t count;
+    size_t capacity;
+    size_t next;            // Next command to execute
+} CommandQueue;
+
+// Outcome of reading, parsing or flushing a client, which may run on an
+// I/O thread; the main thread acts on it afterwards
+typedef enum {
+    CLIENT_IO_OK,
+    CLIENT_IO_CLOSED,       // Peer closed or socket error
+    CLIENT_IO_LIMIT,        // Query buffer limit exceeded
+    CLIENT_IO_PROTOCOL      // Malformed request, see parser.error
+} ClientIOStatus;
+
+// What a blocked client waits for
+typedef enum {
+    BLOCK_NONE,
+    BLOCK_LIST,             // BLPOP, BRPOP, BLMOVE
+    BLOCK_STREAM            // XREAD BLOCK
+} BlockType;
+
+// State of a client parked by a blocking command, see blocking.c
+typedef struct {
+    BlockType type;
+    int key_count;
+    char** keys;                    // Distinct keys waited on
+    size_t* key_lens;
+    struct BlockWaiter** waiters;   // Per key: the client's place in its queue
+    struct Timer* timer;            // Fires at the timeout, NULL to wait forever
+    bool pop_front;                 // List: pop from the head
+    char* target;                   // BLMOVE: destination list, else NULL
+    size_t target_len;
+    bool push_front;                // BLMOVE: push onto the destination's head
+    char** ids;                     // Stream: per key, the last ID already seen
+    long count;                     // Stream: entries per key, 0 for no limit
+} BlockState;
+
+// Channels or patterns a client is subscribed to, see pubsub.c
+typedef struct {
+    struct PubSubLink* links;
+    size_t count;
+    size_t capacity;
+} SubscriptionList;
+
+// CLIENT TRACKING settings, see tracking.c
+typedef struct {
+    bool enabled;
+    bool bcast;             // Invalidate by prefix instead of by the keys read
+    bool noloop;            // Not for keys the client modified itself
+    uint64_t redirect;      // ID of the client receiving the invalidations
+    char** prefixes;        // BCAST: registered prefixes, "" for every key
+    size_t prefix_count;
+} TrackingState;
+
+// A command queued by MULTI, holding its own copy of the arguments
+typedef struct {
+    const struct Command* cmd;
+    int argc;
+    char** argv;
+    size_t* argv_len;
+    char** argv_owned;      // Same strings as argv; a command may take them
+} QueuedCommand;
+
+// A key watched by WATCH and its hashmap_version() at the time
+typedef struct {
+    char* key;
+    size_t key_len;
+    uint64_t version;
+} WatchedKey;
+
+// MULTI/EXEC state, see multi.c
+typedef struct {
+    bool active;            // Between MULTI and EXEC or DISCARD
+    bool dirty;             // A command failed to queue, so EXEC aborts
+    bool executing;         // Running EXEC: blocking commands don't wait
+    QueuedCommand* commands;
+    int count;
+    int capacity;
+    WatchedKey* watched;
+    int watched_count;
+    int watched_capacity;
+} MultiState;
+
 // Client connection structure
 typedef struct {
+    uint64_t id;            // Unique for the process lifetime, never reused
+    size_t slot;            // Index in server->clients
     int fd;
     char* buffer;
     size_t buffer_size;
-    size_t buffer_pos;
+    size_t buffer_pos;      // Bytes read into buffer
+    size_t parse_offset;    // Bytes of buffer already parsed into commands
+    size_t query_offset;    // Bytes of buffer already executed
     bool authenticated;
+    bool pending_read;      // Queued in server->pending_reads
+    bool pending_write;     // Queued in server->pending_writes
+    bool forwarded;         // Waiting for another shard to run a command
+    bool close_deferred;    // Disconnected while forwarded; freed on reply
+    bool close_after_reply; // Disconnect once queued replies are flushed
+    bool close_queued;      // In server->clients_to_close, freed after this iteration
+    bool reply_paused;      // Commands held back until the reply backlog drains
+    BlockState block;       // Set while a blocking command waits
+    void* shard_msg;        // Blocked proxy: the forwarded command it answers
+    SubscriptionList channels;  // Pub/Sub subscriptions
+    SubscriptionList patterns;
+    TrackingState tracking; // Client-side caching
+    MultiState multi;       // Transaction being queued, and watched keys
+    ClientClass client_class;
+    ClientIOStatus io_status;
+    
+    // io_uring backend: requests in flight and the send being written
+    bool recv_armed;
+    bool send_armed;
+    bool closing;           // Requests cancelled; freed when the last completes
+    struct msghdr send_msg;
+    struct iovec* send_iov; // REPLY_MAX_IOV entries, allocated on first send
+    
+    // Protocol state and parsed commands
+    RespParser parser;
+    CommandQueue commands;
+    
+    // Command being executed
+    int argc;
+    char** argv;
+    size_t* argv_len;
+    char** argv_owned;      // See client_take_arg()
+    
+    // Pending replies: fixed buffer first, then overflow chunks
+    char* reply;
+    size_t reply_pos;
+    ReplyChunk* reply_head;
+    ReplyChunk* reply_tail;
+    size_t reply_bytes;     // Bytes held in overflow chunks
+    size_t sent_len;        // Bytes of the first pending block already written
+    size_t reply_limit;     // Hard output limit, 0 for none; see reply_overflow
+    bool reply_overflow;    // Replies dropped at reply_limit; must disconnect
+    int64_t soft_limit_since;  // Monotonic seconds since over the soft limit, or 0
 } Client;
 
 // Server structure
 typedef struct {
     ServerConfig config;
-    int server_fd;
+    int server_fd;            // TCP listener, -1 if none
+    int unix_fd;              // Unix socket listener, -1 if none
+    EventLoop* loop;
     Hashmap* db;
-    Client** clients;
+    Client** clients;         // Dense; a client's slot is moved, not shifted
     size_t client_count;
-    bool running;
+    Client** clients_by_id;   // Open addressing on the ID, see server_find_client()
+    size_t id_index_mask;
+    uint64_t next_client_id;
+    Client** clients_to_close;  // Closed this iteration, freed before sleeping
+    size_t close_count;
+    int64_t last_soft_check;  // Monotonic second of the last soft limit sweep
+    TimerQueue timers;        // Run by the event loop, or by uring_process
+    struct BlockingState* blocking;  // Keys with blocked clients
+    struct PubSub* pubsub;    // Channels and patterns with subscribers
+    struct Tracking* tracking;  // Keys and prefixes clients cache
+    Client* current_client;   // Running a command, NULL otherwise
+    Client** pending_reads;   // Clients with readable sockets
+    size_t pending_read_count;
+    Client** pending_writes;  // Clients with replies to flush before sleeping
+    size_t pending_write_count;
+    struct IOThreadPool* io_pool;
+    struct UringLoop* uring;  // Set when running on the io_uring backend
+    struct ShardGroup* shards;  // NULL unless running as one of several shards
+    int shard_id;
+    atomic_bool running;      // Cleared by server_stop() from any thread
 } Server;
 
 // Function declarations
@@ -43,24 +260,110 @@ void server_destroy(Server* server);
 bool server_start(Server* server);
 void server_stop(Server* server);
 bool server_is_running(const Server* server);
+void server_default_reply_limits(ReplyLimit limits[CLIENT_CLASS_COUNT]);
+void server_unblocked_client(Server* server, Client* client);
+void server_queue_reply(Server* server, Client* client);
+void server_register_client(Server* server, Client* client);
+void server_unregister_client(Server* server, Client* client);
+Client* server_find_client(const Server* server, uint64_t id);
+
+// Command dispatch, see command_table.c
+struct Command;
+bool handle_command(Server* server, Client* client, const char* command, char** args, int argc);
+bool call_command(Server* server, Client* client, const struct Command* cmd, char** args, int argc);
+
+// Numeric arguments; on failure the error has been sent
+bool parse_int64_arg(Client* client, char** args, int index, int64_t* value);
+bool parse_double_arg(Client* client, char** args, int index, double* value);
+bool clamp_range(int64_t start, int64_t end, size_t len, size_t* first, size_t* last);
+
+// Command handlers; argc has already been checked against the arity
+bool set_command(Server* server, Client* client, char** args, int argc);
+bool get_command(Server* server, Client* client, char** args, int argc);
+bool mget_command(Server* server, Client* client, char** args, int argc);
+bool mset_command(Server* server, Client* client, char** args, int argc);
+bool msetnx_command(Server* server, Client* client, char** args, int argc);
+bool del_command(Server* server, Client* client, char** args, int argc);
+bool unlink_command(Server* server, Client* client, char** args, int argc);
+bool exists_command(Server* server, Client* client, char** args, int argc);
+bool incr_command(Server* server, Client* client, char** args, int argc);
+bool decr_command(Server* server, Client* client, char** args, int argc);
+bool incrby_command(Server* server, Client* client, char** args, int argc);
+bool decrby_command(Server* server, Client* client, char** args, int argc);
+bool incrbyfloat_command(Server* server, Client* client, char** args, int argc);
+bool lpush_command(Server* server, Client* client, char** args, int argc);
+bool rpush_command(Server* server, Client* client, char** args, int argc);
+bool lrange_command(Server* server, Client* client, char** args, int argc);
+bool blpop_command(Server* server, Client* client, char** args, int argc);
+bool brpop_command(Server* server, Client* client, char** args, int argc);
+bool blmove_command(Server* server, Client* client, char** args, int argc);
+bool sadd_command(Server* server, Client* client, char** args, int argc);
+bool smembers_command(Server* server, Client* client, char** args, int argc);
+bool sismember_command(Server* server, Client* client, char** args, int argc);
+bool zadd_command(Server* server, Client* client, char** args, int argc);
+bool zrange_command(Server* server, Client* client, char** args, int argc);
+bool zscore_command(Server* server, Client* client, char** args, int argc);
+bool hset_command(Server* server, Client* client, char** args, int argc);
+bool hget_command(Server* server, Client* client, char** args, int argc);
+bool hgetall_command(Server* server, Client* client, char** args, int argc);
+bool setbit_command(Server* server, Client* client, char** args, int argc);
+bool getbit_command(Server* server, Client* client, char** args, int argc);
+bool bitcount_command(Server* server, Client* client, char** args, int argc);
+bool pfadd_command(Server* server, Client* client, char** args, int argc);
+bool pfcount_command(Server* server, Client* client, char** args, int argc);
+bool pfmerge_command(Server* server, Client* client, char** args, int argc);
+bool geoadd_command(Server* server, Client* client, char** args, int argc);
+bool geopos_command(Server* server, Client* client, char** args, int argc);
+bool geodist_command(Server* server, Client* client, char** args, int argc);
+bool xadd_command(Server* server, Client* client, char** args, int argc);
+bool xrange_command(Server* server, Client* client, char** args, int argc);
+bool xread_command(Server* server, Client* client, char** args, int argc);
+bool subscribe_command(Server* server, Client* client, char** args, int argc);
+bool unsubscribe_command(Server* server, Client* client, char** args, int argc);
+bool psubscribe_command(Server* server, Client* client, char** args, int argc);
+bool punsubscribe_command(Server* server, Client* client, char** args, int argc);
+bool publish_command(Server* server, Client* client, char** args, int argc);
+bool client_command(Server* server, Client* client, char** args, int argc);
+bool multi_command(Server* server, Client* client, char** args, int argc);
+bool exec_command(Server* server, Client* client, char** args, int argc);
+bool discard_command(Server* server, Client* client, char** args, int argc);
+bool watch_command(Server* server, Client* client, char** args, int argc);
+bool unwatch_command(Server* server, Client* client, char** args, int argc);
+
+// Client lifecycle and I/O stages
+Client* client_create(int fd);
+void client_free(Client* client);
+ClientIOStatus client_read_query(Client* client);
+ClientIOStatus client_append_query(Client* client, const char* data, size_t len);
+ClientIOStatus client_parse_query(Client* client);
+void client_reset_commands(Client* client);
+char* client_take_arg(Client* client, int index);
+void client_release_args(Client* client);
 
-// Command handlers
-bool handle_string_command(Server* server, Client* client, const char* command, char** args, int argc);
-bool handle_list_command(Server* server, Client* client, const char* command, char** args, int argc);
-bool handle_set_command(Server* server, Client* client, const char* command, char** args, int argc);
-bool handle_sorted_set_command(Server* server, Client* client, const char* command, char** args, int argc);
-bool handle_hash_command(Server* server, Client* client, const char* command, char** args, int argc);
-bool handle_bitmap_command(Server* server, Client* client, const char* command, char** args, int argc);
-bool handle_hyperloglog_command(Server* server, Client* client, const char* command, char** args, int argc);
-bool handle_geo_command(Server* server, Client* client, const char* command, char** args, int argc);
-bool handle_stream_command(Server* server, Client* client, const char* command, char** args, int argc);
+// Reply buffer
+bool client_init_reply(Client* client);
+void client_free_reply(Client* client);
+bool client_has_pending_reply(const Client* client);
+size_t client_reply_size(const Client* client);
+bool client_flush(Client* client);
+int client_reply_iov(const Client* client, struct iovec* iov, int max_iov, size_t* total);
+void client_reply_consume(Client* client, size_t written);
+char* client_take_reply(Client* client, size_t* len);
 
 // Response helpers
+void send_raw(Client* client, const char* data, size_t len);
 void send_ok(Client* client);
+void send_queued(Client* client);
 void send_error(Client* client, const char* error);
+void send_arity_error(Client* client, const char* name);
 void send_integer(Client* client, int64_t value);
 void send_string(Client* client, const char* str);
+void send_bulk(Client* client, const char* data, size_t len);
+void send_double(Client* client, double value);
+void send_bulk_object(Client* client, RedisObject* obj);
+void send_shared(Client* client, RedisObject* obj);
 void send_array(Client* client, size_t size);
 void send_null(Client* client);
+void send_null_array(Client* client);
 
 #endif // SERVER_H 
\ No newline at end of file
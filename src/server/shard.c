@@ -0,0 +1,339 @@
+#include "shard.h"
+#include "command_table.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+// FNV-1a over the key, or over its {tag} when it has a non-empty one so
+// related keys can be placed on the same shard on purpose
+static uint32_t shard_hash(const char* key, size_t len) {
+    const char* open = memchr(key, '{', len);
+    if (open) {
+        const char* close = memchr(open + 1, '}', key + len - open - 1);
+        if (close && close > open + 1) {
+            key = open + 1;
+            len = close - open - 1;
+        }
+    }
+    
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)key[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Shard owning every key of the command, SHARD_ANY if it has no keys or
+// SHARD_CROSS if they are spread over several shards
+int shard_route(int count, int argc, char** argv, const size_t* argv_len) {
+    if (count <= 1 || argc < 2) return SHARD_ANY;
+    
+    const Command* cmd = command_lookup(argv[0], argv_len[0]);
+    int first, last, step;
+    if (!cmd || !command_key_range(cmd, argc, argv, &first, &last, &step)) return SHARD_ANY;
+    
+    int owner = SHARD_ANY;
+    for (int i = first; i <= last && i < argc; i += step) {
+        int shard = shard_hash(argv[i], argv_len[i]) % count;
+        if (owner == SHARD_ANY) {
+            owner = shard;
+        } else if (shard != owner) {
+            return SHARD_CROSS;
+        }
+    }
+    return owner;
+}
+
+static void shard_wake(Shard* shard) {
+    uint64_t one = 1;
+    if (write(shard->wake_fd, &one, sizeof(one)) < 0) {
+        // EAGAIN means the counter is saturated, which still wakes it
+    }
+}
+
+static void wake_handler(EventLoop* loop, int fd, void* data, int mask) {
+    (void)loop;
+    (void)data;
+    (void)mask;
+    // Messages are picked up in before_sleep; only reset the counter
+    uint64_t value;
+    while (read(fd, &value, sizeof(value)) > 0);
+}
+
+ShardGroup* shard_group_create(Server** servers, int count) {
+    if (!servers || count < 1 || count > SHARDS_MAX) return NULL;
+    
+    ShardGroup* group = calloc(1, sizeof(ShardGroup));
+    if (!group) return NULL;
+    
+    group->count = count;
+    group->shards = calloc(count, sizeof(Shard));
+    group->queues = calloc((size_t)count * count, sizeof(SpscQueue*));
+    if (!group->shards || !group->queues) {
+        free(group->shards);
+        free(group->queues);
+        free(group);
+        return NULL;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        group->shards[i].wake_fd = -1;
+    }
+    
+    for (int i = 0; i < count; i++) {
+        Shard* shard = &group->shards[i];
+        shard->server = servers[i];
+        shard->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        shard->proxy = client_create(-1);
+        shard->backlog_head = calloc(count, sizeof(ShardMessage*));
+        shard->backlog_tail = calloc(count, sizeof(ShardMessage*));
+        shard->notify = calloc(count, sizeof(bool));
+        if (shard->wake_fd < 0 || !shard->proxy || !shard->backlog_head ||
+            !shard->backlog_tail || !shard->notify) {
+            perror("Failed to set up shard");
+            shard_group_destroy(group);
+            return NULL;
+        }
+        
+        for (int j = 0; j < count; j++) {
+            if (i == j) continue;
+            group->queues[i * count + j] = spsc_create(SHARD_QUEUE_SIZE);
+            if (!group->queues[i * count + j]) {
+                shard_group_destroy(group);
+                return NULL;
+            }
+        }
+        
+        servers[i]->shards = group;
+        servers[i]->shard_id = i;
+    }
+    
+    return group;
+}
+
+// Call once every shard thread has stopped
+void shard_group_destroy(ShardGroup* group) {
+    if (!group) return;
+    
+    for (int i = 0; i < group->count; i++) {
+        Shard* shard = &group->shards[i];
+        
+        for (int j = 0; j < group->count; j++) {
+            SpscQueue* queue = group->queues[i * group->count + j];
+            if (queue) {
+                ShardMessage* msg;
+                while ((msg = spsc_pop(queue)) != NULL) shard_message_free(msg);
+                spsc_destroy(queue);
+            }
+            
+            if (shard->backlog_head) {
+                ShardMessage* msg = shard->backlog_head[j];
+                while (msg) {
+                    ShardMessage* next = msg->next;
+                    shard_message_free(msg);
+                    msg = next;
+                }
+            }
+        }
+        
+        if (shard->wake_fd >= 0) close(shard->wake_fd);
+        client_free(shard->proxy);
+        free(shard->backlog_head);
+        free(shard->backlog_tail);
+        free(shard->notify);
+        
+        if (shard->server) {
+            shard->server->shards = NULL;
+            shard->server->shard_id = 0;
+        }
+    }
+    
+    free(group->queues);
+    free(group->shards);
+    free(group);
+}
+
+// Register the shard's wakeup fd with its event loop
+bool shard_attach(Server* server) {
+    Shard* shard = &server->shards->shards[server->shard_id];
+    return event_loop_add(server->loop, shard->wake_fd, EVENT_READABLE, wake_handler, shard);
+}
+
+// Queue a message for another shard. It never blocks: if the ring is
+// full the message waits in a local backlog until shard_flush().
+static void shard_send(Server* server, int target, ShardMessage* msg) {
+    ShardGroup* group = server->shards;
+    Shard* shard = &group->shards[server->shard_id];
+    SpscQueue* queue = group->queues[server->shard_id * group->count + target];
+    
+    msg->next = NULL;
+    if (!shard->backlog_head[target] && spsc_push(queue, msg)) {
+        shard->notify[target] = true;
+        return;
+    }
+    
+    if (shard->backlog_tail[target]) {
+        shard->backlog_tail[target]->next = msg;
+    } else {
+        shard->backlog_head[target] = msg;
+    }
+    shard->backlog_tail[target] = msg;
+}
+
+// Copy a command into a message of its own
+static ShardMessage* shard_message_create(Server* server, ShardMessageType type, int argc, char** argv,
+                                          const size_t* argv_len) {
+    size_t bytes = sizeof(ShardMessage) + argc * (sizeof(char*) + sizeof(size_t));
+    for (int i = 0; i < argc; i++) {
+        bytes += argv_len[i] + 1;
+    }
+    
+    ShardMessage* msg = malloc(bytes);
+    if (!msg) return NULL;
+    
+    msg->type = type;
+    msg->from = server->shard_id;
+    msg->client = NULL;
+    msg->argc = argc;
+    msg->argv = (char**)(msg + 1);
+    msg->argv_len = (size_t*)(msg->argv + argc);
+    msg->reply = NULL;
+    msg->reply_len = 0;
+    
+    char* p = (char*)(msg->argv_len + argc);
+    for (int i = 0; i < argc; i++) {
+        memcpy(p, argv[i], argv_len[i]);
+        p[argv_len[i]] = '\0';
+        msg->argv[i] = p;
+        msg->argv_len[i] = argv_len[i];
+        p += argv_len[i] + 1;
+    }
+    return msg;
+}
+
+// Send the client's current command to the shard that owns its keys.
+// The arguments are copied, so the query buffer may be reused meanwhile.
+bool shard_forward(Server* server, Client* client, int target) {
+    ShardMessage* msg = shard_message_create(server, SHARD_REQUEST, client->argc, client->argv, client->argv_len);
+    if (!msg) return false;
+    
+    msg->client = client;
+    shard_send(server, target, msg);
+    return true;
+}
+
+// Hand a PUBLISH to every other shard, whose subscribers it also reaches
+bool shard_publish(Server* server, int argc, char** argv, const size_t* argv_len) {
+    ShardGroup* group = server->shards;
+    for (int target = 0; target < group->count; target++) {
+        if (target == server->shard_id) continue;
+        
+        ShardMessage* msg = shard_message_create(server, SHARD_PUBLISH, argc, argv, argv_len);
+        if (!msg) return false;
+        shard_send(server, target, msg);
+    }
+    return true;
+}
+
+// Next message from any other shard, or NULL when all queues are empty.
+// Sources are visited round-robin so one busy shard can't starve others.
+ShardMessage* shard_receive(Server* server) {
+    ShardGroup* group = server->shards;
+    Shard* shard = &group->shards[server->shard_id];
+    
+    for (int n = 0; n < group->count; n++) {
+        int from = (shard->next_source + n) % group->count;
+        if (from == server->shard_id) continue;
+        
+        ShardMessage* msg = spsc_pop(group->queues[from * group->count + server->shard_id]);
+        if (msg) {
+            shard->next_source = (from + 1) % group->count;
+            return msg;
+        }
+    }
+    return NULL;
+}
+
+// Run a forwarded command against this shard's keyspace and send the
+// reply back to the shard the client is connected to
+void shard_execute(Server* server, ShardMessage* msg) {
+    // A command that may block gets a proxy of its own, which waits here
+    // with the message until shard_reply_blocked()
+    const Command* cmd = msg->argc > 0 ? command_lookup(msg->argv[0], msg->argv_len[0]) : NULL;
+    bool blocking = cmd && (cmd->flags & CMD_BLOCKING);
+    Client* proxy = blocking ? client_create(-1) : server->shards->shards[server->shard_id].proxy;
+    if (!proxy) {
+        msg->reply = NULL;
+        msg->type = SHARD_REPLY;
+        shard_send(server, msg->from, msg);
+        return;
+    }
+    
+    proxy->argc = msg->argc;
+    proxy->argv = msg->argv;
+    proxy->argv_len = msg->argv_len;
+    proxy->argv_owned = NULL;
+    if (msg->argc > 0) {
+        handle_command(server, proxy, msg->argv[0], msg->argv, msg->argc);
+    }
+    
+    if (proxy->block.type != BLOCK_NONE) {
+        proxy->shard_msg = msg;
+        return;
+    }
+    
+    // A NULL reply tells the origin the reply couldn't be captured
+    msg->reply = client_take_reply(proxy, &msg->reply_len);
+    msg->type = SHARD_REPLY;
+    shard_send(server, msg->from, msg);
+    if (blocking) client_free(proxy);
+}
+
+// Send the reply of a proxy that blocked once it has been served or has
+// timed out, and free the proxy
+void shard_reply_blocked(Server* server, Client* proxy) {
+    ShardMessage* msg = proxy->shard_msg;
+    msg->reply = client_take_reply(proxy, &msg->reply_len);
+    msg->type = SHARD_REPLY;
+    shard_send(server, msg->from, msg);
+    client_free(proxy);
+}
+
+// Move backlogged messages into their queues and wake every shard that
+// was sent something during this loop iteration
+void shard_flush(Server* server) {
+    ShardGroup* group = server->shards;
+    Shard* shard = &group->shards[server->shard_id];
+    
+    bool backlogged = false;
+    for (int target = 0; target < group->count; target++) {
+        SpscQueue* queue = group->queues[server->shard_id * group->count + target];
+        while (shard->backlog_head[target] && spsc_push(queue, shard->backlog_head[target])) {
+            shard->backlog_head[target] = shard->backlog_head[target]->next;
+            shard->notify[target] = true;
+        }
+        if (shard->backlog_head[target]) {
+            backlogged = true;
+        } else {
+            shard->backlog_tail[target] = NULL;
+        }
+        
+        if (shard->notify[target]) {
+            shard_wake(&group->shards[target]);
+            shard->notify[target] = false;
+        }
+    }
+    
+    // Retry on the next iteration instead of sleeping on a full queue
+    if (backlogged) shard_wake(shard);
+}
+
+void shard_message_free(ShardMessage* msg) {
+    if (!msg) return;
+    free(msg->reply);
+    free(msg);
+}
@@ -0,0 +1,66 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "server.h"
+#include "spsc.h"
+
+#define SHARDS_MAX 256
+#define SHARD_QUEUE_SIZE 4096
+
+// shard_route() results besides a shard index
+#define SHARD_ANY   -1   // No keys, run where the client is
+#define SHARD_CROSS -2   // Keys live on different shards
+
+typedef enum {
+    SHARD_REQUEST,   // Command to run on the shard owning its keys
+    SHARD_REPLY,     // Serialized reply on its way back
+    SHARD_PUBLISH    // PUBLISH for this shard's subscribers, no reply
+} ShardMessageType;
+
+// A forwarded command and, once executed, its reply. One allocation
+// holds the message, argv, argv_len and the argument bytes.
+typedef struct ShardMessage {
+    struct ShardMessage* next;   // Backlog link while the queue is full
+    ShardMessageType type;
+    int from;                    // Shard the client is connected to
+    Client* client;              // Only dereferenced by shard `from`; NULL for SHARD_PUBLISH
+    int argc;
+    char** argv;
+    size_t* argv_len;
+    char* reply;
+    size_t reply_len;
+} ShardMessage;
+
+// Per-shard state private to the shard's own thread
+typedef struct {
+    Server* server;
+    int wake_fd;                 // eventfd other shards poke after pushing
+    Client* proxy;               // Collects replies to forwarded commands
+    ShardMessage** backlog_head; // Per destination: messages the queue had no room for
+    ShardMessage** backlog_tail;
+    bool* notify;                // Per destination: wake it before sleeping
+    int next_source;             // Round-robin start for draining queues
+} Shard;
+
+typedef struct ShardGroup {
+    int count;
+    Shard* shards;
+    SpscQueue** queues;          // queues[from * count + to]
+} ShardGroup;
+
+// Function declarations
+ShardGroup* shard_group_create(Server** servers, int count);
+void shard_group_destroy(ShardGroup* group);
+bool shard_attach(Server* server);
+int shard_route(int count, int argc, char** argv, const size_t* argv_len);
+bool shard_forward(Server* server, Client* client, int target);
+bool shard_publish(Server* server, int argc, char** argv, const size_t* argv_len);
+ShardMessage* shard_receive(Server* server);
+void shard_execute(Server* server, ShardMessage* msg);
+void shard_reply_blocked(Server* server, Client* proxy);
+void shard_flush(Server* server);
+void shard_message_free(ShardMessage* msg);
+
+#endif // SHARD_H
@@ -0,0 +1,58 @@
+#include "spsc.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Capacity is rounded up to a power of two so slots can be masked
+SpscQueue* spsc_create(size_t capacity) {
+    if (capacity < 2) capacity = 2;
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+    
+    SpscQueue* queue = aligned_alloc(SPSC_CACHE_LINE, sizeof(SpscQueue));
+    if (!queue) return NULL;
+    
+    memset(queue, 0, sizeof(SpscQueue));
+    queue->slots = calloc(size, sizeof(void*));
+    if (!queue->slots) {
+        free(queue);
+        return NULL;
+    }
+    
+    queue->mask = size - 1;
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    return queue;
+}
+
+void spsc_destroy(SpscQueue* queue) {
+    if (!queue) return;
+    free(queue->slots);
+    free(queue);
+}
+
+// Producer side. Returns false when the queue is full.
+bool spsc_push(SpscQueue* queue, void* item) {
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+    if (tail - head > queue->mask) return false;
+    
+    queue->slots[tail & queue->mask] = item;
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+// Consumer side. Returns NULL when the queue is empty.
+void* spsc_pop(SpscQueue* queue) {
+    size_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+    if (head == tail) return NULL;
+    
+    void* item = queue->slots[head & queue->mask];
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+    return item;
+}
+
+bool spsc_empty(SpscQueue* queue) {
+    return atomic_load_explicit(&queue->head, memory_order_acquire) ==
+           atomic_load_explicit(&queue->tail, memory_order_acquire);
+}
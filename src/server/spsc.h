@@ -0,0 +1,27 @@
+#ifndef SPSC_H
+#define SPSC_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#define SPSC_CACHE_LINE 64
+
+// Bounded lock-free queue with exactly one producer and one consumer
+// thread. head and tail live on separate cache lines so the two sides
+// don't bounce a line between cores on every operation.
+typedef struct {
+    _Alignas(SPSC_CACHE_LINE) atomic_size_t head;   // Next slot to pop, written by the consumer
+    _Alignas(SPSC_CACHE_LINE) atomic_size_t tail;   // Next slot to push, written by the producer
+    _Alignas(SPSC_CACHE_LINE) size_t mask;
+    void** slots;
+} SpscQueue;
+
+// Function declarations
+SpscQueue* spsc_create(size_t capacity);
+void spsc_destroy(SpscQueue* queue);
+bool spsc_push(SpscQueue* queue, void* item);
+void* spsc_pop(SpscQueue* queue);
+bool spsc_empty(SpscQueue* queue);
+
+#endif // SPSC_H
@@ -0,0 +1,476 @@
+#include "tracking.h"
+#include "pubsub.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACKING_INITIAL_BUCKETS 16
+#define TRACKING_INITIAL_IDS 4
+#define TRACKING_CHANNEL "__redis__:invalidate"
+
+// A key read by clients in default mode, with the IDs of those clients.
+// IDs rather than pointers, so a client going away needs no cleanup here:
+// its ID just doesn't resolve once the key changes.
+typedef struct TrackedKey {
+    char* name;
+    size_t name_len;
+    uint64_t* ids;              // Open addressing set of ID + 1, 0 for a free slot
+    size_t id_count;
+    size_t id_capacity;         // Power of two
+    struct TrackedKey* next;    // Bucket chain
+    struct TrackedKey* older;   // Insertion order, the oldest is evicted first
+    struct TrackedKey* newer;
+} TrackedKey;
+
+// A BCAST prefix and the clients registered for it
+typedef struct {
+    char* prefix;
+    size_t len;
+    Client** clients;
+    size_t count;
+    size_t capacity;
+} TrackingPrefix;
+
+// Keys tracked for default mode clients, bounded by
+// config.tracking_table_max_keys, and the prefixes of BCAST clients.
+// An entry is dropped once its key has been invalidated: clients read
+// the key again to be told about the next change.
+typedef struct Tracking {
+    TrackedKey** buckets;
+    size_t bucket_count;        // Power of two
+    size_t key_count;
+    TrackedKey* oldest;
+    TrackedKey* newest;
+    TrackingPrefix* prefixes;
+    size_t prefix_count;
+    size_t prefix_capacity;
+} Tracking;
+
+// FNV-1a
+static size_t tracking_hash(const char* name, size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static size_t id_slot(uint64_t id, size_t mask) {
+    uint64_t hash = id * 0x9E3779B97F4A7C15ull;
+    return (size_t)(hash ^ (hash >> 32)) & mask;
+}
+
+Tracking* tracking_create(void) {
+    Tracking* tracking = calloc(1, sizeof(Tracking));
+    if (!tracking) return NULL;
+    
+    tracking->bucket_count = TRACKING_INITIAL_BUCKETS;
+    tracking->buckets = calloc(tracking->bucket_count, sizeof(TrackedKey*));
+    if (!tracking->buckets) {
+        free(tracking);
+        return NULL;
+    }
+    return tracking;
+}
+
+static void free_key(TrackedKey* key) {
+    free(key->name);
+    free(key->ids);
+    free(key);
+}
+
+// Unlink a key from its bucket and from the eviction order
+static void remove_key(Tracking* tracking, TrackedKey* key) {
+    TrackedKey** link = &tracking->buckets[tracking_hash(key->name, key->name_len) & (tracking->bucket_count - 1)];
+    while (*link != key) link = &(*link)->next;
+    *link = key->next;
+    
+    if (key->older) {
+        key->older->newer = key->newer;
+    } else {
+        tracking->oldest = key->newer;
+    }
+    if (key->newer) {
+        key->newer->older = key->older;
+    } else {
+        tracking->newest = key->older;
+    }
+    tracking->key_count--;
+}
+
+static void free_keys(Tracking* tracking) {
+    while (tracking->oldest) {
+        TrackedKey* key = tracking->oldest;
+        remove_key(tracking, key);
+        free_key(key);
+    }
+}
+
+// Drop every tracked key and prefix. Clients keep their settings.
+void tracking_destroy(Server* server) {
+    Tracking* tracking = server->tracking;
+    if (!tracking) return;
+    
+    free_keys(tracking);
+    for (size_t i = 0; i < tracking->prefix_count; i++) {
+        free(tracking->prefixes[i].prefix);
+        free(tracking->prefixes[i].clients);
+    }
+    free(tracking->prefixes);
+    free(tracking->buckets);
+    free(tracking);
+    server->tracking = NULL;
+}
+
+size_t tracking_key_count(const Server* server) {
+    return server->tracking ? server->tracking->key_count : 0;
+}
+
+// The pubsub message telling a client to drop key from its cache, or all
+// of it for a NULL key. The payload is an array of keys, unlike other
+// messages, so the frame is built here.
+static RedisObject* encode_invalidation(const char* key, size_t key_len) {
+    char* buf = malloc(96 + key_len);
+    if (!buf) return NULL;
+    
+    int len = sprintf(buf, "*3\r\n$7\r\nmessage\r\n$%zu\r\n%s\r\n", strlen(TRACKING_CHANNEL), TRACKING_CHANNEL);
+    if (key) {
+        len += sprintf(buf + len, "*1\r\n$%zu\r\n", key_len);
+        memcpy(buf + len, key, key_len);
+        memcpy(buf + len + key_len, "\r\n", 2);
+        len += (int)key_len + 2;
+    } else {
+        memcpy(buf + len, "$-1\r\n", 5);
+        len += 5;
+    }
+    
+    RedisString* str = createRedisStringOwned(buf, (size_t)len);
+    RedisObject* obj = str ? createRedisObject(REDIS_STRING, str) : NULL;
+    if (!obj) {
+        if (str) {
+            freeRedisString(str);
+        } else {
+            free(buf);
+        }
+        return NULL;
+    }
+    return obj;
+}
+
+// Queue an invalidation for client on its redirect connection. Under RESP2
+// that one must be subscribed, or the message would be taken as a reply.
+// The frame is encoded on first use and shared by every receiver.
+static void send_invalidation(Server* server, Client* client, const char* key, size_t key_len,
+                              RedisObject** frame) {
+    if (client->tracking.noloop && client == server->current_client) return;
+    
+    Client* target = server_find_client(server, client->tracking.redirect);
+    if (!target || target->close_queued || pubsub_subscription_count(target) == 0) return;
+    
+    if (!*frame) *frame = encode_invalidation(key, key_len);
+    if (!*frame) return;
+    send_shared(target, *frame);
+    server_queue_reply(server, target);
+}
+
+// Tell every reader of a tracked key it changed and forget the key
+static void invalidate_key(Server* server, TrackedKey* key, RedisObject** frame) {
+    Tracking* tracking = server->tracking;
+    remove_key(tracking, key);
+    
+    for (size_t i = 0; i < key->id_capacity; i++) {
+        if (!key->ids[i]) continue;
+        Client* client = server_find_client(server, key->ids[i] - 1);
+        if (client && client->tracking.enabled && !client->tracking.bcast) {
+            send_invalidation(server, client, key->name, key->name_len, frame);
+        }
+    }
+    free_key(key);
+}
+
+static TrackedKey* find_key(const Tracking* tracking, const char* name, size_t len) {
+    TrackedKey* key = tracking->buckets[tracking_hash(name, len) & (tracking->bucket_count - 1)];
+    while (key && (key->name_len != len || memcmp(key->name, name, len) != 0)) key = key->next;
+    return key;
+}
+
+// Double the buckets once there are more keys than buckets
+static void grow_buckets(Tracking* tracking) {
+    size_t count = tracking->bucket_count * 2;
+    TrackedKey** buckets = calloc(count, sizeof(TrackedKey*));
+    if (!buckets) return;
+    
+    for (size_t i = 0; i < tracking->bucket_count; i++) {
+        TrackedKey* key = tracking->buckets[i];
+        while (key) {
+            TrackedKey* next = key->next;
+            size_t index = tracking_hash(key->name, key->name_len) & (count - 1);
+            key->next = buckets[index];
+            buckets[index] = key;
+            key = next;
+        }
+    }
+    
+    free(tracking->buckets);
+    tracking->buckets = buckets;
+    tracking->bucket_count = count;
+}
+
+static TrackedKey* add_key(Tracking* tracking, const char* name, size_t len) {
+    TrackedKey* key = calloc(1, sizeof(TrackedKey));
+    if (!key) return NULL;
+    key->name = malloc(len + 1);
+    if (key->name) {
+        memcpy(key->name, name, len);
+        key->name[len] = '\0';
+        key->name_len = len;
+    }
+    key->id_capacity = TRACKING_INITIAL_IDS;
+    key->ids = calloc(key->id_capacity, sizeof(uint64_t));
+    if (!key->name || !key->ids) {
+        free_key(key);
+        return NULL;
+    }
+    
+    if (tracking->key_count >= tracking->bucket_count) grow_buckets(tracking);
+    size_t index = tracking_hash(name, len) & (tracking->bucket_count - 1);
+    key->next = tracking->buckets[index];
+    tracking->buckets[index] = key;
+    
+    key->older = tracking->newest;
+    if (tracking->newest) {
+        tracking->newest->newer = key;
+    } else {
+        tracking->oldest = key;
+    }
+    tracking->newest = key;
+    tracking->key_count++;
+    return key;
+}
+
+static void id_set_insert(uint64_t* slots, size_t mask, uint64_t stored) {
+    size_t i = id_slot(stored, mask);
+    while (slots[i] && slots[i] != stored) i = (i + 1) & mask;
+    slots[i] = stored;
+}
+
+// Add a reader to a key, growing the set at 3/4 full
+static bool add_reader(TrackedKey* key, uint64_t id) {
+    uint64_t stored = id + 1;
+    size_t mask = key->id_capacity - 1;
+    for (size_t i = id_slot(stored, mask); key->ids[i]; i = (i + 1) & mask) {
+        if (key->ids[i] == stored) return true;
+    }
+    
+    if ((key->id_count + 1) * 4 > key->id_capacity * 3) {
+        size_t capacity = key->id_capacity * 2;
+        uint64_t* ids = calloc(capacity, sizeof(uint64_t));
+        if (!ids) return false;
+        for (size_t i = 0; i < key->id_capacity; i++) {
+            if (key->ids[i]) id_set_insert(ids, capacity - 1, key->ids[i]);
+        }
+        free(key->ids);
+        key->ids = ids;
+        key->id_capacity = capacity;
+    }
+    
+    id_set_insert(key->ids, key->id_capacity - 1, stored);
+    key->id_count++;
+    return true;
+}
+
+// Remember the keys a default mode client just read. Past the table
+// limit the oldest keys are evicted, and as their readers could no longer
+// be told about changes, they are invalidated right away.
+void tracking_remember_keys(Server* server, Client* client, const Command* cmd, char** argv,
+                            const size_t* argv_len, int argc) {
+    Tracking* tracking = server->tracking;
+    int first, last, step;
+    if (!command_key_range(cmd, argc, argv, &first, &last, &step)) return;
+    
+    for (int i = first; i <= last; i += step) {
+        TrackedKey* key = find_key(tracking, argv[i], argv_len[i]);
+        if (!key) key = add_key(tracking, argv[i], argv_len[i]);
+        if (key) add_reader(key, client->id);
+    }
+    
+    size_t max_keys = server->config.tracking_table_max_keys;
+    while (max_keys && tracking->key_count > max_keys) {
+        RedisObject* frame = NULL;
+        invalidate_key(server, tracking->oldest, &frame);
+        if (frame) decrRefCount(frame);
+    }
+}
+
+// Tell every client with tracking on to drop its whole cache
+static void invalidate_all(Server* server) {
+    RedisObject* frame = NULL;
+    for (size_t i = 0; i < server->client_count; i++) {
+        Client* client = server->clients[i];
+        if (client->tracking.enabled) send_invalidation(server, client, NULL, 0, &frame);
+    }
+    if (frame) decrRefCount(frame);
+    free_keys(server->tracking);
+}
+
+// Hashmap hook: a key was set, changed or removed, NULL for all of them
+void tracking_key_modified(const char* name, size_t len, void* data) {
+    Server* server = data;
+    Tracking* tracking = server->tracking;
+    if (!tracking || (tracking->key_count == 0 && tracking->prefix_count == 0)) return;
+    if (!name) {
+        invalidate_all(server);
+        return;
+    }
+    
+    RedisObject* frame = NULL;
+    TrackedKey* key = tracking->key_count ? find_key(tracking, name, len) : NULL;
+    if (key) invalidate_key(server, key, &frame);
+    
+    // Prefixes are few, so they are simply scanned
+    for (size_t i = 0; i < tracking->prefix_count; i++) {
+        TrackingPrefix* prefix = &tracking->prefixes[i];
+        if (len < prefix->len || memcmp(name, prefix->prefix, prefix->len) != 0) continue;
+        for (size_t j = 0; j < prefix->count; j++) {
+            send_invalidation(server, prefix->clients[j], name, len, &frame);
+        }
+    }
+    if (frame) decrRefCount(frame);
+}
+
+static TrackingPrefix* find_prefix(const Tracking* tracking, const char* str) {
+    for (size_t i = 0; i < tracking->prefix_count; i++) {
+        if (strcmp(tracking->prefixes[i].prefix, str) == 0) return &tracking->prefixes[i];
+    }
+    return NULL;
+}
+
+static bool add_to_prefix(Tracking* tracking, const char* str, Client* client) {
+    TrackingPrefix* prefix = find_prefix(tracking, str);
+    if (!prefix) {
+        if (tracking->prefix_count == tracking->prefix_capacity) {
+            size_t capacity = tracking->prefix_capacity ? tracking->prefix_capacity * 2 : 4;
+            TrackingPrefix* prefixes = realloc(tracking->prefixes, capacity * sizeof(TrackingPrefix));
+            if (!prefixes) return false;
+            tracking->prefixes = prefixes;
+            tracking->prefix_capacity = capacity;
+        }
+        char* copy = strdup(str);
+        if (!copy) return false;
+        prefix = &tracking->prefixes[tracking->prefix_count++];
+        *prefix = (TrackingPrefix){.prefix = copy, .len = strlen(copy)};
+    }
+    
+    if (prefix->count == prefix->capacity) {
+        size_t capacity = prefix->capacity ? prefix->capacity * 2 : 4;
+        Client** clients = realloc(prefix->clients, capacity * sizeof(Client*));
+        if (!clients) return false;
+        prefix->clients = clients;
+        prefix->capacity = capacity;
+    }
+    prefix->clients[prefix->count++] = client;
+    return true;
+}
+
+// Drop a client from a prefix, and the prefix with its last client
+static void remove_from_prefix(Tracking* tracking, const char* str, Client* client) {
+    TrackingPrefix* prefix = find_prefix(tracking, str);
+    if (!prefix) return;
+    
+    for (size_t i = 0; i < prefix->count; i++) {
+        if (prefix->clients[i] == client) {
+            prefix->clients[i] = prefix->clients[--prefix->count];
+            break;
+        }
+    }
+    if (prefix->count > 0) return;
+    
+    free(prefix->prefix);
+    free(prefix->clients);
+    *prefix = tracking->prefixes[--tracking->prefix_count];
+}
+
+// A new prefix that is a prefix of one of the client's, or the other way
+// round, would get the client duplicate messages. Returns the first such
+// prefix and sets other to the one it overlaps, or returns NULL.
+const char* tracking_prefix_overlap(const Client* client, char** prefixes, int prefix_count,
+                                    const char** other) {
+    for (int i = 0; i < prefix_count; i++) {
+        size_t len = strlen(prefixes[i]);
+        for (size_t j = 0; j < client->tracking.prefix_count; j++) {
+            const char* existing = client->tracking.prefixes[j];
+            size_t existing_len = strlen(existing);
+            size_t common = len < existing_len ? len : existing_len;
+            if (len != existing_len && strncmp(prefixes[i], existing, common) == 0) {
+                *other = existing;
+                return prefixes[i];
+            }
+        }
+        for (int j = 0; j < i; j++) {
+            size_t other_len = strlen(prefixes[j]);
+            size_t common = len < other_len ? len : other_len;
+            if (len != other_len && strncmp(prefixes[i], prefixes[j], common) == 0) {
+                *other = prefixes[j];
+                return prefixes[i];
+            }
+        }
+    }
+    return NULL;
+}
+
+static bool client_has_prefix(const Client* client, const char* str) {
+    for (size_t i = 0; i < client->tracking.prefix_count; i++) {
+        if (strcmp(client->tracking.prefixes[i], str) == 0) return true;
+    }
+    return false;
+}
+
+// Register one BCAST prefix for the client, ignoring repeats
+static bool enable_prefix(Server* server, Client* client, const char* str) {
+    if (client_has_prefix(client, str)) return true;
+    
+    char** prefixes = realloc(client->tracking.prefixes, (client->tracking.prefix_count + 1) * sizeof(char*));
+    if (!prefixes) return false;
+    client->tracking.prefixes = prefixes;
+    char* copy = strdup(str);
+    if (!copy) return false;
+    if (!add_to_prefix(server->tracking, copy, client)) {
+        free(copy);
+        return false;
+    }
+    prefixes[client->tracking.prefix_count++] = copy;
+    return true;
+}
+
+// Turn tracking on, or update it if it already is in the same mode. A
+// BCAST client without prefixes is sent every key. Prefixes must have
+// been checked with tracking_prefix_overlap().
+bool tracking_enable(Server* server, Client* client, uint64_t redirect, bool bcast, bool noloop,
+                     char** prefixes, int prefix_count) {
+    client->tracking.enabled = true;
+    client->tracking.bcast = bcast;
+    client->tracking.noloop = noloop;
+    client->tracking.redirect = redirect;
+    if (!bcast) return true;
+    
+    if (prefix_count == 0 && client->tracking.prefix_count == 0) {
+        return enable_prefix(server, client, "");
+    }
+    for (int i = 0; i < prefix_count; i++) {
+        if (!enable_prefix(server, client, prefixes[i])) return false;
+    }
+    return true;
+}
+
+// Keys the client read stay in the table, see TrackedKey
+void tracking_disable(Server* server, Client* client) {
+    if (!client->tracking.enabled) return;
+    
+    for (size_t i = 0; i < client->tracking.prefix_count; i++) {
+        if (server->tracking) remove_from_prefix(server->tracking, client->tracking.prefixes[i], client);
+        free(client->tracking.prefixes[i]);
+    }
+    free(client->tracking.prefixes);
+    memset(&client->tracking, 0, sizeof(client->tracking));
+}
@@ -0,0 +1,23 @@
+#ifndef TRACKING_H
+#define TRACKING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "server.h"
+#include "command_table.h"
+
+// Function declarations
+struct Tracking* tracking_create(void);
+void tracking_destroy(Server* server);
+bool tracking_enable(Server* server, Client* client, uint64_t redirect, bool bcast, bool noloop,
+                     char** prefixes, int prefix_count);
+void tracking_disable(Server* server, Client* client);
+const char* tracking_prefix_overlap(const Client* client, char** prefixes, int prefix_count,
+                                    const char** other);
+void tracking_remember_keys(Server* server, Client* client, const Command* cmd, char** argv,
+                            const size_t* argv_len, int argc);
+void tracking_key_modified(const char* key, size_t key_len, void* data);
+size_t tracking_key_count(const Server* server);
+
+#endif // TRACKING_H
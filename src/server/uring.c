@@ -0,0 +1,362 @@
+#include "uring.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+// Talks to the kernel through the raw syscalls so the server doesn't
+// depend on liburing. Only one thread may use a ring.
+struct UringLoop {
+    int fd;
+    
+    // Submission ring
+    void* sq_ptr;
+    size_t sq_size;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_array;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned sq_local_tail;     // Prepared SQEs not yet visible to the kernel
+    struct io_uring_sqe* sqes;
+    size_t sqes_size;
+    
+    // Completion ring, shares the mapping with the SQ ring when possible
+    void* cq_ptr;
+    size_t cq_size;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe* cqes;
+    
+    // Provided receive buffers the kernel picks from for multishot recv
+    struct io_uring_buf_ring* buf_ring;
+    size_t buf_ring_size;
+    char* buffers;
+    unsigned short buf_tail;
+};
+
+static int sys_uring_setup(unsigned entries, struct io_uring_params* params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int sys_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                           unsigned flags, void* arg, size_t arg_size) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, arg_size);
+}
+
+static int sys_uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+// Ask for the cheapest task running mode the kernel supports
+static int uring_setup(unsigned entries, struct io_uring_params* params) {
+    static const unsigned modes[] = {
+        IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN,   // 6.1+
+        IORING_SETUP_COOP_TASKRUN,                                 // 5.19+
+        0,
+    };
+    
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        memset(params, 0, sizeof(*params));
+        params->flags = modes[i] | IORING_SETUP_CQSIZE;
+        params->cq_entries = entries * 4;
+        int fd = sys_uring_setup(entries, params);
+        if (fd >= 0 || errno != EINVAL) return fd;
+    }
+    return -1;
+}
+
+static bool uring_map_rings(UringLoop* ring, const struct io_uring_params* params) {
+    ring->sq_size = params->sq_off.array + params->sq_entries * sizeof(unsigned);
+    ring->cq_size = params->cq_off.cqes + params->cq_entries * sizeof(struct io_uring_cqe);
+    if (params->features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_size > ring->sq_size) ring->sq_size = ring->cq_size;
+        ring->cq_size = ring->sq_size;
+    }
+    
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) {
+        ring->sq_ptr = NULL;
+        return false;
+    }
+    
+    if (params->features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) {
+            ring->cq_ptr = NULL;
+            return false;
+        }
+    }
+    
+    ring->sqes_size = params->sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        return false;
+    }
+    
+    char* sq = ring->sq_ptr;
+    ring->sq_head = (unsigned*)(sq + params->sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + params->sq_off.tail);
+    ring->sq_array = (unsigned*)(sq + params->sq_off.array);
+    ring->sq_mask = *(unsigned*)(sq + params->sq_off.ring_mask);
+    ring->sq_entries = params->sq_entries;
+    ring->sq_local_tail = *ring->sq_tail;
+    
+    // SQEs are always used in ring order, so the index array is fixed
+    for (unsigned i = 0; i < ring->sq_entries; i++) {
+        ring->sq_array[i] = i;
+    }
+    
+    char* cq = ring->cq_ptr;
+    ring->cq_head = (unsigned*)(cq + params->cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + params->cq_off.tail);
+    ring->cq_mask = *(unsigned*)(cq + params->cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + params->cq_off.cqes);
+    return true;
+}
+
+static void uring_add_buffer(UringLoop* ring, unsigned short bid) {
+    // Only addr/len/bid are written: bufs[0].resv doubles as the tail
+    struct io_uring_buf* buf = &ring->buf_ring->bufs[ring->buf_tail & (URING_BUF_COUNT - 1)];
+    buf->addr = (uint64_t)(uintptr_t)(ring->buffers + (size_t)bid * URING_BUF_SIZE);
+    buf->len = URING_BUF_SIZE;
+    buf->bid = bid;
+    ring->buf_tail++;
+    __atomic_store_n(&ring->buf_ring->tail, ring->buf_tail, __ATOMIC_RELEASE);
+}
+
+static bool uring_setup_buffers(UringLoop* ring) {
+    ring->buf_ring_size = URING_BUF_COUNT * sizeof(struct io_uring_buf);
+    ring->buf_ring = mmap(NULL, ring->buf_ring_size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring->buf_ring == MAP_FAILED) {
+        ring->buf_ring = NULL;
+        return false;
+    }
+    
+    ring->buffers = aligned_alloc(4096, (size_t)URING_BUF_COUNT * URING_BUF_SIZE);
+    if (!ring->buffers) return false;
+    
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)ring->buf_ring;
+    reg.ring_entries = URING_BUF_COUNT;
+    reg.bgid = URING_BUF_GROUP;
+    if (sys_uring_register(ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) return false;
+    
+    for (unsigned i = 0; i < URING_BUF_COUNT; i++) {
+        uring_add_buffer(ring, (unsigned short)i);
+    }
+    return true;
+}
+
+// Make prepared SQEs visible to the kernel and return how many there are
+static unsigned uring_publish(UringLoop* ring) {
+    unsigned pending = ring->sq_local_tail - *ring->sq_tail;
+    if (pending) __atomic_store_n(ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE);
+    return pending;
+}
+
+static int uring_submit(UringLoop* ring) {
+    unsigned pending = uring_publish(ring);
+    if (!pending) return 0;
+    return sys_uring_enter(ring->fd, pending, 0, 0, NULL, 0);
+}
+
+// Next free SQE, submitting the queued ones first if the ring is full.
+// NULL only if the kernel refuses to take more work right now.
+static struct io_uring_sqe* uring_get_sqe(UringLoop* ring) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sq_local_tail - head >= ring->sq_entries) {
+        uring_submit(ring);
+        head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+        if (ring->sq_local_tail - head >= ring->sq_entries) return NULL;
+    }
+    
+    struct io_uring_sqe* sqe = &ring->sqes[ring->sq_local_tail & ring->sq_mask];
+    ring->sq_local_tail++;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+// Multishot receive landed in 6.0; check that it really works here rather
+// than trusting the version number, so the server can fall back to epoll
+static bool uring_probe(UringLoop* ring) {
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, pair) < 0) return false;
+    
+    bool works = false, done = false;
+    if (write(pair[1], "x", 1) == 1 && uring_recv_multishot(ring, pair[0], 1)) {
+        // Closing the peer ends the multishot receive with a final 0
+        for (int round = 0; round < 2 && !done; round++) {
+            if (round == 1) close(pair[1]);
+            if (uring_wait(ring, 1000) < 0) break;
+            
+            UringEvent event;
+            while (uring_next_event(ring, &event)) {
+                if (event.res == 1 && event.more && uring_event_buffer(ring, &event)) {
+                    works = true;
+                }
+                uring_recycle_buffer(ring, &event);
+                if (!event.more) done = true;
+            }
+        }
+    }
+    
+    if (!done) close(pair[1]);
+    close(pair[0]);
+    return works && done;
+}
+
+UringLoop* uring_create(unsigned entries) {
+    UringLoop* ring = calloc(1, sizeof(UringLoop));
+    if (!ring) return NULL;
+    
+    struct io_uring_params params;
+    ring->fd = uring_setup(entries, &params);
+    if (ring->fd < 0) {
+        free(ring);
+        return NULL;
+    }
+    
+    // EXT_ARG gives io_uring_enter a timeout without a timeout SQE
+    if (!(params.features & IORING_FEAT_EXT_ARG) ||
+        !uring_map_rings(ring, &params) ||
+        !uring_setup_buffers(ring) ||
+        !uring_probe(ring)) {
+        uring_destroy(ring);
+        return NULL;
+    }
+    
+    return ring;
+}
+
+void uring_destroy(UringLoop* ring) {
+    if (!ring) return;
+    
+    // Closing the ring fd tears down all in-flight requests
+    if (ring->fd >= 0) close(ring->fd);
+    if (ring->sqes) munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ptr && ring->cq_ptr != ring->sq_ptr) munmap(ring->cq_ptr, ring->cq_size);
+    if (ring->sq_ptr) munmap(ring->sq_ptr, ring->sq_size);
+    if (ring->buf_ring) munmap(ring->buf_ring, ring->buf_ring_size);
+    free(ring->buffers);
+    free(ring);
+}
+
+// One accept SQE keeps producing a CQE per incoming connection
+bool uring_accept_multishot(UringLoop* ring, int fd, uint64_t user_data) {
+    struct io_uring_sqe* sqe = uring_get_sqe(ring);
+    if (!sqe) return false;
+    
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC;
+    sqe->user_data = user_data;
+    return true;
+}
+
+// One recv SQE keeps producing a CQE per chunk read into a provided buffer
+bool uring_recv_multishot(UringLoop* ring, int fd, uint64_t user_data) {
+    struct io_uring_sqe* sqe = uring_get_sqe(ring);
+    if (!sqe) return false;
+    
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUF_GROUP;
+    sqe->user_data = user_data;
+    return true;
+}
+
+// msg and the iovecs it points to must stay valid until the completion
+bool uring_sendmsg(UringLoop* ring, int fd, const struct msghdr* msg, uint64_t user_data) {
+    struct io_uring_sqe* sqe = uring_get_sqe(ring);
+    if (!sqe) return false;
+    
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)msg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = user_data;
+    return true;
+}
+
+// Cancel every request still pending on fd
+bool uring_cancel_fd(UringLoop* ring, int fd, uint64_t user_data) {
+    struct io_uring_sqe* sqe = uring_get_sqe(ring);
+    if (!sqe) return false;
+    
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = fd;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+    sqe->user_data = user_data;
+    return true;
+}
+
+// Submit everything prepared so far and wait up to timeout_ms for at least
+// one completion. Returns the number submitted, or -1 on error.
+int uring_wait(UringLoop* ring, int timeout_ms) {
+    unsigned pending = uring_publish(ring);
+    unsigned ready = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE) - *ring->cq_head;
+    
+    struct __kernel_timespec ts;
+    ts.tv_sec = timeout_ms / 1000;
+    ts.tv_nsec = (long long)(timeout_ms % 1000) * 1000000;
+    
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.sigmask_sz = _NSIG / 8;
+    arg.ts = (uint64_t)(uintptr_t)&ts;
+    
+    int ret = sys_uring_enter(ring->fd, pending, ready ? 0 : 1,
+                              IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    if (ret < 0) {
+        // A timeout, a signal, or a full CQ that we are about to drain
+        if (errno == ETIME || errno == EINTR || errno == EBUSY) return 0;
+        perror("io_uring_enter");
+        return -1;
+    }
+    return ret;
+}
+
+bool uring_next_event(UringLoop* ring, UringEvent* event) {
+    unsigned head = *ring->cq_head;
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) return false;
+    
+    struct io_uring_cqe* cqe = &ring->cqes[head & ring->cq_mask];
+    event->user_data = cqe->user_data;
+    event->res = cqe->res;
+    event->flags = cqe->flags;
+    event->more = (cqe->flags & IORING_CQE_F_MORE) != 0;
+    __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+// Data of a receive completion, valid until the buffer is recycled
+const char* uring_event_buffer(UringLoop* ring, const UringEvent* event) {
+    if (!(event->flags & IORING_CQE_F_BUFFER)) return NULL;
+    unsigned bid = event->flags >> IORING_CQE_BUFFER_SHIFT;
+    return ring->buffers + (size_t)bid * URING_BUF_SIZE;
+}
+
+// Give a receive buffer back to the kernel
+void uring_recycle_buffer(UringLoop* ring, const UringEvent* event) {
+    if (!(event->flags & IORING_CQE_F_BUFFER)) return;
+    uring_add_buffer(ring, (unsigned short)(event->flags >> IORING_CQE_BUFFER_SHIFT));
+}
@@ -0,0 +1,35 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/socket.h>
+
+#define URING_ENTRIES   4096
+#define URING_BUF_COUNT 1024          // Provided receive buffers, power of two
+#define URING_BUF_SIZE  4096
+#define URING_BUF_GROUP 0
+
+typedef struct UringLoop UringLoop;
+
+// One completion taken off the CQ ring
+typedef struct {
+    uint64_t user_data;
+    int res;
+    unsigned flags;
+    bool more;              // A multishot request stays armed after this
+} UringEvent;
+
+// Function declarations
+UringLoop* uring_create(unsigned entries);
+void uring_destroy(UringLoop* ring);
+bool uring_accept_multishot(UringLoop* ring, int fd, uint64_t user_data);
+bool uring_recv_multishot(UringLoop* ring, int fd, uint64_t user_data);
+bool uring_sendmsg(UringLoop* ring, int fd, const struct msghdr* msg, uint64_t user_data);
+bool uring_cancel_fd(UringLoop* ring, int fd, uint64_t user_data);
+int uring_wait(UringLoop* ring, int timeout_ms);
+bool uring_next_event(UringLoop* ring, UringEvent* event);
+const char* uring_event_buffer(UringLoop* ring, const UringEvent* event);
+void uring_recycle_buffer(UringLoop* ring, const UringEvent* event);
+
+#endif // URING_H
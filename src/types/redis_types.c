@@ -9,17 +9,69 @@ RedisObject* createRedisObject(RedisType type, void* data) {
     if (!obj) return NULL;
     
     obj->type = type;
+    obj->encoding = REDIS_ENCODING_RAW;
     obj->data = data;
-    obj->next = NULL;
+    atomic_init(&obj->refcount, 1);
+    obj->version = 0;
     return obj;
 }
 
+// A string holding an integer, kept in the object itself
+RedisObject* createRedisIntegerObject(int64_t value) {
+    RedisObject* obj = createRedisObject(REDIS_STRING, NULL);
+    if (!obj) return NULL;
+    
+    obj->encoding = REDIS_ENCODING_INT;
+    obj->integer = value;
+    return obj;
+}
+
+// Object, string header and bytes in one allocation, so a short string
+// costs one malloc and its reads stay within a cache line or two. The
+// bytes must not change; a new value needs a new object.
+RedisObject* createRedisEmbeddedString(const char* value, size_t len) {
+    RedisObject* obj = malloc(sizeof(RedisObject) + sizeof(RedisString) + len + 1);
+    if (!obj) return NULL;
+    
+    RedisString* str = (RedisString*)(obj + 1);
+    str->value = (char*)(str + 1);
+    str->len = len;
+    str->reply = NULL;
+    str->reply_len = 0;
+    str->reads = 0;
+    memcpy(str->value, value, len);
+    str->value[len] = '\0';
+    
+    obj->type = REDIS_STRING;
+    obj->encoding = REDIS_ENCODING_EMBSTR;
+    obj->data = str;
+    atomic_init(&obj->refcount, 1);
+    obj->version = 0;
+    return obj;
+}
+
+void incrRefCount(RedisObject* obj) {
+    atomic_fetch_add_explicit(&obj->refcount, 1, memory_order_relaxed);
+}
+
+// Drop one reference; the last one frees the object
+void decrRefCount(RedisObject* obj) {
+    if (!obj) return;
+    if (atomic_fetch_sub_explicit(&obj->refcount, 1, memory_order_acq_rel) == 1) {
+        freeRedisObject(obj);
+    }
+}
+
 void freeRedisObject(RedisObject* obj) {
     if (!obj) return;
     
     switch (obj->type) {
         case REDIS_STRING:
-            freeRedisString(obj->data);
+            if (obj->encoding == REDIS_ENCODING_RAW) {
+                freeRedisString(obj->data);
+            } else if (obj->encoding == REDIS_ENCODING_EMBSTR) {
+                free(((RedisString*)obj->data)->reply);
+            }
             break;
         case REDIS_LIST:
             freeRedisList(obj->data);
@@ -50,28 +102,155 @@ void freeRedisObject(RedisObject* obj) {
     free(obj);
 }
 
+// Byte string implementation
+RedisBytes* createRedisBytes(const char* data, size_t len) {
+    RedisBytes* bytes = malloc(sizeof(RedisBytes) + len + 1);
+    if (!bytes) return NULL;
+    
+    bytes->len = len;
+    memcpy(bytes->data, data, len);
+    bytes->data[len] = '\0';
+    return bytes;
+}
+
+// Different lengths can't be equal, so most mismatches never reach memcmp
+bool redisBytesEqual(const RedisBytes* bytes, const char* data, size_t len) {
+    return bytes->len == len && memcmp(bytes->data, data, len) == 0;
+}
+
+// Byte order, a prefix first
+int redisBytesCompare(const RedisBytes* bytes, const char* data, size_t len) {
+    int cmp = memcmp(bytes->data, data, bytes->len < len ? bytes->len : len);
+    if (cmp != 0) return cmp;
+    return bytes->len < len ? -1 : bytes->len > len;
+}
+
 // String implementation
 RedisString* createRedisString(const char* value) {
+    return createRedisStringLen(value, strlen(value));
+}
+
+// Binary-safe variant: value may contain NUL bytes
+RedisString* createRedisStringLen(const char* value, size_t len) {
     RedisString* str = malloc(sizeof(RedisString));
     if (!str) return NULL;
     
-    str->len = strlen(value);
+    str->len = len;
+    str->reply = NULL;
+    str->reply_len = 0;
+    str->reads = 0;
     str->value = malloc(str->len + 1);
     if (!str->value) {
         free(str);
         return NULL;
     }
     
-    strcpy(str->value, value);
+    memcpy(str->value, value, len);
+    str->value[len] = '\0';
+    return str;
+}
+
+// Adopt value without copying; it must hold len bytes plus a NUL
+RedisString* createRedisStringOwned(char* value, size_t len) {
+    RedisString* str = malloc(sizeof(RedisString));
+    if (!str) return NULL;
+    
+    str->value = value;
+    str->len = len;
+    str->reply = NULL;
+    str->reply_len = 0;
+    str->reads = 0;
     return str;
 }
 
 void freeRedisString(RedisString* str) {
     if (!str) return;
     free(str->value);
+    free(str->reply);
     free(str);
 }
 
+// Build the bulk reply for the value once, so GET can send it as is
+bool redisStringCacheReply(RedisString* str) {
+    char header[32];
+    header[0] = '$';
+    size_t header_len = 1 + int64ToString(header + 1, (int64_t)str->len);
+    header[header_len++] = '\r';
+    header[header_len++] = '\n';
+    char* reply = malloc(header_len + str->len + 2);
+    if (!reply) return false;
+    
+    memcpy(reply, header, header_len);
+    memcpy(reply + header_len, str->value, str->len);
+    memcpy(reply + header_len + str->len, "\r\n", 2);
+    str->reply = reply;
+    str->reply_len = header_len + str->len + 2;
+    return true;
+}
+
+// Parse len bytes as an int64 written the way int64ToString() writes it:
+// no sign but '-', no leading zeros or spaces, and no overflow
+bool stringToInt64(const char* str, size_t len, int64_t* value) {
+    if (len == 0 || len > 20) return false;
+    
+    size_t i = 0;
+    bool negative = str[0] == '-';
+    if (negative && ++i == len) return false;
+    if (str[i] == '0') {
+        if (len != 1) return false;
+        *value = 0;
+        return true;
+    }
+    
+    uint64_t v = 0;
+    for (; i < len; i++) {
+        if (str[i] < '0' || str[i] > '9') return false;
+        unsigned digit = str[i] - '0';
+        if (v > (UINT64_MAX - digit) / 10) return false;
+        v = v * 10 + digit;
+    }
+    
+    if (negative) {
+        if (v > (uint64_t)INT64_MAX + 1) return false;
+        *value = v == (uint64_t)INT64_MAX + 1 ? INT64_MIN : -(int64_t)v;
+    } else {
+        if (v > INT64_MAX) return false;
+        *value = (int64_t)v;
+    }
+    return true;
+}
+
+// Write value in decimal with a NUL after it; buf needs 21 bytes. Two
+// digits per division instead of printf's one.
+size_t int64ToString(char* buf, int64_t value) {
+    static const char digits[] =
+        "0001020304050607080910111213141516171819202122232425262728293031323334353637383940414243444546474849"
+        "5051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+    char tmp[20];
+    char* p = tmp + sizeof(tmp);
+    uint64_t v = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+    
+    while (v >= 100) {
+        unsigned i = (v % 100) * 2;
+        v /= 100;
+        *--p = digits[i + 1];
+        *--p = digits[i];
+    }
+    if (v < 10) {
+        *--p = '0' + v;
+    } else {
+        *--p = digits[v * 2 + 1];
+        *--p = digits[v * 2];
+    }
+    
+    size_t len = 0;
+    if (value < 0) buf[len++] = '-';
+    memcpy(buf + len, p, tmp + sizeof(tmp) - p);
+    len += tmp + sizeof(tmp) - p;
+    buf[len] = '\0';
+    return len;
+}
+
 // List implementation
 RedisList* createRedisList(void) {
     RedisList* list = malloc(sizeof(RedisList));
@@ -97,11 +276,15 @@ void freeRedisList(RedisList* list) {
     free(list);
 }
 
-void listPush(RedisList* list, const char* value, bool head) {
+bool listPush(RedisList* list, const char* value, size_t len, bool head) {
     ListNode* node = malloc(sizeof(ListNode));
-    if (!node) return;
+    if (!node) return false;
     
-    node->value = strdup(value);
+    node->value = createRedisBytes(value, len);
+    if (!node->value) {
+        free(node);
+        return false;
+    }
     node->prev = NULL;
     node->next = NULL;
     
@@ -119,9 +302,10 @@ void listPush(RedisList* list, const char* value, bool head) {
     }
     
     list->len++;
+    return true;
 }
 
-char* listPop(RedisList* list, bool head) {
+RedisBytes* listPop(RedisList* list, bool head) {
     if (!list || list->len == 0) return NULL;
     
     ListNode* node;
@@ -134,21 +318,27 @@ char* listPop(RedisList* list, bool head) {
         list->tail = node->prev;
         if (list->tail) list->tail->next = NULL;
     }
+    // The last node was both ends
+    if (!list->head || !list->tail) {
+        list->head = NULL;
+        list->tail = NULL;
+    }
     
-    char* value = node->value;
+    RedisBytes* value = node->value;
     free(node);
     list->len--;
     return value;
 }
 
-char* listIndex(RedisList* list, int64_t index) {
+// The element at index, still owned by the list
+const RedisBytes* listIndex(RedisList* list, int64_t index) {
     if (!list || list->len == 0) return NULL;
     
     if (index < 0) index += list->len;
-    if (index < 0 || index >= list->len) return NULL;
+    if (index < 0 || (size_t)index >= list->len) return NULL;
     
     ListNode* current;
-    if (index < list->len / 2) {
+    if ((size_t)index < list->len / 2) {
         current = list->head;
         for (int64_t i = 0; i < index; i++) {
             current = current->next;
@@ -160,7 +350,7 @@ char* listIndex(RedisList* list, int64_t index) {
         }
     }
     
-    return strdup(current->value);
+    return current->value;
 }
 
 // Set implementation
@@ -170,7 +360,7 @@ RedisSet* createRedisSet(void) {
     
     set->size = 0;
     set->capacity = 16;
-    set->elements = malloc(set->capacity * sizeof(char*));
+    set->elements = malloc(set->capacity * sizeof(RedisBytes*));
     if (!set->elements) {
         free(set);
         return NULL;
@@ -189,39 +379,36 @@ void freeRedisSet(RedisSet* set) {
     free(set);
 }
 
-bool setAdd(RedisSet* set, const char* member) {
+bool setAdd(RedisSet* set, const char* member, size_t len) {
     if (!set || !member) return false;
     
     // Check if member already exists
-    for (size_t i = 0; i < set->size; i++) {
-        if (strcmp(set->elements[i], member) == 0) {
-            return false;
-        }
-    }
+    if (setIsMember(set, member, len)) return false;
     
     // Resize if needed
     if (set->size >= set->capacity) {
         size_t new_capacity = set->capacity * 2;
-        char** new_elements = realloc(set->elements, new_capacity * sizeof(char*));
+        RedisBytes** new_elements = realloc(set->elements, new_capacity * sizeof(RedisBytes*));
         if (!new_elements) return false;
         
         set->elements = new_elements;
         set->capacity = new_capacity;
     }
     
-    set->elements[set->size] = strdup(member);
+    set->elements[set->size] = createRedisBytes(member, len);
+    if (!set->elements[set->size]) return false;
     set->size++;
     return true;
 }
 
-bool setRemove(RedisSet* set, const char* member) {
+bool setRemove(RedisSet* set, const char* member, size_t len) {
     if (!set || !member) return false;
     
     for (size_t i = 0; i < set->size; i++) {
-        if (strcmp(set->elements[i], member) == 0) {
+        if (redisBytesEqual(set->elements[i], member, len)) {
             free(set->elements[i]);
             memmove(&set->elements[i], &set->elements[i + 1], 
-                   (set->size - i - 1) * sizeof(char*));
+                   (set->size - i - 1) * sizeof(RedisBytes*));
             set->size--;
             return true;
         }
@@ -230,11 +417,11 @@ bool setRemove(RedisSet* set, const char* member) {
     return false;
 }
 
-bool setIsMember(RedisSet* set, const char* member) {
+bool setIsMember(RedisSet* set, const char* member, size_t len) {
     if (!set || !member) return false;
     
     for (size_t i = 0; i < set->size; i++) {
-        if (strcmp(set->elements[i], member) == 0) {
+        if (redisBytesEqual(set->elements[i], member, len)) {
             return true;
         }
     }
@@ -291,9 +478,16 @@ void freeRedisSortedSet(RedisSortedSet* zset) {
     free(zset);
 }
 
-bool zsetAdd(RedisSortedSet* zset, const char* member, double score) {
+bool zsetAdd(RedisSortedSet* zset, const char* member, size_t len, double score) {
     if (!zset || !member) return false;
     
+    // A member whose score changes moves to its new place
+    double old_score;
+    if (zsetScore(zset, member, len, &old_score)) {
+        if (old_score == score) return true;
+        zsetRemove(zset, member, len);
+    }
+    
     SkipListNode* update[32] = {0};
     SkipListNode* current = zset->header;
     
@@ -302,19 +496,12 @@ bool zsetAdd(RedisSortedSet* zset, const char* member, double score) {
         while (current->forward[i] && 
                (current->forward[i]->score < score || 
                 (current->forward[i]->score == score && 
-                 strcmp(current->forward[i]->member, member) < 0))) {
+                 redisBytesCompare(current->forward[i]->member, member, len) < 0))) {
             current = current->forward[i];
         }
         update[i] = current;
     }
     
-    // Check if member already exists
-    if (current->forward[0] && 
-        strcmp(current->forward[0]->member, member) == 0) {
-        current->forward[0]->score = score;
-        return true;
-    }
-    
     // Create new node
     size_t level = randomLevel();
     if (level > zset->level) {
@@ -327,11 +514,12 @@ bool zsetAdd(RedisSortedSet* zset, const char* member, double score) {
     SkipListNode* node = malloc(sizeof(SkipListNode));
     if (!node) return false;
     
-    node->member = strdup(member);
+    node->member = createRedisBytes(member, len);
     node->score = score;
     node->level = level;
     node->forward = calloc(level, sizeof(SkipListNode*));
-    if (!node->forward) {
+    if (!node->member || !node->forward) {
+        free(node->forward);
         free(node->member);
         free(node);
         return false;
@@ -347,6 +535,53 @@ bool zsetAdd(RedisSortedSet* zset, const char* member, double score) {
     return true;
 }
 
+bool zsetRemove(RedisSortedSet* zset, const char* member, size_t len) {
+    double score;
+    if (!zsetScore(zset, member, len, &score)) return false;
+    
+    SkipListNode* update[32];
+    SkipListNode* current = zset->header;
+    for (int i = zset->level - 1; i >= 0; i--) {
+        while (current->forward[i] && 
+               (current->forward[i]->score < score || 
+                (current->forward[i]->score == score && 
+                 redisBytesCompare(current->forward[i]->member, member, len) < 0))) {
+            current = current->forward[i];
+        }
+        update[i] = current;
+    }
+    
+    // Unlink the node on every level it is on
+    SkipListNode* node = current->forward[0];
+    for (size_t i = 0; i < zset->level && update[i]->forward[i] == node; i++) {
+        update[i]->forward[i] = node->forward[i];
+    }
+    while (zset->level > 1 && !zset->header->forward[zset->level - 1]) {
+        zset->level--;
+    }
+    
+    free(node->member);
+    free(node->forward);
+    free(node);
+    zset->length--;
+    return true;
+}
+
+// Set *score to the score of member; false if it isn't in the set
+bool zsetScore(RedisSortedSet* zset, const char* member, size_t len, double* score) {
+    if (!zset || !member) return false;
+    
+    // Ordered by score, so a member alone can only be found on level 0
+    for (SkipListNode* node = zset->header->forward[0]; node; node = node->forward[0]) {
+        if (redisBytesEqual(node->member, member, len)) {
+            *score = node->score;
+            return true;
+        }
+    }
+    
+    return false;
+}
+
 // Hash implementation
 RedisHash* createRedisHash(void) {
     RedisHash* hash = malloc(sizeof(RedisHash));
@@ -354,8 +589,8 @@ RedisHash* createRedisHash(void) {
     
     hash->size = 0;
     hash->capacity = 16;
-    hash->fields = malloc(hash->capacity * sizeof(char*));
-    hash->values = malloc(hash->capacity * sizeof(char*));
+    hash->fields = malloc(hash->capacity * sizeof(RedisBytes*));
+    hash->values = malloc(hash->capacity * sizeof(RedisBytes*));
     
     if (!hash->fields || !hash->values) {
         free(hash->fields);
@@ -379,14 +614,17 @@ void freeRedisHash(RedisHash* hash) {
     free(hash);
 }
 
-bool hashSet(RedisHash* hash, const char* field, const char* value) {
+bool hashSet(RedisHash* hash, const char* field, size_t field_len, const char* value, size_t value_len) {
     if (!hash || !field || !value) return false;
     
+    RedisBytes* copy = createRedisBytes(value, value_len);
+    if (!copy) return false;
+    
     // Check if field exists
     for (size_t i = 0; i < hash->size; i++) {
-        if (strcmp(hash->fields[i], field) == 0) {
+        if (redisBytesEqual(hash->fields[i], field, field_len)) {
             free(hash->values[i]);
-            hash->values[i] = strdup(value);
+            hash->values[i] = copy;
             return true;
         }
     }
@@ -394,49 +632,53 @@ bool hashSet(RedisHash* hash, const char* field, const char* value) {
     // Resize if needed
     if (hash->size >= hash->capacity) {
         size_t new_capacity = hash->capacity * 2;
-        char** new_fields = realloc(hash->fields, new_capacity * sizeof(char*));
-        char** new_values = realloc(hash->values, new_capacity * sizeof(char*));
+        RedisBytes** new_fields = realloc(hash->fields, new_capacity * sizeof(RedisBytes*));
+        if (new_fields) hash->fields = new_fields;
+        RedisBytes** new_values = realloc(hash->values, new_capacity * sizeof(RedisBytes*));
+        if (new_values) hash->values = new_values;
         
         if (!new_fields || !new_values) {
-            free(new_fields);
-            free(new_values);
+            free(copy);
             return false;
         }
         
-        hash->fields = new_fields;
-        hash->values = new_values;
         hash->capacity = new_capacity;
     }
     
-    hash->fields[hash->size] = strdup(field);
-    hash->values[hash->size] = strdup(value);
+    hash->fields[hash->size] = createRedisBytes(field, field_len);
+    if (!hash->fields[hash->size]) {
+        free(copy);
+        return false;
+    }
+    hash->values[hash->size] = copy;
     hash->size++;
     return true;
 }
 
-char* hashGet(RedisHash* hash, const char* field) {
+// The value of field, still owned by the hash
+const RedisBytes* hashGet(RedisHash* hash, const char* field, size_t len) {
     if (!hash || !field) return NULL;
     
     for (size_t i = 0; i < hash->size; i++) {
-        if (strcmp(hash->fields[i], field) == 0) {
-            return strdup(hash->values[i]);
+        if (redisBytesEqual(hash->fields[i], field, len)) {
+            return hash->values[i];
         }
     }
     
     return NULL;
 }
 
-bool hashDelete(RedisHash* hash, const char* field) {
+bool hashDelete(RedisHash* hash, const char* field, size_t len) {
     if (!hash || !field) return false;
     
     for (size_t i = 0; i < hash->size; i++) {
-        if (strcmp(hash->fields[i], field) == 0) {
+        if (redisBytesEqual(hash->fields[i], field, len)) {
             free(hash->fields[i]);
             free(hash->values[i]);
             memmove(&hash->fields[i], &hash->fields[i + 1], 
-                   (hash->size - i - 1) * sizeof(char*));
+                   (hash->size - i - 1) * sizeof(RedisBytes*));
             memmove(&hash->values[i], &hash->values[i + 1], 
-                   (hash->size - i - 1) * sizeof(char*));
+                   (hash->size - i - 1) * sizeof(RedisBytes*));
             hash->size--;
             return true;
         }
@@ -555,8 +797,8 @@ static uint32_t murmurhash2(const char* key, size_t len) {
     }
     
     switch (len) {
-        case 3: h ^= data[2] << 16;
-        case 2: h ^= data[1] << 8;
+        case 3: h ^= data[2] << 16;  // fall through
+        case 2: h ^= data[1] << 8;   // fall through
         case 1: h ^= data[0];
                 h *= m;
     }
@@ -568,10 +810,11 @@ static uint32_t murmurhash2(const char* key, size_t len) {
     return h;
 }
 
-void hllAdd(RedisHyperLogLog* hll, const char* element) {
-    if (!hll || !element) return;
+// Returns true if a register went up, i.e. the estimate may have changed
+bool hllAdd(RedisHyperLogLog* hll, const char* element, size_t len) {
+    if (!hll || !element) return false;
     
-    uint32_t hash = murmurhash2(element, strlen(element));
+    uint32_t hash = murmurhash2(element, len);
     uint32_t index = hash & (hll->size - 1);
     uint32_t value = hash >> 14;
     
@@ -583,6 +826,17 @@ void hllAdd(RedisHyperLogLog* hll, const char* element) {
     
     if (count > hll->registers[index]) {
         hll->registers[index] = count;
+        return true;
+    }
+    return false;
+}
+
+// Union of both sets into dst: the larger of each pair of registers
+void hllMerge(RedisHyperLogLog* dst, const RedisHyperLogLog* src) {
+    if (!dst || !src) return;
+    
+    for (size_t i = 0; i < dst->size && i < src->size; i++) {
+        if (src->registers[i] > dst->registers[i]) dst->registers[i] = src->registers[i];
     }
 }
 
@@ -641,12 +895,12 @@ static double geohash(double longitude, double latitude) {
     return (longitude + 180) * 360 + (latitude + 90);
 }
 
-bool geoAdd(RedisGeo* geo, const char* member, double longitude, double latitude) {
+bool geoAdd(RedisGeo* geo, const char* member, size_t len, double longitude, double latitude) {
     if (!geo || !member) return false;
     
     // Check if member exists
     for (size_t i = 0; i < geo->size; i++) {
-        if (strcmp(geo->points[i].member, member) == 0) {
+        if (redisBytesEqual(geo->points[i].member, member, len)) {
             geo->points[i].longitude = longitude;
             geo->points[i].latitude = latitude;
             geo->points[i].score = geohash(longitude, latitude);
@@ -664,7 +918,8 @@ bool geoAdd(RedisGeo* geo, const char* member, double longitude, double latitude
         geo->capacity = new_capacity;
     }
     
-    geo->points[geo->size].member = strdup(member);
+    geo->points[geo->size].member = createRedisBytes(member, len);
+    if (!geo->points[geo->size].member) return false;
     geo->points[geo->size].longitude = longitude;
     geo->points[geo->size].latitude = latitude;
     geo->points[geo->size].score = geohash(longitude, latitude);
@@ -672,11 +927,11 @@ bool geoAdd(RedisGeo* geo, const char* member, double longitude, double latitude
     return true;
 }
 
-GeoPoint* geoGet(RedisGeo* geo, const char* member) {
+GeoPoint* geoGet(RedisGeo* geo, const char* member, size_t len) {
     if (!geo || !member) return NULL;
     
     for (size_t i = 0; i < geo->size; i++) {
-        if (strcmp(geo->points[i].member, member) == 0) {
+        if (redisBytesEqual(geo->points[i].member, member, len)) {
             return &geo->points[i];
         }
     }
@@ -695,11 +950,11 @@ static double haversine(double lat1, double lon1, double lat2, double lon2) {
     return R * c;
 }
 
-double* geoDistance(RedisGeo* geo, const char* member1, const char* member2) {
+double* geoDistance(RedisGeo* geo, const char* member1, size_t len1, const char* member2, size_t len2) {
     if (!geo || !member1 || !member2) return NULL;
     
-    GeoPoint* p1 = geoGet(geo, member1);
-    GeoPoint* p2 = geoGet(geo, member2);
+    GeoPoint* p1 = geoGet(geo, member1, len1);
+    GeoPoint* p2 = geoGet(geo, member2, len2);
     
     if (!p1 || !p2) return NULL;
     
@@ -742,8 +997,8 @@ void freeRedisStream(RedisStream* stream) {
     free(stream);
 }
 
-StreamEntry* streamAdd(RedisStream* stream, const char* id, 
-                      char** fields, char** values, size_t num_fields) {
+StreamEntry* streamAdd(RedisStream* stream, const char* id, char** fields, const size_t* field_lens,
+                       char** values, const size_t* value_lens, size_t num_fields) {
     if (!stream || !id || !fields || !values || num_fields == 0) return NULL;
     
     StreamEntry* entry = malloc(sizeof(StreamEntry));
@@ -751,8 +1006,8 @@ StreamEntry* streamAdd(RedisStream* stream, const char* id,
     
     entry->id = strdup(id);
     entry->num_fields = num_fields;
-    entry->fields = malloc(num_fields * sizeof(char*));
-    entry->values = malloc(num_fields * sizeof(char*));
+    entry->fields = calloc(num_fields, sizeof(RedisBytes*));
+    entry->values = calloc(num_fields, sizeof(RedisBytes*));
     
     if (!entry->fields || !entry->values) {
         free(entry->id);
@@ -763,8 +1018,19 @@ StreamEntry* streamAdd(RedisStream* stream, const char* id,
     }
     
     for (size_t i = 0; i < num_fields; i++) {
-        entry->fields[i] = strdup(fields[i]);
-        entry->values[i] = strdup(values[i]);
+        entry->fields[i] = createRedisBytes(fields[i], field_lens[i]);
+        entry->values[i] = createRedisBytes(values[i], value_lens[i]);
+        if (!entry->fields[i] || !entry->values[i]) {
+            for (size_t j = 0; j <= i; j++) {
+                free(entry->fields[j]);
+                free(entry->values[j]);
+            }
+            free(entry->id);
+            free(entry->fields);
+            free(entry->values);
+            free(entry);
+            return NULL;
+        }
     }
     
     entry->next = NULL;
@@ -1,8 +1,10 @@
 #ifndef REDIS_TYPES_H
 #define REDIS_TYPES_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 
 // Redis data type enumeration
 typedef enum {
@@ -17,22 +19,52 @@ typedef enum {
     REDIS_STREAM
 } RedisType;
 
-// Base structure for all Redis objects
+// How an object's value is held
+typedef enum {
+    REDIS_ENCODING_RAW,     // data points to the type's structure
+    REDIS_ENCODING_INT,     // A REDIS_STRING that is an int64, held in integer
+    REDIS_ENCODING_EMBSTR   // A REDIS_STRING allocated with its object
+} RedisEncoding;
+
+#define REDIS_EMBSTR_MAX_LEN 64  // Strings shorter than this may be embedded
+
+// Base structure for all Redis objects. The keyspace holds one reference;
+// pending replies may hold more, so a value can outlive its key. An
+// object with refcount above 1 is shared and must not be modified.
 typedef struct RedisObject {
     RedisType type;
-    void* data;
-    struct RedisObject* next;  // For chaining in hash map
+    RedisEncoding encoding;
+    union {
+        void* data;
+        int64_t integer;       // REDIS_ENCODING_INT
+    };
+    atomic_uint refcount;      // Dropped from I/O threads too, hence atomic
+    uint64_t version;          // Hash map version when its key last changed
 } RedisObject;
 
-// String type
+// Length-prefixed, binary-safe bytes, for keys and collection members.
+// Compared by length first, then memcmp. data is NUL-terminated as well,
+// for code that prints it.
+typedef struct {
+    size_t len;
+    char data[];
+} RedisBytes;
+
+// String type. reply caches the value framed as a RESP bulk string for
+// hot keys; it isn't part of the value, so a shared string may gain one.
+// A string is never changed in place, writes store a new object, so the
+// cached reply can't go stale.
 typedef struct {
     char* value;
     size_t len;
+    char* reply;        // "$<len>\r\n<value>\r\n", or NULL
+    size_t reply_len;
+    uint32_t reads;     // Counted until reply is built
 } RedisString;
 
 // List type (doubly linked list)
 typedef struct ListNode {
-    char* value;
+    RedisBytes* value;
     struct ListNode* prev;
     struct ListNode* next;
 } ListNode;
@@ -45,14 +77,14 @@ typedef struct {
 
 // Set type (hash set)
 typedef struct {
-    char** elements;
+    RedisBytes** elements;
     size_t size;
     size_t capacity;
 } RedisSet;
 
 // Sorted Set type (skiplist)
 typedef struct SkipListNode {
-    char* member;
+    RedisBytes* member;
     double score;
     struct SkipListNode** forward;
     size_t level;
@@ -66,8 +98,8 @@ typedef struct {
 
 // Hash type
 typedef struct {
-    char** fields;
-    char** values;
+    RedisBytes** fields;
+    RedisBytes** values;
     size_t size;
     size_t capacity;
 } RedisHash;
@@ -86,7 +118,7 @@ typedef struct {
 
 // Geo type (sorted set with geohash)
 typedef struct {
-    char* member;
+    RedisBytes* member;
     double longitude;
     double latitude;
     double score;  // Geohash score
@@ -101,8 +133,8 @@ typedef struct {
 // Stream type
 typedef struct StreamEntry {
     char* id;
-    char** fields;
-    char** values;
+    RedisBytes** fields;
+    RedisBytes** values;
     size_t num_fields;
     struct StreamEntry* next;
 } StreamEntry;
@@ -115,39 +147,53 @@ typedef struct {
 
 // Function declarations
 RedisObject* createRedisObject(RedisType type, void* data);
+RedisObject* createRedisIntegerObject(int64_t value);
+RedisObject* createRedisEmbeddedString(const char* value, size_t len);
 void freeRedisObject(RedisObject* obj);
+void incrRefCount(RedisObject* obj);
+void decrRefCount(RedisObject* obj);
+
+// Byte string operations; free with free()
+RedisBytes* createRedisBytes(const char* data, size_t len);
+bool redisBytesEqual(const RedisBytes* bytes, const char* data, size_t len);
+int redisBytesCompare(const RedisBytes* bytes, const char* data, size_t len);
 
 // String operations
 RedisString* createRedisString(const char* value);
+RedisString* createRedisStringLen(const char* value, size_t len);
+RedisString* createRedisStringOwned(char* value, size_t len);
 void freeRedisString(RedisString* str);
+bool redisStringCacheReply(RedisString* str);
+bool stringToInt64(const char* str, size_t len, int64_t* value);
+size_t int64ToString(char* buf, int64_t value);
 
 // List operations
 RedisList* createRedisList(void);
 void freeRedisList(RedisList* list);
-void listPush(RedisList* list, const char* value, bool head);
-char* listPop(RedisList* list, bool head);
-char* listIndex(RedisList* list, int64_t index);
+bool listPush(RedisList* list, const char* value, size_t len, bool head);
+RedisBytes* listPop(RedisList* list, bool head);
+const RedisBytes* listIndex(RedisList* list, int64_t index);
 
 // Set operations
 RedisSet* createRedisSet(void);
 void freeRedisSet(RedisSet* set);
-bool setAdd(RedisSet* set, const char* member);
-bool setRemove(RedisSet* set, const char* member);
-bool setIsMember(RedisSet* set, const char* member);
+bool setAdd(RedisSet* set, const char* member, size_t len);
+bool setRemove(RedisSet* set, const char* member, size_t len);
+bool setIsMember(RedisSet* set, const char* member, size_t len);
 
 // Sorted Set operations
 RedisSortedSet* createRedisSortedSet(void);
 void freeRedisSortedSet(RedisSortedSet* zset);
-bool zsetAdd(RedisSortedSet* zset, const char* member, double score);
-bool zsetRemove(RedisSortedSet* zset, const char* member);
-double zsetScore(RedisSortedSet* zset, const char* member);
+bool zsetAdd(RedisSortedSet* zset, const char* member, size_t len, double score);
+bool zsetRemove(RedisSortedSet* zset, const char* member, size_t len);
+bool zsetScore(RedisSortedSet* zset, const char* member, size_t len, double* score);
 
 // Hash operations
 RedisHash* createRedisHash(void);
 void freeRedisHash(RedisHash* hash);
-bool hashSet(RedisHash* hash, const char* field, const char* value);
-char* hashGet(RedisHash* hash, const char* field);
-bool hashDelete(RedisHash* hash, const char* field);
+bool hashSet(RedisHash* hash, const char* field, size_t field_len, const char* value, size_t value_len);
+const RedisBytes* hashGet(RedisHash* hash, const char* field, size_t len);
+bool hashDelete(RedisHash* hash, const char* field, size_t len);
 
 // Bitmap operations
 RedisBitmap* createRedisBitmap(void);
@@ -159,20 +205,22 @@ size_t bitmapCount(RedisBitmap* bitmap);
 // HyperLogLog operations
 RedisHyperLogLog* createRedisHyperLogLog(void);
 void freeRedisHyperLogLog(RedisHyperLogLog* hll);
-void hllAdd(RedisHyperLogLog* hll, const char* element);
+bool hllAdd(RedisHyperLogLog* hll, const char* element, size_t len);
+void hllMerge(RedisHyperLogLog* dst, const RedisHyperLogLog* src);
 uint64_t hllCount(RedisHyperLogLog* hll);
 
 // Geo operations
 RedisGeo* createRedisGeo(void);
 void freeRedisGeo(RedisGeo* geo);
-bool geoAdd(RedisGeo* geo, const char* member, double longitude, double latitude);
-GeoPoint* geoGet(RedisGeo* geo, const char* member);
-double* geoDistance(RedisGeo* geo, const char* member1, const char* member2);
+bool geoAdd(RedisGeo* geo, const char* member, size_t len, double longitude, double latitude);
+GeoPoint* geoGet(RedisGeo* geo, const char* member, size_t len);
+double* geoDistance(RedisGeo* geo, const char* member1, size_t len1, const char* member2, size_t len2);
 
 // Stream operations
 RedisStream* createRedisStream(void);
 void freeRedisStream(RedisStream* stream);
-StreamEntry* streamAdd(RedisStream* stream, const char* id, char** fields, char** values, size_t num_fields);
+StreamEntry* streamAdd(RedisStream* stream, const char* id, char** fields, const size_t* field_lens,
+                       char** values, const size_t* value_lens, size_t num_fields);
 StreamEntry* streamGet(RedisStream* stream, const char* id);
 void streamDelete(RedisStream* stream, const char* id);
 
@@ -0,0 +1,216 @@
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <CUnit/Automated.h>
+#include <CUnit/Console.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../src/server/server.h"
+
+// Test fixtures
+static Server* server;
+static Client* alice;
+static Client* bob;
+static Client* carol;
+
+// Setup and teardown functions
+static int setup(void) {
+    server = server_create(DEFAULT_HOST, 0, 64);
+    alice = client_create(-1);
+    bob = client_create(-1);
+    carol = client_create(-1);
+    return server && alice && bob && carol ? 0 : -1;
+}
+
+static int teardown(void) {
+    client_free(alice);
+    client_free(bob);
+    client_free(carol);
+    server_destroy(server);
+    return 0;
+}
+
+static void assert_reply_bytes(Client* client, const char* expected, size_t expected_len) {
+    size_t len;
+    char* reply = client_take_reply(client, &len);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(reply);
+    CU_ASSERT_EQUAL(len, expected_len);
+    CU_ASSERT_TRUE(len == expected_len && memcmp(reply, expected, len) == 0);
+    free(reply);
+}
+
+#define assert_reply(client, expected) assert_reply_bytes(client, expected, sizeof(expected) - 1)
+
+// Run a command as if parsed from the client's query buffer
+static bool run_bytes(Client* client, char** args, size_t* argv_len, int argc) {
+    char* argv_owned[16] = {0};
+    client->argc = argc;
+    client->argv = args;
+    client->argv_len = argv_len;
+    client->argv_owned = argv_owned;
+    
+    bool ok = handle_command(server, client, args[0], args, argc);
+    client->argv = NULL;
+    client->argv_len = NULL;
+    client->argv_owned = NULL;
+    return ok;
+}
+
+static bool run(Client* client, char** args, int argc) {
+    size_t argv_len[16];
+    for (int i = 0; i < argc; i++) argv_len[i] = strlen(args[i]);
+    return run_bytes(client, args, argv_len, argc);
+}
+
+#define RUN(client, ...) run(client, (char*[]){__VA_ARGS__}, sizeof((char*[]){__VA_ARGS__}) / sizeof(char*))
+
+// Test cases
+static void test_blpop_served(void) {
+    // Nothing to pop yet, so alice waits on both keys
+    CU_ASSERT_TRUE(RUN(alice, "BLPOP", "l1", "l2", "0"));
+    CU_ASSERT_EQUAL(alice->block.type, BLOCK_LIST);
+    CU_ASSERT_FALSE(client_has_pending_reply(alice));
+    
+    // Bob's reply comes first, then alice gets the element
+    CU_ASSERT_TRUE(RUN(bob, "RPUSH", "l2", "a", "b"));
+    assert_reply(bob, ":2\r\n");
+    assert_reply(alice, "*2\r\n$2\r\nl2\r\n$1\r\na\r\n");
+    CU_ASSERT_EQUAL(alice->block.type, BLOCK_NONE);
+    
+    // Served first come first served, and only one per element
+    CU_ASSERT_TRUE(RUN(alice, "BRPOP", "l3", "0"));
+    CU_ASSERT_TRUE(RUN(bob, "BRPOP", "l3", "0"));
+    CU_ASSERT_TRUE(RUN(carol, "RPUSH", "l3", "x"));
+    assert_reply(carol, ":1\r\n");
+    assert_reply(alice, "*2\r\n$2\r\nl3\r\n$1\r\nx\r\n");
+    CU_ASSERT_EQUAL(bob->block.type, BLOCK_LIST);
+    CU_ASSERT_FALSE(client_has_pending_reply(bob));
+    CU_ASSERT_PTR_NULL(hashmap_get(server->db, "l3", 2));
+    
+    CU_ASSERT_TRUE(RUN(carol, "RPUSH", "l3", "y"));
+    assert_reply(carol, ":1\r\n");
+    assert_reply(bob, "*2\r\n$2\r\nl3\r\n$1\r\ny\r\n");
+}
+
+static void test_binary_key_served(void) {
+    // Keys differing only after a NUL byte are waited on separately
+    char* wait[] = {"BLPOP", "k\0a", "0"};
+    size_t wait_len[] = {5, 3, 1};
+    CU_ASSERT_TRUE(run_bytes(alice, wait, wait_len, 3));
+    
+    char* other[] = {"RPUSH", "k\0b", "v"};
+    size_t other_len[] = {5, 3, 1};
+    CU_ASSERT_TRUE(run_bytes(bob, other, other_len, 3));
+    assert_reply(bob, ":1\r\n");
+    CU_ASSERT_FALSE(client_has_pending_reply(alice));
+    
+    char* push[] = {"RPUSH", "k\0a", "v"};
+    size_t push_len[] = {5, 3, 1};
+    CU_ASSERT_TRUE(run_bytes(bob, push, push_len, 3));
+    assert_reply(bob, ":1\r\n");
+    assert_reply(alice, "*2\r\n$3\r\nk\0a\r\n$1\r\nv\r\n");
+}
+
+static void test_timeout(void) {
+    CU_ASSERT_TRUE(RUN(alice, "BLPOP", "empty", "0.01"));
+    CU_ASSERT_TRUE(RUN(bob, "BLMOVE", "empty", "dst", "LEFT", "LEFT", "0.01"));
+    CU_ASSERT_EQUAL(timers_run(&server->timers), 0);
+    CU_ASSERT_FALSE(client_has_pending_reply(alice));
+    
+    usleep(20000);
+    CU_ASSERT_EQUAL(timers_run(&server->timers), 2);
+    assert_reply(alice, "*-1\r\n");
+    assert_reply(bob, "$-1\r\n");
+    CU_ASSERT_EQUAL(alice->block.type, BLOCK_NONE);
+    CU_ASSERT_EQUAL(bob->block.type, BLOCK_NONE);
+    
+    // Nobody waits any more, so a push stays in the list
+    CU_ASSERT_TRUE(RUN(bob, "RPUSH", "empty", "v"));
+    CU_ASSERT_TRUE(RUN(bob, "LRANGE", "empty", "0", "-1"));
+    assert_reply(bob, ":1\r\n*1\r\n$1\r\nv\r\n");
+}
+
+static void test_blmove(void) {
+    CU_ASSERT_TRUE(RUN(alice, "BLMOVE", "src", "dst", "RIGHT", "LEFT", "0"));
+    CU_ASSERT_TRUE(RUN(bob, "RPUSH", "src", "a", "b"));
+    assert_reply(bob, ":2\r\n");
+    assert_reply(alice, "$1\r\nb\r\n");
+    CU_ASSERT_TRUE(RUN(bob, "LRANGE", "dst", "0", "-1"));
+    assert_reply(bob, "*1\r\n$1\r\nb\r\n");
+    
+    // The destination stopped being a list while alice waited
+    CU_ASSERT_TRUE(RUN(alice, "BLMOVE", "src2", "dst2", "LEFT", "LEFT", "0"));
+    CU_ASSERT_TRUE(RUN(bob, "SET", "dst2", "string"));
+    CU_ASSERT_TRUE(RUN(bob, "RPUSH", "src2", "x"));
+    assert_reply(bob, "+OK\r\n:1\r\n");
+    assert_reply(alice, "-WRONGTYPE Operation against a key holding the wrong kind of value\r\n");
+    CU_ASSERT_EQUAL(alice->block.type, BLOCK_NONE);
+    
+    // Nothing was popped
+    CU_ASSERT_TRUE(RUN(bob, "LRANGE", "src2", "0", "-1"));
+    assert_reply(bob, "*1\r\n$1\r\nx\r\n");
+}
+
+static void test_blmove_chain(void) {
+    // Each client moves from its key to the next one's, so one push
+    // readies more keys than the ready list first has room for
+    enum { CHAIN = 20 };
+    Client* clients[CHAIN];
+    char keys[CHAIN + 1][8];
+    for (int i = 0; i <= CHAIN; i++) snprintf(keys[i], sizeof(keys[i]), "chain%d", i);
+    for (int i = 0; i < CHAIN; i++) {
+        clients[i] = client_create(-1);
+        CU_ASSERT_PTR_NOT_NULL_FATAL(clients[i]);
+        CU_ASSERT_TRUE(RUN(clients[i], "BLMOVE", keys[i], keys[i + 1], "LEFT", "RIGHT", "0"));
+    }
+    
+    CU_ASSERT_TRUE(RUN(bob, "RPUSH", keys[0], "v"));
+    assert_reply(bob, ":1\r\n");
+    for (int i = 0; i < CHAIN; i++) {
+        assert_reply(clients[i], "$1\r\nv\r\n");
+        CU_ASSERT_EQUAL(clients[i]->block.type, BLOCK_NONE);
+    }
+    CU_ASSERT_TRUE(RUN(bob, "LRANGE", keys[CHAIN], "0", "-1"));
+    assert_reply(bob, "*1\r\n$1\r\nv\r\n");
+    CU_ASSERT_PTR_NULL(hashmap_get(server->db, keys[0], strlen(keys[0])));
+    
+    for (int i = 0; i < CHAIN; i++) client_free(clients[i]);
+}
+
+static void test_xread_block(void) {
+    CU_ASSERT_TRUE(RUN(bob, "XADD", "s", "1-1", "f", "v"));
+    assert_reply(bob, "$3\r\n1-1\r\n");
+    CU_ASSERT_FALSE(RUN(bob, "XADD", "s", "1-1", "f", "v"));
+    assert_reply(bob, "-ERR The ID specified in XADD is equal or smaller than the target stream top item\r\n");
+    
+    // "$" only reads what is added from now on
+    CU_ASSERT_TRUE(RUN(alice, "XREAD", "BLOCK", "0", "STREAMS", "s", "$"));
+    CU_ASSERT_EQUAL(alice->block.type, BLOCK_STREAM);
+    CU_ASSERT_TRUE(RUN(bob, "XADD", "s", "2-0", "k", "x"));
+    assert_reply(bob, "$3\r\n2-0\r\n");
+    assert_reply(alice, "*1\r\n*2\r\n$1\r\ns\r\n*1\r\n*2\r\n$3\r\n2-0\r\n*2\r\n$1\r\nk\r\n$1\r\nx\r\n");
+    
+    CU_ASSERT_TRUE(RUN(alice, "XRANGE", "s", "-", "1"));
+    assert_reply(alice, "*1\r\n*2\r\n$3\r\n1-1\r\n*2\r\n$1\r\nf\r\n$1\r\nv\r\n");
+    CU_ASSERT_TRUE(RUN(alice, "XREAD", "COUNT", "1", "STREAMS", "s", "0"));
+    assert_reply(alice, "*1\r\n*2\r\n$1\r\ns\r\n*1\r\n*2\r\n$3\r\n1-1\r\n*2\r\n$1\r\nf\r\n$1\r\nv\r\n");
+}
+
+// Test suite initialization
+int init_blocking_suite(void) {
+    CU_pSuite suite = CU_add_suite("Blocking Commands Tests", setup, teardown);
+    if (!suite) return CU_get_error();
+    
+    // Add test cases
+    if (!CU_add_test(suite, "test_blpop_served", test_blpop_served) ||
+        !CU_add_test(suite, "test_binary_key_served", test_binary_key_served) ||
+        !CU_add_test(suite, "test_timeout", test_timeout) ||
+        !CU_add_test(suite, "test_blmove", test_blmove) ||
+        !CU_add_test(suite, "test_blmove_chain", test_blmove_chain) ||
+        !CU_add_test(suite, "test_xread_block", test_xread_block)) {
+        return CU_get_error();
+    }
+    
+    return CUE_SUCCESS;
+}
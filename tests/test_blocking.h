@@ -0,0 +1,9 @@
+#ifndef TEST_BLOCKING_H
+#define TEST_BLOCKING_H
+
+#include <CUnit/CUnit.h>
+
+// Test suite initialization
+int init_blocking_suite(void);
+
+#endif // TEST_BLOCKING_H 
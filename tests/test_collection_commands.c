@@ -0,0 +1,145 @@
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <CUnit/Automated.h>
+#include <CUnit/Console.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/server/server.h"
+
+// Test fixtures
+static Server* server;
+static Client* client;
+
+// Setup and teardown functions
+static int setup(void) {
+    server = server_create(DEFAULT_HOST, 0, 16);
+    client = client_create(-1);
+    return server && client ? 0 : -1;
+}
+
+static int teardown(void) {
+    client_free(client);
+    server_destroy(server);
+    return 0;
+}
+
+static void assert_reply_bytes(const char* expected, size_t expected_len) {
+    size_t len;
+    char* reply = client_take_reply(client, &len);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(reply);
+    CU_ASSERT_EQUAL(len, expected_len);
+    CU_ASSERT_TRUE(len == expected_len && memcmp(reply, expected, len) == 0);
+    free(reply);
+}
+
+#define assert_reply(expected) assert_reply_bytes(expected, sizeof(expected) - 1)
+
+// Run a command as if parsed from the client's query buffer
+static bool run(char** args, int argc) {
+    size_t argv_len[16];
+    char* argv_owned[16] = {0};
+    for (int i = 0; i < argc; i++) argv_len[i] = strlen(args[i]);
+    client->argc = argc;
+    client->argv = args;
+    client->argv_len = argv_len;
+    client->argv_owned = argv_owned;
+    
+    bool ok = handle_command(server, client, args[0], args, argc);
+    client->argv = NULL;
+    client->argv_len = NULL;
+    client->argv_owned = NULL;
+    return ok;
+}
+
+#define RUN(...) run((char*[]){__VA_ARGS__}, sizeof((char*[]){__VA_ARGS__}) / sizeof(char*))
+
+// Test cases
+static void test_lrange_clamp(void) {
+    CU_ASSERT_TRUE(RUN("RPUSH", "l", "a", "b", "c"));
+    assert_reply(":3\r\n");
+    
+    CU_ASSERT_TRUE(RUN("LRANGE", "l", "-100", "100"));
+    assert_reply("*3\r\n$1\r\na\r\n$1\r\nb\r\n$1\r\nc\r\n");
+    CU_ASSERT_TRUE(RUN("LRANGE", "l", "-2", "-1"));
+    assert_reply("*2\r\n$1\r\nb\r\n$1\r\nc\r\n");
+    
+    // Empty once clamped
+    CU_ASSERT_TRUE(RUN("LRANGE", "l", "3", "10"));
+    CU_ASSERT_TRUE(RUN("LRANGE", "l", "0", "-4"));
+    CU_ASSERT_TRUE(RUN("LRANGE", "l", "2", "1"));
+    assert_reply("*0\r\n*0\r\n*0\r\n");
+    
+    CU_ASSERT_FALSE(RUN("LRANGE", "l", "0", "x"));
+    assert_reply("-ERR value is not an integer or out of range\r\n");
+}
+
+static void test_zrange_clamp(void) {
+    CU_ASSERT_TRUE(RUN("ZADD", "z", "1", "a", "2", "b", "3", "c"));
+    assert_reply(":3\r\n");
+    
+    CU_ASSERT_TRUE(RUN("ZRANGE", "z", "1", "100"));
+    assert_reply("*2\r\n$1\r\nb\r\n$1\r\nc\r\n");
+    CU_ASSERT_TRUE(RUN("ZRANGE", "z", "-1", "-1", "WITHSCORES"));
+    assert_reply("*2\r\n$1\r\nc\r\n$1\r\n3\r\n");
+    CU_ASSERT_TRUE(RUN("ZRANGE", "z", "5", "-1"));
+    assert_reply("*0\r\n");
+}
+
+static void test_bitmap(void) {
+    CU_ASSERT_TRUE(RUN("SETBIT", "b", "0", "1"));
+    CU_ASSERT_TRUE(RUN("SETBIT", "b", "9", "1"));
+    CU_ASSERT_TRUE(RUN("SETBIT", "b", "9", "1"));
+    CU_ASSERT_TRUE(RUN("GETBIT", "b", "9"));
+    CU_ASSERT_TRUE(RUN("GETBIT", "b", "100000"));
+    assert_reply(":0\r\n:0\r\n:1\r\n:1\r\n:0\r\n");
+    
+    // Ranges are in bytes
+    CU_ASSERT_TRUE(RUN("BITCOUNT", "b"));
+    CU_ASSERT_TRUE(RUN("BITCOUNT", "b", "1", "1"));
+    CU_ASSERT_TRUE(RUN("BITCOUNT", "b", "-1000", "0"));
+    CU_ASSERT_TRUE(RUN("BITCOUNT", "b", "2", "1"));
+    assert_reply(":2\r\n:1\r\n:1\r\n:0\r\n");
+    
+    CU_ASSERT_FALSE(RUN("SETBIT", "b", "-1", "1"));
+    CU_ASSERT_FALSE(RUN("SETBIT", "b", "1", "2"));
+    assert_reply("-ERR bit offset is not an integer or out of range\r\n"
+                 "-ERR bit is not an integer or out of range\r\n");
+}
+
+static void test_double_replies(void) {
+    // Shortest digits that read back as the same double
+    CU_ASSERT_TRUE(RUN("ZADD", "scores", "0.1", "m", "1e300", "big"));
+    CU_ASSERT_TRUE(RUN("ZSCORE", "scores", "m"));
+    CU_ASSERT_TRUE(RUN("ZSCORE", "scores", "big"));
+    CU_ASSERT_TRUE(RUN("ZSCORE", "scores", "missing"));
+    assert_reply(":2\r\n$3\r\n0.1\r\n$6\r\n1e+300\r\n$-1\r\n");
+    
+    CU_ASSERT_TRUE(RUN("GEOADD", "sicily", "13.361389", "38.115556", "Palermo",
+                       "15.087269", "37.502669", "Catania"));
+    CU_ASSERT_TRUE(RUN("GEOADD", "sicily", "13.361389", "38.115556", "Palermo"));
+    assert_reply(":2\r\n:0\r\n");
+    CU_ASSERT_TRUE(RUN("GEOPOS", "sicily", "Palermo", "Nowhere"));
+    assert_reply("*2\r\n*2\r\n$9\r\n13.361389\r\n$9\r\n38.115556\r\n$-1\r\n");
+    CU_ASSERT_TRUE(RUN("GEODIST", "sicily", "Palermo", "Catania"));
+    CU_ASSERT_TRUE(RUN("GEODIST", "sicily", "Palermo", "Nowhere"));
+    assert_reply("$17\r\n166.2273571807551\r\n$-1\r\n");
+    
+    CU_ASSERT_FALSE(RUN("GEOADD", "sicily", "181", "0", "x"));
+    assert_reply("-ERR invalid coordinates\r\n");
+}
+
+// Test suite initialization
+int init_collection_commands_suite(void) {
+    CU_pSuite suite = CU_add_suite("Collection Commands Tests", setup, teardown);
+    if (!suite) return CU_get_error();
+    
+    // Add test cases
+    if (!CU_add_test(suite, "test_lrange_clamp", test_lrange_clamp) ||
+        !CU_add_test(suite, "test_zrange_clamp", test_zrange_clamp) ||
+        !CU_add_test(suite, "test_bitmap", test_bitmap) ||
+        !CU_add_test(suite, "test_double_replies", test_double_replies)) {
+        return CU_get_error();
+    }
+    
+    return CUE_SUCCESS;
+}
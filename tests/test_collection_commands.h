@@ -0,0 +1,9 @@
+#ifndef TEST_COLLECTION_COMMANDS_H
+#define TEST_COLLECTION_COMMANDS_H
+
+#include <CUnit/CUnit.h>
+
+// Test suite initialization
+int init_collection_commands_suite(void);
+
+#endif // TEST_COLLECTION_COMMANDS_H 
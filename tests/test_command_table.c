@@ -0,0 +1,116 @@
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <CUnit/Automated.h>
+#include <CUnit/Console.h>
+#include <ctype.h>
+#include <string.h>
+#include "../src/server/command_table.h"
+
+// Setup and teardown functions
+static int setup(void) {
+    return 0;
+}
+
+static int teardown(void) {
+    return 0;
+}
+
+static const Command* lookup(const char* name) {
+    return command_lookup(name, strlen(name));
+}
+
+static void test_lookup_every_command(void) {
+    size_t count;
+    const Command* table = command_table_entries(&count);
+    CU_ASSERT(count > 0);
+    
+    // Each entry is reachable by its own name, in either case
+    for (size_t i = 0; i < count; i++) {
+        char lower[32];
+        size_t len = strlen(table[i].name);
+        CU_ASSERT_FATAL(len < sizeof(lower));
+        for (size_t j = 0; j <= len; j++) lower[j] = tolower((unsigned char)table[i].name[j]);
+        
+        CU_ASSERT_PTR_EQUAL(lookup(table[i].name), &table[i]);
+        CU_ASSERT_PTR_EQUAL(lookup(lower), &table[i]);
+        CU_ASSERT_PTR_NOT_NULL(table[i].proc);
+    }
+}
+
+static void test_lookup_unknown(void) {
+    // Same switch key as a real command, different name
+    CU_ASSERT_PTR_NULL(lookup("SETBOT"));
+    CU_ASSERT_PTR_NULL(lookup("geolist"));
+    
+    CU_ASSERT_PTR_NULL(lookup("NOSUCHCOMMAND"));
+    CU_ASSERT_PTR_NULL(lookup("S"));
+    CU_ASSERT_PTR_NULL(lookup(""));
+    
+    // Only the given length counts
+    CU_ASSERT_PTR_EQUAL(command_lookup("GETBIT", 3), lookup("GET"));
+}
+
+static void test_arity(void) {
+    const Command* get = lookup("GET");
+    const Command* set = lookup("SET");
+    CU_ASSERT_PTR_NOT_NULL_FATAL(get);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(set);
+    
+    CU_ASSERT_FALSE(command_arity_ok(get, 1));
+    CU_ASSERT_TRUE(command_arity_ok(get, 2));
+    CU_ASSERT_FALSE(command_arity_ok(get, 3));
+    
+    CU_ASSERT_FALSE(command_arity_ok(set, 2));
+    CU_ASSERT_TRUE(command_arity_ok(set, 3));
+    CU_ASSERT_TRUE(command_arity_ok(set, 5));
+    
+    CU_ASSERT_TRUE(get->flags & CMD_READONLY);
+    CU_ASSERT_TRUE(set->flags & CMD_WRITE);
+}
+
+static void test_key_range(void) {
+    int first, last, step;
+    
+    char* get[] = {"GET", "k"};
+    CU_ASSERT_TRUE(command_key_range(lookup("GET"), 2, get, &first, &last, &step));
+    CU_ASSERT_EQUAL(first, 1);
+    CU_ASSERT_EQUAL(last, 1);
+    CU_ASSERT_EQUAL(step, 1);
+    
+    // Last key counted from the end
+    char* pfcount[] = {"PFCOUNT", "a", "b", "c"};
+    CU_ASSERT_TRUE(command_key_range(lookup("PFCOUNT"), 4, pfcount, &first, &last, &step));
+    CU_ASSERT_EQUAL(first, 1);
+    CU_ASSERT_EQUAL(last, 3);
+    
+    // Every argument but the trailing timeout
+    char* blpop[] = {"BLPOP", "a", "b", "0"};
+    CU_ASSERT_TRUE(command_key_range(lookup("BLPOP"), 4, blpop, &first, &last, &step));
+    CU_ASSERT_EQUAL(first, 1);
+    CU_ASSERT_EQUAL(last, 2);
+    
+    // Keys found by scanning the arguments
+    char* xread[] = {"XREAD", "COUNT", "5", "STREAMS", "a", "b", "0", "0"};
+    CU_ASSERT_TRUE(command_key_range(lookup("XREAD"), 8, xread, &first, &last, &step));
+    CU_ASSERT_EQUAL(first, 4);
+    CU_ASSERT_EQUAL(last, 5);
+    
+    char* bad[] = {"XREAD", "STREAMS", "a"};
+    CU_ASSERT_FALSE(command_key_range(lookup("XREAD"), 3, bad, &first, &last, &step));
+}
+
+// Test suite initialization
+int init_command_table_suite(void) {
+    CU_pSuite suite = CU_add_suite("Command Table Tests", setup, teardown);
+    if (!suite) return CU_get_error();
+    
+    // Add test cases
+    if (!CU_add_test(suite, "test_lookup_every_command", test_lookup_every_command) ||
+        !CU_add_test(suite, "test_lookup_unknown", test_lookup_unknown) ||
+        !CU_add_test(suite, "test_arity", test_arity) ||
+        !CU_add_test(suite, "test_key_range", test_key_range)) {
+        return CU_get_error();
+    }
+    
+    return CUE_SUCCESS;
+}
@@ -0,0 +1,9 @@
+#ifndef TEST_COMMAND_TABLE_H
+#define TEST_COMMAND_TABLE_H
+
+#include <CUnit/CUnit.h>
+
+// Test suite initialization
+int init_command_table_suite(void);
+
+#endif // TEST_COMMAND_TABLE_H
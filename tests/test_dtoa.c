@@ -0,0 +1,101 @@
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <CUnit/Automated.h>
+#include <CUnit/Console.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/server/dtoa.h"
+#include "../src/server/server.h"
+
+static void assert_format(double value, const char* expected) {
+    char buf[DTOA_BUF_SIZE];
+    size_t len = dtoa_format(buf, value);
+    CU_ASSERT_EQUAL(len, strlen(expected));
+    CU_ASSERT_STRING_EQUAL(buf, expected);
+}
+
+// Test cases
+static void test_format(void) {
+    // Integral values
+    assert_format(0, "0");
+    assert_format(-0.0, "-0");
+    assert_format(42, "42");
+    assert_format(-1e16, "-10000000000000000");
+    assert_format(1e17, "1e+17");
+    
+    // Fewest digits, laid out like %.17g
+    assert_format(0.1, "0.1");
+    assert_format(0.3, "0.3");
+    assert_format(-1.5, "-1.5");
+    assert_format(3.14159, "3.14159");
+    assert_format(-85.05112878, "-85.05112878");
+    assert_format(1e-4, "0.0001");
+    assert_format(1e-5, "1e-05");
+    assert_format(2.5e-7, "2.5e-07");
+    assert_format(1e100, "1e+100");
+    assert_format(1.7976931348623157e308, "1.7976931348623157e+308");
+    assert_format(5e-324, "5e-324");
+    assert_format(INFINITY, "inf");
+    assert_format(-INFINITY, "-inf");
+}
+
+static void test_round_trip(void) {
+    // Random bit patterns: each reads back as the very same double, in at
+    // most 17 significant digits
+    uint64_t state = 88172645463325252ULL;
+    char buf[DTOA_BUF_SIZE];
+    for (int i = 0; i < 100000; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        double value;
+        memcpy(&value, &state, sizeof(value));
+        if (!isfinite(value)) continue;
+        
+        size_t len = dtoa_format(buf, value);
+        CU_ASSERT_TRUE(len < DTOA_BUF_SIZE && len == strlen(buf));
+        double back = strtod(buf, NULL);
+        CU_ASSERT_TRUE(memcmp(&back, &value, sizeof(value)) == 0);
+        
+        // Leading zeros of 0.000ddd aren't significant
+        int digits = 0;
+        for (const char* p = buf; *p && *p != 'e'; p++) {
+            if ((*p >= '1' && *p <= '9') || (*p == '0' && digits > 0)) digits++;
+        }
+        CU_ASSERT_TRUE(digits <= 17);
+    }
+}
+
+static void test_send_double(void) {
+    Client* client = client_create(-1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(client);
+    send_double(client, 2.5);
+    send_double(client, 100);
+    
+    size_t len;
+    char* reply = client_take_reply(client, &len);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(reply);
+    const char expected[] = "$3\r\n2.5\r\n$3\r\n100\r\n";
+    CU_ASSERT_EQUAL(len, sizeof(expected) - 1);
+    CU_ASSERT_TRUE(len == sizeof(expected) - 1 && memcmp(reply, expected, len) == 0);
+    free(reply);
+    client_free(client);
+}
+
+// Test suite initialization
+int init_dtoa_suite(void) {
+    CU_pSuite suite = CU_add_suite("Double Formatting Tests", NULL, NULL);
+    if (!suite) return CU_get_error();
+    
+    // Add test cases
+    if (!CU_add_test(suite, "test_format", test_format) ||
+        !CU_add_test(suite, "test_round_trip", test_round_trip) ||
+        !CU_add_test(suite, "test_send_double", test_send_double)) {
+        return CU_get_error();
+    }
+    
+    return CUE_SUCCESS;
+}
@@ -0,0 +1,9 @@
+#ifndef TEST_DTOA_H
+#define TEST_DTOA_H
+
+#include <CUnit/CUnit.h>
+
+// Test suite initialization
+int init_dtoa_suite(void);
+
+#endif // TEST_DTOA_H 
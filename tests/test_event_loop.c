@@ -0,0 +1,91 @@
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <CUnit/Automated.h>
+#include <CUnit/Console.h>
+#include <stdint.h>
+#include "../src/server/event_loop.h"
+
+// Test fixtures
+static TimerQueue timers;
+static int fired[8];
+static int fired_count;
+
+// Setup and teardown functions
+static int setup(void) {
+    timers_init(&timers, NULL);
+    fired_count = 0;
+    return 0;
+}
+
+static int teardown(void) {
+    timers_free(&timers);
+    return 0;
+}
+
+static void record_timer(TimerQueue* queue, void* data) {
+    (void)queue;
+    if (fired_count < 8) fired[fired_count++] = (int)(intptr_t)data;
+}
+
+// Test cases
+static void test_timers_run_in_deadline_order(void) {
+    int64_t now = monotonic_ms();
+    fired_count = 0;
+    
+    // Added out of order, all already due
+    int64_t offsets[] = {-10, -30, -20, -40};
+    for (int i = 0; i < 4; i++) {
+        CU_ASSERT_PTR_NOT_NULL(timer_add(&timers, now + offsets[i], record_timer, (void*)(intptr_t)i));
+    }
+    
+    CU_ASSERT_EQUAL(timers_wait_ms(&timers, 1000), 0);
+    CU_ASSERT_EQUAL(timers_run(&timers), 4);
+    CU_ASSERT_EQUAL(fired_count, 4);
+    CU_ASSERT_EQUAL(fired[0], 3);
+    CU_ASSERT_EQUAL(fired[1], 1);
+    CU_ASSERT_EQUAL(fired[2], 2);
+    CU_ASSERT_EQUAL(fired[3], 0);
+    CU_ASSERT_EQUAL(timers.count, 0);
+}
+
+static void test_timer_cancel(void) {
+    int64_t now = monotonic_ms();
+    fired_count = 0;
+    
+    Timer* first = timer_add(&timers, now - 20, record_timer, (void*)(intptr_t)1);
+    Timer* middle = timer_add(&timers, now - 10, record_timer, (void*)(intptr_t)2);
+    Timer* later = timer_add(&timers, now + 60000, record_timer, (void*)(intptr_t)3);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(first);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(middle);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(later);
+    
+    // Cancelling the earliest one reorders the heap
+    timer_cancel(&timers, first);
+    timer_cancel(&timers, NULL);
+    CU_ASSERT_EQUAL(timers_run(&timers), 1);
+    CU_ASSERT_EQUAL(fired_count, 1);
+    CU_ASSERT_EQUAL(fired[0], 2);
+    
+    // Only the far one is left: the wait is capped, not shortened
+    CU_ASSERT_EQUAL(timers_wait_ms(&timers, 100), 100);
+    CU_ASSERT(timers_wait_ms(&timers, -1) > 100);
+    CU_ASSERT_EQUAL(timers_wait_ms(&timers, 0), 0);
+    
+    timer_cancel(&timers, later);
+    CU_ASSERT_EQUAL(timers.count, 0);
+    CU_ASSERT_EQUAL(timers_wait_ms(&timers, -1), -1);
+}
+
+// Test suite initialization
+int init_event_loop_suite(void) {
+    CU_pSuite suite = CU_add_suite("Event Loop Tests", setup, teardown);
+    if (!suite) return CU_get_error();
+    
+    // Add test cases
+    if (!CU_add_test(suite, "test_timers_run_in_deadline_order", test_timers_run_in_deadline_order) ||
+        !CU_add_test(suite, "test_timer_cancel", test_timer_cancel)) {
+        return CU_get_error();
+    }
+    
+    return CUE_SUCCESS;
+}
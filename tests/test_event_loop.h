@@ -0,0 +1,9 @@
+#ifndef TEST_EVENT_LOOP_H
+#define TEST_EVENT_LOOP_H
+
+#include <CUnit/CUnit.h>
+
+// Test suite initialization
+int init_event_loop_suite(void);
+
+#endif // TEST_EVENT_LOOP_H 
@@ -2,112 +2,129 @@
 #include <CUnit/Basic.h>
 #include <CUnit/Automated.h>
 #include <CUnit/Console.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "../src/hashmap/hashmap.h"
 
 // Test fixtures
-static HashMap* map;
+static Hashmap* map;
 
 // Setup and teardown functions
 static int setup(void) {
-    map = createHashMap();
+    map = hashmap_create(0);
     return (map != NULL) ? 0 : -1;
 }
 
 static int teardown(void) {
-    if (map) {
-        freeHashMap(map);
-        map = NULL;
-    }
+    hashmap_destroy(map);
+    map = NULL;
     return 0;
 }
 
-// Test cases
-static void test_create_hashmap(void) {
-    CU_ASSERT_PTR_NOT_NULL(map);
-    CU_ASSERT_EQUAL(map->size, INITIAL_HASHMAP_SIZE);
-    CU_ASSERT_EQUAL(map->itemCount, 0);
+static RedisObject* value(const char* bytes) {
+    return createRedisEmbeddedString(bytes, strlen(bytes));
 }
 
-static void test_insert_and_get(void) {
-    const char* key = "test_key";
-    unsigned char value[] = "test_value";
-    
-    // Test insertion
-    hashMapInsert(map, key, value, sizeof(value));
-    CU_ASSERT_EQUAL(map->itemCount, 1);
-    
-    // Test retrieval
-    size_t foundSize;
-    unsigned char* retrieved = hashMapGet(map, key, &foundSize);
-    CU_ASSERT_PTR_NOT_NULL(retrieved);
-    CU_ASSERT_EQUAL(foundSize, sizeof(value));
-    CU_ASSERT_STRING_EQUAL((char*)retrieved, (char*)value);
+static const char* value_bytes(const RedisObject* obj) {
+    return obj ? ((const RedisString*)obj->data)->value : NULL;
 }
 
-static void test_remove(void) {
-    const char* key = "test_key";
-    unsigned char value[] = "test_value";
+// Test cases
+static void test_put_and_get(void) {
+    CU_ASSERT_TRUE(hashmap_put(map, "test_key", 8, value("test_value")));
+    CU_ASSERT_EQUAL(hashmap_size(map), 1);
+    CU_ASSERT_STRING_EQUAL(value_bytes(hashmap_get(map, "test_key", 8)), "test_value");
     
-    // Insert a value
-    hashMapInsert(map, key, value, sizeof(value));
-    CU_ASSERT_EQUAL(map->itemCount, 1);
+    // A prefix of the key is another key
+    CU_ASSERT_PTR_NULL(hashmap_get(map, "test_key", 4));
     
-    // Remove the value
-    hashMapRemove(map, key);
-    CU_ASSERT_EQUAL(map->itemCount, 0);
+    CU_ASSERT_TRUE(hashmap_put(map, "test_key", 8, value("other")));
+    CU_ASSERT_EQUAL(hashmap_size(map), 1);
+    CU_ASSERT_STRING_EQUAL(value_bytes(hashmap_get(map, "test_key", 8)), "other");
     
-    // Verify removal
-    size_t foundSize;
-    unsigned char* retrieved = hashMapGet(map, key, &foundSize);
-    CU_ASSERT_PTR_NULL(retrieved);
+    CU_ASSERT_TRUE(hashmap_remove(map, "test_key", 8));
+    CU_ASSERT_FALSE(hashmap_remove(map, "test_key", 8));
+    CU_ASSERT_EQUAL(hashmap_size(map), 0);
+    CU_ASSERT_PTR_NULL(hashmap_get(map, "test_key", 8));
 }
 
-static void test_collision_handling(void) {
-    // Insert two values that should hash to the same bucket
-    const char* key1 = "key1";
-    const char* key2 = "key1";  // Same key to force collision
-    unsigned char value1[] = "value1";
-    unsigned char value2[] = "value2";
+static void test_binary_keys(void) {
+    // Keys that only differ after a NUL byte
+    CU_ASSERT_TRUE(hashmap_put(map, "a\0x", 3, value("x")));
+    CU_ASSERT_TRUE(hashmap_put(map, "a\0y", 3, value("y")));
+    CU_ASSERT_TRUE(hashmap_put(map, "a", 1, value("a")));
+    CU_ASSERT_TRUE(hashmap_put(map, "", 0, value("empty")));
+    CU_ASSERT_EQUAL(hashmap_size(map), 4);
     
-    hashMapInsert(map, key1, value1, sizeof(value1));
-    hashMapInsert(map, key2, value2, sizeof(value2));
+    CU_ASSERT_STRING_EQUAL(value_bytes(hashmap_get(map, "a\0x", 3)), "x");
+    CU_ASSERT_STRING_EQUAL(value_bytes(hashmap_get(map, "a\0y", 3)), "y");
+    CU_ASSERT_STRING_EQUAL(value_bytes(hashmap_get(map, "a", 1)), "a");
+    CU_ASSERT_STRING_EQUAL(value_bytes(hashmap_get(map, "", 0)), "empty");
+    CU_ASSERT_PTR_NULL(hashmap_get(map, "a\0z", 3));
     
-    // Verify both values can be retrieved
-    size_t foundSize;
-    unsigned char* retrieved1 = hashMapGet(map, key1, &foundSize);
-    unsigned char* retrieved2 = hashMapGet(map, key2, &foundSize);
-    
-    CU_ASSERT_PTR_NOT_NULL(retrieved1);
-    CU_ASSERT_PTR_NOT_NULL(retrieved2);
-    CU_ASSERT_STRING_EQUAL((char*)retrieved1, (char*)value1);
-    CU_ASSERT_STRING_EQUAL((char*)retrieved2, (char*)value2);
+    CU_ASSERT_TRUE(hashmap_remove(map, "a\0x", 3));
+    CU_ASSERT_PTR_NOT_NULL(hashmap_get(map, "a\0y", 3));
+    hashmap_clear(map);
 }
 
 static void test_resize(void) {
-    // Insert enough items to trigger resize
-    for (int i = 0; i < INITIAL_HASHMAP_SIZE * RESIZE_UP_THRESHOLD + 1; i++) {
-        char key[16];
-        char value[16];
-        snprintf(key, sizeof(key), "key%d", i);
-        snprintf(value, sizeof(value), "value%d", i);
-        hashMapInsert(map, key, (unsigned char*)value, strlen(value) + 1);
+    char key[16];
+    for (int i = 0; i < 1000; i++) {
+        int len = snprintf(key, sizeof(key), "key%d", i);
+        CU_ASSERT_TRUE(hashmap_put(map, key, len, createRedisIntegerObject(i)));
     }
+    CU_ASSERT_EQUAL(hashmap_size(map), 1000);
+    CU_ASSERT_TRUE(map->capacity >= 1000);
     
-    // Verify resize occurred
-    CU_ASSERT(map->size > INITIAL_HASHMAP_SIZE);
-    
-    // Verify all values can still be retrieved
-    for (int i = 0; i < INITIAL_HASHMAP_SIZE * RESIZE_UP_THRESHOLD + 1; i++) {
-        char key[16];
-        char expected_value[16];
-        snprintf(key, sizeof(key), "key%d", i);
-        snprintf(expected_value, sizeof(expected_value), "value%d", i);
-        
-        size_t foundSize;
-        unsigned char* retrieved = hashMapGet(map, key, &foundSize);
-        CU_ASSERT_PTR_NOT_NULL(retrieved);
-        CU_ASSERT_STRING_EQUAL((char*)retrieved, expected_value);
+    // All still found, also through the batched lookup
+    char* keys[1000];
+    size_t key_lens[1000];
+    RedisObject* values[1000];
+    for (int i = 0; i < 1000; i++) {
+        key_lens[i] = snprintf(key, sizeof(key), "key%d", i);
+        keys[i] = strdup(key);
+        RedisObject* obj = hashmap_get(map, key, key_lens[i]);
+        CU_ASSERT_TRUE(obj && obj->integer == i);
     }
+    hashmap_get_many(map, keys, key_lens, 1000, 1, values);
+    for (int i = 0; i < 1000; i++) {
+        CU_ASSERT_TRUE(values[i] && values[i]->integer == i);
+        free(keys[i]);
+    }
+    hashmap_clear(map);
+    CU_ASSERT_EQUAL(hashmap_size(map), 0);
+}
+
+static int modified_count;
+static size_t modified_len;
+
+static void on_modified(const char* key, size_t key_len, void* data) {
+    (void)key;
+    (void)data;
+    modified_count++;
+    modified_len = key_len;
+}
+
+static void test_versions(void) {
+    hashmap_set_modified_hook(map, on_modified, NULL);
+    uint64_t missing = hashmap_version(map, "v\0", 2);
+    
+    CU_ASSERT_TRUE(hashmap_put(map, "v\0", 2, value("1")));
+    uint64_t created = hashmap_version(map, "v\0", 2);
+    CU_ASSERT_NOT_EQUAL(created, missing);
+    CU_ASSERT_EQUAL(modified_count, 1);
+    CU_ASSERT_EQUAL(modified_len, 2);
+    
+    // Other keys don't change it, a change in place does
+    CU_ASSERT_TRUE(hashmap_put(map, "v", 1, value("2")));
+    CU_ASSERT_EQUAL(hashmap_version(map, "v\0", 2), created);
+    hashmap_touch(map, "v\0", 2);
+    CU_ASSERT_NOT_EQUAL(hashmap_version(map, "v\0", 2), created);
+    CU_ASSERT_EQUAL(modified_count, 3);
+    
+    hashmap_set_modified_hook(map, NULL, NULL);
+    hashmap_clear(map);
 }
 
 // Test suite initialization
@@ -116,13 +133,12 @@ int init_hashmap_suite(void) {
     if (!suite) return CU_get_error();
     
     // Add test cases
-    if (!CU_add_test(suite, "test_create_hashmap", test_create_hashmap) ||
-        !CU_add_test(suite, "test_insert_and_get", test_insert_and_get) ||
-        !CU_add_test(suite, "test_remove", test_remove) ||
-        !CU_add_test(suite, "test_collision_handling", test_collision_handling) ||
-        !CU_add_test(suite, "test_resize", test_resize)) {
+    if (!CU_add_test(suite, "test_put_and_get", test_put_and_get) ||
+        !CU_add_test(suite, "test_binary_keys", test_binary_keys) ||
+        !CU_add_test(suite, "test_resize", test_resize) ||
+        !CU_add_test(suite, "test_versions", test_versions)) {
         return CU_get_error();
     }
     
     return CUE_SUCCESS;
-} 
\ No newline at end of file
+}
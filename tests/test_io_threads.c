@@ -0,0 +1,102 @@
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <CUnit/Automated.h>
+#include <CUnit/Console.h>
+#include <sys/socket.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "../src/server/io_threads.h"
+
+#define TEST_CLIENTS 8
+
+// Test fixtures: clients on one end of a socket pair each, with the
+// other end kept to read what they were sent
+static IOThreadPool* pool;
+static Client* clients[TEST_CLIENTS];
+static int peers[TEST_CLIENTS];
+
+// Setup and teardown functions
+static int setup(void) {
+    pool = io_threads_create(2);
+    if (!pool) return -1;
+    for (int i = 0; i < TEST_CLIENTS; i++) {
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) return -1;
+        clients[i] = client_create(fds[0]);
+        peers[i] = fds[1];
+        if (!clients[i]) return -1;
+    }
+    return 0;
+}
+
+static int teardown(void) {
+    for (int i = 0; i < TEST_CLIENTS; i++) {
+        client_free(clients[i]);
+        close(peers[i]);
+    }
+    io_threads_destroy(pool);
+    return 0;
+}
+
+// Queue a reply for every client, flush them all through the pool and
+// check each peer got its own
+static void flush_all(size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        char value[16];
+        snprintf(value, sizeof(value), "client%zu", i);
+        send_string(clients[i], value);
+    }
+    
+    io_threads_run(pool, clients, count, IO_OP_WRITE);
+    
+    for (size_t i = 0; i < count; i++) {
+        char expected[32], buf[32];
+        int len = snprintf(expected, sizeof(expected), "$7\r\nclient%zu\r\n", i);
+        CU_ASSERT_EQUAL(clients[i]->io_status, CLIENT_IO_OK);
+        CU_ASSERT_EQUAL(read(peers[i], buf, sizeof(buf)), len);
+        CU_ASSERT_EQUAL(memcmp(buf, expected, len), 0);
+    }
+}
+
+// Test cases
+static void test_parked_until_load(void) {
+    // Workers start parked, and a couple of clients stay on the caller
+    CU_ASSERT_TRUE(io_threads_parked(pool));
+    flush_all(2);
+    CU_ASSERT_TRUE(io_threads_parked(pool));
+    
+    // Enough clients release them
+    flush_all(TEST_CLIENTS);
+    CU_ASSERT_FALSE(io_threads_parked(pool));
+}
+
+static void test_parked_when_idle(void) {
+    flush_all(TEST_CLIENTS);
+    CU_ASSERT_FALSE(io_threads_parked(pool));
+    
+    // The server parks them once an iteration has no I/O
+    io_threads_park(pool);
+    CU_ASSERT_TRUE(io_threads_parked(pool));
+    io_threads_park(pool);
+    CU_ASSERT_TRUE(io_threads_parked(pool));
+    
+    // and the next load picks up where it left off
+    flush_all(TEST_CLIENTS);
+    CU_ASSERT_FALSE(io_threads_parked(pool));
+    io_threads_park(pool);
+}
+
+// Test suite initialization
+int init_io_threads_suite(void) {
+    CU_pSuite suite = CU_add_suite("I/O Threads Tests", setup, teardown);
+    if (!suite) return CU_get_error();
+    
+    // Add test cases
+    if (!CU_add_test(suite, "test_parked_until_load", test_parked_until_load) ||
+        !CU_add_test(suite, "test_parked_when_idle", test_parked_when_idle)) {
+        return CU_get_error();
+    }
+    
+    return CUE_SUCCESS;
+}
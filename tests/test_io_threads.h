@@ -0,0 +1,9 @@
+#ifndef TEST_IO_THREADS_H
+#define TEST_IO_THREADS_H
+
+#include <CUnit/CUnit.h>
+
+// Test suite initialization
+int init_io_threads_suite(void);
+
+#endif // TEST_IO_THREADS_H 
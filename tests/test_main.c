@@ -1,7 +1,23 @@
 #include <CUnit/CUnit.h>
 #include <CUnit/Basic.h>
+#include "test_blocking.h"
+#include "test_collection_commands.h"
+#include "test_command_table.h"
+#include "test_dtoa.h"
+#include "test_event_loop.h"
 #include "test_hashmap.h"
+#include "test_io_threads.h"
+#include "test_multi.h"
+#include "test_parse.h"
+#include "test_pubsub.h"
+#include "test_query.h"
 #include "test_redis_server.h"
+#include "test_registry.h"
+#include "test_reply.h"
+#include "test_resp.h"
+#include "test_shard.h"
+#include "test_string_commands.h"
+#include "test_tracking.h"
 
 int main(void) {
     // Initialize CUnit test registry
@@ -10,8 +26,24 @@ int main(void) {
     }
 
     // Add test suites
-    if (init_hashmap_suite() != CUE_SUCCESS ||
-        init_redis_server_suite() != CUE_SUCCESS) {
+    if (init_blocking_suite() != CUE_SUCCESS ||
+        init_collection_commands_suite() != CUE_SUCCESS ||
+        init_command_table_suite() != CUE_SUCCESS ||
+        init_dtoa_suite() != CUE_SUCCESS ||
+        init_event_loop_suite() != CUE_SUCCESS ||
+        init_hashmap_suite() != CUE_SUCCESS ||
+        init_io_threads_suite() != CUE_SUCCESS ||
+        init_multi_suite() != CUE_SUCCESS ||
+        init_parse_suite() != CUE_SUCCESS ||
+        init_pubsub_suite() != CUE_SUCCESS ||
+        init_query_suite() != CUE_SUCCESS ||
+        init_redis_server_suite() != CUE_SUCCESS ||
+        init_registry_suite() != CUE_SUCCESS ||
+        init_reply_suite() != CUE_SUCCESS ||
+        init_resp_suite() != CUE_SUCCESS ||
+        init_shard_suite() != CUE_SUCCESS ||
+        init_string_commands_suite() != CUE_SUCCESS ||
+        init_tracking_suite() != CUE_SUCCESS) {
         CU_cleanup_registry();
         return CU_get_error();
     }
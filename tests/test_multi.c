@@ -0,0 +1,143 @@
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <CUnit/Automated.h>
+#include <CUnit/Console.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/server/multi.h"
+
+// Test fixtures
+static Server* server;
+static Client* alice;
+static Client* bob;
+
+// Setup and teardown functions
+static int setup(void) {
+    server = server_create(DEFAULT_HOST, 0, 16);
+    alice = client_create(-1);
+    bob = client_create(-1);
+    return server && alice && bob ? 0 : -1;
+}
+
+static int teardown(void) {
+    client_free(alice);
+    client_free(bob);
+    server_destroy(server);
+    return 0;
+}
+
+static void assert_reply_bytes(Client* client, const char* expected, size_t expected_len) {
+    size_t len;
+    char* reply = client_take_reply(client, &len);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(reply);
+    CU_ASSERT_EQUAL(len, expected_len);
+    CU_ASSERT_TRUE(len == expected_len && memcmp(reply, expected, len) == 0);
+    free(reply);
+}
+
+#define assert_reply(client, expected) assert_reply_bytes(client, expected, sizeof(expected) - 1)
+
+// Run a command as if parsed from the client's query buffer
+static bool run(Client* client, char** args, int argc) {
+    size_t argv_len[16];
+    char* argv_owned[16] = {0};
+    for (int i = 0; i < argc; i++) argv_len[i] = strlen(args[i]);
+    client->argc = argc;
+    client->argv = args;
+    client->argv_len = argv_len;
+    client->argv_owned = argv_owned;
+    
+    bool ok = handle_command(server, client, args[0], args, argc);
+    client->argv = NULL;
+    client->argv_len = NULL;
+    client->argv_owned = NULL;
+    return ok;
+}
+
+#define RUN(client, ...) run(client, (char*[]){__VA_ARGS__}, sizeof((char*[]){__VA_ARGS__}) / sizeof(char*))
+
+// Test cases
+static void test_queue_and_exec(void) {
+    CU_ASSERT_TRUE(RUN(alice, "MULTI"));
+    CU_ASSERT_TRUE(RUN(alice, "SET", "k", "v1"));
+    CU_ASSERT_TRUE(RUN(alice, "GET", "k"));
+    assert_reply(alice, "+OK\r\n+QUEUED\r\n+QUEUED\r\n");
+    
+    // Nothing ran yet
+    CU_ASSERT_PTR_NULL(hashmap_get(server->db, "k", 1));
+    CU_ASSERT_EQUAL(alice->multi.count, 2);
+    
+    CU_ASSERT_TRUE(RUN(alice, "EXEC"));
+    assert_reply(alice, "*2\r\n+OK\r\n$2\r\nv1\r\n");
+    CU_ASSERT_FALSE(alice->multi.active);
+    CU_ASSERT_PTR_NOT_NULL(hashmap_get(server->db, "k", 1));
+    
+    CU_ASSERT_FALSE(RUN(alice, "EXEC"));
+    CU_ASSERT_FALSE(RUN(alice, "DISCARD"));
+    assert_reply(alice, "-ERR EXEC without MULTI\r\n-ERR DISCARD without MULTI\r\n");
+}
+
+static void test_queue_errors_abort(void) {
+    CU_ASSERT_TRUE(RUN(alice, "MULTI"));
+    CU_ASSERT_FALSE(RUN(alice, "MULTI"));
+    CU_ASSERT_FALSE(RUN(alice, "GET"));
+    CU_ASSERT_TRUE(RUN(alice, "SET", "e", "v"));
+    CU_ASSERT_FALSE(RUN(alice, "EXEC"));
+    assert_reply(alice, "+OK\r\n"
+                        "-ERR MULTI calls can not be nested\r\n"
+                        "-ERR wrong number of arguments for 'get' command\r\n"
+                        "+QUEUED\r\n"
+                        "-EXECABORT Transaction discarded because of previous errors.\r\n");
+    CU_ASSERT_PTR_NULL(hashmap_get(server->db, "e", 1));
+    
+    // DISCARD drops the queue
+    CU_ASSERT_TRUE(RUN(alice, "MULTI"));
+    CU_ASSERT_TRUE(RUN(alice, "SET", "e", "v"));
+    CU_ASSERT_TRUE(RUN(alice, "DISCARD"));
+    assert_reply(alice, "+OK\r\n+QUEUED\r\n+OK\r\n");
+    CU_ASSERT_PTR_NULL(hashmap_get(server->db, "e", 1));
+}
+
+static void test_watch(void) {
+    CU_ASSERT_TRUE(RUN(alice, "SET", "k", "1"));
+    CU_ASSERT_TRUE(RUN(alice, "WATCH", "k", "other"));
+    CU_ASSERT_TRUE(RUN(alice, "MULTI"));
+    CU_ASSERT_FALSE(RUN(alice, "WATCH", "k"));
+    CU_ASSERT_TRUE(RUN(alice, "SET", "k", "2"));
+    assert_reply(alice, "+OK\r\n+OK\r\n+OK\r\n-ERR WATCH inside MULTI is not allowed\r\n+QUEUED\r\n");
+    
+    // Another client's write in between voids the transaction
+    CU_ASSERT_TRUE(RUN(bob, "SET", "k", "3"));
+    CU_ASSERT_TRUE(RUN(alice, "EXEC"));
+    assert_reply(alice, "*-1\r\n");
+    CU_ASSERT_EQUAL(alice->multi.watched_count, 0);
+    
+    // Untouched since WATCH: it runs
+    CU_ASSERT_TRUE(RUN(alice, "WATCH", "k"));
+    CU_ASSERT_TRUE(RUN(alice, "MULTI"));
+    CU_ASSERT_TRUE(RUN(alice, "GET", "k"));
+    CU_ASSERT_TRUE(RUN(alice, "EXEC"));
+    assert_reply(alice, "+OK\r\n+OK\r\n+QUEUED\r\n*1\r\n$1\r\n3\r\n");
+    
+    // A watched key that doesn't exist changes when it is created
+    CU_ASSERT_TRUE(RUN(alice, "WATCH", "new"));
+    CU_ASSERT_TRUE(RUN(bob, "SET", "new", "x"));
+    CU_ASSERT_TRUE(RUN(alice, "MULTI"));
+    CU_ASSERT_TRUE(RUN(alice, "EXEC"));
+    assert_reply(alice, "+OK\r\n+OK\r\n*-1\r\n");
+}
+
+// Test suite initialization
+int init_multi_suite(void) {
+    CU_pSuite suite = CU_add_suite("MULTI/EXEC Tests", setup, teardown);
+    if (!suite) return CU_get_error();
+    
+    // Add test cases
+    if (!CU_add_test(suite, "test_queue_and_exec", test_queue_and_exec) ||
+        !CU_add_test(suite, "test_queue_errors_abort", test_queue_errors_abort) ||
+        !CU_add_test(suite, "test_watch", test_watch)) {
+        return CU_get_error();
+    }
+    
+    return CUE_SUCCESS;
+}
@@ -0,0 +1,9 @@
+#ifndef TEST_MULTI_H
+#define TEST_MULTI_H
+
+#include <CUnit/CUnit.h>
+
+// Test suite initialization
+int init_multi_suite(void);
+
+#endif // TEST_MULTI_H 
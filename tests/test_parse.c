@@ -0,0 +1,91 @@
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <CUnit/Automated.h>
+#include <CUnit/Console.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/server/parse.h"
+
+// Test cases
+static void test_find_crlf(void) {
+    // At every position and buffer length, so each vector width and the
+    // scalar tail all find it
+    char buf[100];
+    for (size_t at = 0; at + 1 < sizeof(buf); at++) {
+        memset(buf, 'x', sizeof(buf));
+        buf[at] = '\r';
+        buf[at + 1] = '\n';
+        CU_ASSERT_PTR_EQUAL(parse_find_crlf(buf, sizeof(buf)), buf + at);
+        CU_ASSERT_PTR_NULL(parse_find_crlf(buf, at + 1));
+        CU_ASSERT_PTR_EQUAL(parse_find_crlf(buf, at + 2), buf + at);
+    }
+    
+    // Lone CRs and LFs don't count, nor does a CR at the very end
+    char lone[] = "\r\r x\n\rx\r\r\r\r\r\r\r\r\r\r\r\r\r\r\r\r\r\r\r\r\r\r\r\r\r\r\r\r\r\r\r\r\r\r\r\n";
+    CU_ASSERT_PTR_EQUAL(parse_find_crlf(lone, strlen(lone)), lone + strlen(lone) - 2);
+    CU_ASSERT_PTR_NULL(parse_find_crlf(lone, strlen(lone) - 1));
+    CU_ASSERT_PTR_NULL(parse_find_crlf(lone, 0));
+}
+
+static void assert_double(const char* str, double expected) {
+    double value = 0;
+    CU_ASSERT_TRUE(parse_double(str, strlen(str), &value));
+    CU_ASSERT_TRUE(value == expected);
+    if (value != expected) printf("\n%s parsed as %.17g\n", str, value);
+}
+
+static void test_double(void) {
+    assert_double("0", 0);
+    assert_double("-1.5", -1.5);
+    assert_double("+2", 2);
+    assert_double("3.14159", 3.14159);
+    assert_double(".5", 0.5);
+    assert_double("1.", 1);
+    assert_double("1e3", 1000);
+    assert_double("-2.5E-3", -0.0025);
+    assert_double("0.1", 0.1);
+    assert_double("-85.05112878", -85.05112878);
+    assert_double("inf", INFINITY);
+    assert_double("-inf", -INFINITY);
+    
+    // Past the exact fast path strtod() is still exact
+    assert_double("12345678901234567890123", 12345678901234567890123.0);
+    assert_double("1e300", 1e300);
+    assert_double("2.2250738585072014e-308", 2.2250738585072014e-308);
+    assert_double("0x10", 16);
+    
+    // Every double with up to 17 digits comes back unchanged
+    static const double scales[] = {1e-20, 1e-7, 1e-3, 1, 1e3, 1e9, 1e20};
+    char buf[32];
+    for (int i = 0; i < 10000; i++) {
+        double expected = (rand() - RAND_MAX / 2) / 7.0 * scales[i % 7];
+        snprintf(buf, sizeof(buf), "%.17g", expected);
+        assert_double(buf, expected);
+    }
+    
+    double value;
+    const char* invalid[] = {"", " 1", "1 ", "abc", "1x", "1e", "1e+", "-", ".", "nan", "1e400", "1e-400"};
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        CU_ASSERT_FALSE(parse_double(invalid[i], strlen(invalid[i]), &value));
+    }
+    
+    // Only len bytes are read
+    CU_ASSERT_TRUE(parse_double("12x", 2, &value));
+    CU_ASSERT_TRUE(value == 12);
+}
+
+// Test suite initialization
+int init_parse_suite(void) {
+    CU_pSuite suite = CU_add_suite("Parse Tests", NULL, NULL);
+    if (!suite) return CU_get_error();
+    
+    // Add test cases
+    if (!CU_add_test(suite, "test_find_crlf", test_find_crlf) ||
+        !CU_add_test(suite, "test_double", test_double)) {
+        return CU_get_error();
+    }
+    
+    return CUE_SUCCESS;
+}
@@ -0,0 +1,9 @@
+#ifndef TEST_PARSE_H
+#define TEST_PARSE_H
+
+#include <CUnit/CUnit.h>
+
+// Test suite initialization
+int init_parse_suite(void);
+
+#endif // TEST_PARSE_H 
@@ -0,0 +1,197 @@
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <CUnit/Automated.h>
+#include <CUnit/Console.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/server/pubsub.h"
+
+// Test fixtures
+static Server* server;
+static Client* alice;
+static Client* bob;
+
+// Setup and teardown functions
+static int setup(void) {
+    server = server_create(DEFAULT_HOST, 0, 16);
+    alice = client_create(-1);
+    bob = client_create(-1);
+    return server && alice && bob ? 0 : -1;
+}
+
+static int teardown(void) {
+    pubsub_unsubscribe_all(server, alice);
+    pubsub_unsubscribe_all(server, bob);
+    client_free(alice);
+    client_free(bob);
+    server_destroy(server);
+    return 0;
+}
+
+// Check everything queued for the client so far, NUL bytes included
+static void assert_reply_bytes(Client* client, const char* expected, size_t expected_len) {
+    size_t len;
+    char* reply = client_take_reply(client, &len);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(reply);
+    CU_ASSERT_EQUAL(len, expected_len);
+    CU_ASSERT_TRUE(len == expected_len && memcmp(reply, expected, len) == 0);
+    free(reply);
+}
+
+#define assert_reply(client, expected) assert_reply_bytes(client, expected, sizeof(expected) - 1)
+
+static void drop_reply(Client* client) {
+    size_t len;
+    free(client_take_reply(client, &len));
+}
+
+// Run a command as if parsed from the client's query buffer
+static bool run_bytes(Client* client, char** args, size_t* argv_len, int argc) {
+    client->argv_len = argv_len;
+    bool ok = handle_command(server, client, args[0], args, argc);
+    client->argv_len = NULL;
+    return ok;
+}
+
+static bool run(Client* client, char** args, int argc) {
+    size_t argv_len[16];
+    for (int i = 0; i < argc; i++) argv_len[i] = strlen(args[i]);
+    return run_bytes(client, args, argv_len, argc);
+}
+
+#define RUN(client, ...) run(client, (char*[]){__VA_ARGS__}, sizeof((char*[]){__VA_ARGS__}) / sizeof(char*))
+
+static bool glob_match(const char* pattern, const char* str) {
+    return pubsub_glob_match(pattern, strlen(pattern), str, strlen(str));
+}
+
+static size_t publish(const char* channel, const char* message, size_t message_len) {
+    return pubsub_publish(server, channel, strlen(channel), message, message_len);
+}
+
+// Test cases
+static void test_glob_match(void) {
+    CU_ASSERT_TRUE(glob_match("news.*", "news.sports"));
+    CU_ASSERT_TRUE(glob_match("news.*", "news."));
+    CU_ASSERT_FALSE(glob_match("news.*", "news"));
+    CU_ASSERT_TRUE(glob_match("*", ""));
+    CU_ASSERT_TRUE(glob_match("h?llo", "hello"));
+    CU_ASSERT_FALSE(glob_match("h?llo", "hllo"));
+    CU_ASSERT_TRUE(glob_match("h[ae]llo", "hallo"));
+    CU_ASSERT_FALSE(glob_match("h[^e]llo", "hello"));
+    CU_ASSERT_TRUE(glob_match("h[a-c]llo", "hbllo"));
+    CU_ASSERT_TRUE(glob_match("a\\*b", "a*b"));
+    CU_ASSERT_FALSE(glob_match("a\\*b", "axb"));
+    
+    // A * that has to give bytes back
+    CU_ASSERT_TRUE(glob_match("*.log.*", "app.log.old.log.1"));
+    CU_ASSERT_FALSE(glob_match("*.log.*", "app.log"));
+}
+
+static void test_publish_to_channel(void) {
+    CU_ASSERT_TRUE(RUN(alice, "SUBSCRIBE", "news", "sports"));
+    assert_reply(alice, "*3\r\n$9\r\nsubscribe\r\n$4\r\nnews\r\n:1\r\n"
+                        "*3\r\n$9\r\nsubscribe\r\n$6\r\nsports\r\n:2\r\n");
+    CU_ASSERT_EQUAL(alice->client_class, CLIENT_CLASS_PUBSUB);
+    
+    CU_ASSERT_EQUAL(publish("news", "hi", 2), 1);
+    CU_ASSERT_EQUAL(publish("weather", "hi", 2), 0);
+    assert_reply(alice, "*3\r\n$7\r\nmessage\r\n$4\r\nnews\r\n$2\r\nhi\r\n");
+    
+    // Only subscription commands while subscribed
+    CU_ASSERT_FALSE(RUN(alice, "GET", "k"));
+    drop_reply(alice);
+    
+    CU_ASSERT_TRUE(RUN(alice, "UNSUBSCRIBE"));
+    assert_reply(alice, "*3\r\n$11\r\nunsubscribe\r\n$6\r\nsports\r\n:1\r\n"
+                        "*3\r\n$11\r\nunsubscribe\r\n$4\r\nnews\r\n:0\r\n");
+    CU_ASSERT_EQUAL(alice->client_class, CLIENT_CLASS_NORMAL);
+    CU_ASSERT_EQUAL(publish("news", "hi", 2), 0);
+}
+
+static void test_publish_to_pattern(void) {
+    CU_ASSERT_TRUE(RUN(alice, "PSUBSCRIBE", "news.*"));
+    CU_ASSERT_TRUE(RUN(bob, "PSUBSCRIBE", "n*"));
+    CU_ASSERT_TRUE(RUN(bob, "SUBSCRIBE", "news.it"));
+    drop_reply(alice);
+    drop_reply(bob);
+    
+    // Binary-safe payload, sent once per matching subscription
+    CU_ASSERT_EQUAL(publish("news.it", "a\0b", 3), 3);
+    CU_ASSERT_EQUAL(publish("new", "x", 1), 1);
+    assert_reply(alice, "*4\r\n$8\r\npmessage\r\n$6\r\nnews.*\r\n$7\r\nnews.it\r\n$3\r\na\0b\r\n");
+    assert_reply(bob, "*3\r\n$7\r\nmessage\r\n$7\r\nnews.it\r\n$3\r\na\0b\r\n"
+                      "*4\r\n$8\r\npmessage\r\n$2\r\nn*\r\n$7\r\nnews.it\r\n$3\r\na\0b\r\n"
+                      "*4\r\n$8\r\npmessage\r\n$2\r\nn*\r\n$3\r\nnew\r\n$1\r\nx\r\n");
+    
+    // Disconnecting drops every subscription
+    pubsub_unsubscribe_all(server, bob);
+    CU_ASSERT_EQUAL(publish("news.it", "x", 1), 1);
+    drop_reply(alice);
+}
+
+static void test_large_message_is_shared(void) {
+    CU_ASSERT_TRUE(RUN(alice, "SUBSCRIBE", "big"));
+    CU_ASSERT_TRUE(RUN(bob, "SUBSCRIBE", "big"));
+    
+    // Too big for the reply buffer: both queue the same encoded frame
+    size_t size = REPLY_CHUNK_SIZE + 1;
+    char* payload = malloc(size);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(payload);
+    memset(payload, 'x', size);
+    CU_ASSERT_EQUAL(publish("big", payload, size), 2);
+    free(payload);
+    
+    CU_ASSERT_PTR_NOT_NULL_FATAL(alice->reply_tail);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(bob->reply_tail);
+    CU_ASSERT_PTR_NOT_NULL(alice->reply_tail->obj);
+    CU_ASSERT_PTR_EQUAL(alice->reply_tail->obj, bob->reply_tail->obj);
+    
+    drop_reply(alice);
+    drop_reply(bob);
+}
+
+static void test_binary_names(void) {
+    pubsub_unsubscribe_all(server, alice);
+    pubsub_unsubscribe_all(server, bob);
+    drop_reply(alice);
+    drop_reply(bob);
+    
+    // Channels and patterns may hold a NUL byte, which takes part in matching
+    char* sub[] = {"SUBSCRIBE", "a\0b"};
+    size_t sub_len[] = {9, 3};
+    CU_ASSERT_TRUE(run_bytes(alice, sub, sub_len, 2));
+    assert_reply(alice, "*3\r\n$9\r\nsubscribe\r\n$3\r\na\0b\r\n:1\r\n");
+    char* psub[] = {"PSUBSCRIBE", "a\0*"};
+    size_t psub_len[] = {10, 3};
+    CU_ASSERT_TRUE(run_bytes(bob, psub, psub_len, 2));
+    drop_reply(bob);
+    
+    CU_ASSERT_EQUAL(pubsub_publish(server, "a\0c", 3, "m", 1), 1);
+    CU_ASSERT_EQUAL(pubsub_publish(server, "a", 1, "m", 1), 0);
+    CU_ASSERT_EQUAL(pubsub_publish(server, "a\0b", 3, "m", 1), 2);
+    assert_reply(alice, "*3\r\n$7\r\nmessage\r\n$3\r\na\0b\r\n$1\r\nm\r\n");
+    assert_reply(bob, "*4\r\n$8\r\npmessage\r\n$3\r\na\0*\r\n$3\r\na\0c\r\n$1\r\nm\r\n"
+                      "*4\r\n$8\r\npmessage\r\n$3\r\na\0*\r\n$3\r\na\0b\r\n$1\r\nm\r\n");
+    
+    CU_ASSERT_TRUE(RUN(alice, "UNSUBSCRIBE"));
+    assert_reply(alice, "*3\r\n$11\r\nunsubscribe\r\n$3\r\na\0b\r\n:0\r\n");
+    pubsub_unsubscribe_all(server, bob);
+}
+
+// Test suite initialization
+int init_pubsub_suite(void) {
+    CU_pSuite suite = CU_add_suite("Pub/Sub Tests", setup, teardown);
+    if (!suite) return CU_get_error();
+    
+    // Add test cases
+    if (!CU_add_test(suite, "test_glob_match", test_glob_match) ||
+        !CU_add_test(suite, "test_publish_to_channel", test_publish_to_channel) ||
+        !CU_add_test(suite, "test_publish_to_pattern", test_publish_to_pattern) ||
+        !CU_add_test(suite, "test_large_message_is_shared", test_large_message_is_shared) ||
+        !CU_add_test(suite, "test_binary_names", test_binary_names)) {
+        return CU_get_error();
+    }
+    
+    return CUE_SUCCESS;
+}
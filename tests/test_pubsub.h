@@ -0,0 +1,9 @@
+#ifndef TEST_PUBSUB_H
+#define TEST_PUBSUB_H
+
+#include <CUnit/CUnit.h>
+
+// Test suite initialization
+int init_pubsub_suite(void);
+
+#endif // TEST_PUBSUB_H 
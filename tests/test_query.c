@@ -0,0 +1,163 @@
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <CUnit/Automated.h>
+#include <CUnit/Console.h>
+#include <sys/socket.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "../src/server/server.h"
+
+// Test fixtures: a client on one end of a socket pair, with the other
+// end to send it queries
+static Client* client;
+static int peer;
+
+static void open_client(void) {
+    int fds[2];
+    CU_ASSERT_FATAL(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    client = client_create(fds[0]);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(client);
+    peer = fds[1];
+}
+
+static void close_client(void) {
+    client_free(client);
+    close(peer);
+}
+
+static void send_query(const char* data, size_t len) {
+    CU_ASSERT_FATAL(write(peer, data, len) == (ssize_t)len);
+}
+
+// Read what arrived and queue the commands it completes
+static void read_and_parse(void) {
+    CU_ASSERT_EQUAL_FATAL(client_read_query(client), CLIENT_IO_OK);
+    CU_ASSERT_EQUAL_FATAL(client_parse_query(client), CLIENT_IO_OK);
+}
+
+// Check the next queued command's arguments, joined by spaces, then
+// retire it the way the server does once it has run
+static void assert_next_command(const char* expected) {
+    CommandQueue* queue = &client->commands;
+    CU_ASSERT_FATAL(queue->next < queue->count);
+    
+    size_t i = queue->next++;
+    char joined[256];
+    size_t len = 0;
+    for (int arg = 0; arg < queue->argc[i]; arg++) {
+        size_t start = queue->argv_start[i] + arg;
+        len += snprintf(joined + len, sizeof(joined) - len, "%s%.*s", arg ? " " : "",
+                        (int)queue->argv_len[start], queue->argv[start]);
+    }
+    CU_ASSERT_STRING_EQUAL(joined, expected);
+    
+    client->query_offset += queue->frame_len[i];
+    if (queue->next == queue->count) client_reset_commands(client);
+}
+
+// Test cases
+static void test_pipeline_split_across_reads(void) {
+    open_client();
+    
+    // The second command stops in the middle of an argument
+    const char* first = "*1\r\n$4\r\nPING\r\n*2\r\n$3\r\nGET\r\n$3\r\nfo";
+    send_query(first, strlen(first));
+    read_and_parse();
+    CU_ASSERT_EQUAL(client->commands.count, 1);
+    CU_ASSERT_EQUAL(client->parse_offset, strlen("*1\r\n$4\r\nPING\r\n"));
+    
+    // Nothing more is read while parsed commands wait to run
+    send_query("o\r\n", 3);
+    size_t buffered = client->buffer_pos;
+    CU_ASSERT_EQUAL(client_read_query(client), CLIENT_IO_OK);
+    CU_ASSERT_EQUAL(client->buffer_pos, buffered);
+    
+    // The unfinished command stays put once the rest has run
+    assert_next_command("PING");
+    CU_ASSERT_EQUAL(client->query_offset, client->parse_offset);
+    CU_ASSERT_EQUAL(client->buffer_pos, buffered);
+    
+    const char* rest = "*1\r\n$4\r\nPING\r\n";
+    send_query(rest, strlen(rest));
+    read_and_parse();
+    CU_ASSERT_EQUAL(client->commands.count, 2);
+    assert_next_command("GET foo");
+    assert_next_command("PING");
+    
+    // All of it ran, so the buffer starts over
+    CU_ASSERT_EQUAL(client->buffer_pos, 0);
+    CU_ASSERT_EQUAL(client->query_offset, 0);
+    CU_ASSERT_EQUAL(client->parse_offset, 0);
+    
+    close_client();
+}
+
+// A pipeline longer than the query buffer: the command cut off at its end
+// is moved to the front once the ones before it ran, instead of growing
+// the buffer
+static void test_compaction(void) {
+    open_client();
+    
+    char pipeline[200 * 40];
+    size_t len = 0;
+    for (int i = 0; i < 200; i++) {
+        len += snprintf(pipeline + len, sizeof(pipeline) - len, "*3\r\n$3\r\nSET\r\n$4\r\nk%03d\r\n$4\r\nv%03d\r\n",
+                        i, i);
+    }
+    send_query(pipeline, len);
+    
+    int next = 0;
+    while (next < 200) {
+        read_and_parse();
+        CU_ASSERT_FATAL(client->commands.count > 0);
+        
+        // After the first read, what was left over sits at the front
+        if (next > 0) CU_ASSERT_TRUE(client->buffer[0] == '*');
+        while (client->commands.next < client->commands.count) {
+            char expected[32];
+            snprintf(expected, sizeof(expected), "SET k%03d v%03d", next, next);
+            assert_next_command(expected);
+            next++;
+        }
+    }
+    CU_ASSERT_EQUAL(client->buffer_size, BUFFER_SIZE);
+    CU_ASSERT_EQUAL(client->buffer_pos, 0);
+    
+    close_client();
+}
+
+// Data handed over while commands are still queued, as io_uring does, may
+// grow the buffer; the queued commands move along with it
+static void test_growth_keeps_queued_commands(void) {
+    open_client();
+    
+    const char* get = "*2\r\n$3\r\nGET\r\n$3\r\nfoo\r\n";
+    CU_ASSERT_EQUAL(client_append_query(client, get, strlen(get)), CLIENT_IO_OK);
+    CU_ASSERT_EQUAL(client_parse_query(client), CLIENT_IO_OK);
+    CU_ASSERT_EQUAL(client->commands.count, 1);
+    
+    // Too big for what is left of the buffer, and not parsed yet
+    char big[2 * BUFFER_SIZE];
+    size_t len = snprintf(big, sizeof(big), "*2\r\n$4\r\nECHO\r\n$%d\r\n", BUFFER_SIZE);
+    memset(big + len, 'x', sizeof(big) - len);
+    CU_ASSERT_EQUAL(client_append_query(client, big, sizeof(big)), CLIENT_IO_OK);
+    CU_ASSERT_TRUE(client->buffer_size > BUFFER_SIZE);
+    
+    assert_next_command("GET foo");
+    close_client();
+}
+
+// Test suite initialization
+int init_query_suite(void) {
+    CU_pSuite suite = CU_add_suite("Query Buffer Tests", NULL, NULL);
+    if (!suite) return CU_get_error();
+    
+    if (!CU_add_test(suite, "test_pipeline_split_across_reads", test_pipeline_split_across_reads) ||
+        !CU_add_test(suite, "test_compaction", test_compaction) ||
+        !CU_add_test(suite, "test_growth_keeps_queued_commands", test_growth_keeps_queued_commands)) {
+        return CU_get_error();
+    }
+    
+    return CUE_SUCCESS;
+}
@@ -0,0 +1,9 @@
+#ifndef TEST_QUERY_H
+#define TEST_QUERY_H
+
+#include <CUnit/CUnit.h>
+
+// Test suite initialization
+int init_query_suite(void);
+
+#endif // TEST_QUERY_H 
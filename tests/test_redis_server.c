@@ -3,135 +3,478 @@
 #include <CUnit/Automated.h>
 #include <CUnit/Console.h>
 #include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
-#include "../src/server/redis_server.h"
+#include "../src/server/server.h"
 
-// Test fixtures
-static RedisServer* server;
+// Test fixtures: a real server on its own thread, spoken to over TCP
+static Server* server;
+static pthread_t server_thread;
+static bool server_started;
 static int test_port = 6380;  // Use different port than default for testing
 
+static void* server_main(void* arg) {
+    server_start(arg);
+    return NULL;
+}
+
+// Run a server on its own thread; it is listening once it runs. Gives
+// up after a second.
+static bool start_server(Server* s, pthread_t* thread) {
+    if (!s || pthread_create(thread, NULL, server_main, s) != 0) return false;
+    for (int i = 0; i < 1000 && !server_is_running(s); i++) usleep(1000);
+    if (server_is_running(s)) return true;
+    pthread_join(*thread, NULL);
+    return false;
+}
+
+static void stop_server(Server* s, pthread_t thread) {
+    server_stop(s);
+    pthread_join(thread, NULL);
+}
+
 // Setup and teardown functions
 static int setup(void) {
-    server = createRedisServer(test_port);
-    return (server != NULL) ? 0 : -1;
+    server = server_create("127.0.0.1", test_port, 16);
+    server_started = start_server(server, &server_thread);
+    return server_started ? 0 : -1;
 }
 
 static int teardown(void) {
-    if (server) {
-        stopRedisServer(server);
-        freeRedisServer(server);
-        server = NULL;
+    if (server_started) {
+        stop_server(server, server_thread);
+        server_started = false;
     }
+    server_destroy(server);
+    server = NULL;
     return 0;
 }
 
-// Helper function to create a test client
-static int create_test_client(void) {
+// Connect to a server on port. A non-zero rcvbuf shrinks the socket's
+// receive buffer, so replies the client doesn't read pile up in the
+// server instead of the kernel.
+static int connect_tcp(int port, int rcvbuf) {
     int sock = socket(AF_INET, SOCK_STREAM, 0);
     if (sock < 0) return -1;
-
-    struct sockaddr_in addr;
+    
+    // A missing reply fails the test instead of hanging it
+    struct timeval timeout = {2, 0};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (rcvbuf > 0) setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    
+    struct sockaddr_in addr = {0};
     addr.sin_family = AF_INET;
-    addr.sin_port = htons(test_port);
+    addr.sin_port = htons(port);
     addr.sin_addr.s_addr = inet_addr("127.0.0.1");
-
+    
     if (connect(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
         close(sock);
         return -1;
     }
-
+    
     return sock;
 }
 
-// Helper function to send RESP command
-static void send_resp_command(int sock, const char* cmd) {
-    char* resp = malloc(strlen(cmd) * 2 + 16);  // Extra space for RESP formatting
-    if (!resp) return;
+static int connect_unix(const char* path) {
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (sock < 0) return -1;
+    
+    struct timeval timeout = {2, 0};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    if (connect(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(sock);
+        return -1;
+    }
+    
+    return sock;
+}
 
-    snprintf(resp, strlen(cmd) * 2 + 16, "*1\r\n$%zu\r\n%s\r\n", strlen(cmd), cmd);
-    send(sock, resp, strlen(resp), 0);
-    free(resp);
+// Helper function to create a test client
+static int create_test_client(void) {
+    return connect_tcp(test_port, 0);
 }
 
-// Test cases
-static void test_server_creation(void) {
-    CU_ASSERT_PTR_NOT_NULL(server);
-    CU_ASSERT_PTR_NOT_NULL(server->db);
-    CU_ASSERT_EQUAL(server->server_socket, -1);  // Not started yet
+// Send a command as a RESP array of bulk strings
+static void send_resp_command(int sock, int argc, const char** argv) {
+    char buf[1024];
+    size_t len = snprintf(buf, sizeof(buf), "*%d\r\n", argc);
+    for (int i = 0; i < argc; i++) {
+        len += snprintf(buf + len, sizeof(buf) - len, "$%zu\r\n%s\r\n", strlen(argv[i]), argv[i]);
+    }
+    CU_ASSERT_EQUAL(send(sock, buf, len, 0), (ssize_t)len);
 }
 
-static void test_set_command(void) {
-    int client_sock = create_test_client();
-    CU_ASSERT(client_sock > 0);
+#define SEND(sock, ...) \
+    send_resp_command(sock, sizeof((const char*[]){__VA_ARGS__}) / sizeof(char*), (const char*[]){__VA_ARGS__})
 
-    // Send SET command
-    send_resp_command(client_sock, "SET test_key test_value");
+static void send_all(int sock, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(sock, data, len, 0);
+        CU_ASSERT_FATAL(n > 0);
+        data += n;
+        len -= n;
+    }
+}
 
-    // Read response
-    char buffer[1024];
-    ssize_t bytes = recv(client_sock, buffer, sizeof(buffer) - 1, 0);
-    CU_ASSERT(bytes > 0);
-    buffer[bytes] = '\0';
+// SET key to len bytes of 'x'
+static void set_big_value(int sock, const char* key, size_t len) {
+    char header[128];
+    int header_len = snprintf(header, sizeof(header), "*3\r\n$3\r\nSET\r\n$%zu\r\n%s\r\n$%zu\r\n",
+                              strlen(key), key, len);
+    char* value = malloc(len + 2);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(value);
+    memset(value, 'x', len);
+    memcpy(value + len, "\r\n", 2);
+    send_all(sock, header, header_len);
+    send_all(sock, value, len + 2);
+    free(value);
+}
 
-    // Verify response
-    CU_ASSERT_STRING_EQUAL(buffer, "$2\r\nOK\r\n");
+// Send count copies of a command in one write, as a client that doesn't
+// wait for replies would
+static void send_pipeline(int sock, int count, int argc, const char** argv) {
+    size_t size = 16;
+    for (int i = 0; i < argc; i++) size += strlen(argv[i]) + 32;
+    char* command = malloc(size);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(command);
+    size_t len = snprintf(command, size, "*%d\r\n", argc);
+    for (int i = 0; i < argc; i++) {
+        len += snprintf(command + len, size - len, "$%zu\r\n%s\r\n", strlen(argv[i]), argv[i]);
+    }
+    
+    char* pipeline = malloc(len * count);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(pipeline);
+    for (int i = 0; i < count; i++) memcpy(pipeline + i * len, command, len);
+    send_all(sock, pipeline, len * count);
+    free(pipeline);
+    free(command);
+}
 
-    close(client_sock);
+static bool recv_exact(int sock, char* buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = recv(sock, buf, len, 0);
+        if (n <= 0) return false;
+        buf += n;
+        len -= n;
+    }
+    return true;
 }
 
-static void test_get_command(void) {
-    int client_sock = create_test_client();
-    CU_ASSERT(client_sock > 0);
+// Read count bulk replies holding len bytes of 'x' each
+static void assert_big_replies(int sock, size_t len, int count) {
+    char expected[32], header[32];
+    size_t header_len = snprintf(expected, sizeof(expected), "$%zu\r\n", len);
+    char* value = malloc(len + 2);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(value);
+    for (int i = 0; i < count; i++) {
+        CU_ASSERT_FATAL(recv_exact(sock, header, header_len));
+        CU_ASSERT_EQUAL(memcmp(header, expected, header_len), 0);
+        CU_ASSERT_FATAL(recv_exact(sock, value, len + 2));
+        CU_ASSERT_TRUE(value[0] == 'x' && value[len - 1] == 'x' && memcmp(value + len, "\r\n", 2) == 0);
+    }
+    free(value);
+}
 
-    // First set a value
-    send_resp_command(client_sock, "SET test_key test_value");
+// Read replies until count lines have come, returning the last one.
+// Fails the test if they don't.
+static void read_lines(int sock, int count, char* last, size_t last_size) {
+    char buf[65536];
+    size_t line_len = 0;
+    last[0] = '\0';
+    while (count > 0) {
+        ssize_t n = recv(sock, buf, sizeof(buf), 0);
+        CU_ASSERT_FATAL(n > 0);
+        for (ssize_t i = 0; i < n; i++) {
+            if (buf[i] == '\n') {
+                last[line_len > 0 ? line_len - 1 : 0] = '\0';
+                line_len = 0;
+                count--;
+            } else if (line_len < last_size - 1) {
+                last[line_len++] = buf[i];
+            }
+        }
+    }
+}
 
-    // Then get it
-    send_resp_command(client_sock, "GET test_key");
+// Read until the server closes the connection. False if it is still
+// open when the receive timeout runs out.
+static bool wait_closed(int sock) {
+    char buf[65536];
+    while (true) {
+        ssize_t n = recv(sock, buf, sizeof(buf), 0);
+        if (n == 0 || (n < 0 && errno == ECONNRESET)) return true;
+        if (n < 0) return false;
+    }
+}
 
-    // Read response
+// Read exactly as many bytes as expected, which may come in pieces
+static void assert_response(int sock, const char* expected) {
+    size_t expected_len = strlen(expected);
     char buffer[1024];
-    ssize_t bytes = recv(client_sock, buffer, sizeof(buffer) - 1, 0);
-    CU_ASSERT(bytes > 0);
-    buffer[bytes] = '\0';
+    size_t got = 0;
+    while (got < expected_len) {
+        ssize_t bytes = recv(sock, buffer + got, expected_len - got, 0);
+        if (bytes <= 0) break;
+        got += bytes;
+    }
+    buffer[got] = '\0';
+    CU_ASSERT_STRING_EQUAL(buffer, expected);
+}
+
+// Test cases
+static void test_server_creation(void) {
+    CU_ASSERT_PTR_NOT_NULL(server);
+    CU_ASSERT_PTR_NOT_NULL(server->db);
+    CU_ASSERT_TRUE(server->server_fd >= 0);
+}
 
-    // Verify response
-    CU_ASSERT_STRING_EQUAL(buffer, "$11\r\ntest_value\r\n");
+static void test_set_command(void) {
+    int client_sock = create_test_client();
+    CU_ASSERT_FATAL(client_sock >= 0);
+    
+    SEND(client_sock, "SET", "test_key", "test_value");
+    assert_response(client_sock, "+OK\r\n");
+    
+    close(client_sock);
+}
 
+static void test_get_command(void) {
+    int client_sock = create_test_client();
+    CU_ASSERT_FATAL(client_sock >= 0);
+    
+    // Both commands in one go; the replies come back in order
+    SEND(client_sock, "SET", "test_key", "test_value");
+    SEND(client_sock, "GET", "test_key");
+    assert_response(client_sock, "+OK\r\n$10\r\ntest_value\r\n");
+    
     close(client_sock);
 }
 
 static void test_del_command(void) {
     int client_sock = create_test_client();
-    CU_ASSERT(client_sock > 0);
+    CU_ASSERT_FATAL(client_sock >= 0);
+    
+    SEND(client_sock, "SET", "test_key", "test_value");
+    assert_response(client_sock, "+OK\r\n");
+    SEND(client_sock, "DEL", "test_key");
+    assert_response(client_sock, ":1\r\n");
+    
+    // The key is gone
+    SEND(client_sock, "GET", "test_key");
+    assert_response(client_sock, "$-1\r\n");
+    
+    close(client_sock);
+}
 
-    // First set a value
-    send_resp_command(client_sock, "SET test_key test_value");
+// Output buffer limits. Each test runs its own server, as the limits
+// apply to clients connecting after they are set.
+static void test_reply_hard_limit(void) {
+    Server* limited = server_create("127.0.0.1", test_port + 1, 16);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(limited);
+    limited->config.reply_limits[CLIENT_CLASS_NORMAL].hard_bytes = 256 * 1024;
+    pthread_t thread;
+    CU_ASSERT_FATAL(start_server(limited, &thread));
+    
+    int sock = connect_tcp(test_port + 1, 4096);
+    CU_ASSERT_FATAL(sock >= 0);
+    set_big_value(sock, "big", 64 * 1024);
+    assert_response(sock, "+OK\r\n");
+    
+    // 25MB of replies that aren't read: dropped once 256k are pending
+    send_pipeline(sock, 400, 2, (const char*[]){"GET", "big"});
+    CU_ASSERT_TRUE(wait_closed(sock));
+    close(sock);
+    
+    stop_server(limited, thread);
+    server_destroy(limited);
+}
 
-    // Then delete it
-    send_resp_command(client_sock, "DEL test_key");
+static void test_reply_soft_limit(void) {
+    Server* limited = server_create("127.0.0.1", test_port + 2, 16);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(limited);
+    limited->config.reply_limits[CLIENT_CLASS_NORMAL].soft_bytes = 256 * 1024;
+    limited->config.reply_limits[CLIENT_CLASS_NORMAL].soft_seconds = 2;
+    pthread_t thread;
+    CU_ASSERT_FATAL(start_server(limited, &thread));
+    
+    int sock = connect_tcp(test_port + 2, 4096);
+    CU_ASSERT_FATAL(sock >= 0);
+    set_big_value(sock, "big", 64 * 1024);
+    assert_response(sock, "+OK\r\n");
+    send_pipeline(sock, 400, 2, (const char*[]){"GET", "big"});
+    
+    // Over the soft limit, but not for long enough yet. The stuck client
+    // sends nothing, so only the once-a-second sweep can drop it.
+    usleep(300 * 1000);
+    CU_ASSERT_EQUAL(limited->client_count, 1);
+    for (int i = 0; i < 500 && limited->client_count > 0; i++) usleep(10 * 1000);
+    CU_ASSERT_EQUAL(limited->client_count, 0);
+    CU_ASSERT_TRUE(wait_closed(sock));
+    close(sock);
+    
+    stop_server(limited, thread);
+    server_destroy(limited);
+}
 
-    // Read response
-    char buffer[1024];
-    ssize_t bytes = recv(client_sock, buffer, sizeof(buffer) - 1, 0);
-    CU_ASSERT(bytes > 0);
-    buffer[bytes] = '\0';
+static bool any_client_paused(const Server* s) {
+    for (size_t i = 0; i < s->client_count; i++) {
+        if (s->clients[i]->reply_paused) return true;
+    }
+    return false;
+}
 
-    // Verify response
-    CU_ASSERT_STRING_EQUAL(buffer, "$1\r\n1\r\n");
+static void test_paused_pipeline_resumes(void) {
+    int sock = connect_tcp(test_port, 4096);
+    CU_ASSERT_FATAL(sock >= 0);
+    set_big_value(sock, "big", 256 * 1024);
+    assert_response(sock, "+OK\r\n");
+    
+    // 8MB of replies: the client stops running commands once
+    // REPLY_PAUSE_BYTES are pending, and the SET waits behind them
+    send_pipeline(sock, 32, 2, (const char*[]){"GET", "big"});
+    SEND(sock, "SET", "after", "pause");
+    bool paused = false;
+    for (int i = 0; i < 100 && !paused; i++) {
+        usleep(10 * 1000);
+        paused = any_client_paused(server);
+    }
+    CU_ASSERT_TRUE(paused);
+    
+    // Reading lets it go on where it stopped
+    assert_big_replies(sock, 256 * 1024, 32);
+    assert_response(sock, "+OK\r\n");
+    CU_ASSERT_FALSE(any_client_paused(server));
+    
+    close(sock);
+}
 
-    // Try to get deleted key
-    send_resp_command(client_sock, "GET test_key");
-    bytes = recv(client_sock, buffer, sizeof(buffer) - 1, 0);
-    CU_ASSERT(bytes > 0);
-    buffer[bytes] = '\0';
+// A long pipeline runs a slice per loop iteration, so a client sending one
+// command isn't served only after it
+static void test_pipeline_yields(void) {
+    Server* budgeted = server_create("127.0.0.1", test_port + 3, 16);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(budgeted);
+    budgeted->config.client_budget_commands = 1;
+    budgeted->config.client_budget_usec = 0;
+    pthread_t thread;
+    CU_ASSERT_FATAL(start_server(budgeted, &thread));
+    
+    int heavy = connect_tcp(test_port + 3, 0);
+    int light = connect_tcp(test_port + 3, 0);
+    CU_ASSERT_FATAL(heavy >= 0 && light >= 0);
+    
+    // A long MSET grows the heavy client's query buffer, so its whole
+    // pipeline is read, and queued, at once
+    static const char* mset[1 + 2 * 16384] = {"MSET"};
+    for (int i = 1; i < 1 + 2 * 16384; i++) mset[i] = i % 2 ? "k" : "v";
+    send_pipeline(heavy, 1, 1 + 2 * 16384, mset);
+    assert_response(heavy, "+OK\r\n");
+    
+    // Sent in full before the light client's command, without waiting
+    // for the server to read it
+    int sndbuf = 1024 * 1024;
+    setsockopt(heavy, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    send_pipeline(heavy, 8000, 2, (const char*[]){"INCR", "n"});
+    SEND(light, "INCR", "n");
+    
+    // Served long before the heavy client's pipeline is through
+    char last[32];
+    read_lines(light, 1, last, sizeof(last));
+    CU_ASSERT_EQUAL(last[0], ':');
+    CU_ASSERT_TRUE(atoi(last + 1) < 1000);
+    
+    // The rest of the pipeline runs on by itself, with nothing more sent
+    read_lines(heavy, 8000, last, sizeof(last));
+    CU_ASSERT_STRING_EQUAL(last, ":8001");
+    
+    close(heavy);
+    close(light);
+    stop_server(budgeted, thread);
+    server_destroy(budgeted);
+}
 
-    // Verify response
-    CU_ASSERT_STRING_EQUAL(buffer, "$5\r\n(nil)\r\n");
+// Serving on a Unix socket only, over the socket file a crashed server
+// would leave behind, which is removed again on shutdown
+static void test_unix_socket(void) {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/medis-test-%d.sock", (int)getpid());
+    
+    int stale = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+    unlink(path);
+    CU_ASSERT_FATAL(bind(stale, (struct sockaddr*)&addr, sizeof(addr)) == 0);
+    close(stale);
+    CU_ASSERT_EQUAL(access(path, F_OK), 0);
+    
+    Server* local = server_create("127.0.0.1", 0, 16);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(local);
+    local->config.unix_socket = path;
+    pthread_t thread;
+    CU_ASSERT_FATAL(start_server(local, &thread));
+    
+    int sock = connect_unix(path);
+    CU_ASSERT_FATAL(sock >= 0);
+    SEND(sock, "SET", "where", "unix");
+    assert_response(sock, "+OK\r\n");
+    SEND(sock, "GET", "where");
+    assert_response(sock, "$4\r\nunix\r\n");
+    close(sock);
+    
+    stop_server(local, thread);
+    server_destroy(local);
+    CU_ASSERT_NOT_EQUAL(access(path, F_OK), 0);
+    CU_ASSERT_EQUAL(connect_unix(path), -1);
+}
 
-    close(client_sock);
+// The io_uring backend serves the same traffic as epoll: single commands,
+// a pipeline and a reply sent by reference. Where the kernel has no
+// io_uring the server falls back to epoll, and there is nothing to test.
+static void test_io_uring_backend(void) {
+    Server* ring = server_create("127.0.0.1", test_port + 4, 16);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(ring);
+    ring->config.backend = SERVER_BACKEND_IO_URING;
+    pthread_t thread;
+    CU_ASSERT_FATAL(start_server(ring, &thread));
+    if (ring->config.backend != SERVER_BACKEND_IO_URING) {
+        printf("io_uring not available, skipped ");
+        stop_server(ring, thread);
+        server_destroy(ring);
+        return;
+    }
+    
+    int sock = connect_tcp(test_port + 4, 0);
+    CU_ASSERT_FATAL(sock >= 0);
+    SEND(sock, "SET", "ring", "value");
+    assert_response(sock, "+OK\r\n");
+    SEND(sock, "GET", "ring");
+    assert_response(sock, "$5\r\nvalue\r\n");
+    
+    send_pipeline(sock, 1000, 2, (const char*[]){"INCR", "n"});
+    char last[32];
+    read_lines(sock, 1000, last, sizeof(last));
+    CU_ASSERT_STRING_EQUAL(last, ":1000");
+    
+    set_big_value(sock, "big", 256 * 1024);
+    assert_response(sock, "+OK\r\n");
+    send_pipeline(sock, 4, 2, (const char*[]){"GET", "big"});
+    assert_big_replies(sock, 256 * 1024, 4);
+    close(sock);
+    
+    stop_server(ring, thread);
+    server_destroy(ring);
 }
 
 // Test suite initialization
@@ -143,9 +486,15 @@ int init_redis_server_suite(void) {
     if (!CU_add_test(suite, "test_server_creation", test_server_creation) ||
         !CU_add_test(suite, "test_set_command", test_set_command) ||
         !CU_add_test(suite, "test_get_command", test_get_command) ||
-        !CU_add_test(suite, "test_del_command", test_del_command)) {
+        !CU_add_test(suite, "test_del_command", test_del_command) ||
+        !CU_add_test(suite, "test_reply_hard_limit", test_reply_hard_limit) ||
+        !CU_add_test(suite, "test_reply_soft_limit", test_reply_soft_limit) ||
+        !CU_add_test(suite, "test_paused_pipeline_resumes", test_paused_pipeline_resumes) ||
+        !CU_add_test(suite, "test_pipeline_yields", test_pipeline_yields) ||
+        !CU_add_test(suite, "test_unix_socket", test_unix_socket) ||
+        !CU_add_test(suite, "test_io_uring_backend", test_io_uring_backend)) {
         return CU_get_error();
     }
     
     return CUE_SUCCESS;
-} 
\ No newline at end of file
+} 
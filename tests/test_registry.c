@@ -0,0 +1,116 @@
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <CUnit/Automated.h>
+#include <CUnit/Console.h>
+#include <stdlib.h>
+#include "../src/server/server.h"
+
+#define REGISTRY_SIZE 8
+
+// Test fixtures
+static Server* server;
+
+// Setup and teardown functions
+static int setup(void) {
+    server = server_create(DEFAULT_HOST, 0, REGISTRY_SIZE);
+    return server ? 0 : -1;
+}
+
+static int teardown(void) {
+    server_destroy(server);
+    return 0;
+}
+
+static Client* register_client(void) {
+    Client* client = client_create(-1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(client);
+    server_register_client(server, client);
+    return client;
+}
+
+static void unregister_client(Client* client) {
+    server_unregister_client(server, client);
+    client_free(client);
+}
+
+// Every registered client is found by its ID, and sits in its slot
+static void assert_registry(Client** live, size_t count) {
+    CU_ASSERT_EQUAL(server->client_count, count);
+    for (size_t i = 0; i < count; i++) {
+        CU_ASSERT_PTR_EQUAL(server_find_client(server, live[i]->id), live[i]);
+        CU_ASSERT_PTR_EQUAL(server->clients[live[i]->slot], live[i]);
+    }
+}
+
+// Test cases
+static void test_register_and_find(void) {
+    Client* live[3];
+    for (int i = 0; i < 3; i++) live[i] = register_client();
+    
+    CU_ASSERT_TRUE(live[0]->id != live[1]->id && live[1]->id != live[2]->id);
+    assert_registry(live, 3);
+    CU_ASSERT_PTR_NULL(server_find_client(server, live[2]->id + 1));
+    CU_ASSERT_PTR_NULL(server_find_client(server, 0));
+    
+    for (int i = 0; i < 3; i++) unregister_client(live[i]);
+    CU_ASSERT_EQUAL(server->client_count, 0);
+}
+
+static void test_unregister(void) {
+    Client* live[3];
+    for (int i = 0; i < 3; i++) live[i] = register_client();
+    uint64_t gone = live[0]->id;
+    
+    // The last client takes the free slot
+    unregister_client(live[0]);
+    CU_ASSERT_PTR_NULL(server_find_client(server, gone));
+    CU_ASSERT_EQUAL(live[2]->slot, 0);
+    assert_registry(live + 1, 2);
+    
+    unregister_client(live[1]);
+    unregister_client(live[2]);
+    CU_ASSERT_EQUAL(server->client_count, 0);
+}
+
+// Keep the registry full while clients come and go, so IDs collide and
+// wrap around the index and removals shift their neighbours back
+static void test_churn(void) {
+    Client* live[REGISTRY_SIZE];
+    for (int i = 0; i < REGISTRY_SIZE; i++) live[i] = register_client();
+    
+    unsigned int seed = 1;
+    for (int round = 0; round < 2000; round++) {
+        seed = seed * 1103515245 + 12345;
+        size_t victim = (seed >> 16) % REGISTRY_SIZE;
+        uint64_t gone = live[victim]->id;
+        unregister_client(live[victim]);
+        
+        // Every other client must still be found past the hole
+        live[victim] = live[REGISTRY_SIZE - 1];
+        assert_registry(live, REGISTRY_SIZE - 1);
+        CU_ASSERT_PTR_NULL(server_find_client(server, gone));
+        
+        live[REGISTRY_SIZE - 1] = register_client();
+        assert_registry(live, REGISTRY_SIZE);
+    }
+    
+    // Removing them all leaves no entry behind
+    for (int i = 0; i < REGISTRY_SIZE; i++) unregister_client(live[i]);
+    for (size_t i = 0; i <= server->id_index_mask; i++) {
+        CU_ASSERT_PTR_NULL(server->clients_by_id[i]);
+    }
+}
+
+// Test suite initialization
+int init_registry_suite(void) {
+    CU_pSuite suite = CU_add_suite("Client Registry Tests", setup, teardown);
+    if (!suite) return CU_get_error();
+    
+    if (!CU_add_test(suite, "test_register_and_find", test_register_and_find) ||
+        !CU_add_test(suite, "test_unregister", test_unregister) ||
+        !CU_add_test(suite, "test_churn", test_churn)) {
+        return CU_get_error();
+    }
+    
+    return CUE_SUCCESS;
+}
@@ -0,0 +1,9 @@
+#ifndef TEST_REGISTRY_H
+#define TEST_REGISTRY_H
+
+#include <CUnit/CUnit.h>
+
+// Test suite initialization
+int init_registry_suite(void);
+
+#endif // TEST_REGISTRY_H 
@@ -0,0 +1,194 @@
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <CUnit/Automated.h>
+#include <CUnit/Console.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include "../src/server/server.h"
+
+// More than the fixed buffer and two overflow chunks hold
+#define PATTERN_LEN (3 * REPLY_CHUNK_SIZE + 100)
+
+// Test fixtures
+static Client* client;
+static char* pattern;
+
+// Setup and teardown functions
+static int setup(void) {
+    pattern = malloc(PATTERN_LEN);
+    if (!pattern) return -1;
+    for (size_t i = 0; i < PATTERN_LEN; i++) pattern[i] = 'a' + i % 26;
+    return 0;
+}
+
+static int teardown(void) {
+    free(pattern);
+    return 0;
+}
+
+// Queue the pattern a piece at a time, as replies are built
+static void queue_pattern(size_t piece) {
+    for (size_t pos = 0; pos < PATTERN_LEN; pos += piece) {
+        send_raw(client, pattern + pos, PATTERN_LEN - pos < piece ? PATTERN_LEN - pos : piece);
+    }
+}
+
+static void assert_reply_bytes(const char* expected, size_t expected_len) {
+    size_t len;
+    char* reply = client_take_reply(client, &len);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(reply);
+    CU_ASSERT_EQUAL(len, expected_len);
+    CU_ASSERT_TRUE(len == expected_len && memcmp(reply, expected, len) == 0);
+    free(reply);
+    CU_ASSERT_FALSE(client_has_pending_reply(client));
+}
+
+// Test cases
+static void test_overflow_chain(void) {
+    client = client_create(-1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(client);
+    
+    // The fixed buffer fills up first, then chunks are chained after it
+    queue_pattern(1000);
+    CU_ASSERT_EQUAL(client->reply_pos, REPLY_CHUNK_SIZE);
+    CU_ASSERT_EQUAL(client_reply_size(client), PATTERN_LEN);
+    
+    size_t chunks = 0, chained = 0;
+    for (ReplyChunk* chunk = client->reply_head; chunk; chunk = chunk->next) {
+        CU_ASSERT_TRUE(chunk->used <= chunk->size);
+        chained += chunk->used;
+        chunks++;
+        if (!chunk->next) CU_ASSERT_PTR_EQUAL(chunk, client->reply_tail);
+    }
+    CU_ASSERT_EQUAL(chunks, 3);
+    CU_ASSERT_EQUAL(chained, PATTERN_LEN - REPLY_CHUNK_SIZE);
+    assert_reply_bytes(pattern, PATTERN_LEN);
+    
+    // A piece bigger than a chunk gets a chunk of its own size
+    queue_pattern(PATTERN_LEN);
+    assert_reply_bytes(pattern, PATTERN_LEN);
+    
+    client_free(client);
+}
+
+// Large values are queued by reference, between the bytes around them
+static void test_reference_chunk(void) {
+    client = client_create(-1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(client);
+    RedisObject* obj = createRedisObject(REDIS_STRING, createRedisStringLen(pattern, REPLY_REF_MIN_BYTES));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(obj);
+    
+    send_bulk(client, "a", 1);
+    send_bulk_object(client, obj);
+    send_ok(client);
+    CU_ASSERT_EQUAL(obj->refcount, 2);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(client->reply_head);
+    CU_ASSERT_PTR_EQUAL(client->reply_head->obj, obj);
+    
+    char header[64];
+    size_t header_len = snprintf(header, sizeof(header), "$1\r\na\r\n$%d\r\n", REPLY_REF_MIN_BYTES);
+    size_t expected_len = header_len + REPLY_REF_MIN_BYTES + strlen("\r\n+OK\r\n");
+    char* expected = malloc(expected_len);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(expected);
+    memcpy(expected, header, header_len);
+    memcpy(expected + header_len, pattern, REPLY_REF_MIN_BYTES);
+    memcpy(expected + header_len + REPLY_REF_MIN_BYTES, "\r\n+OK\r\n", 7);
+    assert_reply_bytes(expected, expected_len);
+    free(expected);
+    
+    // Written, so the reply let go of the value
+    CU_ASSERT_EQUAL(obj->refcount, 1);
+    decrRefCount(obj);
+    client_free(client);
+}
+
+// A short write leaves the rest queued, and the next iovec starts where
+// the write stopped, in the fixed buffer or in the middle of a chunk
+static void test_partial_consume(void) {
+    client = client_create(-1);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(client);
+    queue_pattern(1000);
+    
+    struct iovec iov[REPLY_MAX_IOV];
+    size_t total;
+    client_reply_consume(client, 100);
+    CU_ASSERT_EQUAL(client_reply_iov(client, iov, REPLY_MAX_IOV, &total), 4);
+    CU_ASSERT_PTR_EQUAL(iov[0].iov_base, client->reply + 100);
+    CU_ASSERT_EQUAL(total, PATTERN_LEN - 100);
+    
+    // Past the fixed buffer and into the first chunk
+    client_reply_consume(client, REPLY_CHUNK_SIZE - 100 + 50);
+    CU_ASSERT_EQUAL(client->reply_pos, 0);
+    CU_ASSERT_EQUAL(client_reply_iov(client, iov, REPLY_MAX_IOV, &total), 3);
+    CU_ASSERT_PTR_EQUAL(iov[0].iov_base, client->reply_head->data + 50);
+    CU_ASSERT_EQUAL(total, PATTERN_LEN - REPLY_CHUNK_SIZE - 50);
+    
+    // Fewer iovecs than blocks: the rest waits for the next write
+    CU_ASSERT_EQUAL(client_reply_iov(client, iov, 1, &total), 1);
+    CU_ASSERT_EQUAL(total, client->reply_head->used - 50);
+    
+    // Nothing is queued twice: new replies go after the rest
+    send_raw(client, "+OK\r\n", 5);
+    size_t len;
+    char* reply = client_take_reply(client, &len);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(reply);
+    CU_ASSERT_EQUAL(len, PATTERN_LEN - REPLY_CHUNK_SIZE - 50 + 5);
+    CU_ASSERT_EQUAL(memcmp(reply, pattern + REPLY_CHUNK_SIZE + 50, PATTERN_LEN - REPLY_CHUNK_SIZE - 50), 0);
+    CU_ASSERT_EQUAL(memcmp(reply + len - 5, "+OK\r\n", 5), 0);
+    free(reply);
+    
+    client_free(client);
+}
+
+// Flush into a socket that takes a little at a time, reading what it
+// took in between: every byte arrives once, in order
+static void test_flush_short_writes(void) {
+    int fds[2];
+    CU_ASSERT_FATAL(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    int sndbuf = 4096;
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    client = client_create(fds[0]);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(client);
+    queue_pattern(1000);
+    
+    char* received = malloc(PATTERN_LEN);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(received);
+    size_t got = 0;
+    int short_writes = 0;
+    while (got < PATTERN_LEN) {
+        CU_ASSERT_FATAL(client_flush(client));
+        if (client_has_pending_reply(client)) short_writes++;
+        
+        ssize_t n = recv(fds[1], received + got, PATTERN_LEN - got, MSG_DONTWAIT);
+        CU_ASSERT_FATAL(n > 0);
+        got += n;
+    }
+    CU_ASSERT_TRUE(short_writes > 0);
+    CU_ASSERT_FALSE(client_has_pending_reply(client));
+    CU_ASSERT_EQUAL(memcmp(received, pattern, PATTERN_LEN), 0);
+    
+    free(received);
+    client_free(client);
+    close(fds[1]);
+}
+
+// Test suite initialization
+int init_reply_suite(void) {
+    CU_pSuite suite = CU_add_suite("Reply Buffer Tests", setup, teardown);
+    if (!suite) return CU_get_error();
+    
+    if (!CU_add_test(suite, "test_overflow_chain", test_overflow_chain) ||
+        !CU_add_test(suite, "test_reference_chunk", test_reference_chunk) ||
+        !CU_add_test(suite, "test_partial_consume", test_partial_consume) ||
+        !CU_add_test(suite, "test_flush_short_writes", test_flush_short_writes)) {
+        return CU_get_error();
+    }
+    
+    return CUE_SUCCESS;
+}
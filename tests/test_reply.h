@@ -0,0 +1,9 @@
+#ifndef TEST_REPLY_H
+#define TEST_REPLY_H
+
+#include <CUnit/CUnit.h>
+
+// Test suite initialization
+int init_reply_suite(void);
+
+#endif // TEST_REPLY_H 
@@ -0,0 +1,211 @@
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <CUnit/Automated.h>
+#include <CUnit/Console.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/server/resp.h"
+
+// Test fixtures
+static RespParser parser;
+
+// Setup and teardown functions
+static int setup(void) {
+    return resp_parser_init(&parser) ? 0 : -1;
+}
+
+static int teardown(void) {
+    resp_parser_free(&parser);
+    return 0;
+}
+
+// Test cases
+static void test_multibulk(void) {
+    char buf[] = "*3\r\n$3\r\nSET\r\n$3\r\nkey\r\n$5\r\nvalue\r\n";
+    size_t consumed;
+    
+    CU_ASSERT_EQUAL(resp_parse(&parser, buf, strlen(buf), &consumed), RESP_OK);
+    CU_ASSERT_EQUAL(consumed, strlen("*3\r\n$3\r\nSET\r\n$3\r\nkey\r\n$5\r\nvalue\r\n"));
+    CU_ASSERT_EQUAL(parser.argc, 3);
+    CU_ASSERT_STRING_EQUAL(parser.argv[0], "SET");
+    CU_ASSERT_STRING_EQUAL(parser.argv[1], "key");
+    CU_ASSERT_STRING_EQUAL(parser.argv[2], "value");
+    CU_ASSERT_EQUAL(parser.argv_len[2], 5);
+    
+    // Arguments are slices of the input, not copies
+    CU_ASSERT_PTR_EQUAL(parser.argv[0], buf + 8);
+    resp_parser_reset(&parser);
+}
+
+static void test_binary_payload(void) {
+    char buf[] = "*2\r\n$3\r\nSET\r\n$7\r\na b\0c\r\n\r\n";
+    size_t len = sizeof(buf) - 1;
+    size_t consumed;
+    
+    CU_ASSERT_EQUAL(resp_parse(&parser, buf, len, &consumed), RESP_OK);
+    CU_ASSERT_EQUAL(consumed, len);
+    CU_ASSERT_EQUAL(parser.argc, 2);
+    CU_ASSERT_EQUAL(parser.argv_len[1], 7);
+    CU_ASSERT(memcmp(parser.argv[1], "a b\0c\r\n", 7) == 0);
+    resp_parser_reset(&parser);
+}
+
+static void test_partial_frames(void) {
+    const char* frame = "*2\r\n$3\r\nGET\r\n$10\r\n0123456789\r\n";
+    size_t len = strlen(frame);
+    char buf[64];
+    size_t consumed;
+    
+    // Feed the frame one byte at a time; only the last byte completes it
+    for (size_t i = 1; i < len; i++) {
+        memcpy(buf, frame, i);
+        CU_ASSERT_EQUAL(resp_parse(&parser, buf, i, &consumed), RESP_INCOMPLETE);
+    }
+    
+    memcpy(buf, frame, len);
+    CU_ASSERT_EQUAL(resp_parse(&parser, buf, len, &consumed), RESP_OK);
+    CU_ASSERT_EQUAL(consumed, len);
+    CU_ASSERT_STRING_EQUAL(parser.argv[1], "0123456789");
+    resp_parser_reset(&parser);
+}
+
+static void test_pipelined_frames(void) {
+    char buf[] = "*1\r\n$4\r\nPING\r\n*2\r\n$3\r\nGET\r\n$1\r\nk\r\n";
+    size_t consumed;
+    
+    CU_ASSERT_EQUAL(resp_parse(&parser, buf, strlen(buf), &consumed), RESP_OK);
+    CU_ASSERT_EQUAL(consumed, 14);
+    CU_ASSERT_EQUAL(parser.argc, 1);
+    resp_parser_reset(&parser);
+    
+    CU_ASSERT_EQUAL(resp_parse(&parser, buf + 14, sizeof(buf) - 1 - 14, &consumed), RESP_OK);
+    CU_ASSERT_EQUAL(parser.argc, 2);
+    CU_ASSERT_STRING_EQUAL(parser.argv[1], "k");
+    resp_parser_reset(&parser);
+}
+
+static void test_inline(void) {
+    char buf[] = "SET  key\tvalue\r\nGET key\r\n";
+    size_t consumed;
+    
+    CU_ASSERT_EQUAL(resp_parse(&parser, buf, strlen(buf), &consumed), RESP_OK);
+    CU_ASSERT_EQUAL(consumed, 16);
+    CU_ASSERT_EQUAL(parser.argc, 3);
+    CU_ASSERT_STRING_EQUAL(parser.argv[0], "SET");
+    CU_ASSERT_STRING_EQUAL(parser.argv[1], "key");
+    CU_ASSERT_STRING_EQUAL(parser.argv[2], "value");
+    resp_parser_reset(&parser);
+    
+    char partial[] = "GET ke";
+    CU_ASSERT_EQUAL(resp_parse(&parser, partial, strlen(partial), &consumed), RESP_INCOMPLETE);
+    resp_parser_reset(&parser);
+}
+
+static void test_many_arguments(void) {
+    char buf[4096];
+    size_t len = snprintf(buf, sizeof(buf), "*100\r\n");
+    for (int i = 0; i < 100; i++) {
+        len += snprintf(buf + len, sizeof(buf) - len, "$1\r\n%c\r\n", 'a' + i % 26);
+    }
+    size_t consumed;
+    
+    CU_ASSERT_EQUAL(resp_parse(&parser, buf, len, &consumed), RESP_OK);
+    CU_ASSERT_EQUAL(parser.argc, 100);
+    CU_ASSERT_STRING_EQUAL(parser.argv[99], "v");
+    resp_parser_reset(&parser);
+}
+
+static void test_protocol_errors(void) {
+    size_t consumed;
+    
+    char bad_count[] = "*x\r\n";
+    CU_ASSERT_EQUAL(resp_parse(&parser, bad_count, strlen(bad_count), &consumed), RESP_ERROR);
+    resp_parser_reset(&parser);
+    
+    char missing_dollar[] = "*1\r\n+GET\r\n";
+    CU_ASSERT_EQUAL(resp_parse(&parser, missing_dollar, strlen(missing_dollar), &consumed), RESP_ERROR);
+    resp_parser_reset(&parser);
+    
+    char bad_terminator[] = "*1\r\n$3\r\nGETXX";
+    CU_ASSERT_EQUAL(resp_parse(&parser, bad_terminator, strlen(bad_terminator), &consumed), RESP_ERROR);
+    resp_parser_reset(&parser);
+    
+    char negative_bulk[] = "*1\r\n$-5\r\n";
+    CU_ASSERT_EQUAL(resp_parse(&parser, negative_bulk, strlen(negative_bulk), &consumed), RESP_ERROR);
+    resp_parser_reset(&parser);
+}
+
+// "SET k <value_len bytes>" into frame; returns its length and sets
+// *header to the offset of the payload
+static size_t big_frame(char* frame, size_t value_len, size_t* header) {
+    *header = snprintf(frame, 64, "*3\r\n$3\r\nSET\r\n$1\r\nk\r\n$%zu\r\n", value_len);
+    memset(frame + *header, 'v', value_len);
+    memcpy(frame + *header + value_len, "\r\n", 2);
+    return *header + value_len + 2;
+}
+
+static void test_big_bulk(void) {
+    size_t value_len = RESP_BIG_BULK_LEN + 100;
+    char* frame = malloc(64 + value_len);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(frame);
+    size_t header;
+    size_t len = big_frame(frame, value_len, &header);
+    size_t consumed;
+    
+    // Part of the payload is in: it moves to a buffer of its own
+    CU_ASSERT_EQUAL(resp_parse(&parser, frame, header + 10, &consumed), RESP_INCOMPLETE);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(parser.bulk_buf);
+    CU_ASSERT_EQUAL(parser.pos, header);
+    CU_ASSERT_EQUAL(parser.bulk_filled, 10);
+    CU_ASSERT_EQUAL(parser.need, 0);
+    
+    // Feeding stops at the end of the bulk
+    CU_ASSERT_EQUAL(resp_parser_feed_bulk(&parser, frame + header + 10, len - header), len - header - 10);
+    CU_ASSERT_EQUAL(resp_parse(&parser, frame, header, &consumed), RESP_OK);
+    CU_ASSERT_EQUAL(consumed, header);
+    CU_ASSERT_EQUAL(parser.argc, 3);
+    CU_ASSERT_STRING_EQUAL(parser.argv[1], "k");
+    CU_ASSERT_EQUAL(parser.argv_len[2], value_len);
+    CU_ASSERT_PTR_EQUAL(parser.argv[2], parser.arg_owned[2]);
+    CU_ASSERT_EQUAL(parser.argv[2][value_len], '\0');
+    CU_ASSERT_PTR_NULL(parser.arg_owned[1]);
+    resp_parser_reset(&parser);
+    
+    // Already complete in the buffer: parsed in place as usual
+    len = big_frame(frame, value_len, &header);
+    CU_ASSERT_EQUAL(resp_parse(&parser, frame, len, &consumed), RESP_OK);
+    CU_ASSERT_EQUAL(consumed, len);
+    CU_ASSERT_PTR_NULL(parser.arg_owned[2]);
+    CU_ASSERT_PTR_EQUAL(parser.argv[2], frame + header);
+    resp_parser_reset(&parser);
+    
+    // A bad terminator is still caught
+    len = big_frame(frame, value_len, &header);
+    frame[len - 2] = 'X';
+    CU_ASSERT_EQUAL(resp_parse(&parser, frame, header + 1, &consumed), RESP_INCOMPLETE);
+    resp_parser_feed_bulk(&parser, frame + header + 1, len - header - 1);
+    CU_ASSERT_EQUAL(resp_parse(&parser, frame, header, &consumed), RESP_ERROR);
+    resp_parser_reset(&parser);
+    free(frame);
+}
+
+// Test suite initialization
+int init_resp_suite(void) {
+    CU_pSuite suite = CU_add_suite("RESP Parser Tests", setup, teardown);
+    if (!suite) return CU_get_error();
+    
+    // Add test cases
+    if (!CU_add_test(suite, "test_multibulk", test_multibulk) ||
+        !CU_add_test(suite, "test_binary_payload", test_binary_payload) ||
+        !CU_add_test(suite, "test_partial_frames", test_partial_frames) ||
+        !CU_add_test(suite, "test_pipelined_frames", test_pipelined_frames) ||
+        !CU_add_test(suite, "test_inline", test_inline) ||
+        !CU_add_test(suite, "test_many_arguments", test_many_arguments) ||
+        !CU_add_test(suite, "test_protocol_errors", test_protocol_errors) ||
+        !CU_add_test(suite, "test_big_bulk", test_big_bulk)) {
+        return CU_get_error();
+    }
+    
+    return CUE_SUCCESS;
+} 
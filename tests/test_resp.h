@@ -0,0 +1,9 @@
+#ifndef TEST_RESP_H
+#define TEST_RESP_H
+
+#include <CUnit/CUnit.h>
+
+// Test suite initialization
+int init_resp_suite(void);
+
+#endif // TEST_RESP_H 
@@ -0,0 +1,194 @@
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <CUnit/Automated.h>
+#include <CUnit/Console.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include "../src/server/shard.h"
+
+#define TRANSFER_COUNT 200000
+
+// Test fixtures
+static SpscQueue* queue;
+
+// Setup and teardown functions
+static int setup(void) {
+    queue = spsc_create(8);
+    return queue ? 0 : -1;
+}
+
+static int teardown(void) {
+    spsc_destroy(queue);
+    return 0;
+}
+
+// Test cases
+static void test_spsc_fifo(void) {
+    int values[3] = {1, 2, 3};
+    
+    CU_ASSERT_TRUE(spsc_empty(queue));
+    CU_ASSERT_PTR_NULL(spsc_pop(queue));
+    
+    for (int i = 0; i < 3; i++) {
+        CU_ASSERT_TRUE(spsc_push(queue, &values[i]));
+    }
+    CU_ASSERT_FALSE(spsc_empty(queue));
+    
+    for (int i = 0; i < 3; i++) {
+        CU_ASSERT_PTR_EQUAL(spsc_pop(queue), &values[i]);
+    }
+    CU_ASSERT_TRUE(spsc_empty(queue));
+}
+
+static void test_spsc_full(void) {
+    int value = 0;
+    
+    // Capacity is exact once rounded to a power of two
+    for (int i = 0; i < 8; i++) {
+        CU_ASSERT_TRUE(spsc_push(queue, &value));
+    }
+    CU_ASSERT_FALSE(spsc_push(queue, &value));
+    
+    CU_ASSERT_PTR_EQUAL(spsc_pop(queue), &value);
+    CU_ASSERT_TRUE(spsc_push(queue, &value));
+    
+    while (spsc_pop(queue));
+    CU_ASSERT_TRUE(spsc_empty(queue));
+}
+
+static void test_spsc_wraparound(void) {
+    uintptr_t next_push = 1;
+    uintptr_t next_pop = 1;
+    
+    // Keep the queue partly filled while the indexes wrap many times
+    for (int round = 0; round < 100; round++) {
+        while (spsc_push(queue, (void*)next_push)) next_push++;
+        for (int i = 0; i < 5; i++) {
+            CU_ASSERT_EQUAL((uintptr_t)spsc_pop(queue), next_pop);
+            next_pop++;
+        }
+    }
+    
+    void* item;
+    while ((item = spsc_pop(queue)) != NULL) {
+        CU_ASSERT_EQUAL((uintptr_t)item, next_pop);
+        next_pop++;
+    }
+    CU_ASSERT_EQUAL(next_pop, next_push);
+}
+
+static void* producer_main(void* arg) {
+    SpscQueue* q = arg;
+    for (uintptr_t i = 1; i <= TRANSFER_COUNT; i++) {
+        while (!spsc_push(q, (void*)i)) sched_yield();
+    }
+    return NULL;
+}
+
+static void test_spsc_threads(void) {
+    SpscQueue* shared = spsc_create(1024);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(shared);
+    
+    pthread_t producer;
+    CU_ASSERT_EQUAL_FATAL(pthread_create(&producer, NULL, producer_main, shared), 0);
+    
+    // Items arrive complete and in order
+    uintptr_t expected = 1;
+    bool ordered = true;
+    while (expected <= TRANSFER_COUNT) {
+        void* item = spsc_pop(shared);
+        if (!item) {
+            sched_yield();
+            continue;
+        }
+        if ((uintptr_t)item != expected) ordered = false;
+        expected++;
+    }
+    
+    pthread_join(producer, NULL);
+    CU_ASSERT_TRUE(ordered);
+    CU_ASSERT_TRUE(spsc_empty(shared));
+    spsc_destroy(shared);
+}
+
+static int route(int count, int argc, const char** args) {
+    char* argv[8];
+    size_t argv_len[8];
+    for (int i = 0; i < argc; i++) {
+        argv[i] = (char*)args[i];
+        argv_len[i] = strlen(args[i]);
+    }
+    return shard_route(count, argc, argv, argv_len);
+}
+
+static void test_route_single_key(void) {
+    const char* get[] = {"GET", "user:1"};
+    const char* set[] = {"SET", "user:1", "x"};
+    
+    int shard = route(4, 2, get);
+    CU_ASSERT(shard >= 0 && shard < 4);
+    CU_ASSERT_EQUAL(route(4, 3, set), shard);
+    
+    // One shard owns everything
+    CU_ASSERT_EQUAL(route(1, 2, get), SHARD_ANY);
+    
+    // No key at all
+    const char* bare[] = {"GET"};
+    CU_ASSERT_EQUAL(route(4, 1, bare), SHARD_ANY);
+}
+
+static void test_route_hash_tags(void) {
+    const char* a[] = {"GET", "{user:1}.name"};
+    const char* b[] = {"GET", "{user:1}.email"};
+    const char* c[] = {"GET", "user:1"};
+    
+    CU_ASSERT_EQUAL(route(16, 2, a), route(16, 2, b));
+    CU_ASSERT_EQUAL(route(16, 2, a), route(16, 2, c));
+}
+
+static void test_route_multi_key(void) {
+    const char* tagged[] = {"PFMERGE", "{hll}dst", "{hll}a", "{hll}b"};
+    CU_ASSERT(route(8, 4, tagged) >= 0);
+    
+    // Find two keys that land on different shards
+    char first[16], second[16];
+    snprintf(first, sizeof(first), "key:0");
+    const char* probe[] = {"GET", first};
+    int owner = route(8, 2, probe);
+    for (int i = 1; i < 100; i++) {
+        snprintf(second, sizeof(second), "key:%d", i);
+        const char* other[] = {"GET", second};
+        if (route(8, 2, other) != owner) break;
+    }
+    
+    const char* spread[] = {"PFCOUNT", first, second};
+    CU_ASSERT_EQUAL(route(8, 3, spread), SHARD_CROSS);
+    
+    // XREAD keys sit between STREAMS and the ids
+    const char* xread[] = {"XREAD", "COUNT", "10", "STREAMS", "{s}a", "{s}b", "0", "0"};
+    CU_ASSERT(route(8, 8, xread) >= 0);
+    const char* xspread[] = {"XREAD", "STREAMS", first, second, "0", "0"};
+    CU_ASSERT_EQUAL(route(8, 6, xspread), SHARD_CROSS);
+}
+
+// Test suite initialization
+int init_shard_suite(void) {
+    CU_pSuite suite = CU_add_suite("Shard Tests", setup, teardown);
+    if (!suite) return CU_get_error();
+    
+    // Add test cases
+    if (!CU_add_test(suite, "test_spsc_fifo", test_spsc_fifo) ||
+        !CU_add_test(suite, "test_spsc_full", test_spsc_full) ||
+        !CU_add_test(suite, "test_spsc_wraparound", test_spsc_wraparound) ||
+        !CU_add_test(suite, "test_spsc_threads", test_spsc_threads) ||
+        !CU_add_test(suite, "test_route_single_key", test_route_single_key) ||
+        !CU_add_test(suite, "test_route_hash_tags", test_route_hash_tags) ||
+        !CU_add_test(suite, "test_route_multi_key", test_route_multi_key)) {
+        return CU_get_error();
+    }
+    
+    return CUE_SUCCESS;
+}
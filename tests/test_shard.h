@@ -0,0 +1,9 @@
+#ifndef TEST_SHARD_H
+#define TEST_SHARD_H
+
+#include <CUnit/CUnit.h>
+
+// Test suite initialization
+int init_shard_suite(void);
+
+#endif // TEST_SHARD_H 
@@ -0,0 +1,229 @@
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <CUnit/Automated.h>
+#include <CUnit/Console.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/server/server.h"
+
+// Test fixtures
+static Server* server;
+static Client* client;
+
+// Setup and teardown functions
+static int setup(void) {
+    server = server_create(DEFAULT_HOST, 0, 16);
+    client = client_create(-1);
+    return server && client ? 0 : -1;
+}
+
+static int teardown(void) {
+    client_free(client);
+    server_destroy(server);
+    return 0;
+}
+
+static void assert_reply_bytes(const char* expected, size_t expected_len) {
+    size_t len;
+    char* reply = client_take_reply(client, &len);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(reply);
+    CU_ASSERT_EQUAL(len, expected_len);
+    CU_ASSERT_TRUE(len == expected_len && memcmp(reply, expected, len) == 0);
+    free(reply);
+}
+
+#define assert_reply(expected) assert_reply_bytes(expected, sizeof(expected) - 1)
+
+// Run a command as if parsed from the client's query buffer
+static bool run_bytes(char** args, size_t* argv_len, int argc) {
+    char* argv_owned[128] = {0};
+    client->argc = argc;
+    client->argv = args;
+    client->argv_len = argv_len;
+    client->argv_owned = argv_owned;
+    
+    bool ok = handle_command(server, client, args[0], args, argc);
+    client->argv = NULL;
+    client->argv_len = NULL;
+    client->argv_owned = NULL;
+    return ok;
+}
+
+static bool run(char** args, int argc) {
+    size_t argv_len[128];
+    for (int i = 0; i < argc; i++) argv_len[i] = strlen(args[i]);
+    return run_bytes(args, argv_len, argc);
+}
+
+#define RUN(...) run((char*[]){__VA_ARGS__}, sizeof((char*[]){__VA_ARGS__}) / sizeof(char*))
+
+// Test cases
+static void test_mset_mget(void) {
+    CU_ASSERT_TRUE(RUN("MSET", "a", "1", "b", "22"));
+    CU_ASSERT_TRUE(RUN("MGET", "a", "missing", "b", "a"));
+    assert_reply("+OK\r\n*4\r\n$1\r\n1\r\n$-1\r\n$2\r\n22\r\n$1\r\n1\r\n");
+    
+    CU_ASSERT_FALSE(RUN("MSET", "a", "1", "b"));
+    assert_reply("-ERR wrong number of arguments for 'mset' command\r\n");
+    
+    // MSETNX sets all of them or none
+    CU_ASSERT_TRUE(RUN("MSETNX", "c", "3", "a", "x"));
+    CU_ASSERT_TRUE(RUN("MSETNX", "c", "3", "d", "4"));
+    CU_ASSERT_TRUE(RUN("MGET", "a", "c", "d"));
+    assert_reply(":0\r\n:1\r\n*3\r\n$1\r\n1\r\n$1\r\n3\r\n$1\r\n4\r\n");
+}
+
+static void test_del_exists(void) {
+    CU_ASSERT_TRUE(RUN("MSET", "x1", "v", "x2", "v"));
+    CU_ASSERT_TRUE(RUN("EXISTS", "x1", "x1", "nope", "x2"));
+    CU_ASSERT_TRUE(RUN("DEL", "x1", "x1", "nope"));
+    CU_ASSERT_TRUE(RUN("UNLINK", "x2"));
+    CU_ASSERT_TRUE(RUN("EXISTS", "x1", "x2"));
+    assert_reply("+OK\r\n:3\r\n:1\r\n:1\r\n:0\r\n");
+}
+
+// More keys than one lookup batch
+static void test_many_keys(void) {
+    enum { KEYS = HASHMAP_BATCH * 2 + 3 };
+    char names[KEYS][8];
+    char* mset[1 + KEYS * 2];
+    char* mget[1 + KEYS];
+    mset[0] = "MSET";
+    mget[0] = "MGET";
+    for (int i = 0; i < KEYS; i++) {
+        snprintf(names[i], sizeof(names[i]), "m%d", i);
+        mset[1 + i * 2] = names[i];
+        mset[2 + i * 2] = names[i];
+        mget[1 + i] = names[i];
+    }
+    
+    CU_ASSERT_TRUE(run(mset, 1 + KEYS * 2));
+    CU_ASSERT_TRUE(run(mget, 1 + KEYS));
+    
+    size_t len;
+    char* reply = client_take_reply(client, &len);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(reply);
+    CU_ASSERT_TRUE(strncmp(reply, "+OK\r\n*35\r\n$2\r\nm0\r\n", 18) == 0);
+    CU_ASSERT_TRUE(len > 7 && memcmp(reply + len - 7, "\r\nm34\r\n", 7) == 0);
+    free(reply);
+    
+    mget[0] = "DEL";
+    CU_ASSERT_TRUE(run(mget, 1 + KEYS));
+    assert_reply(":35\r\n");
+}
+
+static void test_reply_cache(void) {
+    CU_ASSERT_TRUE(RUN("SET", "hot", "value"));
+    RedisString* str = hashmap_get(server->db, "hot", sizeof("hot") - 1)->data;
+    
+    // Built on the second read, then sent as is
+    CU_ASSERT_TRUE(RUN("GET", "hot"));
+    CU_ASSERT_PTR_NULL(str->reply);
+    CU_ASSERT_TRUE(RUN("GET", "hot"));
+    CU_ASSERT_PTR_NOT_NULL_FATAL(str->reply);
+    CU_ASSERT_EQUAL(str->reply_len, 11);
+    CU_ASSERT_TRUE(RUN("MGET", "hot"));
+    assert_reply("+OK\r\n$5\r\nvalue\r\n$5\r\nvalue\r\n*1\r\n$5\r\nvalue\r\n");
+    
+    // A write stores a new value without one
+    CU_ASSERT_TRUE(RUN("SET", "hot", "v2"));
+    CU_ASSERT_TRUE(RUN("GET", "hot"));
+    assert_reply("+OK\r\n$2\r\nv2\r\n");
+    CU_ASSERT_PTR_NULL(((RedisString*)hashmap_get(server->db, "hot", sizeof("hot") - 1)->data)->reply);
+    
+    // Values over the size limit are never cached
+    server->config.reply_cache_max_bytes = 1;
+    for (int i = 0; i < 3; i++) CU_ASSERT_TRUE(RUN("GET", "hot"));
+    assert_reply("$2\r\nv2\r\n$2\r\nv2\r\n$2\r\nv2\r\n");
+    CU_ASSERT_PTR_NULL(((RedisString*)hashmap_get(server->db, "hot", sizeof("hot") - 1)->data)->reply);
+    server->config.reply_cache_max_bytes = REPLY_CACHE_MAX_BYTES;
+}
+
+static void test_counters(void) {
+    CU_ASSERT_TRUE(RUN("INCR", "n"));
+    CU_ASSERT_TRUE(RUN("INCRBY", "n", "41"));
+    CU_ASSERT_TRUE(RUN("DECR", "n"));
+    CU_ASSERT_TRUE(RUN("DECRBY", "n", "-10"));
+    CU_ASSERT_TRUE(RUN("GET", "n"));
+    assert_reply(":1\r\n:42\r\n:41\r\n:51\r\n$2\r\n51\r\n");
+    
+    // Held in the object and changed in place
+    RedisObject* obj = hashmap_get(server->db, "n", sizeof("n") - 1);
+    CU_ASSERT_EQUAL(obj->encoding, REDIS_ENCODING_INT);
+    CU_ASSERT_TRUE(RUN("INCR", "n"));
+    CU_ASSERT_PTR_EQUAL(hashmap_get(server->db, "n", sizeof("n") - 1), obj);
+    CU_ASSERT_EQUAL(obj->integer, 52);
+    assert_reply(":52\r\n");
+    
+    // SET stores integers the same way, but only in their canonical form
+    CU_ASSERT_TRUE(RUN("MSET", "i", "-9223372036854775808", "s", "007"));
+    CU_ASSERT_EQUAL(hashmap_get(server->db, "i", sizeof("i") - 1)->encoding, REDIS_ENCODING_INT);
+    CU_ASSERT_EQUAL(hashmap_get(server->db, "s", sizeof("s") - 1)->encoding, REDIS_ENCODING_EMBSTR);
+    CU_ASSERT_TRUE(RUN("MGET", "i", "s"));
+    CU_ASSERT_FALSE(RUN("DECR", "i"));
+    CU_ASSERT_FALSE(RUN("INCR", "s"));
+    CU_ASSERT_FALSE(RUN("INCRBY", "n", "1x"));
+    assert_reply("+OK\r\n*2\r\n$20\r\n-9223372036854775808\r\n$3\r\n007\r\n"
+                 "-ERR increment or decrement would overflow\r\n"
+                 "-ERR value is not an integer or out of range\r\n"
+                 "-ERR value is not an integer or out of range\r\n");
+    
+    CU_ASSERT_TRUE(RUN("INCRBYFLOAT", "n", "0.5"));
+    CU_ASSERT_TRUE(RUN("INCRBYFLOAT", "n", "-0.5"));
+    CU_ASSERT_FALSE(RUN("INCRBYFLOAT", "n", "abc"));
+    assert_reply("$4\r\n52.5\r\n$2\r\n52\r\n-ERR value is not a valid float\r\n");
+    CU_ASSERT_EQUAL(hashmap_get(server->db, "n", sizeof("n") - 1)->encoding, REDIS_ENCODING_INT);
+}
+
+static void test_embedded_strings(void) {
+    char long_value[REDIS_EMBSTR_MAX_LEN + 1];
+    memset(long_value, 'x', REDIS_EMBSTR_MAX_LEN);
+    long_value[REDIS_EMBSTR_MAX_LEN] = '\0';
+    
+    CU_ASSERT_TRUE(RUN("MSET", "short", "abc", "long", long_value));
+    RedisObject* obj = hashmap_get(server->db, "short", sizeof("short") - 1);
+    CU_ASSERT_EQUAL(obj->encoding, REDIS_ENCODING_EMBSTR);
+    CU_ASSERT_PTR_EQUAL(obj->data, obj + 1);
+    CU_ASSERT_EQUAL(hashmap_get(server->db, "long", sizeof("long") - 1)->encoding, REDIS_ENCODING_RAW);
+    
+    CU_ASSERT_TRUE(RUN("GET", "short"));
+    CU_ASSERT_TRUE(RUN("GET", "short"));
+    CU_ASSERT_TRUE(RUN("DEL", "short", "long"));
+    assert_reply("+OK\r\n$3\r\nabc\r\n$3\r\nabc\r\n:2\r\n");
+}
+
+static void test_binary_keys(void) {
+    // Keys and values that differ only past a NUL byte
+    char* set1[] = {"SET", "k\0a", "v\0\r\n1"};
+    char* set2[] = {"SET", "k\0b", "2"};
+    char* get[] = {"GET", "k\0a"};
+    char* exists[] = {"EXISTS", "k", "k\0a", "k\0b", "k\0c"};
+    CU_ASSERT_TRUE(run_bytes(set1, (size_t[]){3, 3, 5}, 3));
+    CU_ASSERT_TRUE(run_bytes(set2, (size_t[]){3, 3, 1}, 3));
+    CU_ASSERT_TRUE(run_bytes(get, (size_t[]){3, 3}, 2));
+    CU_ASSERT_TRUE(run_bytes(exists, (size_t[]){6, 1, 3, 3, 3}, 5));
+    assert_reply("+OK\r\n+OK\r\n$5\r\nv\0\r\n1\r\n:2\r\n");
+    
+    CU_ASSERT_PTR_NULL(hashmap_get(server->db, "k", 1));
+    CU_ASSERT_PTR_NOT_NULL(hashmap_get(server->db, "k\0b", 3));
+}
+
+// Test suite initialization
+int init_string_commands_suite(void) {
+    CU_pSuite suite = CU_add_suite("String Command Tests", setup, teardown);
+    if (!suite) return CU_get_error();
+    
+    // Add test cases
+    if (!CU_add_test(suite, "test_mset_mget", test_mset_mget) ||
+        !CU_add_test(suite, "test_del_exists", test_del_exists) ||
+        !CU_add_test(suite, "test_many_keys", test_many_keys) ||
+        !CU_add_test(suite, "test_reply_cache", test_reply_cache) ||
+        !CU_add_test(suite, "test_counters", test_counters) ||
+        !CU_add_test(suite, "test_embedded_strings", test_embedded_strings) ||
+        !CU_add_test(suite, "test_binary_keys", test_binary_keys)) {
+        return CU_get_error();
+    }
+    
+    return CUE_SUCCESS;
+}
@@ -0,0 +1,9 @@
+#ifndef TEST_STRING_COMMANDS_H
+#define TEST_STRING_COMMANDS_H
+
+#include <CUnit/CUnit.h>
+
+// Test suite initialization
+int init_string_commands_suite(void);
+
+#endif // TEST_STRING_COMMANDS_H 
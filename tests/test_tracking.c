@@ -0,0 +1,171 @@
+#include <CUnit/CUnit.h>
+#include <CUnit/Basic.h>
+#include <CUnit/Automated.h>
+#include <CUnit/Console.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/server/tracking.h"
+
+// Test fixtures: alice caches, bob receives her invalidations
+static Server* server;
+static Client* alice;
+static Client* bob;
+static char bob_id[32];
+
+// Setup and teardown functions
+static int setup(void) {
+    server = server_create(DEFAULT_HOST, 0, 16);
+    alice = client_create(-1);
+    bob = client_create(-1);
+    if (!server || !alice || !bob) return -1;
+    
+    // Registered clients are freed with the server
+    server_register_client(server, alice);
+    server_register_client(server, bob);
+    snprintf(bob_id, sizeof(bob_id), "%llu", (unsigned long long)bob->id);
+    return 0;
+}
+
+static int teardown(void) {
+    server_destroy(server);
+    return 0;
+}
+
+static void assert_reply_bytes(Client* client, const char* expected, size_t expected_len) {
+    size_t len;
+    char* reply = client_take_reply(client, &len);
+    CU_ASSERT_PTR_NOT_NULL_FATAL(reply);
+    CU_ASSERT_EQUAL(len, expected_len);
+    CU_ASSERT_TRUE(len == expected_len && memcmp(reply, expected, len) == 0);
+    free(reply);
+}
+
+#define assert_reply(client, expected) assert_reply_bytes(client, expected, sizeof(expected) - 1)
+
+static void drop_reply(Client* client) {
+    size_t len;
+    free(client_take_reply(client, &len));
+}
+
+// Run a command as if parsed from the client's query buffer
+static bool run(Client* client, char** args, int argc) {
+    size_t argv_len[16];
+    char* argv_owned[16] = {0};
+    for (int i = 0; i < argc; i++) argv_len[i] = strlen(args[i]);
+    client->argc = argc;
+    client->argv = args;
+    client->argv_len = argv_len;
+    client->argv_owned = argv_owned;
+    
+    bool ok = handle_command(server, client, args[0], args, argc);
+    client->argv = NULL;
+    client->argv_len = NULL;
+    client->argv_owned = NULL;
+    return ok;
+}
+
+#define INVALIDATE(key) "*3\r\n$7\r\nmessage\r\n$20\r\n__redis__:invalidate\r\n*1\r\n$1\r\n" key "\r\n"
+
+// Test cases
+static void test_redirect_required(void) {
+    char* no_redirect[] = {"CLIENT", "TRACKING", "on"};
+    CU_ASSERT_FALSE(run(alice, no_redirect, 3));
+    drop_reply(alice);
+    
+    char* unknown[] = {"CLIENT", "TRACKING", "on", "REDIRECT", "999999"};
+    CU_ASSERT_FALSE(run(alice, unknown, 5));
+    drop_reply(alice);
+    
+    char* prefix[] = {"CLIENT", "TRACKING", "on", "REDIRECT", bob_id, "PREFIX", "a"};
+    CU_ASSERT_FALSE(run(alice, prefix, 7));
+    drop_reply(alice);
+    CU_ASSERT_FALSE(alice->tracking.enabled);
+}
+
+static void subscribe_bob(void) {
+    char* subscribe[] = {"SUBSCRIBE", "__redis__:invalidate"};
+    CU_ASSERT_TRUE(run(bob, subscribe, 2));
+    drop_reply(bob);
+}
+
+static void test_default_mode(void) {
+    subscribe_bob();
+    char* on[] = {"CLIENT", "TRACKING", "on", "REDIRECT", bob_id};
+    CU_ASSERT_TRUE(run(alice, on, 5));
+    assert_reply(alice, "+OK\r\n");
+    
+    char* get[] = {"GET", "k"};
+    CU_ASSERT_TRUE(run(alice, get, 2));
+    drop_reply(alice);
+    CU_ASSERT_EQUAL(tracking_key_count(server), 1);
+    
+    // Invalidated once, then forgotten until read again
+    char* set[] = {"SET", "k", "v"};
+    CU_ASSERT_TRUE(run(alice, set, 3));
+    drop_reply(alice);
+    assert_reply(bob, INVALIDATE("k"));
+    CU_ASSERT_EQUAL(tracking_key_count(server), 0);
+    CU_ASSERT_TRUE(run(alice, set, 3));
+    drop_reply(alice);
+    CU_ASSERT_FALSE(client_has_pending_reply(bob));
+    
+    // Past the table limit the oldest key is invalidated right away
+    server->config.tracking_table_max_keys = 2;
+    char* a[] = {"GET", "a"};
+    char* b[] = {"GET", "b"};
+    char* c[] = {"GET", "c"};
+    CU_ASSERT_TRUE(run(alice, a, 2));
+    CU_ASSERT_TRUE(run(alice, b, 2));
+    CU_ASSERT_TRUE(run(alice, c, 2));
+    drop_reply(alice);
+    CU_ASSERT_EQUAL(tracking_key_count(server), 2);
+    assert_reply(bob, INVALIDATE("a"));
+    server->config.tracking_table_max_keys = TRACKING_TABLE_MAX_KEYS;
+    
+    char* off[] = {"CLIENT", "TRACKING", "off"};
+    CU_ASSERT_TRUE(run(alice, off, 3));
+    drop_reply(alice);
+}
+
+static void test_broadcast_mode(void) {
+    subscribe_bob();
+    char* on[] = {"CLIENT", "TRACKING", "on", "REDIRECT", bob_id, "BCAST", "PREFIX", "u:", "NOLOOP"};
+    CU_ASSERT_TRUE(run(alice, on, 9));
+    drop_reply(alice);
+    
+    char* overlap[] = {"CLIENT", "TRACKING", "on", "REDIRECT", bob_id, "BCAST", "PREFIX", "u:1"};
+    CU_ASSERT_FALSE(run(alice, overlap, 8));
+    drop_reply(alice);
+    
+    // No read needed, only the prefix counts
+    tracking_key_modified("u:1", 3, server);
+    assert_reply(bob, "*3\r\n$7\r\nmessage\r\n$20\r\n__redis__:invalidate\r\n*1\r\n$3\r\nu:1\r\n");
+    tracking_key_modified("x", 1, server);
+    CU_ASSERT_FALSE(client_has_pending_reply(bob));
+    
+    // NOLOOP: not for alice's own writes
+    char* set[] = {"SET", "u:2", "v"};
+    CU_ASSERT_TRUE(run(alice, set, 3));
+    drop_reply(alice);
+    CU_ASSERT_FALSE(client_has_pending_reply(bob));
+    
+    tracking_disable(server, alice);
+    tracking_key_modified("u:1", 3, server);
+    CU_ASSERT_FALSE(client_has_pending_reply(bob));
+}
+
+// Test suite initialization
+int init_tracking_suite(void) {
+    CU_pSuite suite = CU_add_suite("Client Tracking Tests", setup, teardown);
+    if (!suite) return CU_get_error();
+    
+    // Add test cases
+    if (!CU_add_test(suite, "test_redirect_required", test_redirect_required) ||
+        !CU_add_test(suite, "test_default_mode", test_default_mode) ||
+        !CU_add_test(suite, "test_broadcast_mode", test_broadcast_mode)) {
+        return CU_get_error();
+    }
+    
+    return CUE_SUCCESS;
+}
@@ -0,0 +1,9 @@
+#ifndef TEST_TRACKING_H
+#define TEST_TRACKING_H
+
+#include <CUnit/CUnit.h>
+
+// Test suite initialization
+int init_tracking_suite(void);
+
+#endif // TEST_TRACKING_H 